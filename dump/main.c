@@ -23,6 +23,27 @@
 #define bitsToBytes(x) ((x>>3) + (x&7 ? 1 : 0))
 #define printAddrs() if ( wantAddrs ) printf("%08tX: ", p-buffer)
 
+// A simple model of the link to the micro, for estimating where the programming time goes
+struct Link {
+	double latency;    // seconds per control transfer
+	double bandwidth;  // bulk bytes per second
+	double tckRate;    // TCK cycles per second
+};
+
+// What one record type costs in total
+struct Cost {
+	uint32 count;
+	uint64 bytes;     // bytes of bulk data
+	uint64 clocks;    // TCK cycles, including RUNTEST
+	uint64 numXfers;  // USB transactions: control transfers & 64-byte bulk packets
+	double time;
+};
+
+#define REGION_SIZE 0x1000
+#define NUM_TOP_REGIONS 5
+
+static int profile(const uint8 *buffer, size_t length, const struct Link *link);
+
 int main(int argc, const char *argv[]) {
 	const uint8 *buffer, *p, *savePtr;
 	size_t length;
@@ -30,15 +51,37 @@ int main(int argc, const char *argv[]) {
 	uint32 xsdrSize = 0;
 	uint32 numBytes, temp;
 	bool wantAddrs = true;
-	if ( argc != 2 && argc != 3 ) {
+	bool wantProfile = false;
+	struct Link link = {250e-6, 1e6, 1e6};
+	int i = 1;
+	while ( i < argc - 1 && argv[i][0] == '-' ) {
+		if ( argv[i][1] == 'n' && argv[i][2] == '\0' ) {
+			wantAddrs = false;
+		} else if ( argv[i][1] == 'p' && argv[i][2] == '\0' ) {
+			wantProfile = true;
+		} else if ( argv[i][1] == 'l' && argv[i][2] == '\0' && i < argc - 2 ) {
+			link.latency = atof(argv[++i]) * 1e-6;
+		} else if ( argv[i][1] == 'b' && argv[i][2] == '\0' && i < argc - 2 ) {
+			link.bandwidth = atof(argv[++i]) * 1e3;
+		} else if ( argv[i][1] == 't' && argv[i][2] == '\0' && i < argc - 2 ) {
+			link.tckRate = atof(argv[++i]) * 1e3;
+		} else {
+			break;
+		}
+		i++;
+	}
+	if ( i != argc - 1 || link.bandwidth <= 0.0 || link.tckRate <= 0.0 ) {
 		fprintf(stderr, "Synopsis: %s [-n] <xsvfFile>\n", argv[0]);
+		fprintf(stderr, "          %s -p [-l <latency us>] [-b <bulk KB/s>] [-t <TCK kHz>] <csvfFile>\n", argv[0]);
 		exit(1);
 	}
-	if ( argv[1][0] == '-' && argv[1][1] == 'n' && argv[1][2] == '\0' ) {
-		buffer = flLoadFile(argv[2], &length);
-		wantAddrs = false;
-	} else {
-		buffer = flLoadFile(argv[1], &length);
+	buffer = flLoadFile(argv[i], &length);
+	if ( !buffer ) {
+		fprintf(stderr, "Unable to load %s\n", argv[i]);
+		exit(1);
+	}
+	if ( wantProfile ) {
+		return profile(buffer, length, &link);
 	}
 	p = buffer;
 	byte = *p;
@@ -165,3 +208,169 @@ int main(int argc, const char *argv[]) {
 	printf("XCOMPLETE\n");
 	return 0;
 }
+
+// Estimate what each record costs to play, the way csvfPlayCommands() drives the micro: each
+// shift navigates to Shift-xR, shifts & navigates back to Run-Test/Idle, each a control transfer,
+// then clocks out any RUNTEST with another. The bulk data is pipelined, so a shift takes as long
+// as the slower of the USB and the TCK.
+//
+static int profile(const uint8 *buffer, size_t length, const struct Link *link) {
+	static const char *const names[] = {
+		"XCOMPLETE", "XTDOMASK", "XSIR", "XSDR", "XRUNTEST", NULL, NULL, NULL, "XSDRSIZE", "XSDRTDO"
+	};
+	struct Cost costs[XSDRTDO + 1] = {{0,}};
+	struct Cost total = {0,};
+	const size_t numRegions = length / REGION_SIZE + 1;
+	double *const regions = (double *)calloc(numRegions, sizeof(double));
+	const uint8 *p = buffer;
+	const uint8 *const end = buffer + length;
+	uint32 xsdrSize = 0, xruntest = 0, runClocks = 0;
+	uint64 totalRunClocks = 0, numControl = 0, numBulk = 0;
+	uint32 numBits, numBytes, numControlHere, numBulkHere, i, j;
+	size_t offset = 0;
+	uint8 byte = 0x00;
+	double time, dataTime;
+	if ( !regions ) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	while ( p < end && *p != XCOMPLETE ) {
+		offset = (size_t)(p - buffer);
+		byte = *p++;
+		numBits = numBytes = numControlHere = numBulkHere = 0;
+		dataTime = 0.0;
+		switch ( byte ) {
+		case XTDOMASK:
+			if ( (size_t)(end - p) < bitsToBytes(xsdrSize) ) {
+				goto truncated;
+			}
+			p += bitsToBytes(xsdrSize);
+			break;
+		case XRUNTEST:
+			if ( end - p < 4 ) {
+				goto truncated;
+			}
+			xruntest = (uint32)((p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+			p += 4;
+			break;
+		case XSDRSIZE:
+			if ( end - p < 4 ) {
+				goto truncated;
+			}
+			xsdrSize = (uint32)((p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+			p += 4;
+			break;
+		case XSIR:
+			if ( end - p < 1 ) {
+				goto truncated;
+			}
+			numBits = *p++;
+			numBytes = bitsToBytes(numBits);
+			if ( (size_t)(end - p) < numBytes ) {
+				goto truncated;
+			}
+			p += numBytes;
+			break;
+		case XSDR:
+			numBits = xsdrSize;
+			numBytes = bitsToBytes(numBits);
+			if ( (size_t)(end - p) < numBytes ) {
+				goto truncated;
+			}
+			p += numBytes;
+			break;
+		case XSDRTDO:
+			numBits = xsdrSize;
+			numBytes = 2*bitsToBytes(numBits);  // TDI out, TDO back
+			if ( (size_t)(end - p) < numBytes ) {
+				goto truncated;
+			}
+			p += numBytes;
+			break;
+		default:
+			fprintf(
+				stderr, "%08zX: Record %02X can't be profiled; convert to CSVF first\n",
+				offset, byte);
+			free(regions);
+			return 1;
+		}
+		if ( numBits ) {
+			runClocks = xruntest;
+			numControlHere = xruntest ? 4 : 3;
+			numBulkHere = (byte == XSDRTDO) ? 2*((numBytes/2 + 63) / 64) : (numBytes + 63) / 64;
+			dataTime = numBytes / link->bandwidth;
+			if ( numBits / link->tckRate > dataTime ) {
+				dataTime = numBits / link->tckRate;
+			}
+		} else {
+			runClocks = 0;
+		}
+		time = numControlHere * link->latency + dataTime + runClocks / link->tckRate;
+		costs[byte].count++;
+		costs[byte].bytes += numBytes;
+		costs[byte].clocks += numBits + runClocks;
+		costs[byte].numXfers += numControlHere + numBulkHere;
+		costs[byte].time += time;
+		totalRunClocks += runClocks;
+		numControl += numControlHere;
+		numBulk += numBulkHere;
+		regions[offset / REGION_SIZE] += time;
+	}
+	if ( p >= end ) {
+		fprintf(stderr, "File ends without XCOMPLETE\n");
+		free(regions);
+		return 1;
+	}
+
+	printf(
+		"Link model: %.0fus per control transfer, %.0fKB/s bulk, %.0fkHz TCK\n\n",
+		link->latency * 1e6, link->bandwidth / 1e3, link->tckRate / 1e3);
+	printf("Record        Count         Bytes          Clocks  Transactions   Est. time\n");
+	for ( i = 0; i <= XSDRTDO; i++ ) {
+		if ( costs[i].count ) {
+			printf(
+				"%-9s %9u %13llu %15llu %13llu %10.3fs\n", names[i], costs[i].count,
+				(unsigned long long)costs[i].bytes, (unsigned long long)costs[i].clocks,
+				(unsigned long long)costs[i].numXfers, costs[i].time);
+			total.count += costs[i].count;
+			total.bytes += costs[i].bytes;
+			total.clocks += costs[i].clocks;
+			total.numXfers += costs[i].numXfers;
+			total.time += costs[i].time;
+		}
+	}
+	printf(
+		"%-9s %9u %13llu %15llu %13llu %10.3fs\n\n", "Total", total.count,
+		(unsigned long long)total.bytes, (unsigned long long)total.clocks,
+		(unsigned long long)total.numXfers, total.time);
+	printf(
+		"RUNTEST clocks: %llu (%.3fs)\n", (unsigned long long)totalRunClocks,
+		totalRunClocks / link->tckRate);
+	printf(
+		"USB transactions: %llu control, %llu bulk\n\n",
+		(unsigned long long)numControl, (unsigned long long)numBulk);
+
+	// Pick out the most expensive regions, a few at a time
+	printf("Most expensive %d-byte regions:\n", REGION_SIZE);
+	for ( i = 0; i < NUM_TOP_REGIONS; i++ ) {
+		size_t worst = 0;
+		for ( j = 1; j < numRegions; j++ ) {
+			if ( regions[j] > regions[worst] ) {
+				worst = j;
+			}
+		}
+		if ( regions[worst] <= 0.0 ) {
+			break;
+		}
+		printf(
+			"  %08zX-%08zX: %10.3fs (%4.1f%%)\n", worst * REGION_SIZE,
+			(worst + 1) * REGION_SIZE - 1, regions[worst], 100.0 * regions[worst] / total.time);
+		regions[worst] = -1.0;
+	}
+	free(regions);
+	return 0;
+truncated:
+	fprintf(stderr, "%08zX: Record %02X is truncated\n", offset, byte);
+	free(regions);
+	return 1;
+}
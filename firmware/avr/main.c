@@ -147,7 +147,8 @@ int main(void) {
 	const char progOp5[] PROGMEM = "PROG_PARALLEL";
 	const char progOp6[] PROGMEM = "PROG_SPI_SEND";
 	const char progOp7[] PROGMEM = "PROG_SPI_RECV";
-	static const char *const progOpName[] PROGMEM = { progOp0, progOp1, progOp2, progOp3, progOp4, progOp5, progOp6, progOp7 };
+	const char progOp8[] PROGMEM = "PROG_SPI_BATCH";
+	static const char *const progOpName[] PROGMEM = { progOp0, progOp1, progOp2, progOp3, progOp4, progOp5, progOp6, progOp7, progOp8 };
 	const char lp0[] PROGMEM = "LP_CHOOSE";
 	const char lp1[] PROGMEM = "LP_MISO";
 	const char lp2[] PROGMEM = "LP_MOSI";
@@ -207,7 +208,7 @@ void EVENT_USB_Device_ControlRequest(void) {
 			statusBuffer[11] = (uint8)(DATE>>16);      // Version
 			statusBuffer[12] = (uint8)(DATE>>8);       // Version
 			statusBuffer[13] = (uint8)DATE;            // Version LSB
-			statusBuffer[14] = 0x00;                   // Reserved
+			statusBuffer[14] = bmCAP_SPI_BATCH;        // Capabilities
 			statusBuffer[15] = 0x00;                   // Reserved
 			Endpoint_Write_Control_Stream_LE(statusBuffer, 16);
 			Endpoint_ClearStatusStage();
@@ -240,6 +240,7 @@ typedef struct {
 	FuncPtr progSerSend;
 	FuncPtr progSerRecv;
 	FuncPtr progParSend;
+	FuncPtr progSerBatch;
 } IndirectionTable;
 
 static const IndirectionTable indirectionTable[] PROGMEM = {
@@ -250,6 +251,7 @@ static const IndirectionTable indirectionTable[] PROGMEM = {
 		nullFunc,
 		nullFunc,
 		nullFunc,
+		nullFunc,
 		nullFunc
 	}, {
 		hwIsSendingIsReceiving, // bit-bang implementations
@@ -258,7 +260,8 @@ static const IndirectionTable indirectionTable[] PROGMEM = {
 		hwNotSendingNotReceiving,
 		hwSerSend,
 		hwSerRecv,
-		hwParSend
+		hwParSend,
+		hwSerBatch
 	}, {
 		bbIsSendingIsReceiving, // bit-bang implementations
 		bbIsSendingNotReceiving,
@@ -266,7 +269,8 @@ static const IndirectionTable indirectionTable[] PROGMEM = {
 		bbNotSendingNotReceiving,
 		bbSerSend,
 		bbSerRecv,
-		bbParSend
+		bbParSend,
+		bbSerBatch
 	}
 };
 
@@ -282,6 +286,7 @@ static inline FuncPtr getFunc(uint8 index, uint8 offset) {
 #define progSerSend() (*getFunc(m_funcIndex, offsetof(IndirectionTable, progSerSend)))()
 #define progSerRecv() (*getFunc(m_funcIndex, offsetof(IndirectionTable, progSerRecv)))()
 #define progParSend() (*getFunc(m_funcIndex, offsetof(IndirectionTable, progParSend)))()
+#define progSerBatch() (*getFunc(m_funcIndex, offsetof(IndirectionTable, progSerBatch)))()
 
 // Actually execute the shift operation initiated by progBeginShift(). This is
 // done in a separate function because vendor commands cannot read & write to
@@ -314,6 +319,9 @@ void progShiftExecute(void) {
 	case PROG_PARALLEL:
 		progParSend();
 		break;
+	case PROG_SPI_BATCH:
+		progSerBatch();
+		break;
 	case PROG_NOP:
 	default:
 		break;
@@ -259,6 +259,50 @@ static void CONCAT(OP_HDR, SerRecv)(void) {
 	m_progOp = PROG_NOP;
 }
 
+// The host is sending us a batch of SPI transactions, each a little-endian 16-bit byte count
+// followed by that many bytes. The device is selected for each transaction in turn whilst its
+// bytes are clocked in, and the whole stream goes back to the host, with each byte replaced by
+// the one clocked out of the device in its place. The counts are sent back unchanged.
+//
+static void CONCAT(OP_HDR, SerBatch)(void) {
+	uint8 buf[ENDPOINT_SIZE], *ptr;
+	uint8 chunkSize, i, countLow = 0x00;
+	uint16 segBytes = 0;
+	bool haveLow = false;
+	CONCAT(OP_HDR, SpiEnable)();
+	while ( m_numBits ) {
+		chunkSize = (m_numBits >= ENDPOINT_SIZE) ? ENDPOINT_SIZE : (uint8)m_numBits;
+		usbSelectEndpoint(OUT_ENDPOINT_ADDR);
+		Endpoint_Read_Stream_LE(buf, chunkSize, NULL);
+		ptr = buf;
+		for ( i = 0; i < chunkSize; i++ ) {
+			if ( segBytes ) {
+				*ptr = CONCAT(OP_HDR, ShiftInOut)(*ptr);
+				if ( !--segBytes ) {
+					SS_OUT |= bmSS;  // end of this transaction
+				}
+			} else if ( haveLow ) {
+				segBytes = (uint16)((*ptr << 8) | countLow);
+				haveLow = false;
+				if ( segBytes ) {
+					SS_OUT &= ~bmSS;  // start of the next transaction
+				}
+			} else {
+				countLow = *ptr;
+				haveLow = true;
+			}
+			ptr++;
+		}
+		usbSelectEndpoint(IN_ENDPOINT_ADDR);
+		Endpoint_Write_Stream_LE(buf, chunkSize, NULL);
+		m_numBits -= chunkSize;
+		usbFlushPacket();
+		usbAckPacket();
+	}
+	CONCAT(OP_HDR, SpiDisable)();
+	m_progOp = PROG_NOP;
+}
+
 // Keep TMS and TDI as they are, and clock the JTAG state machine "numClocks" times.
 //
 static void CONCAT(OP_HDR, ProgClocks)(uint32 numClocks) {
@@ -252,7 +252,7 @@ uint8 handleVendorCommand(uint8 cmd) {
 			EP0BUF[11] = (uint8)(DATE>>16);      // Version
 			EP0BUF[12] = (uint8)(DATE>>8);       // Version
 			EP0BUF[13] = (uint8)DATE;            // Version LSB
-			EP0BUF[14] = 0x00;                   // Reserved
+			EP0BUF[14] = bmCAP_SPI_BATCH;        // Capabilities
 			EP0BUF[15] = 0x00;                   // Reserved
 			
 			// Return status packet to host
@@ -466,6 +466,44 @@ static void progSerRecv(void) {
 	m_progOp = PROG_NOP;
 }
 
+static void progSerBatch(void) {
+	// A batch of SPI transactions, each a little-endian count followed by that many bytes. TMS
+	// selects the device for each transaction, and the counts are echoed back unchanged.
+	__xdata uint8 bytesRead, i, countLow = 0x00;
+	__xdata uint16 segBytes = 0;
+	__xdata bool haveLow = false;
+	while ( m_numBits ) {
+		while ( EP01STAT & bmEP1OUTBSY );  // Wait for some EP1OUT data
+		while ( EP01STAT & bmEP1INBSY );   // Wait for space for EP1IN data
+		bytesRead = EP1OUTBC;
+		m_inPtr = EP1OUTBUF;
+		m_outPtr = EP1INBUF;
+		for ( i = 0; i < bytesRead; i++ ) {
+			if ( segBytes ) {
+				*m_outPtr++ = shiftInOut(*m_inPtr++);
+				if ( !--segBytes ) {
+					TMS = 1;  // end of this transaction
+				}
+			} else if ( haveLow ) {
+				segBytes = (*m_inPtr << 8) | countLow;
+				*m_outPtr++ = *m_inPtr++;
+				haveLow = false;
+				if ( segBytes ) {
+					TMS = 0;  // start of the next transaction
+				}
+			} else {
+				countLow = *m_inPtr;
+				*m_outPtr++ = *m_inPtr++;
+				haveLow = true;
+			}
+		}
+		EP1OUTBC = 0x00;  // ready to accept more data from host
+		EP1INBC = bytesRead;  // send response back to host
+		m_numBits -= bytesRead;
+	}
+	m_progOp = PROG_NOP;
+}
+
 // Actually execute the shift operation initiated by progBeginShift(). This is done in a
 // separate method because vendor commands cannot read & write to bulk endpoints.
 //
@@ -495,6 +533,9 @@ void progShiftExecute(void) {
 	case PROG_SPI_RECV:
 		progSerRecv();
 		break;
+	case PROG_SPI_BATCH:
+		progSerBatch();
+		break;
 	case PROG_NOP:
 	default:
 		break;
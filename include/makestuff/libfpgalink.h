@@ -69,7 +69,8 @@ extern "C" {
 		FL_PROG_ERR,             ///< The device failed to start after programming.
 		FL_PORT_IO,              ///< There was a problem doing port I/O.
 		FL_BAD_STATE,            ///< You're trying to do something that is illegal in this state.
-		FL_INTERNAL_ERR          ///< An internal error occurred. Please report it!
+		FL_INTERNAL_ERR,         ///< An internal error occurred. Please report it!
+		FL_CANCELLED             ///< The operation was cancelled.
 	} FLStatus;
 
 	/**
@@ -95,16 +96,40 @@ extern "C" {
 	} PinConfig;
 
 	/**
-	 * Enum used by \c spiSend() and \c spiRecv() to set the order bits are clocked in.
+	 * Enum used by \c spiSend(), \c spiRecv(), \c spiXfer() and \c spiXferBatch() to set the order
+	 * bits are clocked in.
 	 */
 	typedef enum {
 		SPI_MSBFIRST,  ///< Clock each byte most-significant bit first.
 		SPI_LSBFIRST   ///< Clock each byte least-significant bit first.
 	} BitOrder;
+
+	/**
+	 * Enum used by \c FLProgressFunc to say what a \c flProgramAsync() operation is doing.
+	 */
+	typedef enum {
+		FL_PHASE_PROG, ///< Resetting the FPGA (PROG_B, nCONFIG or CRESET_B asserted).
+		FL_PHASE_INIT, ///< Waiting for the FPGA to be ready for data.
+		FL_PHASE_DATA, ///< Sending configuration data, or playing the JTAG programming file.
+		FL_PHASE_DONE  ///< Checking that the FPGA started.
+	} FLProgPhase;
+
+	/**
+	 * Progress callback for \c flProgramAsync(). It's called on the programming thread at the
+	 * start of each phase and then every one percent or so, with \c done out of \c total bytes
+	 * (of configuration data or CSVF) handled so far in this phase, and the average throughput
+	 * in bytes per second since the phase began. It must not call FPGALink functions on the same
+	 * handle, and should return quickly.
+	 */
+	typedef void (*FLProgressFunc)(
+		void *userData, FLProgPhase phase, uint64 done, uint64 total, double bytesPerSec
+	);
 	//@}
 
 	// Forward declarations
 	struct FLContext; // Opaque FPGALink context
+	struct FLProgJob; // Opaque asynchronous programming operation
+	struct FLPortConfig; // Opaque compiled port configuration
 	struct Buffer;    // Dynamic binary buffer (see libbuffer)
 
 	// ---------------------------------------------------------------------------------------------
@@ -237,7 +262,8 @@ extern "C" {
 	 * FPGALink, including but not limited to JTAG. An affirmative response means you are free to
 	 * call \c flProgram(), \c flProgramBlob(), \c jtagScanChain(), \c progOpen(), \c progClose(),
 	 * \c jtagShiftInOnly(), \c jtagShiftInOut(), \c jtagClockFSM(), \c jtagClocks(),
-	 * \c progGetPort(), \c progGetBit(), \c spiSend(), \c spiRecv() and \c spiBitSwap().
+	 * \c progGetPort(), \c progGetBit(), \c spiSend(), \c spiRecv(), \c spiXfer(),
+	 * \c spiXferBatch() and \c spiBitSwap().
 	 *
 	 * This function merely returns a flag determined by \c flOpen(), so it cannot fail.
 	 *
@@ -640,7 +666,8 @@ extern "C" {
 	 *
 	 * This will program an FPGA or CPLD using the specified microcontroller ports and the specified
 	 * programming file. Several programming algorithms are supported (JTAG, Xilinx Slave-Serial,
-	 * Xilinx SelectMap and Altera Passive-Serial). In each case, it's necessary to tell the micro
+	 * Xilinx SelectMap, Altera Passive-Serial, Altera Fast Passive Parallel and Lattice iCE40
+	 * SPI-slave). In each case, it's necessary to tell the micro
 	 * which ports to use. Here are some examples:
 	 *
 	 * A Digilent board using JTAG: <code>progConfig="J:D0D2D3D4"</code>:
@@ -663,6 +690,22 @@ extern "C" {
 	 * - DCLK: PD1
 	 * - DATA0: PD2
 	 *
+	 * An Altera board using Fast Passive Parallel: <code>progConfig="AP:D5D6D1A01234567"</code>
+	 * (MSEL must select FPP, and the file must be an uncompressed, unencrypted .rbf, since those
+	 * need several DCLK cycles per byte):
+	 * - nCONFIG: PD5
+	 * - CONF_DONE: PD6
+	 * - DCLK: PD1
+	 * - DATA[7:0]: PA[7:0]
+	 *
+	 * An iCE40 board using Lattice SPI-slave, programmed with a .bin file:
+	 * <code>progConfig="LS:C4C5B0B1B2"</code>:
+	 * - CRESET_B: PC4
+	 * - CDONE: PC5
+	 * - SPI_SS_B: PB0
+	 * - SPI_SCK: PB1
+	 * - SPI_SI: PB2
+	 *
 	 * Aessent aes220 using Xilinx Slave-Serial:
 	 * <code>progConfig="XS:D0D5D1D6A7[D3?,B1+,B5+,B3+]"</code>:
 	 * - PROG_B: PD0
@@ -703,6 +746,16 @@ extern "C" {
 	 * \c "J:A7A0A3A1:fpga.xsvf") or you can supply the programming filename separately in
 	 * \c progFile.
 	 *
+	 * To program several devices in one JTAG chain at once, give a comma-separated list of files,
+	 * one for each device, starting with the device nearest TDI (e.g
+	 * \c "J:A7A0A3A1:prom.svf,fpga.svf"). Each file must be made for its device alone, as if it were
+	 * the only device in the chain. They're merged so that each IR and DR scan carries data for
+	 * every device at once, so the whole chain takes about as long as the longest file would on
+	 * its own.
+	 *
+	 * A JTAG file may also be a CSVC container (a compressed, indexed form of CSVF), whatever its
+	 * extension. It is memory-mapped and played a block at a time rather than loaded whole.
+	 *
 	 * @param handle The handle returned by \c flOpen().
 	 * @param progConfig The port configuration described above.
 	 * @param progFile The name of the programming file, or \c NULL if it's already given in
@@ -737,13 +790,275 @@ extern "C" {
 		struct FLContext *handle, const char *progConfig, const char *progFile, const char **error
 	) WARN_UNUSED_RESULT;
 
+	/**
+	 * @brief Program a device over JTAG, converting the programming file whilst it's played.
+	 *
+	 * Does the same job as \c flProgram() for a single JTAG programming file, but rather than
+	 * converting the whole file to CSVF before programming starts, the conversion runs on a
+	 * separate thread and each block of CSVF is played as soon as it's ready. The conversion time
+	 * is therefore hidden behind the JTAG time, which matters for large SVF files. The catch is
+	 * that a malformed file is only noticed when the conversion reaches the bad part, by which time
+	 * the device may have been partly programmed.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param progConfig A JTAG port configuration as described for \c flProgram() (e.g
+	 *            \c "J:A7A0A3A1:fpga.svf").
+	 * @param progFile The name of the SVF, XSVF, CSVF or CSVC programming file, or \c NULL if
+	 *            it's already given in \c progConfig.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if we ran out of memory, or the converter thread could not be started.
+	 *     - \c FL_USB_ERR if a USB error occurred.
+	 *     - \c FL_FILE_ERR if the programming file is unreadable or an unexpected format.
+	 *     - \c FL_UNSUPPORTED_CMD_ERR if an XSVF file contains an unsupported command.
+	 *     - \c FL_UNSUPPORTED_DATA_ERR if an XSVF file contains an unsupported XENDDR/XENDIR.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if an XSVF command is too long.
+	 *     - \c FL_SVF_PARSE_ERR if an SVF file is unparseable.
+	 *     - \c FL_CONF_FORMAT if \c progConfig is malformed, or not a JTAG configuration.
+	 *     - \c FL_PROG_PORT_MAP if the micro was unable to map its ports to those given.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_RECV if the micro refused to provide programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 *     - \c FL_PROG_JTAG_CLOCKS if the micro refused to send JTAG clocks.
+	 *     - \c FL_PROG_SVF_COMPARE if an SVF/XSVF compare operation failed.
+	 *     - \c FL_PROG_SVF_UNKNOWN_CMD if an SVF/XSVF unknown command was encountered.
+	 */
+	DLLEXPORT(FLStatus) flProgramStreaming(
+		struct FLContext *handle, const char *progConfig, const char *progFile, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Program a device over JTAG, so that an interrupted run can be resumed.
+	 *
+	 * This is like \c flProgram() for JTAG, except that every so often a checkpoint is saved to
+	 * \c ckptFile, at a point where the device is waiting between operations (e.g after an erase
+	 * or a page program has had its \c RUNTEST time). If the run fails part-way through, perhaps
+	 * because the cable was knocked, calling this again with the same programming file and
+	 * checkpoint file resets the TAP and carries on from the last checkpoint instead of starting
+	 * again. A checkpoint for a different programming file is ignored. The checkpoint file is
+	 * removed when programming succeeds.
+	 *
+	 * Resuming is only safe if the device was left as it was; if it was power-cycled, remove the
+	 * checkpoint file first.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param progConfig A JTAG port configuration as described for \c flProgram() (e.g
+	 *            \c "J:A7A0A3A1:fpga.svf").
+	 * @param progFile The name of the SVF, XSVF, CSVF or CSVC programming file, or \c NULL if
+	 *            it's already given in \c progConfig.
+	 * @param ckptFile The name of the checkpoint file.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if we ran out of memory.
+	 *     - \c FL_USB_ERR if a USB error occurred.
+	 *     - \c FL_FILE_ERR if the programming file is unreadable or an unexpected format, or the
+	 *            checkpoint file could not be written.
+	 *     - \c FL_UNSUPPORTED_CMD_ERR if an XSVF file contains an unsupported command.
+	 *     - \c FL_UNSUPPORTED_DATA_ERR if an XSVF file contains an unsupported XENDDR/XENDIR.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if an XSVF command is too long.
+	 *     - \c FL_SVF_PARSE_ERR if an SVF file is unparseable.
+	 *     - \c FL_CONF_FORMAT if \c progConfig is malformed or not a JTAG configuration.
+	 *     - \c FL_PROG_PORT_MAP if the micro was unable to map its ports to those given.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_RECV if the micro refused to provide programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 *     - \c FL_PROG_JTAG_CLOCKS if the micro refused to send JTAG clocks.
+	 *     - \c FL_PROG_SVF_COMPARE if an SVF/XSVF compare operation failed.
+	 *     - \c FL_PROG_SVF_UNKNOWN_CMD if an SVF/XSVF unknown command was encountered.
+	 */
+	DLLEXPORT(FLStatus) flProgramResumable(
+		struct FLContext *handle, const char *progConfig, const char *progFile, const char *ckptFile,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Program a device only if it isn't already running the same design.
+	 *
+	 * Reprogramming an FPGA which is already running the right design wastes time. This function
+	 * avoids that by keeping a fingerprint of the programming file (a 64-bit hash of its contents,
+	 * or of each file's contents in a comma-separated list) in the design itself. The design must
+	 * provide an eight-byte register on CommFPGA channel \c idChan, which reads back whatever was
+	 * last written to it, and reads as something else (e.g zeros) after configuration.
+	 *
+	 * If the FPGA is running and the register holds the file's fingerprint, nothing more is done.
+	 * Otherwise the device is programmed as for \c flProgram(), and the fingerprint is written to
+	 * the register of the newly-running design. Any reconfiguration by other means clears it, so
+	 * the next call programs the device again.
+	 *
+	 * On exit, conduit \c conduit is selected.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param progConfig The port configuration described in \c flProgram().
+	 * @param progFile The name of the programming file, or \c NULL if it's already given in
+	 *            \c progConfig.
+	 * @param conduit The CommFPGA conduit to read & write the fingerprint on (typically 1).
+	 * @param idChan The CommFPGA channel of the fingerprint register (0-127).
+	 * @param programmed A pointer to an 8-bit integer which will be set on exit to 1 if the
+	 *            device was programmed, or 0 if it was already running the design.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_PROTOCOL_ERR if the device does not support CommFPGA on \c conduit.
+	 *     - \c FL_PROG_ERR if the FPGA was programmed but isn't running afterwards.
+	 *     - Any of the codes returned by \c flProgram(), \c flReadChannel() or
+	 *       \c flWriteChannel().
+	 */
+	DLLEXPORT(FLStatus) flProgramIfDifferent(
+		struct FLContext *handle, const char *progConfig, const char *progFile, uint8 conduit,
+		uint8 idChan, uint8 *programmed, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Program several devices at once with the same file.
+	 *
+	 * This loads the programming file just once (converting it to CSVF if it's an SVF or XSVF
+	 * file), then opens each device in \c vpList, selects conduit zero and programs it with
+	 * \c flProgramBlob(), several devices at a time on a pool of threads. Devices on different
+	 * USB controllers are programmed truly in parallel, so the whole lot takes little longer than
+	 * the slowest device does alone.
+	 *
+	 * Each device gets its own status, and optionally its own error message. The devices must not
+	 * already be open.
+	 *
+	 * @param vpList An array of \c numDevices VID:PID[:DID] strings, as for \c flOpen().
+	 * @param numDevices The number of devices to program.
+	 * @param progConfig The port configuration described in \c flProgram(), which must suit every
+	 *            device.
+	 * @param progFile The name of the programming file, or \c NULL if it's already given in
+	 *            \c progConfig.
+	 * @param maxThreads The most devices to program at once, or zero for all of them.
+	 * @param statuses An array of \c numDevices entries, each set on exit to the result of
+	 *            programming that device. If the config or the file is bad, no device is tried
+	 *            and every entry is set to the return code.
+	 * @param errors An array of \c numDevices pointers, each set on exit to \c NULL or to an
+	 *            allocated error message for that device, which must be freed with
+	 *            \c flFreeError(). May be \c NULL if the messages aren't wanted.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if every device was programmed successfully.
+	 *     - \c FL_ALLOC_ERR if we ran out of memory.
+	 *     - \c FL_FILE_ERR if the programming file is unreadable or an unexpected format.
+	 *     - \c FL_CONF_FORMAT if \c progConfig is malformed.
+	 *     - Otherwise, the status of the first device which failed.
+	 */
+	DLLEXPORT(FLStatus) flProgramMulti(
+		const char *const *vpList, uint32 numDevices, const char *progConfig, const char *progFile,
+		uint32 maxThreads, FLStatus *statuses, const char **errors, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Start programming a device, without waiting for it to finish.
+	 *
+	 * This runs \c flProgram() on a thread of its own and returns straight away. Progress is
+	 * reported through \c progress as it goes, and the operation may be cancelled with
+	 * \c flProgramCancel(). Either way, \c flProgramAwait() must be called to get the result
+	 * and free the job. Until then, the handle must not be used for anything else.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param progConfig The port configuration described in \c flProgram().
+	 * @param progFile The name of the programming file, or \c NULL if it's already given in
+	 *            \c progConfig.
+	 * @param progress A function to report progress to, or \c NULL.
+	 * @param userData Passed to \c progress as-is.
+	 * @param job A pointer to a <code>struct FLProgJob*</code> which will be set on exit to the
+	 *            new job, to be passed to \c flProgramCancel() and \c flProgramAwait().
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation started successfully.
+	 *     - \c FL_ALLOC_ERR if we ran out of memory, or the thread could not be started.
+	 */
+	DLLEXPORT(FLStatus) flProgramAsync(
+		struct FLContext *handle, const char *progConfig, const char *progFile,
+		FLProgressFunc progress, void *userData, struct FLProgJob **job, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Ask a \c flProgramAsync() operation to stop.
+	 *
+	 * The operation stops at the next chunk of data (or JTAG record), and \c flProgramAwait()
+	 * then returns \c FL_CANCELLED. The FPGA is left partly configured, so it must be programmed
+	 * again before use. This may be called from any thread, including from the progress callback.
+	 *
+	 * @param job The job returned by \c flProgramAsync().
+	 */
+	DLLEXPORT(void) flProgramCancel(
+		struct FLProgJob *job
+	);
+
+	/**
+	 * @brief Wait for a \c flProgramAsync() operation to finish, and free it.
+	 *
+	 * @param job The job returned by \c flProgramAsync(). It is invalid on exit.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_CANCELLED if the operation was cancelled with \c flProgramCancel().
+	 *     - Otherwise, whatever \c flProgram() returned.
+	 */
+	DLLEXPORT(FLStatus) flProgramAwait(
+		struct FLProgJob *job, const char **error
+	);
+
+	/**
+	 * @brief Keep converted SVF & XSVF files in a cache directory.
+	 *
+	 * Once a cache directory is set, each SVF or XSVF file \c flProgram() converts to CSVF is saved
+	 * there, keyed by a hash of the file's contents. Programming with a file whose contents have
+	 * been seen before then loads the saved CSVF instead of converting again, even in another
+	 * process. Several processes may share the directory; an entry is never seen half-written.
+	 * The directory must already exist. Entries are never removed, so clear it out occasionally.
+	 *
+	 * Call this before programming starts, not while another thread is programming.
+	 *
+	 * @param cacheDir The directory to use, or \c NULL to stop caching.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if we ran out of memory.
+	 */
+	DLLEXPORT(FLStatus) flSetConversionCache(
+		const char *cacheDir, const char **error
+	) WARN_UNUSED_RESULT;
+
 	/**
 	 * @brief Program a device using the specified programming blob.
 	 *
 	 * This is similar to \c flProgram(), except that instead of reading the programming information
 	 * from a file, it runs the programming operation from a binary blob already stored in memory.
-	 * For JTAG programming this is assumed to be a CSVF file; for Xilinx programming it is assumed
-	 * to be a raw bitstream (.bin) file.
+	 * For JTAG programming this is assumed to be a CSVF file; for Xilinx programming it may be a
+	 * raw bitstream (.bin) or a .bit file. Either way only the configuration data is sent, without
+	 * the .bit header or padding, followed by just enough clocks for the FPGA to start up.
 	 *
 	 * @param handle The handle returned by \c flOpen().
 	 * @param progConfig The port configuration described in \c flProgram().
@@ -774,6 +1089,88 @@ extern "C" {
 		const char **error
 	) WARN_UNUSED_RESULT;
 
+	/**
+	 * @brief Parse a programming config once, so it can be used many times.
+	 *
+	 * \c flProgram() and \c flProgramBlob() parse their \c progConfig on every call. If you
+	 * program the same way repeatedly, parse it once with this function and pass the result to
+	 * \c flProgramCompiled() or \c flProgramBlobCompiled() instead. The compiled config holds
+	 * the pins the algorithm uses, in the order it drives them, and the bit-ordering table for the
+	 * data. It isn't tied to a device, so it may be shared by several threads at once.
+	 *
+	 * @param progConfig The port configuration described in \c flProgram().
+	 * @param compiled A pointer to a <code>struct FLPortConfig*</code> which will be set on exit
+	 *            to the compiled config, to be freed with \c flFreePortConfig().
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the config was compiled successfully.
+	 *     - \c FL_CONF_FORMAT if \c progConfig is malformed.
+	 *     - \c FL_ALLOC_ERR if we ran out of memory.
+	 */
+	DLLEXPORT(FLStatus) flCompileProgConfig(
+		const char *progConfig, struct FLPortConfig **compiled, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Free a config previously returned by \c flCompileProgConfig() or
+	 * \c flCompilePortConfig().
+	 *
+	 * @param compiled The compiled config, or \c NULL.
+	 */
+	DLLEXPORT(void) flFreePortConfig(
+		struct FLPortConfig *compiled
+	);
+
+	/**
+	 * @brief Program a device using a compiled config and the specified file.
+	 *
+	 * This is just like \c flProgram(), except that the config has already been parsed by
+	 * \c flCompileProgConfig().
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param progConfig The config returned by \c flCompileProgConfig().
+	 * @param progFile The name of the programming file, or \c NULL if it was given in the config.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - Whatever \c flProgram() returns.
+	 */
+	DLLEXPORT(FLStatus) flProgramCompiled(
+		struct FLContext *handle, const struct FLPortConfig *progConfig, const char *progFile,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Program a device using a compiled config and the specified programming blob.
+	 *
+	 * This is just like \c flProgramBlob(), except that the config has already been parsed by
+	 * \c flCompileProgConfig().
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param progConfig The config returned by \c flCompileProgConfig().
+	 * @param numBytes The number of bytes of programming data.
+	 * @param progData A pointer to the start of the programming data.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_CONF_FORMAT if \c progConfig came from \c flCompilePortConfig().
+	 *     - Otherwise, whatever \c flProgramBlob() returns.
+	 */
+	DLLEXPORT(FLStatus) flProgramBlobCompiled(
+		struct FLContext *handle, const struct FLPortConfig *progConfig, uint32 numBytes,
+		const uint8 *progData, const char **error
+	) WARN_UNUSED_RESULT;
+
 	/**
 	 * @brief Scan the JTAG chain and return an array of IDCODEs.
 	 *
@@ -960,45 +1357,55 @@ extern "C" {
 	) WARN_UNUSED_RESULT;
 
 	/**
-	 * @brief Get the physical port number of the specified logical port.
+	 * @brief Scan the JTAG chain and remember its layout for the \c jtagTarget*() functions.
 	 *
-	 * Get the physical port number assigned to the specified logical port by the preceding call to
-	 * \c progOpen(). This is just a convenience function to avoid re-parsing the port config, which
-	 * is typically supplied by the user as a string. For example, to send data to a SPI peripheral,
-	 * you'll probably want to assert \c SS. So you'll want to call \c progGetPort(handle, LP_SS) to
-	 * find out which physical port \c SS was assigned to.
+	 * Scan the JTAG chain with \c jtagScanChain() and record each device's IDCODE in the handle,
+	 * together with its instruction register length, looked up in a built-in table of common
+	 * Xilinx, Altera, Lattice and ARM devices. Devices not in the table get an IR length of zero;
+	 * you must supply their IR lengths with \c jtagChainSetIRLength() before calling
+	 * \c jtagTargetShiftIR(). At most 32 devices are supported. Device zero is nearest TDI.
 	 *
 	 * @param handle The handle returned by \c flOpen().
-	 * @param logicalPort The @ref LogicalPort to query for.
-	 * @returns The physical port mapped to the given @ref LogicalPort.
+	 * @param portConfig The port bits to use for TDO, TDI, TMS & TCK, e.g "D0D2D3D4".
+	 * @param numDevices A pointer to a \c uint32 which will be set on exit to the number of devices
+	 *            in the JTAG chain, or \c NULL if you're not interested.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_CONF_FORMAT if \c portConfig is malformed.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if there are more than 32 devices in the chain.
+	 *     - \c FL_PROG_PORT_MAP if the micro was unable to map its ports to those given.
+	 *     - \c FL_PROG_RECV if the micro refused to provide programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 *     - \c FL_PORT_IO if the micro refused to configure one of its ports.
 	 */
-	DLLEXPORT(uint8) progGetPort(struct FLContext *handle, uint8 logicalPort);
+	DLLEXPORT(FLStatus) jtagChainDetect(
+		struct FLContext *handle, const char *portConfig, uint32 *numDevices, const char **error
+	) WARN_UNUSED_RESULT;
 
 	/**
-	 * @brief Get the physical bit number of the specified logical port.
-	 *
-	 * Get the physical bit number assigned to the specified logical port by the preceding call to
-	 * \c progOpen(). This is just a convenience function to avoid re-parsing the port config, which
-	 * is typically supplied by the user as a string. For example, to send data to a SPI peripheral,
-	 * you'll probably want to assert \c SS. So you'll want to call \c progGetBit(handle, LP_SS) to
-	 * find out which physical port bit \c SS was assigned to.
+	 * @brief Get the instruction register length of a device in the chain.
 	 *
 	 * @param handle The handle returned by \c flOpen().
-	 * @param logicalPort The @ref LogicalPort to query for.
-	 * @returns The physical bit mapped to the given @ref LogicalPort.
+	 * @param device The position of the device in the chain, with device zero nearest TDI.
+	 * @returns The IR length, or zero if it is unknown or \c device is not in the chain.
 	 */
-	DLLEXPORT(uint8) progGetBit(struct FLContext *handle, uint8 logicalPort);
+	DLLEXPORT(uint8) jtagChainGetIRLength(struct FLContext *handle, uint32 device);
 
 	/**
-	 * @brief Send a number of whole bytes over SPI, either LSB-first or MSB-first.
+	 * @brief Set the instruction register length of a device in the chain.
 	 *
-	 * Shift \c numBytes bytes from \c sendData into the microcontroller's SPI bus (if any), either
-	 * MSB-first or LSB-first. You must have previously called \c progOpen().
+	 * Use this to describe devices which are not in the built-in IDCODE table, or to override the
+	 * table's value.
 	 *
 	 * @param handle The handle returned by \c flOpen().
-	 * @param numBytes The number of bytes to send.
-	 * @param sendData A pointer to the source data.
-	 * @param bitOrder Either \c SPI_MSBFIRST or \c SPI_LSBFIRST (see @ref BitOrder).
+	 * @param device The position of the device in the chain, with device zero nearest TDI.
+	 * @param irLength The number of bits in the device's instruction register.
 	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
 	 *            allocated error message if something goes wrong. Responsibility for this
 	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
@@ -1006,24 +1413,511 @@ extern "C" {
 	 *            return code will still be valid.
 	 * @returns
 	 *     - \c FL_SUCCESS if the operation completed successfully.
-	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
-	 *     - \c FL_USB_ERR if USB communications failed whilst sending the data.
-	 *     - \c FL_PROTOCOL_ERR if the device does not support SPI.
+	 *     - \c FL_BAD_STATE if \c device is not in the chain, or \c irLength is zero.
 	 */
-	DLLEXPORT(FLStatus) spiSend(
-		struct FLContext *handle, uint32 numBytes, const uint8 *sendData, uint8 bitOrder,
-		const char **error
+	DLLEXPORT(FLStatus) jtagChainSetIRLength(
+		struct FLContext *handle, uint32 device, uint8 irLength, const char **error
 	) WARN_UNUSED_RESULT;
 
 	/**
-	 * @brief Receive a number of whole bytes over SPI, either LSB-first or MSB-first.
+	 * @brief Load an instruction into one device in the chain, putting all others in BYPASS.
 	 *
-	 * Shift \c numBytes bytes from the microcontroller's SPI bus (if any) into \c buffer, either
-	 * MSB-first or LSB-first. You must have previously called \c progOpen().
+	 * Navigate from \c Run-Test/Idle to \c Shift-IR, shift the instruction LSB-first into the
+	 * target device and all-ones (BYPASS) into every other device, then return to
+	 * \c Run-Test/Idle. The chain must have been described by \c jtagChainDetect(), and you must
+	 * have previously called \c progOpen() and put the TAP state-machine in \c Run-Test/Idle (e.g
+	 * with <code>jtagClockFSM(handle, 0x0000001F, 6, &error)</code>).
 	 *
 	 * @param handle The handle returned by \c flOpen().
-	 * @param buffer A pointer to a buffer to receive the data.
-	 * @param numBytes The number of bytes to receive.
+	 * @param device The position of the target device in the chain, with device zero nearest TDI.
+	 * @param irData A pointer to the instruction, which is \c jtagChainGetIRLength() bits long, or
+	 *            \c SHIFT_ZEROS or \c SHIFT_ONES.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_BAD_STATE if \c device is not in the chain, or an IR length is unknown.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 */
+	DLLEXPORT(FLStatus) jtagTargetShiftIR(
+		struct FLContext *handle, uint32 device, const uint8 *irData, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Shift data into and out of one device's data register.
+	 *
+	 * Navigate from \c Run-Test/Idle to \c Shift-DR, shift \c numBits bits LSB-first through the
+	 * target device's data register, then return to \c Run-Test/Idle. All other devices are
+	 * assumed to be in BYPASS (e.g by a preceding \c jtagTargetShiftIR()), so each adds just one bit
+	 * of padding. Only as many padding bits as are needed are clocked: a write needs one for each
+	 * device between TDI and the target, and a read needs one for each device between the target
+	 * and TDO.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param device The position of the target device in the chain, with device zero nearest TDI.
+	 * @param numBits The number of bits in the target's data register.
+	 * @param tdiData A pointer to the source data, or \c SHIFT_ZEROS or \c SHIFT_ONES.
+	 * @param tdoData A pointer to a buffer to receive output data, or \c NULL if you don't care.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_BAD_STATE if \c device is not in the chain.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_RECV if the micro refused to provide programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 */
+	DLLEXPORT(FLStatus) jtagTargetShiftDR(
+		struct FLContext *handle, uint32 device, uint32 numBits, const uint8 *tdiData,
+		uint8 *tdoData, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Open a channel-style data link to an FPGA through one of its JTAG USER registers.
+	 *
+	 * For boards which have JTAG but no CommFPGA conduit. This resets the TAP state-machine and
+	 * loads \c userInsn (e.g USER1 is 0x02 on Spartan-6) into the target device, leaving the others
+	 * in BYPASS. Subsequent calls to \c jtagUserWrite() and \c jtagUserRead() then move data with
+	 * DR scans alone, each carrying up to 64KiB, using the pipelined shift path.
+	 *
+	 * The FPGA must implement the host's framing on its BSCAN primitive. Each DR scan carries one
+	 * frame, shifted LSB-first, byte by byte:
+	 * - A sync byte 0x01. The FPGA ignores everything after \c Capture-DR until the first 1-bit,
+	 *   which is the LSB of this byte.
+	 * - A command byte: the channel number (0-127), with bit 7 set for a read.
+	 * - A big-endian 16-bit byte count, with 0x0000 meaning 65536.
+	 * - For writes, the data bytes. For reads, one turnaround byte, during which the FPGA must
+	 *   fetch the first byte of the reply; it then drives the reply on TDO, one bit per TCK.
+	 *
+	 * The chain must have been described by \c jtagChainDetect(), and you must have previously
+	 * called \c progOpen(). Any subsequent \c jtagTargetShiftIR() closes the channel.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param device The position of the FPGA in the chain, with device zero nearest TDI.
+	 * @param userInsn The USER instruction to load, LSB-first.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_BAD_STATE if \c device is not in the chain, or an IR length is unknown.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if the device's IR is longer than 32 bits.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 */
+	DLLEXPORT(FLStatus) jtagUserOpen(
+		struct FLContext *handle, uint32 device, uint32 userInsn, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Synchronously write one or more bytes to the specified USER-register channel.
+	 *
+	 * Write \c count bytes from \c data to the specified FPGA channel, through the USER register
+	 * opened by \c jtagUserOpen().
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param chan The FPGA channel to write to (0-127).
+	 * @param count The number of bytes to write.
+	 * @param data The address of the array of bytes to be written to the FPGA.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_PROTOCOL_ERR if \c count is zero.
+	 *     - \c FL_BAD_STATE if the channel is not open.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 */
+	DLLEXPORT(FLStatus) jtagUserWrite(
+		struct FLContext *handle, uint8 chan, size_t count, const uint8 *data, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Synchronously read one or more bytes from the specified USER-register channel.
+	 *
+	 * Read \c count bytes from the specified FPGA channel into \c buffer, through the USER
+	 * register opened by \c jtagUserOpen().
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param chan The FPGA channel to read from (0-127).
+	 * @param count The number of bytes to read.
+	 * @param buffer The address of a buffer to store the bytes read from the FPGA.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_PROTOCOL_ERR if \c count is zero.
+	 *     - \c FL_BAD_STATE if the channel is not open.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_RECV if the micro refused to provide programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 */
+	DLLEXPORT(FLStatus) jtagUserRead(
+		struct FLContext *handle, uint8 chan, size_t count, uint8 *buffer, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Open a SPI flash attached to an FPGA, through a bridge in one of its USER registers.
+	 *
+	 * Programming configuration flash by playing vendor SVF files is very slow, because every page
+	 * of data is wrapped in its own JTAG operations, with long fixed delays. Instead, this loads a
+	 * small bridge design into the FPGA, and then drives the flash's own SPI commands through the
+	 * bridge, packing whole page-programs and their status polling into single DR scans.
+	 *
+	 * If \c bridgeFile is not \c NULL, the FPGA is first programmed with it using
+	 * \c flProgram(). Then the chain is detected with \c jtagChainDetect(), the port is opened
+	 * with \c progOpen() and \c userInsn is loaded with \c jtagUserOpen(). Finally the flash's
+	 * JEDEC ID is read, to check that it's responding. You should call \c progClose() when you're
+	 * finished with the flash.
+	 *
+	 * The bridge uses the framing described for \c jtagUserOpen(), with a command byte of 0x80
+	 * meaning one SPI transaction: the flash is selected while the \c count bytes following the
+	 * header are clocked MSB-first onto MOSI, one SCK per TCK, and the bridge drives each MISO bit
+	 * back on TDO exactly eight TCKs after the corresponding MOSI bit. The frame ends with one
+	 * more byte to carry out the last MISO byte, after which the flash is deselected. Unlike the
+	 * channel protocol, several frames may follow one another in one DR scan; after each, the
+	 * bridge waits for the next sync bit.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param portConfig The port bits to use for TDO, TDI, TMS & TCK, e.g "D0D2D3D4".
+	 * @param bridgeFile The SVF, XSVF or CSVF file of the bridge design, or \c NULL if the FPGA
+	 *            already has it loaded.
+	 * @param device The position of the FPGA in the chain, with device zero nearest TDI.
+	 * @param userInsn The USER instruction the bridge is attached to, LSB-first.
+	 * @param jedecId A pointer to a \c uint32 which will be set on exit to the flash's three-byte
+	 *            JEDEC ID, or \c NULL if you're not interested.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_BAD_STATE if \c device is not in the chain, or an IR length is unknown.
+	 *     - \c FL_PROG_ERR if no flash responded.
+	 *     - Any of the errors returned by \c flProgram() and \c jtagChainDetect().
+	 */
+	DLLEXPORT(FLStatus) jtagFlashOpen(
+		struct FLContext *handle, const char *portConfig, const char *bridgeFile, uint32 device,
+		uint32 userInsn, uint32 *jedecId, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Erase, program and verify a range of the flash opened by \c jtagFlashOpen().
+	 *
+	 * Each 64KiB sector covered by the range is read first, and left alone if it already holds
+	 * the new data. Otherwise it is erased (unless the new data only clears bits), each 256-byte
+	 * page that differs is programmed, and the sector is read back and compared. So rewriting an
+	 * image that has hardly changed costs little more than reading it. If the range ends part-way
+	 * through a sector, the rest of that sector is preserved. Each page is sent in one
+	 * DR scan together with its write-enable and a burst of status reads, so the host rarely has
+	 * to wait for a separate poll. Only three-byte addressing (16MiB) is supported.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param address The flash address to start at, which must be on a 64KiB sector boundary.
+	 * @param length The number of bytes to write.
+	 * @param data The address of the array of bytes to be written to the flash.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_BAD_STATE if the bridge is not open, or \c address is not sector-aligned.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if the range extends beyond 16MiB.
+	 *     - \c FL_PROG_ERR if the flash timed out, or the data did not verify.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_RECV if the micro refused to provide programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 */
+	DLLEXPORT(FLStatus) jtagFlashWrite(
+		struct FLContext *handle, uint32 address, uint32 length, const uint8 *data,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Read a range of the flash opened by \c jtagFlashOpen().
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param address The flash address to start at.
+	 * @param length The number of bytes to read.
+	 * @param buffer The address of a buffer to store the bytes read from the flash.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_BAD_STATE if the bridge is not open.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if the range extends beyond 16MiB.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_RECV if the micro refused to provide programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 */
+	DLLEXPORT(FLStatus) jtagFlashRead(
+		struct FLContext *handle, uint32 address, uint32 length, uint8 *buffer, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Open an SPI flash wired directly to the micro's SPI port.
+	 *
+	 * This is for boards where the FPGA's configuration flash can be reached directly, with the
+	 * FPGA held off its SPI bus (e.g by holding PROG_B or CRESET_B low with
+	 * \c flSingleBitPortAccess()). The port is opened with \c progOpen(), with the flash's chip
+	 * select on the SS pin, and the flash's JEDEC ID is read to check that it's responding. Then
+	 * \c spiFlashWrite() and \c spiFlashRead() work just like \c jtagFlashWrite() and
+	 * \c jtagFlashRead(). You should call \c progClose() when you're finished with the flash.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param portConfig The port bits to use for MISO, MOSI, SS & SCK, e.g "D0D2D3D4".
+	 * @param jedecId A pointer to a \c uint32 which will be set on exit to the flash's three-byte
+	 *            JEDEC ID, or \c NULL if you're not interested.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_CONF_FORMAT if \c portConfig is malformed.
+	 *     - \c FL_PROG_ERR if no flash responded.
+	 *     - \c FL_PROTOCOL_ERR if the device does not support SPI.
+	 *     - \c FL_USB_ERR if USB communications failed.
+	 *     - \c FL_PORT_IO if the micro refused to configure one of its ports.
+	 */
+	DLLEXPORT(FLStatus) spiFlashOpen(
+		struct FLContext *handle, const char *portConfig, uint32 *jedecId, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Update a range of the flash opened by \c spiFlashOpen().
+	 *
+	 * Sectors are compared, erased, programmed and verified just as described for
+	 * \c jtagFlashWrite(), except that each SPI transaction is a separate transfer.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param address The flash address to start at, which must be on a 64KiB sector boundary.
+	 * @param length The number of bytes to write.
+	 * @param data The address of the array of bytes to be written to the flash.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_BAD_STATE if \c address is not sector-aligned.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if the range extends beyond 16MiB.
+	 *     - \c FL_PROG_ERR if the flash timed out, or the data did not verify.
+	 *     - \c FL_USB_ERR if USB communications failed.
+	 *     - \c FL_PORT_IO if the micro refused to drive the SS pin.
+	 */
+	DLLEXPORT(FLStatus) spiFlashWrite(
+		struct FLContext *handle, uint32 address, uint32 length, const uint8 *data,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Read a range of the flash opened by \c spiFlashOpen().
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param address The flash address to start at.
+	 * @param length The number of bytes to read.
+	 * @param buffer The address of a buffer to store the bytes read from the flash.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if the range extends beyond 16MiB.
+	 *     - \c FL_USB_ERR if USB communications failed.
+	 *     - \c FL_PORT_IO if the micro refused to drive the SS pin.
+	 */
+	DLLEXPORT(FLStatus) spiFlashRead(
+		struct FLContext *handle, uint32 address, uint32 length, uint8 *buffer, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Read back configuration frames from a 7-series FPGA.
+	 *
+	 * Synchronise with the configuration logic of the target FPGA over \c CFG_IN, set the frame
+	 * address register, ask for \c numFrames frames from \c FDRO and read them back over
+	 * \c CFG_OUT in one long DR scan, then desynchronise. The configuration memory is read
+	 * without disturbing the running design. Frames are 101 words, returned as big-endian 32-bit
+	 * words, in the order the frame address register walks them. The chain must have been
+	 * described by \c jtagChainDetect(), and you must have previously called \c progOpen().
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param device The position of the FPGA in the chain, with device zero nearest TDI.
+	 * @param frameAddress The frame address to start at (e.g zero for the whole device).
+	 * @param numFrames The number of frames to read.
+	 * @param buffer The address of a buffer of <code>404*numFrames</code> bytes, to receive the
+	 *            frames.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_BAD_STATE if \c device is not in the chain or is not a 7-series FPGA.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if \c numFrames is zero or too large.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_RECV if the micro refused to provide programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 */
+	DLLEXPORT(FLStatus) jtagReadback(
+		struct FLContext *handle, uint32 device, uint32 frameAddress, uint32 numFrames,
+		uint8 *buffer, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Read back configuration frames from a 7-series FPGA and check them.
+	 *
+	 * Read frames as \c jtagReadback() does, checking each one as it arrives, so a scrub cycle
+	 * takes little longer than the readback itself and needs no frame-sized buffers. Each frame is
+	 * compared either with its golden copy or, if \c golden is \c NULL, with its golden CRC-32.
+	 * Either way, if \c mask is not \c NULL, the bits which are zero in it (e.g those of LUT RAMs
+	 * and shift registers, whose contents change at runtime) are ignored; when checking CRCs, those
+	 * bits are cleared before the CRC is calculated. Do not call this while a device in the chain
+	 * is being configured.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param device The position of the FPGA in the chain, with device zero nearest TDI.
+	 * @param frameAddress The frame address to start at (e.g zero for the whole device).
+	 * @param numFrames The number of frames to check.
+	 * @param golden The expected frame data, in the format returned by \c jtagReadback(), or
+	 *            \c NULL to check CRCs instead.
+	 * @param mask The mask data, in the same format, or \c NULL to check every bit.
+	 * @param goldenCrcs An array of \c numFrames expected CRC-32s, used if \c golden is \c NULL.
+	 * @param badFrames An array of \c numFrames elements which will be populated on exit with the
+	 *            indices (relative to \c frameAddress) of the frames which failed the check.
+	 * @param numBad A pointer to a \c uint32 which will be set on exit to the number of bad frames.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the readback completed (whether or not any frames were bad).
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_BAD_STATE if \c device is not in the chain or is not a 7-series FPGA, or neither
+	 *       \c golden nor \c goldenCrcs was given.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if \c numFrames is zero or too large.
+	 *     - \c FL_PROG_SEND if the micro refused to accept programming data.
+	 *     - \c FL_PROG_RECV if the micro refused to provide programming data.
+	 *     - \c FL_PROG_SHIFT if the micro refused to begin a JTAG shift operation.
+	 *     - \c FL_PROG_JTAG_FSM if the micro refused to navigate the TAP state-machine.
+	 */
+	DLLEXPORT(FLStatus) jtagScrub(
+		struct FLContext *handle, uint32 device, uint32 frameAddress, uint32 numFrames,
+		const uint8 *golden, const uint8 *mask, const uint32 *goldenCrcs,
+		uint32 *badFrames, uint32 *numBad, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Get the physical port number of the specified logical port.
+	 *
+	 * Get the physical port number assigned to the specified logical port by the preceding call to
+	 * \c progOpen(). This is just a convenience function to avoid re-parsing the port config, which
+	 * is typically supplied by the user as a string. For example, to send data to a SPI peripheral,
+	 * you'll probably want to assert \c SS. So you'll want to call \c progGetPort(handle, LP_SS) to
+	 * find out which physical port \c SS was assigned to.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param logicalPort The @ref LogicalPort to query for.
+	 * @returns The physical port mapped to the given @ref LogicalPort.
+	 */
+	DLLEXPORT(uint8) progGetPort(struct FLContext *handle, uint8 logicalPort);
+
+	/**
+	 * @brief Get the physical bit number of the specified logical port.
+	 *
+	 * Get the physical bit number assigned to the specified logical port by the preceding call to
+	 * \c progOpen(). This is just a convenience function to avoid re-parsing the port config, which
+	 * is typically supplied by the user as a string. For example, to send data to a SPI peripheral,
+	 * you'll probably want to assert \c SS. So you'll want to call \c progGetBit(handle, LP_SS) to
+	 * find out which physical port bit \c SS was assigned to.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param logicalPort The @ref LogicalPort to query for.
+	 * @returns The physical bit mapped to the given @ref LogicalPort.
+	 */
+	DLLEXPORT(uint8) progGetBit(struct FLContext *handle, uint8 logicalPort);
+
+	/**
+	 * @brief Send a number of whole bytes over SPI, either LSB-first or MSB-first.
+	 *
+	 * Shift \c numBytes bytes from \c sendData into the microcontroller's SPI bus (if any), either
+	 * MSB-first or LSB-first. You must have previously called \c progOpen(). Nothing is
+	 * allocated, however long the data is, and unless async CommFPGA writes are still in flight
+	 * several bulk transfers are kept in flight so long writes go at the full speed of the link.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param numBytes The number of bytes to send.
+	 * @param sendData A pointer to the source data.
+	 * @param bitOrder Either \c SPI_MSBFIRST or \c SPI_LSBFIRST (see @ref BitOrder).
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_USB_ERR if USB communications failed whilst sending the data.
+	 *     - \c FL_PROTOCOL_ERR if the device does not support SPI.
+	 */
+	DLLEXPORT(FLStatus) spiSend(
+		struct FLContext *handle, uint32 numBytes, const uint8 *sendData, uint8 bitOrder,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Receive a number of whole bytes over SPI, either LSB-first or MSB-first.
+	 *
+	 * Shift \c numBytes bytes from the microcontroller's SPI bus (if any) into \c buffer, either
+	 * MSB-first or LSB-first. You must have previously called \c progOpen().
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param buffer A pointer to a buffer to receive the data.
+	 * @param numBytes The number of bytes to receive.
 	 * @param bitOrder Either \c SPI_MSBFIRST or \c SPI_LSBFIRST (see @ref BitOrder).
 	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
 	 *            allocated error message if something goes wrong. Responsibility for this
@@ -1039,6 +1933,76 @@ extern "C" {
 		struct FLContext *handle, uint32 numBytes, uint8 *buffer, uint8 bitOrder, const char **error
 	) WARN_UNUSED_RESULT;
 
+	/**
+	 * @brief Send and receive a number of whole bytes over SPI at the same time.
+	 *
+	 * Shift \c numBytes bytes from \c sendData into the microcontroller's SPI bus (if any), whilst
+	 * shifting the same number of bytes out of it into \c recvData, either MSB-first or LSB-first.
+	 * This needs just one control transfer however long the data is, so it's the cheapest way to
+	 * talk to a peripheral which answers a command within the same transaction. As with
+	 * \c spiSend() and \c spiRecv(), \c SS is left alone, and you must have previously called
+	 * \c progOpen().
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param numBytes The number of bytes to send and receive.
+	 * @param sendData A pointer to the source data.
+	 * @param recvData A pointer to a buffer to receive the data, or \c NULL to discard it.
+	 * @param bitOrder Either \c SPI_MSBFIRST or \c SPI_LSBFIRST (see @ref BitOrder).
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_BAD_STATE if \c numBytes is more than 0x1FFFFFFF.
+	 *     - \c FL_USB_ERR if USB communications failed whilst transferring the data.
+	 *     - \c FL_PROTOCOL_ERR if the device does not support SPI.
+	 */
+	DLLEXPORT(FLStatus) spiXfer(
+		struct FLContext *handle, uint32 numBytes, const uint8 *sendData, uint8 *recvData,
+		uint8 bitOrder, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Run a sequence of SPI transactions, each framed by \c SS, in one exchange.
+	 *
+	 * Each transaction is full-duplex, like \c spiXfer(): the micro drives \c SS low, shifts the
+	 * transaction's bytes into the SPI bus whilst shifting the same number out, then drives \c SS
+	 * high again before starting the next. The whole batch needs just one control transfer and
+	 * one stream of bulk transfers, so a register-style peripheral costs one round trip however
+	 * many accesses are batched together. The transactions' data are concatenated in \c sendData
+	 * and \c recvData, with \c segLengths giving the length of each. \c SS should be high (i.e
+	 * deselected) when you call this, and it will be left high. You must have previously called
+	 * \c progOpen(). Firmware older than this function (and the LPC firmware) does not understand
+	 * batches, and says so when the device is opened, so the call fails straight away with
+	 * \c FL_PROTOCOL_ERR.
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param numSegs The number of transactions.
+	 * @param segLengths An array of \c numSegs transaction lengths, each 1-65535 bytes.
+	 * @param sendData A pointer to the source data for all the transactions, or \c NULL to send
+	 *            zeros.
+	 * @param recvData A pointer to a buffer to receive the data from all the transactions, or
+	 *            \c NULL to discard it.
+	 * @param bitOrder Either \c SPI_MSBFIRST or \c SPI_LSBFIRST (see @ref BitOrder).
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the operation completed successfully.
+	 *     - \c FL_ALLOC_ERR if there was a memory allocation failure.
+	 *     - \c FL_BAD_STATE if a transaction length is zero or more than 65535.
+	 *     - \c FL_USB_ERR if USB communications failed whilst transferring the data.
+	 *     - \c FL_PROTOCOL_ERR if the device does not support SPI, or SPI batches.
+	 */
+	DLLEXPORT(FLStatus) spiXferBatch(
+		struct FLContext *handle, uint32 numSegs, const uint32 *segLengths, const uint8 *sendData,
+		uint8 *recvData, uint8 bitOrder, const char **error
+	) WARN_UNUSED_RESULT;
+
 	/**
 	 * @brief Swap the bits in a byte array.
 	 *
@@ -1298,6 +2262,54 @@ extern "C" {
 	DLLEXPORT(FLStatus) flMultiBitPortAccess(
 		struct FLContext *handle, const char *portConfig, uint32 *readState, const char **error
 	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Parse a list of port configurations once, so it can be used many times.
+	 *
+	 * The result may be passed to \c flMultiBitPortAccessCompiled() as often as you like, which
+	 * saves parsing the list each time you poll the same pins.
+	 *
+	 * @param portConfig A comma-separated sequence of port configurations, as described in
+	 *            \c flMultiBitPortAccess().
+	 * @param compiled A pointer to a <code>struct FLPortConfig*</code> which will be set on exit
+	 *            to the compiled list, to be freed with \c flFreePortConfig().
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the list was compiled successfully.
+	 *     - \c FL_CONF_FORMAT if \c portConfig is malformed.
+	 *     - \c FL_ALLOC_ERR if we ran out of memory.
+	 */
+	DLLEXPORT(FLStatus) flCompilePortConfig(
+		const char *portConfig, struct FLPortConfig **compiled, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Configure multiple port bits on the microcontroller, using a compiled list.
+	 *
+	 * This is just like \c flMultiBitPortAccess(), except that the list has already been parsed
+	 * by \c flCompilePortConfig().
+	 *
+	 * @param handle The handle returned by \c flOpen().
+	 * @param portConfig The list returned by \c flCompilePortConfig().
+	 * @param readState Pointer to a <code>uint32</code> to be set on exit to the port readback.
+	 * @param error A pointer to a <code>const char*</code> which will be set on exit to an
+	 *            allocated error message if something goes wrong. Responsibility for this
+	 *            allocated memory passes to the caller and must be freed with \c flFreeError(). If
+	 *            \c error is \c NULL, no allocation is done and no message is returned, but the
+	 *            return code will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the port access command completed successfully.
+	 *     - \c FL_CONF_FORMAT if \c portConfig came from \c flCompileProgConfig().
+	 *     - \c FL_PORT_IO if the micro failed to respond to the port access command.
+	 */
+	DLLEXPORT(FLStatus) flMultiBitPortAccessCompiled(
+		struct FLContext *handle, const struct FLPortConfig *portConfig, uint32 *readState,
+		const char **error
+	) WARN_UNUSED_RESULT;
 	//@}
 
 #ifdef __cplusplus
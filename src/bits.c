@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include "bits.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define BITS_SSE2
+#endif
+
+// Replicate a byte into every byte of a word
+#define BYTES64(x) (0x0101010101010101ULL * (uint64)(x))
+
+// Copy a single bit.
+//
+// Called by:
+//   bitCopy() -> copyBit()
+//
+static void copyBit(uint8 *dst, uint32 d, const uint8 *src, uint32 s) {
+	if ( (src[s >> 3] >> (s & 7)) & 1 ) {
+		dst[d >> 3] = (uint8)(dst[d >> 3] | (1 << (d & 7)));
+	} else {
+		dst[d >> 3] = (uint8)(dst[d >> 3] & ~(1 << (d & 7)));
+	}
+}
+
+// Copy a run of bits between two LSB-first bit-streams.
+//
+// Called by:
+//   jtagTargetShiftIR() -> bitCopy()
+//   jtagTargetShiftDR() -> bitCopy()
+//
+void bitCopy(uint8 *dst, uint32 dstOffset, const uint8 *src, uint32 srcOffset, uint32 numBits) {
+	uint32 numBytes;
+	if ( (dstOffset & 7) == 0 && (srcOffset & 7) == 0 ) {
+		// Both byte-aligned: copy whole bytes, then merge the leftover bits into the last byte
+		const uint32 numBytes = numBits >> 3;
+		const uint32 numLeft = numBits & 7;
+		dst += dstOffset >> 3;
+		src += srcOffset >> 3;
+		memcpy(dst, src, numBytes);
+		if ( numLeft ) {
+			const uint8 mask = (uint8)((1 << numLeft) - 1);
+			dst[numBytes] = (uint8)((dst[numBytes] & ~mask) | (src[numBytes] & mask));
+		}
+		return;
+	}
+	// Copy bits singly until dst is byte-aligned...
+	while ( numBits && (dstOffset & 7) ) {
+		copyBit(dst, dstOffset++, src, srcOffset++);
+		numBits--;
+	}
+
+	// ...then whole bytes of dst, each straddling two bytes of src...
+	numBytes = numBits >> 3;
+	if ( numBytes ) {
+		if ( srcOffset & 7 ) {
+			bitFunnelLsb(dst + (dstOffset >> 3), src + (srcOffset >> 3), numBytes, srcOffset & 7);
+		} else {
+			memcpy(dst + (dstOffset >> 3), src + (srcOffset >> 3), numBytes);
+		}
+		dstOffset += numBytes << 3;
+		srcOffset += numBytes << 3;
+		numBits &= 7;
+	}
+
+	// ...and finally whatever's left
+	while ( numBits-- ) {
+		copyBit(dst, dstOffset++, src, srcOffset++);
+	}
+}
+
+// Set a run of bits in an LSB-first bit-stream to all-zeros or all-ones.
+//
+// Called by:
+//   jtagTargetShiftIR() -> bitFill()
+//
+void bitFill(uint8 *dst, uint32 dstOffset, uint32 numBits, bool value) {
+	const uint8 fill = value ? 0xFF : 0x00;
+	uint8 mask;
+	dst += dstOffset >> 3;
+	dstOffset &= 7;
+	if ( dstOffset ) {
+		// Leading partial byte
+		const uint32 numHere = (numBits < 8 - dstOffset) ? numBits : 8 - dstOffset;
+		mask = (uint8)(((1 << numHere) - 1) << dstOffset);
+		*dst = (uint8)((*dst & ~mask) | (fill & mask));
+		dst++;
+		numBits -= numHere;
+	}
+	memset(dst, fill, numBits >> 3);
+	dst += numBits >> 3;
+	numBits &= 7;
+	if ( numBits ) {
+		// Trailing partial byte
+		mask = (uint8)((1 << numBits) - 1);
+		*dst = (uint8)((*dst & ~mask) | (fill & mask));
+	}
+}
+
+// Sixteen bytes at a time with SSE2, then eight at a time in a 64-bit word. There are no per-byte
+// shifts, so each is a 16-bit (or 64-bit) shift with the bits which crossed into the neighbouring
+// byte masked off. That works whatever the byte order, so the words are just copied in and out.
+//
+// Called by:
+//   shiftLeft() -> bitFunnelMsb()
+//
+void bitFunnelMsb(uint8 *dst, const uint8 *src, uint32 numBytes, uint32 shift) {
+	const uint32 back = 8 - shift;
+	const uint8 hiMask = (uint8)(0xFF << shift);
+	const uint8 loMask = (uint8)(0xFF >> back);
+	uint64 x, y;
+#ifdef BITS_SSE2
+	const __m128i shl = _mm_cvtsi32_si128((int)shift);
+	const __m128i shr = _mm_cvtsi32_si128((int)back);
+	const __m128i vHi = _mm_set1_epi8((char)hiMask);
+	const __m128i vLo = _mm_set1_epi8((char)loMask);
+	while ( numBytes >= 16 ) {
+		const __m128i a = _mm_loadu_si128((const __m128i *)src);
+		const __m128i b = _mm_loadu_si128((const __m128i *)(src + 1));
+		_mm_storeu_si128(
+			(__m128i *)dst,
+			_mm_or_si128(
+				_mm_and_si128(_mm_sll_epi16(a, shl), vHi),
+				_mm_and_si128(_mm_srl_epi16(b, shr), vLo)));
+		src += 16;
+		dst += 16;
+		numBytes -= 16;
+	}
+#endif
+	while ( numBytes >= 8 ) {
+		memcpy(&x, src, 8);
+		memcpy(&y, src + 1, 8);
+		x = ((x << shift) & BYTES64(hiMask)) | ((y >> back) & BYTES64(loMask));
+		memcpy(dst, &x, 8);
+		src += 8;
+		dst += 8;
+		numBytes -= 8;
+	}
+	while ( numBytes-- ) {
+		*dst++ = (uint8)((src[0] << shift) | (src[1] >> back));
+		src++;
+	}
+}
+
+// The same as bitFunnelMsb(), but the other way round.
+//
+// Called by:
+//   bitCopy() -> bitFunnelLsb()
+//
+void bitFunnelLsb(uint8 *dst, const uint8 *src, uint32 numBytes, uint32 shift) {
+	const uint32 back = 8 - shift;
+	const uint8 loMask = (uint8)(0xFF >> shift);
+	const uint8 hiMask = (uint8)(0xFF << back);
+	uint64 x, y;
+#ifdef BITS_SSE2
+	const __m128i shr = _mm_cvtsi32_si128((int)shift);
+	const __m128i shl = _mm_cvtsi32_si128((int)back);
+	const __m128i vLo = _mm_set1_epi8((char)loMask);
+	const __m128i vHi = _mm_set1_epi8((char)hiMask);
+	while ( numBytes >= 16 ) {
+		const __m128i a = _mm_loadu_si128((const __m128i *)src);
+		const __m128i b = _mm_loadu_si128((const __m128i *)(src + 1));
+		_mm_storeu_si128(
+			(__m128i *)dst,
+			_mm_or_si128(
+				_mm_and_si128(_mm_srl_epi16(a, shr), vLo),
+				_mm_and_si128(_mm_sll_epi16(b, shl), vHi)));
+		src += 16;
+		dst += 16;
+		numBytes -= 16;
+	}
+#endif
+	while ( numBytes >= 8 ) {
+		memcpy(&x, src, 8);
+		memcpy(&y, src + 1, 8);
+		x = ((x >> shift) & BYTES64(loMask)) | ((y << back) & BYTES64(hiMask));
+		memcpy(dst, &x, 8);
+		src += 8;
+		dst += 8;
+		numBytes -= 8;
+	}
+	while ( numBytes-- ) {
+		*dst++ = (uint8)((src[0] >> shift) | (src[1] << back));
+		src++;
+	}
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BITS_H
+#define BITS_H
+
+#include <makestuff/common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// Copy numBits bits from src (starting at bit srcOffset) to dst (starting at bit dstOffset).
+	// Bit-streams are LSB-first, so bit n of a stream is (stream[n/8] >> (n%8)) & 1, which is the
+	// order jtagShiftInOut() clocks them. Bits of dst outside the target range are preserved.
+	void bitCopy(
+		uint8 *dst, uint32 dstOffset, const uint8 *src, uint32 srcOffset, uint32 numBits
+	);
+
+	// Set numBits bits of dst (starting at bit dstOffset) to all-zeros or all-ones.
+	void bitFill(uint8 *dst, uint32 dstOffset, uint32 numBits, bool value);
+
+	// Funnel shifts: each of the numBytes bytes of dst is made from two adjacent bytes of src,
+	// shifted by shift (1-7) bits. Both read numBytes+1 bytes of src, and dst must not overlap it.
+	//
+	// For MSB-first data (e.g SVF hex, which is a big-endian number), shifting left:
+	//   dst[i] = (src[i] << shift) | (src[i+1] >> (8 - shift))
+	void bitFunnelMsb(uint8 *dst, const uint8 *src, uint32 numBytes, uint32 shift);
+
+	// For LSB-first bit-streams, extracting bytes starting shift bits into src:
+	//   dst[i] = (src[i] >> shift) | (src[i+1] << (8 - shift))
+	void bitFunnelLsb(uint8 *dst, const uint8 *src, uint32 numBytes, uint32 shift);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include "bitstream.h"
+#include "private.h"
+
+// -------------------------------------------------------------------------------------------------
+// Declaration of private types & functions
+// -------------------------------------------------------------------------------------------------
+
+static FLStatus parseHeader(
+	const uint8 **data, uint32 *length, struct Bitstream *bs, const char **error);
+static uint32 findStart(const uint8 *data, uint32 length);
+static uint32 findEnd(const uint8 *data, uint32 start, uint32 length);
+
+static const uint8 bitMagic[] = {
+	0x00, 0x09, 0x0F, 0xF0, 0x0F, 0xF0, 0x0F, 0xF0, 0x0F, 0xF0, 0x00, 0x00, 0x01
+};
+static const uint8 syncWord[] = {0xAA, 0x99, 0x55, 0x66};
+static const uint8 dummyWord[] = {0xFF, 0xFF, 0xFF, 0xFF};
+static const uint8 busWidth[] = {0x00, 0x00, 0x00, 0xBB, 0x11, 0x22, 0x00, 0x44};
+static const uint8 desync32[] = {0x30, 0x00, 0x80, 0x01, 0x00, 0x00, 0x00, 0x0D};  // most families
+static const uint8 desync16[] = {0x30, 0xA1, 0x00, 0x0D};  // Spartan-6
+
+// -------------------------------------------------------------------------------------------------
+// Public functions
+// -------------------------------------------------------------------------------------------------
+
+// Strip the .bit header (if any) and the padding around the configuration data.
+//
+FLStatus bitParse(const uint8 *data, uint32 length, struct Bitstream *bs, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint32 start, end;
+	bs->design = NULL;
+	bs->part = NULL;
+	fStatus = parseHeader(&data, &length, bs, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "bitParse()");
+	start = findStart(data, length);
+	if ( start == length ) {
+		// No sync word, so send the lot
+		bs->config = data;
+		bs->configLength = length;
+		bs->isComplete = false;
+	} else {
+		end = findEnd(data, start, length);
+		bs->config = data + start;
+		bs->configLength = (end ? end : length) - start;
+		bs->isComplete = (end != 0);
+	}
+cleanup:
+	return retVal;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of private functions
+// -------------------------------------------------------------------------------------------------
+
+// If there's a .bit header, get the design & part names from it and move data & length on to the
+// configuration data it contains.
+//
+// Called by:
+//   bitParse() -> parseHeader()
+//
+static FLStatus parseHeader(
+	const uint8 **data, uint32 *length, struct Bitstream *bs, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	const uint8 *p = *data;
+	const uint8 *const end = p + *length;
+	uint32 fieldLength;
+	uint8 key;
+	if ( *length < sizeof(bitMagic) || memcmp(p, bitMagic, sizeof(bitMagic)) ) {
+		return FL_SUCCESS;  // no header, so it's a .bin file
+	}
+	p += sizeof(bitMagic);
+	for ( ;; ) {
+		CHECK_STATUS(
+			end - p < 3, FL_FILE_ERR, cleanup,
+			"parseHeader(): The .bit header is truncated");
+		key = *p++;
+		if ( key == 'e' ) {
+			CHECK_STATUS(
+				end - p < 4, FL_FILE_ERR, cleanup,
+				"parseHeader(): The .bit header is truncated");
+			fieldLength = flReadLong(p);
+			p += 4;
+			CHECK_STATUS(
+				fieldLength > (uint32)(end - p), FL_FILE_ERR, cleanup,
+				"parseHeader(): The .bit file is truncated (expecting %u bytes of data, got %u)",
+				fieldLength, (uint32)(end - p));
+			*data = p;
+			*length = fieldLength;
+			break;
+		}
+		fieldLength = flReadWord(p);
+		p += 2;
+		CHECK_STATUS(
+			fieldLength > (uint32)(end - p), FL_FILE_ERR, cleanup,
+			"parseHeader(): The .bit header is truncated");
+		if ( fieldLength && p[fieldLength - 1] == '\0' ) {
+			if ( key == 'a' ) {
+				bs->design = (const char *)p;
+			} else if ( key == 'b' ) {
+				bs->part = (const char *)p;
+			}
+		}
+		p += fieldLength;
+	}
+cleanup:
+	return retVal;
+}
+
+// Find the first byte the FPGA needs: the dummy word before the sync word, or before the bus-width
+// detection pattern if there is one. Returns length if there's no sync word.
+//
+// Called by:
+//   bitParse() -> findStart()
+//
+static uint32 findStart(const uint8 *data, uint32 length) {
+	uint32 sync, start;
+	for ( sync = 0; sync + sizeof(syncWord) <= length; sync++ ) {
+		if ( !memcmp(data + sync, syncWord, sizeof(syncWord)) ) {
+			break;
+		}
+	}
+	if ( sync + sizeof(syncWord) > length ) {
+		return length;
+	}
+	start = sync;
+	while ( start >= 4 && sync - start < 8 && !memcmp(data + start - 4, dummyWord, 4) ) {
+		start -= 4;
+	}
+	if ( start >= sizeof(busWidth) && !memcmp(data + start - sizeof(busWidth), busWidth, sizeof(busWidth)) ) {
+		start -= (uint32)sizeof(busWidth);
+		if ( start >= 4 && !memcmp(data + start - 4, dummyWord, 4) ) {
+			start -= 4;
+		}
+	} else if ( sync - start == 8 ) {
+		start += 4;  // one dummy word is enough
+	}
+	return start;
+}
+
+// Find the end of the last DESYNC command, provided nothing but NOOPs follow it. Returns zero if
+// there isn't one.
+//
+// Called by:
+//   bitParse() -> findEnd()
+//
+static uint32 findEnd(const uint8 *data, uint32 start, uint32 length) {
+	uint32 end, i;
+	for ( end = length; end >= start + sizeof(desync16); end-- ) {
+		if ( end >= start + sizeof(desync32) && !memcmp(data + end - sizeof(desync32), desync32, sizeof(desync32)) ) {
+			// Type 1 NOOPs are 0x20000000
+			for ( i = end; i + 4 <= length; i += 4 ) {
+				if ( flReadLong(data + i) != 0x20000000 ) {
+					return 0;
+				}
+			}
+			return i == length ? end : 0;
+		}
+		if ( !memcmp(data + end - sizeof(desync16), desync16, sizeof(desync16)) ) {
+			// Spartan-6 NOOPs are 0x2000
+			for ( i = end; i + 2 <= length; i += 2 ) {
+				if ( flReadWord(data + i) != 0x2000 ) {
+					return 0;
+				}
+			}
+			return i == length ? end : 0;
+		}
+	}
+	return 0;
+}
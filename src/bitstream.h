@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BITSTREAM_H
+#define BITSTREAM_H
+
+#include <makestuff/common.h>
+#include <makestuff/libfpgalink.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// A Xilinx configuration file (.bit or .bin), split into the part the FPGA needs and the rest.
+	// A .bit file starts with a header of tagged fields:
+	//
+	//   00 09 0F F0 0F F0 0F F0 0F F0 00 00 01
+	//   'a' len(u16) design name, NUL-terminated
+	//   'b' len(u16) part name, NUL-terminated
+	//   'c' len(u16) date
+	//   'd' len(u16) time
+	//   'e' len(u32) the configuration data, as in a .bin file
+	//
+	// The configuration data is padded with dummy words before the sync word, and with NOOPs after
+	// the DESYNC command which ends it. Only one dummy word (and the bus-width detection pattern,
+	// if there is one) needs to go before the sync word, and nothing after the DESYNC but enough
+	// clocks for the start-up sequence.
+	//
+	#define BIT_STARTUP_CLOCKS 64  // enough for all eight start-up phases, whatever the options
+
+	struct Bitstream {
+		const char *design;   // from the .bit header, or NULL if there isn't one
+		const char *part;     // ...
+		const uint8 *config;  // from the first byte the FPGA needs...
+		uint32 configLength;  // ...to the end of the DESYNC command
+		bool isComplete;      // a DESYNC was found, so only the start-up clocks need to follow
+	};
+
+	// Find the configuration data. If there's no sync word it's all kept, since there's no way of
+	// telling what can be dropped.
+	FLStatus bitParse(
+		const uint8 *data, uint32 length, struct Bitstream *bs, const char **error
+	) WARN_UNUSED_RESULT;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
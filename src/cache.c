@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef WIN32
+	#include <process.h>
+	#define getpid _getpid
+#else
+	#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/liberror.h>
+#include "cache.h"
+#include "hash.h"
+#include "thread.h"
+#include "private.h"
+
+// -------------------------------------------------------------------------------------------------
+// Declaration of private types & functions
+// -------------------------------------------------------------------------------------------------
+
+// Bump this whenever the converters' output changes, so old entries are no longer found
+#define CACHE_VERSION 1
+
+// Each entry is a header of magic "FLCC", CACHE_VERSION, maxBufSize, the CSVF length and the CSVF's
+// CRC-32 (all u32, big-endian), followed by the CSVF itself.
+#define CACHE_HDR_SIZE 20
+
+static uint64 cacheKey(const char *srcFile, const uint8 *src, size_t srcLength);
+static bool entryValid(const uint8 *entry, size_t entryLength);
+static void cacheStore(
+	const char *entryName, const uint8 *csvfData, uint32 csvfLength, uint32 maxBufSize);
+
+static const uint8 magic[] = {'F', 'L', 'C', 'C'};
+static char *cacheDir = NULL;
+
+// -------------------------------------------------------------------------------------------------
+// Public functions
+// -------------------------------------------------------------------------------------------------
+
+DLLEXPORT(FLStatus) flSetConversionCache(const char *dir, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	char *newDir = NULL;
+	if ( dir ) {
+		newDir = (char *)malloc(strlen(dir) + 1);
+		CHECK_STATUS(!newDir, FL_ALLOC_ERR, cleanup, "flSetConversionCache()");
+		strcpy(newDir, dir);
+	}
+	free((void*)cacheDir);
+	cacheDir = newDir;
+cleanup:
+	return retVal;
+}
+
+FLStatus cacheConvert(
+	const char *srcFile, CacheConverter convert, struct Buffer *csvfBuf, uint32 *maxBufSize,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	uint8 *src = NULL, *entry = NULL;
+	size_t srcLength, entryLength;
+	char *entryName = NULL;
+	const size_t initLength = csvfBuf->length;
+	bool found = false;
+	uint32 dummy = 0;
+	if ( !maxBufSize ) {
+		maxBufSize = &dummy;
+	}
+	if ( cacheDir ) {
+		src = flLoadFile(srcFile, &srcLength);
+		if ( !src ) {
+			errRenderStd(error);
+			errPrefix(error, "cacheConvert(): Unable to load %s", srcFile);
+			FAIL_RET(FL_FILE_ERR, cleanup);
+		}
+		entryName = (char *)malloc(strlen(cacheDir) + 32);
+		CHECK_STATUS(!entryName, FL_ALLOC_ERR, cleanup, "cacheConvert()");
+		sprintf(
+			entryName, "%s/%016llX.flcc", cacheDir,
+			(unsigned long long)cacheKey(srcFile, src, srcLength));
+		entry = flLoadFile(entryName, &entryLength);
+		found = entry && entryValid(entry, entryLength);
+	}
+	if ( found ) {
+		bStatus = bufAppendBlock(
+			csvfBuf, entry + CACHE_HDR_SIZE, entryLength - CACHE_HDR_SIZE, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "cacheConvert()");
+		*maxBufSize = flReadLong(entry + 8);
+	} else {
+		// The converters only ever raise it, so it must start from zero
+		*maxBufSize = 0;
+		fStatus = convert(srcFile, csvfBuf, maxBufSize, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "cacheConvert()");
+		if ( entryName ) {
+			cacheStore(
+				entryName, csvfBuf->data + initLength, (uint32)(csvfBuf->length - initLength),
+				*maxBufSize);
+		}
+	}
+cleanup:
+	free((void*)entryName);
+	flFreeFile(entry);
+	flFreeFile(src);
+	return retVal;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of private functions
+// -------------------------------------------------------------------------------------------------
+
+// The key covers the cache version, the file's extension (which picks the converter) and its
+// contents, but not its name or timestamp: the same image copied somewhere else is still a hit.
+//
+// Called by:
+//   cacheConvert() -> cacheKey()
+//
+static uint64 cacheKey(const char *srcFile, const uint8 *src, size_t srcLength) {
+	const char *const ext = strrchr(srcFile, '.');
+	uint8 version[4];
+	uint64 key;
+	flWriteLong(CACHE_VERSION, version);
+	key = hashFnv64(HASH_FNV64_INIT, version, 4);
+	if ( ext ) {
+		key = hashFnv64(key, (const uint8 *)ext, strlen(ext));
+	}
+	return hashFnv64(key, src, srcLength);
+}
+
+// Called by:
+//   cacheConvert() -> entryValid()
+//
+static bool entryValid(const uint8 *entry, size_t entryLength) {
+	return
+		entryLength >= CACHE_HDR_SIZE &&
+		!memcmp(entry, magic, sizeof(magic)) &&
+		flReadLong(entry + 4) == CACHE_VERSION &&
+		flReadLong(entry + 12) == entryLength - CACHE_HDR_SIZE &&
+		flReadLong(entry + 16) == hashCrc32(0, entry + CACHE_HDR_SIZE, entryLength - CACHE_HDR_SIZE);
+}
+
+// The entry is written to a temporary file which is then renamed, so other processes sharing the
+// cache see either the whole entry or none of it. The temporary name is unique to this call, even
+// with several threads storing the same entry. Failure just means there's no entry next time.
+//
+// Called by:
+//   cacheConvert() -> cacheStore()
+//
+static void cacheStore(
+	const char *entryName, const uint8 *csvfData, uint32 csvfLength, uint32 maxBufSize)
+{
+	struct Buffer file = {0,};
+	char *const tmpName = (char *)malloc(strlen(entryName) + 32);
+	BufferStatus bStatus;
+	if ( !tmpName ) {
+		return;
+	}
+	sprintf(tmpName, "%s.%d-%u.tmp", entryName, (int)getpid(), threadUniqueId());
+	bStatus = bufInitialise(&file, CACHE_HDR_SIZE + csvfLength, 0x00, NULL);
+	if ( bStatus == BUF_SUCCESS ) {
+		bStatus = bufAppendConst(&file, 0x00, CACHE_HDR_SIZE, NULL);
+	}
+	if ( bStatus == BUF_SUCCESS ) {
+		memcpy(file.data, magic, sizeof(magic));
+		flWriteLong(CACHE_VERSION, file.data + 4);
+		flWriteLong(maxBufSize, file.data + 8);
+		flWriteLong(csvfLength, file.data + 12);
+		flWriteLong(hashCrc32(0, csvfData, csvfLength), file.data + 16);
+		bStatus = bufAppendBlock(&file, csvfData, csvfLength, NULL);
+	}
+	if ( bStatus == BUF_SUCCESS ) {
+		bStatus = bufWriteBinaryFile(&file, tmpName, 0, file.length, NULL);
+	}
+	if ( bStatus != BUF_SUCCESS || rename(tmpName, entryName) ) {
+		// On Windows the rename fails if another process got there first, which is fine
+		remove(tmpName);
+	}
+	bufDestroy(&file);
+	free((void*)tmpName);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfpgalink.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// One of the converters, e.g flLoadSvfAndConvertToCsvf()
+	typedef FLStatus (*CacheConverter)(
+		const char *srcFile, struct Buffer *csvfBuf, uint32 *maxBufSize, const char **error
+	);
+
+	// Append the CSVF converted from srcFile to csvfBuf. If flSetConversionCache() has been given a
+	// directory, a previous conversion of a file with the same contents is used if there is one;
+	// otherwise the file is converted and the result saved there for next time.
+	FLStatus cacheConvert(
+		const char *srcFile, CacheConverter convert, struct Buffer *csvfBuf, uint32 *maxBufSize,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libfpgalink.h>
+#include "private.h"
+#include "chain.h"
+#include "bits.h"
+
+// Scans of up to this many bytes are padded in a stack buffer rather than on the heap
+#define LOCAL_SIZE 128
+
+// IR lengths of some common devices. The table is searched in order and the first match wins, so
+// specific parts must come before the family-wide entries that follow them.
+static const struct {
+	uint32 idCode;
+	uint32 mask;
+	uint8 irLength;
+} idTable[] = {
+	// Xilinx Platform Flash PROMs
+	{0x05044093, 0x0FFFFFFF, 8},   // XCF01S
+	{0x05045093, 0x0FFFFFFF, 8},   // XCF02S
+	{0x05046093, 0x0FFFFFFF, 8},   // XCF04S
+	{0x05057093, 0x0FFFFFFF, 16},  // XCF08P
+	{0x05058093, 0x0FFFFFFF, 16},  // XCF16P
+	{0x05059093, 0x0FFFFFFF, 16},  // XCF32P
+
+	// Xilinx CPLDs
+	{0x09500093, 0x0FF00FFF, 8},   // XC9500
+	{0x09600093, 0x0FF00FFF, 8},   // XC9500XL
+	{0x06D00093, 0x0FF00FFF, 8},   // CoolRunner-II
+	{0x06E00093, 0x0FF00FFF, 8},   // CoolRunner-II (A-series)
+
+	// Xilinx FPGAs
+	{0x01400093, 0x0FE00FFF, 6},   // Spartan-3
+	{0x01C00093, 0x0FE00FFF, 6},   // Spartan-3E
+	{0x02200093, 0x0FE00FFF, 6},   // Spartan-3A
+	{0x04000093, 0x0FE00FFF, 6},   // Spartan-6
+	{0x03600093, 0x0FE00FFF, 6},   // 7-series & Zynq PL
+
+	// Other vendors
+	{0x0BA00477, 0x0FFFFFFF, 4},   // ARM CoreSight DAP (e.g Zynq PS)
+	{0x000000DD, 0x00000FFF, 10},  // Altera FPGAs & CPLDs
+	{0x00000043, 0x00000FFF, 8}    // Lattice FPGAs & CPLDs
+};
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of private functions
+// -------------------------------------------------------------------------------------------------
+
+uint8 chainLookupIRLength(uint32 idCode) {
+	uint32 i;
+	for ( i = 0; i < sizeof(idTable)/sizeof(*idTable); i++ ) {
+		if ( (idCode & idTable[i].mask) == idTable[i].idCode ) {
+			return idTable[i].irLength;
+		}
+	}
+	return 0;
+}
+
+// Every device other than the target is in BYPASS, so each contributes exactly one bit. The target's
+// data must travel through the "before" devices (those nearer TDI) to reach its register, and its
+// captured data must travel through the "after" devices (those nearer TDO) to reach TDO. So a write
+// needs dataBits + numBefore clocks, and a read needs dataBits + numAfter clocks. When doing both,
+// the TDI data is delayed so that it arrives in the target's register on the final clock.
+//
+// Called by:
+//   jtagTargetShiftDR() -> chainPlanDR()
+//
+void chainPlanDR(
+	uint32 numDevices, uint32 device, uint32 dataBits, bool isReading, struct ChainPlan *plan)
+{
+	const uint32 numBefore = device;
+	const uint32 numAfter = numDevices - device - 1;
+	const uint32 padding = (isReading && numAfter > numBefore) ? numAfter : numBefore;
+	plan->numBits = dataBits + padding;
+	plan->tdiOffset = padding - numBefore;
+	plan->tdoOffset = numAfter;
+}
+
+// Check that the given device is a valid target and, for IR scans, that the IR length of every
+// device in the chain is known.
+//
+// Called by:
+//   jtagTargetShiftIR() -> checkTarget()
+//   jtagTargetShiftDR() -> checkTarget()
+//
+static FLStatus checkTarget(
+	struct FLContext *handle, uint32 device, bool needIR, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	uint32 i;
+	CHECK_STATUS(
+		device >= handle->chainLength, FL_BAD_STATE, cleanup,
+		"checkTarget(): Device %d is not in the chain (did you call jtagChainDetect()?)", device);
+	if ( needIR ) {
+		for ( i = 0; i < handle->chainLength; i++ ) {
+			CHECK_STATUS(
+				handle->chainIrLengths[i] == 0, FL_BAD_STATE, cleanup,
+				"checkTarget(): IR length of device %d (IDCODE 0x%08X) is unknown; set it with jtagChainSetIRLength()",
+				i, handle->chainIdCodes[i]);
+		}
+	}
+cleanup:
+	return retVal;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of public functions
+// -------------------------------------------------------------------------------------------------
+
+DLLEXPORT(FLStatus) jtagChainDetect(
+	struct FLContext *handle, const char *portConfig, uint32 *numDevices, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint32 i, count;
+	handle->chainLength = 0;
+	handle->isUserOpen = false;
+	fStatus = jtagScanChain(
+		handle, portConfig, &count, handle->chainIdCodes, CHAIN_MAX_DEVICES, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagChainDetect()");
+	CHECK_STATUS(
+		count > CHAIN_MAX_DEVICES, FL_UNSUPPORTED_SIZE_ERR, cleanup,
+		"jtagChainDetect(): Found %d devices but at most %d are supported", count, CHAIN_MAX_DEVICES);
+	for ( i = 0; i < count; i++ ) {
+		handle->chainIrLengths[i] = chainLookupIRLength(handle->chainIdCodes[i]);
+	}
+	handle->chainLength = count;
+	if ( numDevices ) {
+		*numDevices = count;
+	}
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(uint8) jtagChainGetIRLength(struct FLContext *handle, uint32 device) {
+	return (device < handle->chainLength) ? handle->chainIrLengths[device] : 0;
+}
+
+DLLEXPORT(FLStatus) jtagChainSetIRLength(
+	struct FLContext *handle, uint32 device, uint8 irLength, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	CHECK_STATUS(
+		device >= handle->chainLength, FL_BAD_STATE, cleanup,
+		"jtagChainSetIRLength(): Device %d is not in the chain (did you call jtagChainDetect()?)", device);
+	CHECK_STATUS(
+		irLength == 0, FL_BAD_STATE, cleanup,
+		"jtagChainSetIRLength(): IR length must be nonzero");
+	handle->chainIrLengths[device] = irLength;
+cleanup:
+	return retVal;
+}
+
+// Load an instruction into one device, and BYPASS into all the others. Unlike a DR scan, there's
+// no shortcut here: every device's instruction register sits between TDI and TDO.
+//
+DLLEXPORT(FLStatus) jtagTargetShiftIR(
+	struct FLContext *handle, uint32 device, const uint8 *irData, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint8 local[LOCAL_SIZE];
+	uint8 *buf = local;
+	uint32 numBits = 0, offset = 0, i;
+	handle->isUserOpen = false;  // any USER instruction is about to be replaced
+	fStatus = checkTarget(handle, device, true, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagTargetShiftIR()");
+	for ( i = 0; i < handle->chainLength; i++ ) {
+		if ( i > device ) {
+			offset += handle->chainIrLengths[i];  // devices after the target are shifted first
+		}
+		numBits += handle->chainIrLengths[i];
+	}
+	if ( bitsToBytes(numBits) > LOCAL_SIZE ) {
+		buf = (uint8 *)malloc(bitsToBytes(numBits));
+		CHECK_STATUS(!buf, FL_ALLOC_ERR, cleanup, "jtagTargetShiftIR()");
+	}
+	bitFill(buf, 0, numBits, true);
+	if ( irData == SHIFT_ZEROS ) {
+		bitFill(buf, offset, handle->chainIrLengths[device], false);
+	} else if ( irData != SHIFT_ONES ) {
+		bitCopy(buf, offset, irData, 0, handle->chainIrLengths[device]);
+	}
+	fStatus = jtagClockFSM(handle, 0x00000003, 4, error);  // -> Shift-IR
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagTargetShiftIR()");
+	fStatus = jtagShiftInOnly(handle, numBits, buf, true, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagTargetShiftIR()");
+	fStatus = jtagClockFSM(handle, 0x00000001, 2, error);  // -> Run-Test/Idle
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagTargetShiftIR()");
+cleanup:
+	if ( buf != local ) {
+		free((void*)buf);
+	}
+	return retVal;
+}
+
+// Shift data through one device's data register, with all the other devices in BYPASS.
+//
+DLLEXPORT(FLStatus) jtagTargetShiftDR(
+	struct FLContext *handle, uint32 device, uint32 numBits, const uint8 *tdiData, uint8 *tdoData,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint8 local[LOCAL_SIZE];
+	uint8 *buf = local;
+	struct ChainPlan plan;
+	const uint8 *inData = tdiData;
+	uint8 *outData = tdoData;
+	fStatus = checkTarget(handle, device, false, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagTargetShiftDR()");
+	chainPlanDR(handle->chainLength, device, numBits, tdoData != NULL, &plan);
+	if ( plan.numBits != numBits ) {
+		// Some padding is needed, so the data must be moved into a bigger scratch buffer. When both
+		// reading and writing, the same buffer serves for both, because the firmware sends each
+		// chunk before receiving it.
+		if ( bitsToBytes(plan.numBits) > LOCAL_SIZE ) {
+			buf = (uint8 *)malloc(bitsToBytes(plan.numBits));
+			CHECK_STATUS(!buf, FL_ALLOC_ERR, cleanup, "jtagTargetShiftDR()");
+		}
+		if ( tdiData != SHIFT_ZEROS && tdiData != SHIFT_ONES ) {
+			bitFill(buf, 0, plan.numBits, false);
+			bitCopy(buf, plan.tdiOffset, tdiData, 0, numBits);
+			inData = buf;
+		}
+		if ( tdoData ) {
+			outData = buf;
+		}
+	}
+	fStatus = jtagClockFSM(handle, 0x00000001, 3, error);  // -> Shift-DR
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagTargetShiftDR()");
+	if ( outData ) {
+		fStatus = jtagShiftInOut(handle, plan.numBits, inData, outData, true, error);
+	} else {
+		fStatus = jtagShiftInOnly(handle, plan.numBits, inData, true, error);
+	}
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagTargetShiftDR()");
+	fStatus = jtagClockFSM(handle, 0x00000001, 2, error);  // -> Run-Test/Idle
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagTargetShiftDR()");
+	if ( tdoData && outData != tdoData ) {
+		bitCopy(tdoData, 0, outData, plan.tdoOffset, numBits);
+	}
+cleanup:
+	if ( buf != local ) {
+		free((void*)buf);
+	}
+	return retVal;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CHAIN_H
+#define CHAIN_H
+
+#include <makestuff/common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// Look up the IR length of a device by its IDCODE, or return zero if it's not known.
+	uint8 chainLookupIRLength(uint32 idCode);
+
+	// Describes the bit-stream needed to reach one device's data register, given that every other
+	// device in the chain is in BYPASS. The TDI stream has the target's data at bit tdiOffset, and
+	// the target's captured data appears in the TDO stream at bit tdoOffset.
+	struct ChainPlan {
+		uint32 numBits;
+		uint32 tdiOffset;
+		uint32 tdoOffset;
+	};
+
+	// Plan a DR scan of dataBits bits on the given device of a chain of numDevices devices, with
+	// device zero nearest TDI. If isReading is false, only enough bits are clocked to load the
+	// target's data register.
+	void chainPlanDR(
+		uint32 numDevices, uint32 device, uint32 dataBits, bool isReading, struct ChainPlan *plan
+	);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
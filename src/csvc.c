@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef WIN32
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/liberror.h>
+#include "csvc.h"
+#include "csvfplay.h"
+#include "svf2csvf.h"
+#include "hash.h"
+#include "xsvf.h"
+#include "private.h"
+
+// -------------------------------------------------------------------------------------------------
+// Declaration of private types & functions
+// -------------------------------------------------------------------------------------------------
+
+static FLStatus rleEncode(
+	const uint8 *src, uint32 length, struct Buffer *out, const char **error);
+static bool rleDecode(const uint8 *src, uint32 srcLength, uint8 *dst, uint32 dstLength);
+static FLStatus mapFile(
+	const char *fileName, const uint8 **base, size_t *size, const char **error);
+static void unmapFile(const uint8 *base, size_t size);
+
+static const uint8 magic[] = {'C', 'S', 'V', 'C'};
+
+// -------------------------------------------------------------------------------------------------
+// Public functions
+// -------------------------------------------------------------------------------------------------
+
+DLLEXPORT(FLStatus) flSaveCsvc(
+	const char *csvcFile, const uint8 *csvfData, uint32 blockSize, bool compress,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	struct Buffer index = {0,}, payload = {0,}, file = {0,};
+	const uint8 *block = csvfData, *ptr = csvfData;
+	uint32 xsdrBytes = 0, numBlocks = 0, maxBlock = 0, length, offset, stored, base, i;
+	uint8 entry[CSVC_INDEX_SIZE];
+	bool done = false;
+	bStatus = bufInitialise(&index, 1024, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flSaveCsvc()");
+	bStatus = bufInitialise(&payload, 0x10000, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flSaveCsvc()");
+	bStatus = bufInitialise(&file, 0x10000, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flSaveCsvc()");
+	while ( !done ) {
+		// Gather whole commands until there's at least blockSize of them
+		do {
+			done = (*ptr == XCOMPLETE);
+			ptr += csvfCommandLength(ptr, &xsdrBytes);
+		} while ( !done && (uint32)(ptr - block) < blockSize );
+		length = (uint32)(ptr - block);
+
+		// Compress it, unless that doesn't help
+		offset = (uint32)payload.length;
+		stored = length;
+		if ( compress ) {
+			fStatus = rleEncode(block, length, &payload, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "flSaveCsvc()");
+			stored = (uint32)payload.length - offset;
+			if ( stored >= length ) {
+				payload.length = offset;
+				stored = length;
+			}
+		}
+		if ( stored == length ) {
+			bStatus = bufAppendBlock(&payload, block, length, error);
+			CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flSaveCsvc()");
+		}
+		flWriteLong(offset, entry);
+		flWriteLong(stored, entry + 4);
+		flWriteLong(length, entry + 8);
+		flWriteLong(hashCrc32(0, payload.data + offset, stored), entry + 12);
+		bStatus = bufAppendBlock(&index, entry, CSVC_INDEX_SIZE, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flSaveCsvc()");
+		if ( length > maxBlock ) {
+			maxBlock = length;
+		}
+		numBlocks++;
+		block = ptr;
+	}
+
+	// The payload offsets are relative to the end of the index, so fix them up
+	base = CSVC_HDR_SIZE + numBlocks*CSVC_INDEX_SIZE;
+	for ( i = 0; i < numBlocks; i++ ) {
+		flWriteLong(flReadLong(index.data + i*CSVC_INDEX_SIZE) + base, index.data + i*CSVC_INDEX_SIZE);
+	}
+	bStatus = bufAppendConst(&file, 0x00, CSVC_HDR_SIZE, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flSaveCsvc()");
+	memcpy(file.data, magic, 4);
+	flWriteWord(CSVC_VERSION, file.data + 4);
+	flWriteWord(compress ? CSVC_FLAG_RLE : 0x0000, file.data + 6);
+	flWriteLong(numBlocks, file.data + 8);
+	flWriteLong((uint32)(ptr - csvfData), file.data + 12);
+	flWriteLong(maxBlock, file.data + 16);
+	bStatus = bufAppendBlock(&file, index.data, index.length, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flSaveCsvc()");
+	flWriteLong(hashCrc32(0, file.data, file.length), file.data + 20);
+	bStatus = bufAppendBlock(&file, payload.data, payload.length, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flSaveCsvc()");
+	bStatus = bufWriteBinaryFile(&file, csvcFile, 0, file.length, error);
+	CHECK_STATUS(bStatus, FL_FILE_ERR, cleanup, "flSaveCsvc()");
+cleanup:
+	bufDestroy(&file);
+	bufDestroy(&payload);
+	bufDestroy(&index);
+	return retVal;
+}
+
+bool csvcSniff(const char *fileName) {
+	uint8 header[sizeof(magic)];
+	bool isCsvc = false;
+	FILE *const file = fopen(fileName, "rb");
+	if ( file ) {
+		isCsvc =
+			fread(header, 1, sizeof(header), file) == sizeof(header) &&
+			!memcmp(header, magic, sizeof(magic));
+		fclose(file);
+	}
+	return isCsvc;
+}
+
+FLStatus csvcOpen(struct Csvc *self, const char *fileName, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	const uint8 *hdr, *entry;
+	uint32 crc, offset, stored, length, i;
+	uint8 zeros[4] = {0, 0, 0, 0};
+	memset(self, 0, sizeof(*self));
+	fStatus = mapFile(fileName, &self->base, &self->size, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "csvcOpen()");
+	hdr = self->base;
+	CHECK_STATUS(
+		self->size < CSVC_HDR_SIZE || memcmp(hdr, magic, sizeof(magic)), FL_FILE_ERR, cleanup,
+		"csvcOpen(): %s is not a CSVC file", fileName);
+	CHECK_STATUS(
+		flReadWord(hdr + 4) != CSVC_VERSION, FL_FILE_ERR, cleanup,
+		"csvcOpen(): %s is CSVC version %d; only version %d is supported",
+		fileName, flReadWord(hdr + 4), CSVC_VERSION);
+	self->numBlocks = flReadLong(hdr + 8);
+	self->csvfLength = flReadLong(hdr + 12);
+	self->maxBlock = flReadLong(hdr + 16);
+	CHECK_STATUS(
+		self->numBlocks == 0 ||
+		(self->size - CSVC_HDR_SIZE) / CSVC_INDEX_SIZE < self->numBlocks, FL_FILE_ERR, cleanup,
+		"csvcOpen(): %s has a bad block count", fileName);
+
+	// The CRC covers the header (with the CRC itself zeroed) and the index
+	crc = hashCrc32(0, hdr, 20);
+	crc = hashCrc32(crc, zeros, 4);
+	crc = hashCrc32(crc, hdr + CSVC_HDR_SIZE, self->numBlocks*CSVC_INDEX_SIZE);
+	CHECK_STATUS(
+		crc != flReadLong(hdr + 20), FL_FILE_ERR, cleanup,
+		"csvcOpen(): %s has a corrupt header", fileName);
+
+	// So the index can be trusted not to have been damaged; it may still have been made badly
+	for ( i = 0; i < self->numBlocks; i++ ) {
+		entry = hdr + CSVC_HDR_SIZE + i*CSVC_INDEX_SIZE;
+		offset = flReadLong(entry);
+		stored = flReadLong(entry + 4);
+		length = flReadLong(entry + 8);
+		CHECK_STATUS(
+			offset > self->size || stored > self->size - offset || stored > length ||
+			length > self->maxBlock, FL_FILE_ERR, cleanup,
+			"csvcOpen(): %s has a bad index entry for block %d", fileName, i);
+	}
+cleanup:
+	if ( retVal != FL_SUCCESS ) {
+		csvcClose(self);
+	}
+	return retVal;
+}
+
+void csvcClose(struct Csvc *self) {
+	if ( self->base ) {
+		unmapFile(self->base, self->size);
+		self->base = NULL;
+	}
+}
+
+FLStatus csvcGetBlock(
+	const struct Csvc *self, uint32 block, struct Buffer *out, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	const uint8 *const entry = self->base + CSVC_HDR_SIZE + block*CSVC_INDEX_SIZE;
+	const uint8 *const payload = self->base + flReadLong(entry);
+	const uint32 stored = flReadLong(entry + 4);
+	const uint32 length = flReadLong(entry + 8);
+	const size_t initLength = out->length;
+	CHECK_STATUS(
+		hashCrc32(0, payload, stored) != flReadLong(entry + 12), FL_FILE_ERR, cleanup,
+		"csvcGetBlock(): Block %d is corrupt", block);
+	if ( stored == length ) {
+		bStatus = bufAppendBlock(out, payload, length, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvcGetBlock()");
+	} else {
+		bStatus = bufAppendConst(out, 0x00, length, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvcGetBlock()");
+		if ( !rleDecode(payload, stored, out->data + initLength, length) ) {
+			out->length = initLength;
+			FAIL_RET(FL_FILE_ERR, cleanup, "csvcGetBlock(): Block %d does not decompress", block);
+		}
+	}
+cleanup:
+	return retVal;
+}
+
+FLStatus csvcLoad(const struct Csvc *self, struct Buffer *out, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint32 i;
+	for ( i = 0; i < self->numBlocks; i++ ) {
+		fStatus = csvcGetBlock(self, i, out, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvcLoad()");
+	}
+cleanup:
+	return retVal;
+}
+
+FLStatus csvcStream(const struct Csvc *self, struct CsvfSink *sink, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	struct Buffer block = {0,};
+	uint32 i;
+	bStatus = bufInitialise(&block, self->maxBlock, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvcStream()");
+	for ( i = 0; i < self->numBlocks; i++ ) {
+		block.length = 0;
+		fStatus = csvcGetBlock(self, i, &block, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvcStream()");
+		fStatus = sink->put(sink, &block, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvcStream()");
+	}
+cleanup:
+	bufDestroy(&block);
+	return retVal;
+}
+
+FLStatus csvcPlay(struct FLContext *handle, const struct Csvc *self, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	struct Buffer block = {0,};
+	struct CsvfPlayer player;
+	uint32 i;
+	bStatus = bufInitialise(&block, self->maxBlock + 1, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvcPlay()");
+	fStatus = csvfPlayInit(handle, &player, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "csvcPlay()");
+	for ( i = 0; i < self->numBlocks; i++ ) {
+		block.length = 0;
+		fStatus = csvcGetBlock(self, i, &block, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvcPlay()");
+		bStatus = bufAppendByte(&block, XCOMPLETE, error);  // only the last block has its own
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvcPlay()");
+		fStatus = csvfPlayCommands(handle, &player, block.data, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvcPlay()");
+	}
+cleanup:
+	bufDestroy(&block);
+	return retVal;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of private functions
+// -------------------------------------------------------------------------------------------------
+
+// PackBits: a header byte n in 0..127 is followed by n+1 literal bytes; one in 129..255 is followed
+// by a single byte to be repeated 257-n times. It's cheap to decode, and the long runs of 0x00 and
+// 0xFF in bitstream TDI & TDO data compress well.
+//
+// Called by:
+//   flSaveCsvc() -> rleEncode()
+//
+static FLStatus rleEncode(
+	const uint8 *src, uint32 length, struct Buffer *out, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	const size_t initLength = out->length;
+	uint8 *dst;
+	uint32 i = 0, start, run;
+	bStatus = bufAppendConst(out, 0x00, length + (length + 127)/128, error);  // worst case
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "rleEncode()");
+	dst = out->data + initLength;
+	while ( i < length ) {
+		run = 1;
+		while ( i + run < length && run < 128 && src[i + run] == src[i] ) {
+			run++;
+		}
+		if ( run >= 3 ) {
+			*dst++ = (uint8)(257 - run);
+			*dst++ = src[i];
+			i += run;
+		} else {
+			// Gather literals up to the next run of three or more
+			start = i;
+			while (
+				i < length && i - start < 128 &&
+				!(i + 2 < length && src[i] == src[i + 1] && src[i] == src[i + 2]) )
+			{
+				i++;
+			}
+			*dst++ = (uint8)(i - start - 1);
+			memcpy(dst, src + start, i - start);
+			dst += i - start;
+		}
+	}
+	out->length = (size_t)(dst - out->data);
+cleanup:
+	return retVal;
+}
+
+// Returns false if the data doesn't decompress to exactly dstLength bytes.
+//
+// Called by:
+//   csvcGetBlock() -> rleDecode()
+//
+static bool rleDecode(const uint8 *src, uint32 srcLength, uint8 *dst, uint32 dstLength) {
+	const uint8 *const srcEnd = src + srcLength;
+	const uint8 *const dstEnd = dst + dstLength;
+	uint32 count;
+	uint8 n;
+	while ( src < srcEnd ) {
+		n = *src++;
+		if ( n < 128 ) {
+			count = n + 1U;
+			if ( count > (uint32)(srcEnd - src) || count > (uint32)(dstEnd - dst) ) {
+				return false;
+			}
+			memcpy(dst, src, count);
+			src += count;
+			dst += count;
+		} else if ( n > 128 ) {
+			count = 257U - n;
+			if ( src == srcEnd || count > (uint32)(dstEnd - dst) ) {
+				return false;
+			}
+			memset(dst, *src++, count);
+			dst += count;
+		}
+	}
+	return dst == dstEnd;
+}
+
+// Called by:
+//   csvcOpen() -> mapFile()
+//
+static FLStatus mapFile(
+	const char *fileName, const uint8 **base, size_t *size, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+#ifdef WIN32
+	HANDLE mapping = NULL;
+	LARGE_INTEGER fileSize;
+	const HANDLE file = CreateFileA(
+		fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	CHECK_STATUS(
+		file == INVALID_HANDLE_VALUE, FL_FILE_ERR, cleanup,
+		"mapFile(): Unable to open %s", fileName);
+	CHECK_STATUS(
+		!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < CSVC_HDR_SIZE, FL_FILE_ERR, cleanup,
+		"mapFile(): %s is too short to be a CSVC file", fileName);
+	mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CHECK_STATUS(!mapping, FL_FILE_ERR, cleanup, "mapFile(): Unable to map %s", fileName);
+	*base = (const uint8 *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CHECK_STATUS(!*base, FL_FILE_ERR, cleanup, "mapFile(): Unable to map %s", fileName);
+	*size = (size_t)fileSize.QuadPart;
+cleanup:
+	// The view keeps the file open
+	if ( mapping ) {
+		CloseHandle(mapping);
+	}
+	if ( file != INVALID_HANDLE_VALUE ) {
+		CloseHandle(file);
+	}
+#else
+	struct stat st;
+	void *addr;
+	const int fd = open(fileName, O_RDONLY);
+	if ( fd < 0 ) {
+		errRenderStd(error);
+		errPrefix(error, "mapFile(): Unable to open %s", fileName);
+		FAIL_RET(FL_FILE_ERR, cleanup);
+	}
+	CHECK_STATUS(
+		fstat(fd, &st) || st.st_size < CSVC_HDR_SIZE, FL_FILE_ERR, cleanup,
+		"mapFile(): %s is too short to be a CSVC file", fileName);
+	addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if ( addr == MAP_FAILED ) {
+		errRenderStd(error);
+		errPrefix(error, "mapFile(): Unable to map %s", fileName);
+		FAIL_RET(FL_FILE_ERR, cleanup);
+	}
+	*base = (const uint8 *)addr;
+	*size = (size_t)st.st_size;
+cleanup:
+	// The mapping keeps the file open
+	if ( fd >= 0 ) {
+		close(fd);
+	}
+#endif
+	return retVal;
+}
+
+// Called by:
+//   csvcClose() -> unmapFile()
+//
+static void unmapFile(const uint8 *base, size_t size) {
+#ifdef WIN32
+	(void)size;
+	UnmapViewOfFile(base);
+#else
+	munmap((void *)base, size);
+#endif
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CSVC_H
+#define CSVC_H
+
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfpgalink.h>
+#include "csvfstream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// A CSVC file is a CSVF stream split into blocks of whole commands, each of which may be
+	// PackBits-compressed. All multi-byte fields are big-endian, like CSVF itself:
+	//
+	//    0  magic "CSVC"
+	//    4  version (u16)
+	//    6  flags (u16)
+	//    8  numBlocks (u32)
+	//   12  csvfLength (u32): the whole CSVF stream, including its XCOMPLETE
+	//   16  maxBlock (u32): the biggest block, uncompressed
+	//   20  crc (u32): CRC-32 of the header (with this field zeroed) and the index
+	//   24  index: numBlocks entries of {offset, storedLength, length, crc} (u32 each), giving
+	//       where each block's payload is in the file, its size there and when uncompressed, and
+	//       the CRC-32 of the payload as stored. A block is compressed iff storedLength < length.
+	//
+	#define CSVC_VERSION     1
+	#define CSVC_FLAG_RLE    0x0001
+	#define CSVC_HDR_SIZE    24
+	#define CSVC_INDEX_SIZE  16
+
+	// A CSVC file mapped into memory
+	struct Csvc {
+		const uint8 *base;
+		size_t size;
+		uint32 numBlocks;
+		uint32 csvfLength;
+		uint32 maxBlock;
+	};
+
+	// Does the file start with the CSVC magic?
+	bool csvcSniff(const char *fileName);
+
+	// Map the file and check its header & index. The blocks are checked as they're read.
+	FLStatus csvcOpen(
+		struct Csvc *self, const char *fileName, const char **error
+	) WARN_UNUSED_RESULT;
+	void csvcClose(struct Csvc *self);
+
+	// Append one block of CSVF (or the whole stream) to a buffer.
+	FLStatus csvcGetBlock(
+		const struct Csvc *self, uint32 block, struct Buffer *out, const char **error
+	) WARN_UNUSED_RESULT;
+	FLStatus csvcLoad(
+		const struct Csvc *self, struct Buffer *out, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Send the blocks on to a sink, one at a time.
+	FLStatus csvcStream(
+		const struct Csvc *self, struct CsvfSink *sink, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Play the CSVF into the JTAG port, decompressing each block just before it's needed.
+	FLStatus csvcPlay(
+		struct FLContext *handle, const struct Csvc *self, const char **error
+	) WARN_UNUSED_RESULT;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libbuffer.h>
+#include "private.h"
+#include "svf2csvf.h"
+#include "xsvf.h"
+#include "bits.h"
+
+// A cursor into one device's CSVF stream. The sticky XSDRSIZE, XTDOMASK and XRUNTEST state is
+// tracked as the stream is read, so each pending shift can be taken as a self-contained unit.
+struct Device {
+	const uint8 *ptr;     // the next record in the stream
+	uint32 xsdrSize;
+	uint32 runTest;
+	const uint8 *mask;    // the data of the most recent XTDOMASK, or NULL
+	uint32 maskBits;
+	uint8 cmd;            // the pending shift: XSIR, XSDR, XSDRTDO or XCOMPLETE
+	uint32 numBits;
+	const uint8 *data;    // the pending shift's data (interleaved TDI/TDO for XSDRTDO)
+	const uint8 *irData;  // the instruction most recently loaded from this stream
+	uint8 irLength;
+	bool inBypass;        // true if the merged stream has put this device in BYPASS
+};
+
+// The sticky state of the merged stream, and some scratch buffers for building shifts.
+struct MergeContext {
+	struct Buffer *out;
+	uint32 *maxBufSize;
+	uint32 xsdrSize;
+	uint32 runTest;
+	struct Buffer lastMask;
+	struct Buffer tdi;
+	struct Buffer tdo;
+	struct Buffer mask;
+	struct Buffer lane;
+};
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of private functions
+// -------------------------------------------------------------------------------------------------
+
+// Advance to the next shift in a device's stream, absorbing any state changes on the way.
+//
+// Called by:
+//   flMergeCsvf() -> nextShift()
+//   mergeIR() -> nextShift()
+//   mergeDR() -> nextShift()
+//
+static FLStatus nextShift(struct Device *dev, uint32 index, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	uint8 cmd;
+	for ( ;; ) {
+		cmd = *dev->ptr++;
+		switch ( cmd ) {
+		case XTDOMASK:
+			dev->mask = dev->ptr;
+			dev->maskBits = dev->xsdrSize;
+			dev->ptr += bitsToBytes(dev->xsdrSize);
+			break;
+		case XRUNTEST:
+			dev->runTest = readLongBE(dev->ptr);
+			dev->ptr += 4;
+			break;
+		case XSDRSIZE:
+			dev->xsdrSize = readLongBE(dev->ptr);
+			dev->ptr += 4;
+			break;
+		case XSIR:
+			dev->numBits = *dev->ptr++;
+			dev->data = dev->ptr;
+			dev->ptr += bitsToBytes(dev->numBits);
+			dev->cmd = XSIR;
+			return FL_SUCCESS;
+		case XSDR:
+			dev->numBits = dev->xsdrSize;
+			dev->data = dev->ptr;
+			dev->ptr += bitsToBytes(dev->numBits);
+			dev->cmd = XSDR;
+			return FL_SUCCESS;
+		case XSDRTDO:
+			dev->numBits = dev->xsdrSize;
+			dev->data = dev->ptr;
+			dev->ptr += 2*bitsToBytes(dev->numBits);
+			dev->cmd = XSDRTDO;
+			return FL_SUCCESS;
+		case XCOMPLETE:
+			dev->ptr--;  // park on the XCOMPLETE
+			dev->cmd = XCOMPLETE;
+			return FL_SUCCESS;
+		default:
+			FAIL_RET(
+				FL_PROG_SVF_UNKNOWN_CMD, cleanup,
+				"nextShift(): Unsupported command 0x%02X in stream %d", cmd, index);
+		}
+	}
+cleanup:
+	return retVal;
+}
+
+// Zero a scratch buffer and make it numBytes long.
+//
+// Called by:
+//   mergeIR() -> resetScratch()
+//   mergeDR() -> resetScratch()
+//
+static FLStatus resetScratch(struct Buffer *buf, uint32 numBytes, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	bufZeroLength(buf);
+	bStatus = bufAppendConst(buf, 0x00, numBytes, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "resetScratch()");
+cleanup:
+	return retVal;
+}
+
+// XRUNTEST is sticky, so only emit it when it changes.
+//
+// Called by:
+//   mergeIR() -> setRunTest()
+//   mergeDR() -> setRunTest()
+//
+static FLStatus setRunTest(struct MergeContext *cxt, uint32 runTest, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	if ( runTest != cxt->runTest ) {
+		bStatus = bufAppendByte(cxt->out, XRUNTEST, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "setRunTest()");
+		bStatus = bufAppendLongBE(cxt->out, runTest, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "setRunTest()");
+		cxt->runTest = runTest;
+	}
+cleanup:
+	return retVal;
+}
+
+// Emit one IR scan covering the whole chain, for the devices whose pending shift is cmd. If cmd
+// is XSIR, each of them gets its new instruction, and the XRUNTEST is the longest any of them
+// asked for. Otherwise, each of them gets its current instruction again, ready for its DR scan.
+// Either way, every other device is put in BYPASS.
+//
+// Called by:
+//   flMergeCsvf() -> mergeIR()
+//
+static FLStatus mergeIR(
+	struct MergeContext *cxt, struct Device *devs, uint32 numDevices, uint8 cmd,
+	const char **error)
+{
+	const bool loadNew = (cmd == XSIR);
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	uint32 numBits = 0, offset = 0, runTest = 0, i;
+	struct Device *dev;
+	for ( i = 0; i < numDevices; i++ ) {
+		dev = devs + i;
+		numBits += (loadNew && dev->cmd == XSIR) ? dev->numBits : dev->irLength;
+	}
+	CHECK_STATUS(
+		numBits > 255, FL_UNSUPPORTED_SIZE_ERR, cleanup,
+		"mergeIR(): The combined instruction register is %d bits long; the maximum is 255", numBits);
+	fStatus = resetScratch(&cxt->tdi, bitsToBytes(numBits), error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "mergeIR()");
+
+	// The device nearest TDO is shifted first
+	i = numDevices;
+	while ( i-- ) {
+		dev = devs + i;
+		if ( loadNew && dev->cmd == XSIR ) {
+			dev->irData = dev->data;
+			dev->irLength = (uint8)dev->numBits;
+			dev->inBypass = false;
+			if ( dev->runTest > runTest ) {
+				runTest = dev->runTest;
+			}
+			bitCopy(cxt->tdi.data, offset, dev->irData, 0, dev->irLength);
+		} else if ( !loadNew && dev->cmd == cmd ) {
+			dev->inBypass = false;
+			bitCopy(cxt->tdi.data, offset, dev->irData, 0, dev->irLength);
+		} else {
+			dev->inBypass = true;
+			bitFill(cxt->tdi.data, offset, dev->irLength, true);
+		}
+		offset += dev->irLength;
+	}
+	fStatus = setRunTest(cxt, runTest, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "mergeIR()");
+	bStatus = bufAppendByte(cxt->out, XSIR, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeIR()");
+	bStatus = bufAppendByte(cxt->out, (uint8)numBits, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeIR()");
+	bStatus = bufAppendBlock(cxt->out, cxt->tdi.data, bitsToBytes(numBits), error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeIR()");
+	if ( loadNew ) {
+		for ( i = 0; i < numDevices; i++ ) {
+			if ( devs[i].cmd == XSIR ) {
+				fStatus = nextShift(devs + i, i, error);
+				CHECK_STATUS(fStatus, fStatus, cleanup, "mergeIR()");
+			}
+		}
+	}
+cleanup:
+	return retVal;
+}
+
+// Emit one DR scan carrying the pending DR scan of every device whose pending shift is cmd
+// (either XSDR or XSDRTDO, never a mixture). The others must already be in BYPASS, so they each
+// contribute one don't-care bit. For XSDRTDO, the mask covers only the checked devices' bits.
+//
+// Called by:
+//   flMergeCsvf() -> mergeDR()
+//
+static FLStatus mergeDR(
+	struct MergeContext *cxt, struct Device *devs, uint32 numDevices, uint8 cmd,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	uint32 numBits = 0, numBytes, devBytes, offset = 0, runTest = 0, i, j;
+	const bool checkTDO = (cmd == XSDRTDO);
+	struct Device *dev;
+	for ( i = 0; i < numDevices; i++ ) {
+		dev = devs + i;
+		if ( dev->cmd == cmd ) {
+			numBits += dev->numBits;
+			if ( dev->runTest > runTest ) {
+				runTest = dev->runTest;
+			}
+		} else {
+			numBits++;
+		}
+	}
+	numBytes = bitsToBytes(numBits);
+	CHECK_STATUS(
+		checkTDO && numBytes > BUF_SIZE, FL_UNSUPPORTED_SIZE_ERR, cleanup,
+		"mergeDR(): Combined XSDRTDO of %d bytes exceeds the maximum of %d", numBytes, BUF_SIZE);
+	if ( cxt->maxBufSize && numBytes > *cxt->maxBufSize ) {
+		*cxt->maxBufSize = numBytes;
+	}
+	fStatus = resetScratch(&cxt->tdi, numBytes, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "mergeDR()");
+	fStatus = resetScratch(&cxt->tdo, numBytes, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "mergeDR()");
+	fStatus = resetScratch(&cxt->mask, numBytes, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "mergeDR()");
+
+	// The device nearest TDO is shifted first
+	i = numDevices;
+	while ( i-- ) {
+		dev = devs + i;
+		if ( dev->cmd != cmd ) {
+			offset++;
+		} else if ( cmd == XSDR ) {
+			bitCopy(cxt->tdi.data, offset, dev->data, 0, dev->numBits);
+			offset += dev->numBits;
+		} else {
+			// Separate the interleaved TDI & TDO bytes
+			devBytes = bitsToBytes(dev->numBits);
+			fStatus = resetScratch(&cxt->lane, 2*devBytes, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "mergeDR()");
+			for ( j = 0; j < devBytes; j++ ) {
+				cxt->lane.data[j] = dev->data[2*j];
+				cxt->lane.data[devBytes + j] = dev->data[2*j + 1];
+			}
+			bitCopy(cxt->tdi.data, offset, cxt->lane.data, 0, dev->numBits);
+			bitCopy(cxt->tdo.data, offset, cxt->lane.data + devBytes, 0, dev->numBits);
+			if ( dev->mask ) {
+				// Bits beyond the end of the last XTDOMASK are not checked
+				bitCopy(
+					cxt->mask.data, offset, dev->mask, 0,
+					(dev->maskBits < dev->numBits) ? dev->maskBits : dev->numBits);
+			} else {
+				// No XTDOMASK yet, so check every bit
+				bitFill(cxt->mask.data, offset, dev->numBits, true);
+			}
+			offset += dev->numBits;
+		}
+	}
+
+	if ( numBits != cxt->xsdrSize ) {
+		bStatus = bufAppendByte(cxt->out, XSDRSIZE, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeDR()");
+		bStatus = bufAppendLongBE(cxt->out, numBits, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeDR()");
+		cxt->xsdrSize = numBits;
+	}
+	if ( checkTDO ) {
+		if ( cxt->lastMask.length != numBytes ||
+		     memcmp(cxt->lastMask.data, cxt->mask.data, numBytes) != 0 )
+		{
+			bStatus = bufAppendByte(cxt->out, XTDOMASK, error);
+			CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeDR()");
+			bStatus = bufAppendBlock(cxt->out, cxt->mask.data, numBytes, error);
+			CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeDR()");
+			bufSwap(&cxt->lastMask, &cxt->mask);
+		}
+	}
+	fStatus = setRunTest(cxt, runTest, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "mergeDR()");
+	if ( checkTDO ) {
+		bStatus = bufAppendByte(cxt->out, XSDRTDO, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeDR()");
+		for ( j = 0; j < numBytes; j++ ) {
+			bStatus = bufAppendByte(cxt->out, cxt->tdi.data[j], error);
+			CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeDR()");
+			bStatus = bufAppendByte(cxt->out, cxt->tdo.data[j], error);
+			CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeDR()");
+		}
+	} else {
+		bStatus = bufAppendByte(cxt->out, XSDR, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeDR()");
+		bStatus = bufAppendBlock(cxt->out, cxt->tdi.data, numBytes, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "mergeDR()");
+	}
+	for ( i = 0; i < numDevices; i++ ) {
+		if ( devs[i].cmd == cmd ) {
+			fStatus = nextShift(devs + i, i, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "mergeDR()");
+		}
+	}
+cleanup:
+	return retVal;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of public functions
+// -------------------------------------------------------------------------------------------------
+
+// Merge one CSVF stream per device into a single stream for the whole chain. The streams advance
+// in lock-step: while any device has DR scans to do, they're combined into one DR scan per step,
+// with the devices that have no DR scan of that kind pending held in BYPASS. Once every device is
+// waiting for a new instruction (or has finished), the instructions are combined into one IR scan.
+// So the merged stream has about as many shifts as the longest of its inputs, rather than the sum.
+//
+// When an XSDRTDO fails its compare, csvfPlay() retries the whole scan. So a write-only XSDR is
+// never merged with an XSDRTDO, or a retried status poll on one device would repeat another
+// device's program write. Pending XSDRs go first, and the checked scans follow on their own.
+//
+DLLEXPORT(FLStatus) flMergeCsvf(
+	const uint8 *const *csvfData, uint32 numDevices, struct Buffer *csvfBuf, uint32 *maxBufSize,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	struct MergeContext cxt = {0,};
+	struct Device *devs = NULL;
+	uint32 numDR, numTDO, numIR, i;
+	uint8 cmd;
+	bool needIR;
+	CHECK_STATUS(
+		numDevices == 0, FL_FILE_ERR, cleanup,
+		"flMergeCsvf(): Nothing to merge");
+	cxt.out = csvfBuf;
+	cxt.maxBufSize = maxBufSize;
+	cxt.xsdrSize = 0xFFFFFFFF;  // force an XSDRSIZE before the first DR scan
+	bStatus = bufInitialise(&cxt.lastMask, 256, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flMergeCsvf()");
+	bStatus = bufInitialise(&cxt.tdi, 256, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flMergeCsvf()");
+	bStatus = bufInitialise(&cxt.tdo, 256, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flMergeCsvf()");
+	bStatus = bufInitialise(&cxt.mask, 256, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flMergeCsvf()");
+	bStatus = bufInitialise(&cxt.lane, 256, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flMergeCsvf()");
+	devs = (struct Device *)calloc(numDevices, sizeof(struct Device));
+	CHECK_STATUS(!devs, FL_ALLOC_ERR, cleanup, "flMergeCsvf()");
+	if ( maxBufSize ) {
+		*maxBufSize = 0;
+	}
+
+	// Each stream must load an instruction before anything else, so that we know its IR length
+	for ( i = 0; i < numDevices; i++ ) {
+		devs[i].ptr = csvfData[i];
+		fStatus = nextShift(devs + i, i, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flMergeCsvf()");
+		CHECK_STATUS(
+			devs[i].cmd != XSIR, FL_FILE_ERR, cleanup,
+			"flMergeCsvf(): Stream %d does not begin with an IR scan", i);
+	}
+
+	for ( ;; ) {
+		numDR = numTDO = numIR = 0;
+		for ( i = 0; i < numDevices; i++ ) {
+			if ( devs[i].cmd == XSDR ) {
+				numDR++;
+			} else if ( devs[i].cmd == XSDRTDO ) {
+				numTDO++;
+			} else if ( devs[i].cmd == XSIR ) {
+				numIR++;
+			}
+		}
+		if ( numDR || numTDO ) {
+			// The devices taking part must have their instruction loaded, and the rest be in BYPASS
+			cmd = numDR ? XSDR : XSDRTDO;
+			needIR = false;
+			for ( i = 0; i < numDevices; i++ ) {
+				if ( (devs[i].cmd == cmd) == devs[i].inBypass ) {
+					needIR = true;
+				}
+			}
+			if ( needIR ) {
+				fStatus = mergeIR(&cxt, devs, numDevices, cmd, error);
+				CHECK_STATUS(fStatus, fStatus, cleanup, "flMergeCsvf()");
+			}
+			fStatus = mergeDR(&cxt, devs, numDevices, cmd, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "flMergeCsvf()");
+		} else if ( numIR ) {
+			fStatus = mergeIR(&cxt, devs, numDevices, XSIR, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "flMergeCsvf()");
+		} else {
+			break;
+		}
+	}
+	bStatus = bufAppendByte(csvfBuf, XCOMPLETE, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flMergeCsvf()");
+cleanup:
+	free((void*)devs);
+	bufDestroy(&cxt.lane);
+	bufDestroy(&cxt.mask);
+	bufDestroy(&cxt.tdo);
+	bufDestroy(&cxt.tdi);
+	bufDestroy(&cxt.lastMask);
+	return retVal;
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/liberror.h>
+#include "csvfopt.h"
+#include "svf2csvf.h"
+#include "xsvf.h"
+#include "private.h"
+
+// -------------------------------------------------------------------------------------------------
+// Declaration of private types & functions
+// -------------------------------------------------------------------------------------------------
+
+static FLStatus emitLong(uint8 cmd, uint32 value, struct Buffer *out, const char **error);
+static FLStatus emitRunTest(struct CsvfOpt *self, struct Buffer *out, const char **error);
+static FLStatus emitSize(struct CsvfOpt *self, struct Buffer *out, const char **error);
+static FLStatus emitMask(
+	struct CsvfOpt *self, uint32 numBytes, struct Buffer *out, const char **error);
+static bool isZero(const uint8 *p, uint32 numBytes);
+
+// -------------------------------------------------------------------------------------------------
+// Public functions
+// -------------------------------------------------------------------------------------------------
+
+void csvfOptInit(struct CsvfOpt *self) {
+	self->wantSize = self->haveSize = 0;
+	self->wantRunTest = self->haveRunTest = 0;
+	self->wantMaskLength = self->haveMaskLength = 0;
+}
+
+// Shifts are never merged with their neighbours: each one goes through Update-IR or Update-DR, and
+// the device may act on every update (e.g. each word of a bitstream), so two shifts are not the
+// same as one longer one. What goes is every state record the player doesn't need.
+//
+FLStatus csvfOptimise(
+	struct CsvfOpt *self, const uint8 *data, size_t length, struct Buffer *out,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	const uint8 *const end = data + length;
+	const uint8 *ptr = data;
+	uint32 numBytes, i;
+	uint8 *dst;
+	while ( ptr < end ) {
+		numBytes = bitsToBytes(self->wantSize);
+		switch ( *ptr ) {
+		case XCOMPLETE:
+			bStatus = bufAppendByte(out, XCOMPLETE, error);
+			CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvfOptimise()");
+			ptr++;
+			break;
+
+		case XSDRSIZE:
+			self->wantSize = readLongBE(ptr + 1);
+			ptr += 5;
+			break;
+
+		case XRUNTEST:
+			self->wantRunTest = readLongBE(ptr + 1);
+			ptr += 5;
+			break;
+
+		case XTDOMASK:
+			CHECK_STATUS(
+				numBytes > BUF_SIZE, FL_UNSUPPORTED_SIZE_ERR, cleanup,
+				"csvfOptimise(): No room for a %d-byte XTDOMASK", numBytes);
+			memcpy(self->wantMask, ptr + 1, numBytes);
+			if ( numBytes > self->wantMaskLength ) {
+				self->wantMaskLength = numBytes;
+			}
+			ptr += 1 + numBytes;
+			break;
+
+		case XSIR:
+			fStatus = emitRunTest(self, out, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfOptimise()");
+			bStatus = bufAppendBlock(out, ptr, 2 + bitsToBytes((uint32)ptr[1]), error);
+			CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvfOptimise()");
+			ptr += 2 + bitsToBytes((uint32)ptr[1]);
+			break;
+
+		case XSDR:
+			fStatus = emitRunTest(self, out, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfOptimise()");
+			fStatus = emitSize(self, out, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfOptimise()");
+			bStatus = bufAppendBlock(out, ptr, 1 + numBytes, error);
+			CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvfOptimise()");
+			ptr += 1 + numBytes;
+			break;
+
+		case XSDRTDO:
+			fStatus = emitRunTest(self, out, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfOptimise()");
+			fStatus = emitSize(self, out, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfOptimise()");
+			if ( numBytes <= self->wantMaskLength && isZero(self->wantMask, numBytes) ) {
+				// Nothing to compare, so just shift in the TDI bytes
+				i = (uint32)out->length;
+				bStatus = bufAppendConst(out, XSDR, 1 + numBytes, error);
+				CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvfOptimise()");
+				dst = out->data + i + 1;
+				for ( i = 0; i < numBytes; i++ ) {
+					dst[i] = ptr[1 + 2*i];
+				}
+			} else {
+				if ( numBytes <= self->wantMaskLength ) {
+					fStatus = emitMask(self, numBytes, out, error);
+					CHECK_STATUS(fStatus, fStatus, cleanup, "csvfOptimise()");
+				}
+				bStatus = bufAppendBlock(out, ptr, 1 + 2*numBytes, error);
+				CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvfOptimise()");
+			}
+			ptr += 1 + 2*numBytes;
+			break;
+
+		default:
+			FAIL_RET(
+				FL_INTERNAL_ERR, cleanup,
+				"csvfOptimise(): Unrecognised CSVF command (cmd=0x%02X)!", *ptr);
+		}
+	}
+cleanup:
+	return retVal;
+}
+
+FLStatus csvfOptimiseBuffer(struct Buffer *csvfBuf, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	struct Buffer newBuf = {0,};
+	struct CsvfOpt *const opt = (struct CsvfOpt *)malloc(sizeof(struct CsvfOpt));
+	CHECK_STATUS(opt == NULL, FL_ALLOC_ERR, cleanup, "csvfOptimiseBuffer()");
+	csvfOptInit(opt);
+	bStatus = bufInitialise(&newBuf, csvfBuf->length, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvfOptimiseBuffer()");
+	fStatus = csvfOptimise(opt, csvfBuf->data, csvfBuf->length, &newBuf, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "csvfOptimiseBuffer()");
+	bufSwap(&newBuf, csvfBuf);
+cleanup:
+	bufDestroy(&newBuf);
+	free((void*)opt);
+	return retVal;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Optimising sink
+// -------------------------------------------------------------------------------------------------
+
+static FLStatus optSinkPut(struct CsvfSink *self, struct Buffer *block, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	struct CsvfOptSink *const sink = (struct CsvfOptSink *)self;
+	sink->out.length = 0;
+	fStatus = csvfOptimise(&sink->opt, block->data, block->length, &sink->out, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "optSinkPut()");
+	block->length = 0;
+	if ( sink->out.length ) {
+		fStatus = sink->next->put(sink->next, &sink->out, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "optSinkPut()");
+	}
+cleanup:
+	return retVal;
+}
+
+FLStatus csvfOptSinkInit(struct CsvfOptSink *self, struct CsvfSink *next, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	self->sink.put = optSinkPut;
+	self->next = next;
+	csvfOptInit(&self->opt);
+	bStatus = bufInitialise(&self->out, 1024, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvfOptSinkInit()");
+cleanup:
+	return retVal;
+}
+
+void csvfOptSinkDestroy(struct CsvfOptSink *self) {
+	bufDestroy(&self->out);
+}
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of private functions
+// -------------------------------------------------------------------------------------------------
+
+// Called by:
+//   emitRunTest() -> emitLong()
+//   emitSize() -> emitLong()
+//
+static FLStatus emitLong(uint8 cmd, uint32 value, struct Buffer *out, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	uint8 *p;
+	const size_t initLength = out->length;
+	bStatus = bufAppendConst(out, cmd, 5, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "emitLong()");
+	p = out->data + initLength;
+	p[1] = (uint8)(value >> 24);
+	p[2] = (uint8)(value >> 16);
+	p[3] = (uint8)(value >> 8);
+	p[4] = (uint8)value;
+cleanup:
+	return retVal;
+}
+
+// Called by:
+//   csvfOptimise() -> emitRunTest()
+//
+static FLStatus emitRunTest(struct CsvfOpt *self, struct Buffer *out, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	if ( self->wantRunTest != self->haveRunTest ) {
+		fStatus = emitLong(XRUNTEST, self->wantRunTest, out, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "emitRunTest()");
+		self->haveRunTest = self->wantRunTest;
+	}
+cleanup:
+	return retVal;
+}
+
+// Called by:
+//   csvfOptimise() -> emitSize()
+//
+static FLStatus emitSize(struct CsvfOpt *self, struct Buffer *out, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	if ( self->wantSize != self->haveSize ) {
+		fStatus = emitLong(XSDRSIZE, self->wantSize, out, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "emitSize()");
+		self->haveSize = self->wantSize;
+	}
+cleanup:
+	return retVal;
+}
+
+// The player compares only the first numBytes of its mask, so only those need to match.
+//
+// Called by:
+//   csvfOptimise() -> emitMask()
+//
+static FLStatus emitMask(
+	struct CsvfOpt *self, uint32 numBytes, struct Buffer *out, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	if ( numBytes > self->haveMaskLength || memcmp(self->haveMask, self->wantMask, numBytes) ) {
+		bStatus = bufAppendByte(out, XTDOMASK, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "emitMask()");
+		bStatus = bufAppendBlock(out, self->wantMask, numBytes, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "emitMask()");
+		memcpy(self->haveMask, self->wantMask, numBytes);
+		if ( numBytes > self->haveMaskLength ) {
+			self->haveMaskLength = numBytes;
+		}
+	}
+cleanup:
+	return retVal;
+}
+
+// Called by:
+//   csvfOptimise() -> isZero()
+//
+static bool isZero(const uint8 *p, uint32 numBytes) {
+	while ( numBytes-- ) {
+		if ( *p++ ) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CSVFOPT_H
+#define CSVFOPT_H
+
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfpgalink.h>
+#include "csvfplay.h"
+#include "csvfstream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// Tracks the sticky XSDRSIZE, XRUNTEST & XTDOMASK values, both as the input stream sets them
+	// and as the player will see them given what has been emitted so far. State records are only
+	// emitted just before a shift which needs them, and only if the player's copy is different.
+	struct CsvfOpt {
+		uint32 wantSize, haveSize;
+		uint32 wantRunTest, haveRunTest;
+		uint32 wantMaskLength, haveMaskLength;  // how many leading mask bytes are known
+		uint8 wantMask[BUF_SIZE];
+		uint8 haveMask[BUF_SIZE];
+	};
+
+	// Start with the state csvfPlayInit() leaves the player in.
+	void csvfOptInit(struct CsvfOpt *self);
+
+	// Optimise some whole commands, appending the result to out. Records which set state are held
+	// back until a shift needs them; an XCOMPLETE is passed straight through.
+	FLStatus csvfOptimise(
+		struct CsvfOpt *self, const uint8 *data, size_t length, struct Buffer *out,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Optimise a whole XCOMPLETE-terminated CSVF buffer in place.
+	FLStatus csvfOptimiseBuffer(
+		struct Buffer *csvfBuf, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// A sink which optimises each block before handing it on to another sink. Blocks which turn
+	// out to be empty are not passed on.
+	struct CsvfOptSink {
+		struct CsvfSink sink;
+		struct CsvfSink *next;
+		struct Buffer out;
+		struct CsvfOpt opt;
+	};
+	FLStatus csvfOptSinkInit(
+		struct CsvfOptSink *self, struct CsvfSink *next, const char **error
+	) WARN_UNUSED_RESULT;
+	void csvfOptSinkDestroy(struct CsvfOptSink *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -17,12 +17,20 @@
 // Uncomment for help debugging JTAG issues
 //#define DEBUG
 
-#ifdef DEBUG
-#include <stdio.h>
+#ifdef WIN32
+	#include <Windows.h>
+	#include <process.h>
+	#define getpid _getpid
+#else
+	#include <unistd.h>
 #endif
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <makestuff/common.h>
 #include <makestuff/liberror.h>
+#include "hash.h"
+#include "thread.h"
 #include "private.h"
 #include "vendorCommands.h"
 #include "xsvf.h"
@@ -32,6 +40,24 @@
 // Declaration of private types & functions
 // -------------------------------------------------------------------------------------------------
 
+// A checkpoint is saved at the first safe point after each CKPT_INTERVAL bytes of CSVF.
+#define CKPT_INTERVAL 0x10000
+#define CKPT_VERSION 1
+#define CKPT_HDR_SIZE 32
+#define CKPT_FILE_SIZE (CKPT_HDR_SIZE + BUF_SIZE)
+
+// A player which saves checkpoints as it goes. The player must come first.
+struct Resume {
+	struct CsvfPlayer player;
+	const uint8 *csvfData;
+	const char *ckptFile;
+	struct CsvfCheckpoint ckpt;
+};
+
+static FLStatus playerInit(
+	struct FLContext *handle, struct CsvfPlayer *player, const struct CsvfTap *tap,
+	const char **error);
+static FLStatus resumeSafePoint(struct CsvfPlayer *self, const uint8 *cmd, const char **error);
 static void dumpSimple(const unsigned char *input, unsigned int length, char *p);
 static bool tdoMatchFailed(
 	const uint8 *tdoData, const uint8 *tdoMask, const uint8 *tdoExpected, uint32 numBytes);
@@ -43,15 +69,44 @@ static bool tdoMatchFailed(
 // Play the CSVF stream into the JTAG port.
 //
 FLStatus csvfPlay(struct FLContext *handle, const uint8 *csvfData, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	struct CsvfPlayer player;
+	fStatus = csvfPlayInit(handle, &player, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+	fStatus = csvfPlayCommands(handle, &player, csvfData, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+cleanup:
+	return retVal;
+}
+
+// The real JTAG port
+const struct CsvfTap csvfJtag = {jtagClockFSM, jtagShiftInOut, jtagShiftInOnly, jtagClocks};
+
+// Reset the TAP and the player state, ready for the first csvfPlayCommands().
+//
+FLStatus csvfPlayInit(struct FLContext *handle, struct CsvfPlayer *player, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	fStatus = playerInit(handle, player, &csvfJtag, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayInit()");
+cleanup:
+	return retVal;
+}
+
+// Play CSVF commands up to the next XCOMPLETE, carrying the sticky XSDRSIZE, XRUNTEST & XTDOMASK
+// values over from (and on to) other calls with the same player.
+//
+FLStatus csvfPlayCommands(
+	struct FLContext *handle, struct CsvfPlayer *player, const uint8 *csvfData, const char **error)
+{
 	FLStatus retVal = FL_SUCCESS;
 	FLStatus fStatus;
 	uint8 thisByte, numBits;
 	uint32 numBytes;
 	uint8 *tdoPtr, *tdiPtr;
 	uint8 i;
-	uint32 xsdrSize = 0;
-	uint32 xruntest = 0;
-	uint8 tdoMask[BUF_SIZE];
+	uint32 xsdrSize = player->xsdrSize;
+	uint32 xruntest = player->xruntest;
+	uint8 *const tdoMask = player->tdoMask;
 	uint8 tdiData[BUF_SIZE];
 	uint8 tdoData[BUF_SIZE];
 	uint8 tdoExpected[BUF_SIZE];
@@ -62,9 +117,7 @@ FLStatus csvfPlay(struct FLContext *handle, const uint8 *csvfData, const char **
 	
 	uint8 *tdiAll;
 	const uint8 *ptr = csvfData;
-
-	fStatus = jtagClockFSM(handle, 0x0000001F, 6, error);  // Reset TAP, goto Run-Test/Idle
-	CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+	const uint8 *reported = csvfData;
 
 	thisByte = *ptr++;
 	while ( thisByte != XCOMPLETE ) {
@@ -101,8 +154,14 @@ FLStatus csvfPlay(struct FLContext *handle, const uint8 *csvfData, const char **
 			break;
 
 		case XSIR:
-			fStatus = jtagClockFSM(handle, 0x00000003, 4, error);  // -> Shift-IR
-			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+			if ( player->safePoint && player->settled ) {
+				player->xsdrSize = xsdrSize;
+				player->xruntest = xruntest;
+				fStatus = player->safePoint(player, ptr - 1, error);
+				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
+			}
+			fStatus = player->tap->clockFSM(handle, 0x00000003, 4, error);  // -> Shift-IR
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
 			numBits = *ptr++;
 			#ifdef DEBUG
 				printf("XSIR(%02X, ", numBits);
@@ -119,14 +178,15 @@ FLStatus csvfPlay(struct FLContext *handle, const uint8 *csvfData, const char **
 			#ifdef DEBUG
 				printf(")\n");
 			#endif
-			fStatus = jtagShiftInOnly(handle, numBits, tdiData, true, error);  // -> Exit1-DR
-			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
-			fStatus = jtagClockFSM(handle, 0x00000001, 2, error);  // -> Run-Test/Idle
-			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+			fStatus = player->tap->shiftInOnly(handle, numBits, tdiData, true, error);  // -> Exit1-DR
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
+			fStatus = player->tap->clockFSM(handle, 0x00000001, 2, error);  // -> Run-Test/Idle
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
 			if ( xruntest ) {
-				fStatus = jtagClocks(handle, xruntest, error);
-				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+				fStatus = player->tap->clocks(handle, xruntest, error);
+				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
 			}
+			player->settled = (xruntest != 0);
 			break;
 
 		case XSDRSIZE:
@@ -153,15 +213,15 @@ FLStatus csvfPlay(struct FLContext *handle, const uint8 *csvfData, const char **
 			numBytes = bitsToBytes(xsdrSize);
 			i = 0;
 			do {
-				fStatus = jtagClockFSM(handle, 0x00000001, 3, error);  // -> Shift-DR
-				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
-				fStatus = jtagShiftInOut(handle, xsdrSize, tdiData, tdoData, true, error);  // -> Exit1-DR
-				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
-				fStatus = jtagClockFSM(handle, 0x0000001A, 6, error);  // -> Run-Test/Idle
-				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+				fStatus = player->tap->clockFSM(handle, 0x00000001, 3, error);  // -> Shift-DR
+				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
+				fStatus = player->tap->shiftInOut(handle, xsdrSize, tdiData, tdoData, true, error);  // -> Exit1-DR
+				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
+				fStatus = player->tap->clockFSM(handle, 0x0000001A, 6, error);  // -> Run-Test/Idle
+				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
 				if ( xruntest ) {
-					fStatus = jtagClocks(handle, xruntest, error);
-					CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+					fStatus = player->tap->clocks(handle, xruntest, error);
+					CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
 				}
 				i++;
 				#ifdef DEBUG
@@ -178,9 +238,10 @@ FLStatus csvfPlay(struct FLContext *handle, const uint8 *csvfData, const char **
 				dumpSimple(tdoExpected, numBytes, expected);
 				FAIL_RET(
 					FL_PROG_SVF_COMPARE, cleanup,
-					"csvfPlay(): XSDRTDO failed:\n  Got: %s\n  Mask: %s\n  Expecting: %s",
+					"csvfPlayCommands(): XSDRTDO failed:\n  Got: %s\n  Mask: %s\n  Expecting: %s",
 					data, mask, expected);
 			}
+			player->settled = (xruntest != 0);
 			break;
 
 		case XSDR:
@@ -188,32 +249,180 @@ FLStatus csvfPlay(struct FLContext *handle, const uint8 *csvfData, const char **
 				// TODO: Need to print actual TDO data too
 				printf("XSDR(%08X)\n", xsdrSize);
 			#endif
-			fStatus = jtagClockFSM(handle, 0x00000001, 3, error);  // -> Shift-DR
-			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+			fStatus = player->tap->clockFSM(handle, 0x00000001, 3, error);  // -> Shift-DR
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
 			numBytes = bitsToBytes(xsdrSize);
 			tdiAll = malloc(numBytes);
 			tdiPtr = tdiAll;
 			while ( numBytes-- ) {
 				*tdiPtr++ = *ptr++;
 			}
-			fStatus = jtagShiftInOnly(handle, xsdrSize, tdiAll, true, error);  // -> Exit1-DR
+			fStatus = player->tap->shiftInOnly(handle, xsdrSize, tdiAll, true, error);  // -> Exit1-DR
 			free(tdiAll);
-			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
-			fStatus = jtagClockFSM(handle, 0x00000001, 2, error);  // -> Run-Test/Idle
-			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
+			fStatus = player->tap->clockFSM(handle, 0x00000001, 2, error);  // -> Run-Test/Idle
+			CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
 			if ( xruntest ) {
-				fStatus = jtagClocks(handle, xruntest, error);
-				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlay()");
+				fStatus = player->tap->clocks(handle, xruntest, error);
+				CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
 			}
+			player->settled = (xruntest != 0);
 			break;
 
 		default:
 			FAIL_RET(
 				FL_PROG_SVF_UNKNOWN_CMD, cleanup,
-				"csvfPlay(): Unsupported command 0x%02X", thisByte);
+				"csvfPlayCommands(): Unsupported command 0x%02X", thisByte);
 		}
+		fStatus = progAdvance(handle, (uint64)(ptr - reported), error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayCommands()");
+		reported = ptr;
 		thisByte = *ptr++;
 	}
+cleanup:
+	player->xsdrSize = xsdrSize;
+	player->xruntest = xruntest;
+	return retVal;
+}
+
+// Save a checkpoint. It's written to a temporary file which is then renamed, so a crash part-way
+// through leaves the previous checkpoint intact.
+//
+// File layout (all big-endian):
+//   0  "FLCK"
+//   4  CKPT_VERSION
+//   8  csvfLength
+//   12 csvfCrc
+//   16 offset
+//   20 xsdrSize
+//   24 xruntest
+//   28 CRC32 of bytes 0-27 and the mask
+//   32 tdoMask[BUF_SIZE]
+//
+FLStatus csvfCheckpointSave(
+	const char *fileName, const struct CsvfCheckpoint *ckpt, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	uint8 file[CKPT_FILE_SIZE];
+	char *const tmpName = (char *)malloc(strlen(fileName) + 32);
+	FILE *f = NULL;
+	uint32 crc;
+	size_t written;
+	CHECK_STATUS(!tmpName, FL_ALLOC_ERR, cleanup, "csvfCheckpointSave()");
+	sprintf(tmpName, "%s.%d-%u.tmp", fileName, (int)getpid(), threadUniqueId());
+	memcpy(file, "FLCK", 4);
+	flWriteLong(CKPT_VERSION, file + 4);
+	flWriteLong(ckpt->csvfLength, file + 8);
+	flWriteLong(ckpt->csvfCrc, file + 12);
+	flWriteLong(ckpt->offset, file + 16);
+	flWriteLong(ckpt->xsdrSize, file + 20);
+	flWriteLong(ckpt->xruntest, file + 24);
+	memcpy(file + CKPT_HDR_SIZE, ckpt->tdoMask, BUF_SIZE);
+	crc = hashCrc32(0, file, 28);
+	crc = hashCrc32(crc, file + CKPT_HDR_SIZE, BUF_SIZE);
+	flWriteLong(crc, file + 28);
+	f = fopen(tmpName, "wb");
+	CHECK_STATUS(
+		!f, FL_FILE_ERR, cleanup,
+		"csvfCheckpointSave(): Unable to create %s", tmpName);
+	written = fwrite(file, 1, CKPT_FILE_SIZE, f);
+	if ( fclose(f) || written != CKPT_FILE_SIZE ) {
+		remove(tmpName);
+		FAIL_RET(
+			FL_FILE_ERR, cleanup,
+			"csvfCheckpointSave(): Unable to write %s", tmpName);
+	}
+	#ifdef WIN32
+		if ( !MoveFileExA(tmpName, fileName, MOVEFILE_REPLACE_EXISTING) ) {
+	#else
+		if ( rename(tmpName, fileName) ) {
+	#endif
+		remove(tmpName);
+		FAIL_RET(
+			FL_FILE_ERR, cleanup,
+			"csvfCheckpointSave(): Unable to replace %s", fileName);
+	}
+cleanup:
+	free((void*)tmpName);
+	return retVal;
+}
+
+// Load a checkpoint, checking it's complete and undamaged.
+//
+bool csvfCheckpointLoad(const char *fileName, struct CsvfCheckpoint *ckpt) {
+	size_t length;
+	uint8 *const file = flLoadFile(fileName, &length);
+	bool valid;
+	uint32 crc;
+	if ( !file ) {
+		return false;
+	}
+	valid = length == CKPT_FILE_SIZE && !memcmp(file, "FLCK", 4) &&
+		flReadLong(file + 4) == CKPT_VERSION && flReadLong(file + 20) <= BUF_SIZE*8;
+	if ( valid ) {
+		crc = hashCrc32(0, file, 28);
+		crc = hashCrc32(crc, file + CKPT_HDR_SIZE, BUF_SIZE);
+		valid = flReadLong(file + 28) == crc;
+	}
+	if ( valid ) {
+		ckpt->csvfLength = flReadLong(file + 8);
+		ckpt->csvfCrc = flReadLong(file + 12);
+		ckpt->offset = flReadLong(file + 16);
+		ckpt->xsdrSize = flReadLong(file + 20);
+		ckpt->xruntest = flReadLong(file + 24);
+		memcpy(ckpt->tdoMask, file + CKPT_HDR_SIZE, BUF_SIZE);
+	}
+	flFreeFile(file);
+	return valid;
+}
+
+// Play the CSVF stream, saving a checkpoint at safe points so an interrupted run can carry on
+// where it left off rather than starting again. The TAP is reset either way; a resumed run then
+// starts at an XSIR with the sticky XSDRSIZE, XRUNTEST & XTDOMASK values restored.
+//
+FLStatus csvfPlayResumable(
+	struct FLContext *handle, const uint8 *csvfData, size_t csvfLength, const char *ckptFile,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	fStatus = csvfPlayResumableOn(handle, &csvfJtag, csvfData, csvfLength, ckptFile, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayResumable()");
+cleanup:
+	return retVal;
+}
+
+// Like csvfPlayResumable(), but driving the given TAP.
+//
+FLStatus csvfPlayResumableOn(
+	struct FLContext *handle, const struct CsvfTap *tap, const uint8 *csvfData, size_t csvfLength,
+	const char *ckptFile, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	struct Resume resume;
+	const uint32 crc = hashCrc32(0, csvfData, csvfLength);
+	uint32 offset = 0;
+	fStatus = playerInit(handle, &resume.player, tap, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayResumableOn()");
+	resume.player.safePoint = resumeSafePoint;
+	resume.csvfData = csvfData;
+	resume.ckptFile = ckptFile;
+	if (
+		csvfCheckpointLoad(ckptFile, &resume.ckpt) &&
+		resume.ckpt.csvfLength == csvfLength && resume.ckpt.csvfCrc == crc &&
+		resume.ckpt.offset < csvfLength && csvfData[resume.ckpt.offset] == XSIR )
+	{
+		offset = resume.ckpt.offset;
+		resume.player.xsdrSize = resume.ckpt.xsdrSize;
+		resume.player.xruntest = resume.ckpt.xruntest;
+		memcpy(resume.player.tdoMask, resume.ckpt.tdoMask, BUF_SIZE);
+	} else {
+		resume.ckpt.csvfLength = (uint32)csvfLength;
+		resume.ckpt.csvfCrc = crc;
+		resume.ckpt.offset = 0;
+	}
+	fStatus = csvfPlayCommands(handle, &resume.player, csvfData + offset, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "csvfPlayResumableOn()");
+	remove(ckptFile);
 cleanup:
 	return retVal;
 }
@@ -222,6 +431,49 @@ cleanup:
 // Implementation of private functions
 // -------------------------------------------------------------------------------------------------
 
+// Reset the TAP and the player state, with the player driving the given TAP.
+//
+// Called by:
+//   csvfPlayInit() -> playerInit()
+//   csvfPlayResumableOn() -> playerInit()
+//
+static FLStatus playerInit(
+	struct FLContext *handle, struct CsvfPlayer *player, const struct CsvfTap *tap,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	player->tap = tap;
+	player->xsdrSize = 0;
+	player->xruntest = 0;
+	player->settled = false;
+	player->safePoint = NULL;
+	fStatus = tap->clockFSM(handle, 0x0000001F, 6, error);  // Reset TAP, goto Run-Test/Idle
+	CHECK_STATUS(fStatus, fStatus, cleanup, "playerInit()");
+cleanup:
+	return retVal;
+}
+
+// Save a checkpoint if it's been long enough since the last one.
+//
+// Called by:
+//   csvfPlayResumableOn() -> csvfPlayCommands() -> resumeSafePoint()
+//
+static FLStatus resumeSafePoint(struct CsvfPlayer *self, const uint8 *cmd, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	struct Resume *const resume = (struct Resume *)self;
+	const uint32 offset = (uint32)(cmd - resume->csvfData);
+	if ( offset - resume->ckpt.offset >= CKPT_INTERVAL ) {
+		resume->ckpt.offset = offset;
+		resume->ckpt.xsdrSize = self->xsdrSize;
+		resume->ckpt.xruntest = self->xruntest;
+		memcpy(resume->ckpt.tdoMask, self->tdoMask, BUF_SIZE);
+		fStatus = csvfCheckpointSave(resume->ckptFile, &resume->ckpt, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "resumeSafePoint()");
+	}
+cleanup:
+	return retVal;
+}
+
 static const char *const nibbles = "0123456789ABCDEF";
 
 // Dump some hex bytes to a buffer.
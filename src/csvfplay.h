@@ -19,6 +19,7 @@
 
 #include <makestuff/common.h>
 #include <makestuff/libfpgalink.h>
+#include "xsvf.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,6 +30,72 @@ extern "C" {
 		struct FLContext *handle, const uint8 *csvfData, const char **error
 	) WARN_UNUSED_RESULT;
 
+	// The JTAG operations the player drives. csvfJtag is the real port; tests give their own, to
+	// see what the player does.
+	struct CsvfTap {
+		FLStatus (*clockFSM)(
+			struct FLContext *handle, uint32 bitPattern, uint8 transitionCount, const char **error);
+		FLStatus (*shiftInOut)(
+			struct FLContext *handle, uint32 numBits, const uint8 *tdiData, uint8 *tdoData,
+			uint8 isLast, const char **error);
+		FLStatus (*shiftInOnly)(
+			struct FLContext *handle, uint32 numBits, const uint8 *tdiData, uint8 isLast,
+			const char **error);
+		FLStatus (*clocks)(struct FLContext *handle, uint32 numClocks, const char **error);
+	};
+	extern const struct CsvfTap csvfJtag;
+
+	// The state remembered from one CSVF command to the next, so a stream can be played in pieces.
+	// If safePoint is set, it's called before each XSIR which follows a shift with a non-zero
+	// XRUNTEST (e.g the wait for an erase or a page program to finish), since a stream can be
+	// restarted from there.
+	struct CsvfPlayer {
+		uint32 xsdrSize;
+		uint32 xruntest;
+		uint8 tdoMask[BUF_SIZE];
+		bool settled;  // the last shift had a non-zero XRUNTEST
+		const struct CsvfTap *tap;
+		FLStatus (*safePoint)(struct CsvfPlayer *self, const uint8 *cmd, const char **error);
+	};
+
+	// Reset the TAP and the player state, with the player driving the real JTAG port.
+	FLStatus csvfPlayInit(
+		struct FLContext *handle, struct CsvfPlayer *player, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Play CSVF commands up to (but not including) the next XCOMPLETE.
+	FLStatus csvfPlayCommands(
+		struct FLContext *handle, struct CsvfPlayer *player, const uint8 *csvfData,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Where a stream can restart, and the player state to restart with.
+	struct CsvfCheckpoint {
+		uint32 csvfLength;  // the stream this is for...
+		uint32 csvfCrc;     // ...
+		uint32 offset;      // ...and where in it to restart
+		uint32 xsdrSize;
+		uint32 xruntest;
+		uint8 tdoMask[BUF_SIZE];
+	};
+	FLStatus csvfCheckpointSave(
+		const char *fileName, const struct CsvfCheckpoint *ckpt, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Returns false if there's no checkpoint file, or it's damaged.
+	bool csvfCheckpointLoad(const char *fileName, struct CsvfCheckpoint *ckpt);
+
+	// Play the CSVF stream, saving a checkpoint every so often. If a checkpoint for this stream was
+	// saved by an earlier, failed run, playback restarts from there. It's removed on success.
+	FLStatus csvfPlayResumable(
+		struct FLContext *handle, const uint8 *csvfData, size_t csvfLength, const char *ckptFile,
+		const char **error
+	) WARN_UNUSED_RESULT;
+	FLStatus csvfPlayResumableOn(
+		struct FLContext *handle, const struct CsvfTap *tap, const uint8 *csvfData,
+		size_t csvfLength, const char *ckptFile, const char **error
+	) WARN_UNUSED_RESULT;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/liberror.h>
+#include "csvfstream.h"
+#include "svf2csvf.h"
+#include "csvc.h"
+#include "private.h"
+
+FLStatus csvfStreamFile(
+	const char *progFile, struct CsvfSink *sink, size_t blockSize, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	struct Buffer csvfBuf = {0,};
+	struct Csvc csvc = {0,};
+	const size_t nameLength = strlen(progFile);
+	const char *const ext = progFile + (nameLength > 5 ? nameLength - 5 : 0);
+	if ( csvcSniff(progFile) ) {
+		fStatus = csvcOpen(&csvc, progFile, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvfStreamFile()");
+		fStatus = csvcStream(&csvc, sink, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvfStreamFile()");
+	} else if ( strcmp(".svf", ext+1) == 0 ) {
+		fStatus = svfStream(progFile, sink, blockSize, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvfStreamFile()");
+	} else if ( strcmp(".xsvf", ext) == 0 ) {
+		fStatus = xsvfStream(progFile, sink, blockSize, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvfStreamFile()");
+	} else if ( strcmp(".csvf", ext) == 0 ) {
+		// Already CSVF, so just send it on whole
+		bStatus = bufInitialise(&csvfBuf, 0x20000, 0x00, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvfStreamFile()");
+		bStatus = bufAppendFromBinaryFile(&csvfBuf, progFile, error);
+		CHECK_STATUS(bStatus, FL_FILE_ERR, cleanup, "csvfStreamFile()");
+		fStatus = sink->put(sink, &csvfBuf, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "csvfStreamFile()");
+	} else {
+		FAIL_RET(
+			FL_FILE_ERR, cleanup,
+			"csvfStreamFile(): JTAG files should have .svf, .xsvf or .csvf extension");
+	}
+cleanup:
+	csvcClose(&csvc);
+	bufDestroy(&csvfBuf);
+	return retVal;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Buffer sink
+// -------------------------------------------------------------------------------------------------
+
+static FLStatus bufferSinkPut(struct CsvfSink *self, struct Buffer *block, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	struct CsvfBufferSink *const sink = (struct CsvfBufferSink *)self;
+	BufferStatus bStatus = bufAppendBlock(sink->buf, block->data, block->length, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "bufferSinkPut()");
+	block->length = 0;
+cleanup:
+	return retVal;
+}
+
+void csvfBufferSinkInit(struct CsvfBufferSink *self, struct Buffer *buf) {
+	self->sink.put = bufferSinkPut;
+	self->buf = buf;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Bounded queue
+// -------------------------------------------------------------------------------------------------
+
+// Blocks are never copied: the converter's block is swapped into a free slot, and the slot's old
+// buffer (the one the player last finished with) is handed back empty.
+//
+static FLStatus queuePut(struct CsvfSink *self, struct Buffer *block, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	struct CsvfQueue *const queue = (struct CsvfQueue *)self;
+	struct Buffer *slot;
+	mutexLock(&queue->lock);
+	while ( queue->count == CSVF_QUEUE_DEPTH && !queue->cancelled ) {
+		condWait(&queue->changed, &queue->lock);
+	}
+	if ( queue->cancelled ) {
+		mutexUnlock(&queue->lock);
+		FAIL_RET(FL_BAD_STATE, cleanup, "queuePut(): The player has stopped");
+	}
+	slot = queue->slots + (queue->head + queue->count) % CSVF_QUEUE_DEPTH;
+	bufSwap(slot, block);
+	block->length = 0;
+	queue->count++;
+	condBroadcast(&queue->changed);
+	mutexUnlock(&queue->lock);
+cleanup:
+	return retVal;
+}
+
+FLStatus csvfQueueInit(struct CsvfQueue *self, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	uint32 i;
+	memset(self, 0, sizeof(*self));
+	self->sink.put = queuePut;
+	mutexInit(&self->lock);
+	condInit(&self->changed);
+	for ( i = 0; i < CSVF_QUEUE_DEPTH; i++ ) {
+		bStatus = bufInitialise(self->slots + i, 1024, 0x00, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "csvfQueueInit()");
+	}
+cleanup:
+	return retVal;
+}
+
+void csvfQueueDestroy(struct CsvfQueue *self) {
+	uint32 i;
+	for ( i = 0; i < CSVF_QUEUE_DEPTH; i++ ) {
+		bufDestroy(self->slots + i);
+	}
+	if ( self->error ) {
+		errFree(self->error);
+	}
+	condDestroy(&self->changed);
+	mutexDestroy(&self->lock);
+}
+
+void csvfQueueClose(struct CsvfQueue *self, FLStatus status, const char *error) {
+	mutexLock(&self->lock);
+	self->closed = true;
+	self->status = status;
+	self->error = error;
+	condBroadcast(&self->changed);
+	mutexUnlock(&self->lock);
+}
+
+FLStatus csvfQueueTake(struct CsvfQueue *self, struct Buffer *block, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	FLStatus status;
+	block->length = 0;
+	mutexLock(&self->lock);
+	while ( self->count == 0 && !self->closed ) {
+		condWait(&self->changed, &self->lock);
+	}
+	if ( self->count ) {
+		bufSwap(self->slots + self->head, block);
+		self->head = (self->head + 1) % CSVF_QUEUE_DEPTH;
+		self->count--;
+		condBroadcast(&self->changed);
+		mutexUnlock(&self->lock);
+	} else {
+		// Finished; pass on the converter's error, if any
+		status = self->status;
+		if ( status && error ) {
+			*error = self->error;
+			self->error = NULL;
+		}
+		mutexUnlock(&self->lock);
+		CHECK_STATUS(status, status, cleanup, "csvfQueueTake()");
+	}
+cleanup:
+	return retVal;
+}
+
+void csvfQueueCancel(struct CsvfQueue *self) {
+	mutexLock(&self->lock);
+	self->cancelled = true;
+	condBroadcast(&self->changed);
+	mutexUnlock(&self->lock);
+}
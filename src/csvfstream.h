@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CSVFSTREAM_H
+#define CSVFSTREAM_H
+
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfpgalink.h>
+#include "thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// Somewhere for a converter to send its CSVF as it goes. Each block holds whole commands, and
+	// the last one ends with XCOMPLETE. The sink takes the block's contents, leaving it empty (but
+	// maybe swapped for another buffer) for the converter to carry on with.
+	struct CsvfSink {
+		FLStatus (*put)(struct CsvfSink *self, struct Buffer *block, const char **error);
+	};
+
+	// Convert the SVF, XSVF, CSVF or CSVC file and send it to the sink in blocks of roughly blockSize.
+	FLStatus csvfStreamFile(
+		const char *progFile, struct CsvfSink *sink, size_t blockSize, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Convert an XSVF file, sending the CSVF on to the sink in blocks of roughly blockSize bytes.
+	// The XSVF is read through a fixed window, so memory use is bounded by blockSize plus the
+	// biggest single command (which for an XSDRB...XSDRE sequence is the whole sequence).
+	FLStatus xsvfStream(
+		const char *xsvfFile, struct CsvfSink *sink, size_t blockSize, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// A sink which just appends the blocks to a buffer
+	struct CsvfBufferSink {
+		struct CsvfSink sink;
+		struct Buffer *buf;
+	};
+	void csvfBufferSinkInit(struct CsvfBufferSink *self, struct Buffer *buf);
+
+	// A bounded queue of blocks, for a converter thread to hand CSVF to a player thread. The
+	// converter blocks when the queue is full; the player blocks when it's empty.
+	#define CSVF_QUEUE_DEPTH 4
+	struct CsvfQueue {
+		struct CsvfSink sink;
+		struct Mutex lock;
+		struct Cond changed;
+		struct Buffer slots[CSVF_QUEUE_DEPTH];
+		uint32 head;        // the next slot to take
+		uint32 count;       // the number of full slots
+		bool closed;        // the converter has finished...
+		FLStatus status;    // ...with this result...
+		const char *error;  // ...and this error message
+		bool cancelled;     // the player has given up
+	};
+	FLStatus csvfQueueInit(
+		struct CsvfQueue *self, const char **error
+	) WARN_UNUSED_RESULT;
+	void csvfQueueDestroy(struct CsvfQueue *self);
+
+	// Converter side: finish, handing over the result and any error message
+	void csvfQueueClose(struct CsvfQueue *self, FLStatus status, const char *error);
+
+	// Player side: get the next block, or an empty one once the converter has finished. If the
+	// converter failed, its result and error are returned.
+	FLStatus csvfQueueTake(
+		struct CsvfQueue *self, struct Buffer *block, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Player side: give up, making the converter's next put() fail
+	void csvfQueueCancel(struct CsvfQueue *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
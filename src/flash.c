@@ -0,0 +1,530 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libfpgalink.h>
+#include "private.h"
+#include "flash.h"
+
+// SPI flash commands
+#define CMD_WREN 0x06  // write enable
+#define CMD_RDSR 0x05  // read status register
+#define CMD_READ 0x03  // read data
+#define CMD_PP   0x02  // page program
+#define CMD_SE   0xD8  // sector erase
+#define CMD_RDID 0x9F  // read JEDEC ID
+#define SR_WIP   0x01  // status register: write in progress
+
+// Every program or erase is followed by this many status reads in the same batch, so the flash
+// has usually finished by the time the host looks. If not, further batches of status reads are
+// issued, up to the given number of times.
+#define POLL_BYTES 32
+#define PAGE_TIMEOUT 1000
+#define SECTOR_TIMEOUT 100000
+
+// Reads and verifies are done this many bytes at a time
+#define READ_CHUNK 0x8000
+
+// The USER-register frame command used by the bridge for an SPI transaction
+#define BRIDGE_SPI_XFER 0x80
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of private functions
+// -------------------------------------------------------------------------------------------------
+
+// Given the status bytes from a preceding RDSR, the last of which is the most recent, keep polling
+// until the flash is no longer busy.
+//
+// Called by:
+//   busyCommand() -> waitReady()
+//
+static FLStatus waitReady(
+	struct FLContext *handle, FlashXfer xfer, const uint8 *status, uint32 timeout,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	const uint8 rdsr = CMD_RDSR;
+	uint8 poll[1 + POLL_BYTES];
+	struct FlashSeg seg;
+	seg.mosi = &rdsr;
+	seg.mosiLength = 1;
+	seg.miso = poll;
+	seg.length = 1 + POLL_BYTES;
+	while ( status[POLL_BYTES - 1] & SR_WIP ) {
+		CHECK_STATUS(
+			timeout-- == 0, FL_PROG_ERR, cleanup,
+			"waitReady(): Timed out waiting for the flash to finish");
+		fStatus = xfer(handle, &seg, 1, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "waitReady()");
+		status = poll + 1;
+	}
+cleanup:
+	return retVal;
+}
+
+// Enable writes, then issue a command which makes the flash busy, together with some status reads,
+// in one batch. Then wait for the flash to finish.
+//
+// Called by:
+//   flashUpdate() -> busyCommand()
+//
+static FLStatus busyCommand(
+	struct FLContext *handle, FlashXfer xfer, const uint8 *cmd, uint32 cmdLength, uint32 timeout,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	const uint8 wren = CMD_WREN;
+	const uint8 rdsr = CMD_RDSR;
+	uint8 status[1 + POLL_BYTES];
+	struct FlashSeg segs[3];
+	segs[0].mosi = &wren;
+	segs[0].mosiLength = 1;
+	segs[0].miso = NULL;
+	segs[0].length = 1;
+	segs[1].mosi = cmd;
+	segs[1].mosiLength = cmdLength;
+	segs[1].miso = NULL;
+	segs[1].length = cmdLength;
+	segs[2].mosi = &rdsr;
+	segs[2].mosiLength = 1;
+	segs[2].miso = status;
+	segs[2].length = 1 + POLL_BYTES;
+	fStatus = xfer(handle, segs, 3, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "busyCommand()");
+	fStatus = waitReady(handle, xfer, status + 1, timeout, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "busyCommand()");
+cleanup:
+	return retVal;
+}
+
+// Read the JEDEC ID (manufacturer, memory type & capacity) of the flash.
+//
+// Called by:
+//   jtagFlashOpen() -> flashReadId()
+//   spiFlashOpen() -> flashReadId()
+//
+FLStatus flashReadId(
+	struct FLContext *handle, FlashXfer xfer, uint32 *jedecId, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	const uint8 rdid = CMD_RDID;
+	uint8 id[4];
+	struct FlashSeg seg;
+	seg.mosi = &rdid;
+	seg.mosiLength = 1;
+	seg.miso = id;
+	seg.length = 4;
+	fStatus = xfer(handle, &seg, 1, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flashReadId()");
+	*jedecId = (uint32)((id[1] << 16) | (id[2] << 8) | id[3]);
+cleanup:
+	return retVal;
+}
+
+// Read a range of the flash.
+//
+// Called by:
+//   jtagFlashRead() -> flashRead()
+//   spiFlashRead() -> flashRead()
+//   flashUpdate() -> flashRead()
+//
+FLStatus flashRead(
+	struct FLContext *handle, FlashXfer xfer, uint32 address, uint32 length, uint8 *buffer,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint8 cmd[4];
+	uint8 *scratch = NULL;
+	uint32 chunkSize;
+	struct FlashSeg seg;
+	CHECK_STATUS(
+		address > FLASH_MAX_SIZE || length > FLASH_MAX_SIZE - address, FL_UNSUPPORTED_SIZE_ERR,
+		cleanup, "flashRead(): Range exceeds the 16MiB reach of three-byte addressing");
+	scratch = (uint8 *)malloc(4 + READ_CHUNK);
+	CHECK_STATUS(!scratch, FL_ALLOC_ERR, cleanup, "flashRead()");
+	seg.mosi = cmd;
+	seg.mosiLength = 4;
+	seg.miso = scratch;
+	while ( length ) {
+		chunkSize = (length > READ_CHUNK) ? READ_CHUNK : length;
+		cmd[0] = CMD_READ;
+		cmd[1] = (uint8)(address >> 16);
+		cmd[2] = (uint8)(address >> 8);
+		cmd[3] = (uint8)address;
+		seg.length = 4 + chunkSize;
+		fStatus = xfer(handle, &seg, 1, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flashRead()");
+		memcpy(buffer, scratch + 4, chunkSize);
+		buffer += chunkSize;
+		address += chunkSize;
+		length -= chunkSize;
+	}
+cleanup:
+	free((void*)scratch);
+	return retVal;
+}
+
+// Update a range of the flash a sector at a time. Each whole sector is read first, and left alone
+// if it already holds the new data. If the new data only clears bits, the pages which differ are
+// just programmed over the old data; otherwise the sector is erased and every page that isn't all
+// 0xFF is programmed. If the range ends part-way through a sector, the rest of that sector keeps
+// its old contents, which are programmed back after an erase. Each sector that was changed is
+// then read back to verify it.
+//
+// Called by:
+//   jtagFlashWrite() -> flashUpdate()
+//   spiFlashWrite() -> flashUpdate()
+//
+FLStatus flashUpdate(
+	struct FLContext *handle, FlashXfer xfer, uint32 address, uint32 length, const uint8 *data,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint8 cmd[4 + FLASH_PAGE_SIZE];
+	uint8 *current = NULL, *wanted;
+	uint32 offset, sectorSize, page, i;
+	bool needErase;
+	CHECK_STATUS(
+		address % FLASH_SECTOR_SIZE, FL_BAD_STATE, cleanup,
+		"flashUpdate(): Address 0x%06X is not on a %d-byte sector boundary", address, FLASH_SECTOR_SIZE);
+	CHECK_STATUS(
+		address > FLASH_MAX_SIZE || length > FLASH_MAX_SIZE - address, FL_UNSUPPORTED_SIZE_ERR,
+		cleanup, "flashUpdate(): Range exceeds the 16MiB reach of three-byte addressing");
+	current = (uint8 *)malloc(2*FLASH_SECTOR_SIZE);
+	CHECK_STATUS(!current, FL_ALLOC_ERR, cleanup, "flashUpdate()");
+	wanted = current + FLASH_SECTOR_SIZE;
+	for ( offset = 0; offset < length; offset += FLASH_SECTOR_SIZE ) {
+		sectorSize = (length - offset > FLASH_SECTOR_SIZE) ? FLASH_SECTOR_SIZE : length - offset;
+
+		// Is there anything to do?
+		fStatus = flashRead(handle, xfer, address + offset, FLASH_SECTOR_SIZE, current, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flashUpdate()");
+		if ( !memcmp(current, data + offset, sectorSize) ) {
+			continue;
+		}
+		memcpy(wanted, current, FLASH_SECTOR_SIZE);
+		memcpy(wanted, data + offset, sectorSize);
+
+		// Erase, unless programming can only clear bits that need clearing
+		needErase = false;
+		for ( i = 0; i < sectorSize; i++ ) {
+			if ( (current[i] & wanted[i]) != wanted[i] ) {
+				needErase = true;
+				break;
+			}
+		}
+		if ( needErase ) {
+			cmd[0] = CMD_SE;
+			cmd[1] = (uint8)((address + offset) >> 16);
+			cmd[2] = (uint8)((address + offset) >> 8);
+			cmd[3] = (uint8)(address + offset);
+			fStatus = busyCommand(handle, xfer, cmd, 4, SECTOR_TIMEOUT, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "flashUpdate()");
+			memset(current, 0xFF, FLASH_SECTOR_SIZE);
+		}
+
+		// Program the pages which differ
+		for ( page = 0; page < FLASH_SECTOR_SIZE; page += FLASH_PAGE_SIZE ) {
+			if ( !memcmp(current + page, wanted + page, FLASH_PAGE_SIZE) ) {
+				continue;
+			}
+			cmd[0] = CMD_PP;
+			cmd[1] = (uint8)((address + offset + page) >> 16);
+			cmd[2] = (uint8)((address + offset + page) >> 8);
+			cmd[3] = (uint8)(address + offset + page);
+			memcpy(cmd + 4, wanted + page, FLASH_PAGE_SIZE);
+			fStatus = busyCommand(handle, xfer, cmd, 4 + FLASH_PAGE_SIZE, PAGE_TIMEOUT, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "flashUpdate()");
+		}
+
+		// Verify
+		fStatus = flashRead(handle, xfer, address + offset, FLASH_SECTOR_SIZE, current, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flashUpdate()");
+		if ( memcmp(current, wanted, FLASH_SECTOR_SIZE) ) {
+			i = 0;
+			while ( current[i] == wanted[i] ) {
+				i++;
+			}
+			FAIL_RET(
+				FL_PROG_ERR, cleanup,
+				"flashUpdate(): Verify failed at address 0x%06X (wrote 0x%02X, read 0x%02X)",
+				address + offset + i, wanted[i], current[i]);
+		}
+	}
+cleanup:
+	free((void*)current);
+	return retVal;
+}
+
+// Run a batch of SPI transactions through the bridge in the FPGA, as back-to-back frames in a
+// single DR scan. Each frame is followed by one extra byte, which carries the MISO data of the last
+// byte of the transaction back out, and gives the bridge time to deselect the flash.
+//
+// Called by:
+//   flashReadId(), flashRead(), flashUpdate() etc -> jtagFlashXfer()
+//
+static FLStatus jtagFlashXfer(
+	struct FLContext *handle, const struct FlashSeg *segs, uint32 numSegs, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint32 total = 0, offset, i;
+	bool isReading = false;
+	uint8 *tdi = NULL, *tdo;
+	for ( i = 0; i < numSegs; i++ ) {
+		CHECK_STATUS(
+			segs[i].length == 0 || segs[i].length > USER_FRAME_MAX, FL_INTERNAL_ERR, cleanup,
+			"jtagFlashXfer(): Illegal transaction length %d", segs[i].length);
+		total += USER_READ_HDR + segs[i].length;
+		if ( segs[i].miso ) {
+			isReading = true;
+		}
+	}
+	tdi = (uint8 *)calloc(isReading ? 2*total : total, 1);
+	CHECK_STATUS(!tdi, FL_ALLOC_ERR, cleanup, "jtagFlashXfer()");
+	tdo = tdi + total;
+	offset = 0;
+	for ( i = 0; i < numSegs; i++ ) {
+		userMakeHeader(tdi + offset, BRIDGE_SPI_XFER, segs[i].length);
+		memcpy(tdi + offset + USER_WRITE_HDR, segs[i].mosi, segs[i].mosiLength);
+		spiBitSwap(segs[i].mosiLength, tdi + offset + USER_WRITE_HDR);
+		offset += USER_READ_HDR + segs[i].length;
+	}
+	fStatus = userScan(handle, tdi, total, isReading ? tdo : NULL, total, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagFlashXfer()");
+	offset = 0;
+	for ( i = 0; i < numSegs; i++ ) {
+		if ( segs[i].miso ) {
+			memcpy(segs[i].miso, tdo + offset + USER_READ_HDR, segs[i].length);
+			spiBitSwap(segs[i].length, segs[i].miso);
+		}
+		offset += USER_READ_HDR + segs[i].length;
+	}
+cleanup:
+	free((void*)tdi);
+	return retVal;
+}
+
+// Run SPI transactions one at a time, for firmware which can't run batches. SS is driven from
+// here, and the micro can't send and receive at once, so the command bytes are sent and then the
+// rest are received, which is all a flash needs; MISO during the command bytes reads as 0xFF.
+//
+// Called by:
+//   spiFlashXfer() -> spiFlashEach()
+//
+static FLStatus spiFlashEach(
+	struct FLContext *handle, const struct FlashSeg *segs, uint32 numSegs, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	bool isSelected = false;
+	uint32 i;
+	for ( i = 0; i < numSegs; i++ ) {
+		CHECK_STATUS(
+			segs[i].length < segs[i].mosiLength || (!segs[i].miso && segs[i].length != segs[i].mosiLength),
+			FL_INTERNAL_ERR, cleanup,
+			"spiFlashEach(): Illegal transaction length %d", segs[i].length);
+		fStatus = flSingleBitPortAccess(handle, handle->ssPort, handle->ssBit, PIN_LOW, NULL, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashEach()");
+		isSelected = true;
+		fStatus = spiSend(handle, segs[i].mosiLength, segs[i].mosi, SPI_MSBFIRST, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashEach()");
+		if ( segs[i].miso ) {
+			memset(segs[i].miso, 0xFF, segs[i].mosiLength);
+			if ( segs[i].length > segs[i].mosiLength ) {
+				fStatus = spiRecv(
+					handle, segs[i].length - segs[i].mosiLength, segs[i].miso + segs[i].mosiLength,
+					SPI_MSBFIRST, error);
+				CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashEach()");
+			}
+		}
+		isSelected = false;
+		fStatus = flSingleBitPortAccess(handle, handle->ssPort, handle->ssBit, PIN_HIGH, NULL, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashEach()");
+	}
+cleanup:
+	if ( isSelected ) {
+		// Deselect the flash so it abandons the command; the first error is the one reported
+		fStatus = flSingleBitPortAccess(handle, handle->ssPort, handle->ssBit, PIN_HIGH, NULL, NULL);
+	}
+	return retVal;
+}
+
+// Run a batch of SPI transactions in one spiXferBatch(), with the micro framing each with SS.
+//
+// Called by:
+//   spiFlashXfer() -> spiFlashBatch()
+//
+static FLStatus spiFlashBatch(
+	struct FLContext *handle, const struct FlashSeg *segs, uint32 numSegs, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint32 *lengths = NULL;
+	uint8 *data = NULL;
+	uint32 total = 0, offset, i;
+	for ( i = 0; i < numSegs; i++ ) {
+		CHECK_STATUS(
+			segs[i].length == 0 || segs[i].length > 0xFFFF || segs[i].length < segs[i].mosiLength,
+			FL_INTERNAL_ERR, cleanup,
+			"spiFlashBatch(): Illegal transaction length %d", segs[i].length);
+		total += segs[i].length;
+	}
+	lengths = (uint32 *)calloc(numSegs, sizeof(uint32));
+	CHECK_STATUS(!lengths, FL_ALLOC_ERR, cleanup, "spiFlashBatch()");
+	data = (uint8 *)calloc(total, 1);
+	CHECK_STATUS(!data, FL_ALLOC_ERR, cleanup, "spiFlashBatch()");
+	offset = 0;
+	for ( i = 0; i < numSegs; i++ ) {
+		lengths[i] = segs[i].length;
+		memcpy(data + offset, segs[i].mosi, segs[i].mosiLength);
+		offset += segs[i].length;
+	}
+	fStatus = spiXferBatch(handle, numSegs, lengths, data, data, SPI_MSBFIRST, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashBatch()");
+	offset = 0;
+	for ( i = 0; i < numSegs; i++ ) {
+		if ( segs[i].miso ) {
+			memcpy(segs[i].miso, data + offset, segs[i].length);
+		}
+		offset += segs[i].length;
+	}
+cleanup:
+	free((void*)data);
+	free((void*)lengths);
+	return retVal;
+}
+
+// Run a batch of SPI transactions directly on the micro's SPI port, selecting the flash with the
+// SS pin given to progOpen(). If the firmware can run SPI batches, the whole batch goes to the
+// micro at once, so a page program and its status polling cost just one round trip. Older
+// firmware (and the LPC firmware) gets the transactions one at a time.
+//
+// Called by:
+//   flashReadId(), flashRead(), flashUpdate() etc -> spiFlashXfer()
+//
+static FLStatus spiFlashXfer(
+	struct FLContext *handle, const struct FlashSeg *segs, uint32 numSegs, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	if ( handle->isSpiBatchCapable ) {
+		fStatus = spiFlashBatch(handle, segs, numSegs, error);
+	} else {
+		fStatus = spiFlashEach(handle, segs, numSegs, error);
+	}
+	CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashXfer()");
+cleanup:
+	return retVal;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of public functions
+// -------------------------------------------------------------------------------------------------
+
+DLLEXPORT(FLStatus) jtagFlashOpen(
+	struct FLContext *handle, const char *portConfig, const char *bridgeFile, uint32 device,
+	uint32 userInsn, uint32 *jedecId, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	char *progConfig = NULL;
+	uint32 id;
+	if ( bridgeFile ) {
+		progConfig = (char *)malloc(strlen(portConfig) + 3);
+		CHECK_STATUS(!progConfig, FL_ALLOC_ERR, cleanup, "jtagFlashOpen()");
+		sprintf(progConfig, "J:%s", portConfig);
+		fStatus = flProgram(handle, progConfig, bridgeFile, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagFlashOpen()");
+	}
+	fStatus = jtagChainDetect(handle, portConfig, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagFlashOpen()");
+	fStatus = progOpen(handle, portConfig, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagFlashOpen()");
+	fStatus = jtagUserOpen(handle, device, userInsn, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagFlashOpen()");
+	fStatus = flashReadId(handle, jtagFlashXfer, &id, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagFlashOpen()");
+	CHECK_STATUS(
+		id == 0x000000 || id == 0xFFFFFF, FL_PROG_ERR, cleanup,
+		"jtagFlashOpen(): No SPI flash responded through the bridge");
+	if ( jedecId ) {
+		*jedecId = id;
+	}
+cleanup:
+	free((void*)progConfig);
+	return retVal;
+}
+
+DLLEXPORT(FLStatus) jtagFlashWrite(
+	struct FLContext *handle, uint32 address, uint32 length, const uint8 *data, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	fStatus = flashUpdate(handle, jtagFlashXfer, address, length, data, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagFlashWrite()");
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(FLStatus) jtagFlashRead(
+	struct FLContext *handle, uint32 address, uint32 length, uint8 *buffer, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	fStatus = flashRead(handle, jtagFlashXfer, address, length, buffer, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagFlashRead()");
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(FLStatus) spiFlashOpen(
+	struct FLContext *handle, const char *portConfig, uint32 *jedecId, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint32 id;
+	fStatus = progOpen(handle, portConfig, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashOpen()");
+	fStatus = flSingleBitPortAccess(handle, handle->ssPort, handle->ssBit, PIN_HIGH, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashOpen()");
+	fStatus = flashReadId(handle, spiFlashXfer, &id, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashOpen()");
+	CHECK_STATUS(
+		id == 0x000000 || id == 0xFFFFFF, FL_PROG_ERR, cleanup,
+		"spiFlashOpen(): No SPI flash responded");
+	if ( jedecId ) {
+		*jedecId = id;
+	}
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(FLStatus) spiFlashWrite(
+	struct FLContext *handle, uint32 address, uint32 length, const uint8 *data, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	fStatus = flashUpdate(handle, spiFlashXfer, address, length, data, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashWrite()");
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(FLStatus) spiFlashRead(
+	struct FLContext *handle, uint32 address, uint32 length, uint8 *buffer, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	fStatus = flashRead(handle, spiFlashXfer, address, length, buffer, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "spiFlashRead()");
+cleanup:
+	return retVal;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLASH_H
+#define FLASH_H
+
+#include <makestuff/common.h>
+#include <makestuff/libfpgalink.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// SPI flash geometry & commands common to the M25P, N25Q, S25FL, W25Q, AT25 & MX25 families
+	#define FLASH_PAGE_SIZE   256
+	#define FLASH_SECTOR_SIZE 0x10000
+	#define FLASH_MAX_SIZE    0x1000000  // three-byte addressing only
+
+	// One SPI transaction, with the flash selected throughout. The length bytes are clocked
+	// MSB-first: the first mosiLength come from mosi and the rest are zeros. If miso is not NULL,
+	// it receives all length bytes clocked back from the flash.
+	struct FlashSeg {
+		const uint8 *mosi;
+		uint32 mosiLength;
+		uint8 *miso;
+		uint32 length;
+	};
+
+	// A transport runs a batch of transactions in order, deselecting the flash between each. It
+	// should run them all in one go if it can, because the engine gives it whole page-programs
+	// together with their status polling.
+	typedef FLStatus (*FlashXfer)(
+		struct FLContext *handle, const struct FlashSeg *segs, uint32 numSegs, const char **error
+	);
+
+	// Transport-independent flash operations
+	FLStatus flashReadId(
+		struct FLContext *handle, FlashXfer xfer, uint32 *jedecId, const char **error
+	) WARN_UNUSED_RESULT;
+	FLStatus flashRead(
+		struct FLContext *handle, FlashXfer xfer, uint32 address, uint32 length, uint8 *buffer,
+		const char **error
+	) WARN_UNUSED_RESULT;
+	FLStatus flashUpdate(
+		struct FLContext *handle, FlashXfer xfer, uint32 address, uint32 length, const uint8 *data,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
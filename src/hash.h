@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef HASH_H
+#define HASH_H
+
+#include <makestuff/common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// Update a running CRC-32 (the IEEE 802.3 one, as used by zip & PNG) with some more data. Start
+	// with a crc of zero.
+	uint32 hashCrc32(uint32 crc, const uint8 *data, size_t length);
+
+	// Update a running 64-bit FNV-1a hash with some more data. Start with HASH_FNV64_INIT. It's
+	// quick, and good enough for keying a cache, but it's no use against deliberate collisions.
+	#define HASH_FNV64_INIT 0xCBF29CE484222325ULL
+	uint64 hashFnv64(uint64 hash, const uint8 *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -96,6 +96,7 @@ DLLEXPORT(FLStatus) flOpen(const char *vp, struct FLContext **handle, const char
 		newCxt->commOutEP = (commEndpoints >> 4);
 		newCxt->commInEP = (commEndpoints & 0x0F);
 	}
+	newCxt->isSpiBatchCapable = (statusBuffer[14] & bmCAP_SPI_BATCH) ? true : false;
 	newCxt->firmwareID = (uint16)(
 		(statusBuffer[8] << 8) |
 		statusBuffer[9]
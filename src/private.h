@@ -22,6 +22,7 @@
 #include <makestuff/libfpgalink.h>
 #include <makestuff/libusbwrap.h>
 #include "firmware.h"
+#include "vendorCommands.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,6 +30,53 @@ extern "C" {
 
 	#define U32MAX 0xFFFFFFFFU
 
+	// The maximum number of devices in a JTAG chain described by jtagChainDetect()
+	#define CHAIN_MAX_DEVICES 32
+
+	// The maximum number of bulk transfers the pipelined NeroProg operations keep in flight
+	#define PIPELINE_DEPTH 8
+
+	// Progress reporting & cancellation for a flProgramAsync() operation
+	struct Progress {
+		FLProgressFunc func;
+		void *userData;
+		FLProgPhase phase;
+		uint64 done;
+		uint64 total;
+		uint64 nextReport;  // report again when done gets this far
+		double startTime;   // when this phase began
+		volatile uint32 isCancelled;  // only touched through threadAtomicGet() & threadAtomicSet()
+	};
+
+	// A pin named in a port config, and the state it should be put into
+	struct PinOp {
+		uint8 port;
+		uint8 bit;
+		uint8 config;  // a PinConfig
+	};
+
+	// A port config, parsed just once so it can be used again and again: the algorithm's own pins,
+	// the other pins to drive while programming, the bit-transformation for the data and the
+	// programming file, if one was named. A plain list of pins for flMultiBitPortAccess() has only
+	// the pins.
+	struct FLPortConfig {
+		char algoVendor;          // 'X', 'A', 'L' or 'J', or '\0' for a plain list of pins
+		ProgOp progOp;            // PROG_PARALLEL or PROG_SPI_SEND
+		struct PinOp ctrl[5];     // the algorithm's own pins, indexed by the enums below
+		uint8 dataPort;
+		uint8 dataBit;            // serial only; the parallel bus is mapped as a whole port
+		struct PinOp *pins;       // in port & bit order, or as given for a plain list
+		uint32 numPins;
+		uint8 lookupTable[256];
+		char *progFile;
+	};
+
+	// Where each algorithm keeps its own pins in FLPortConfig::ctrl
+	enum { X_PROG, X_INIT, X_DONE, X_CCLK };
+	enum { A_NCONFIG, A_DONE, A_DCLK };
+	enum { L_CRESET, L_CDONE, L_SS, L_SCK, L_SDI };
+	enum { J_TDO, J_TDI, J_TMS, J_TCK };
+
 	// Struct used to maintain context for most of the FPGALink operations
 	struct FLContext {
 		// USB connection
@@ -43,6 +91,7 @@ extern "C" {
 
 		// JTAG stuff
 		bool isNeroCapable;
+		bool isSpiBatchCapable;   // firmware understands PROG_SPI_BATCH
 		uint8 progOutEP;
 		uint8 progInEP;
 		uint8 misoPort, misoBit;  // TDO
@@ -50,13 +99,59 @@ extern "C" {
 		uint8 ssPort, ssBit;      // TMS
 		uint8 sckPort, sckBit;    // TCK
 
+		// JTAG chain descriptor (device zero is nearest TDI)
+		uint32 chainLength;
+		uint32 chainIdCodes[CHAIN_MAX_DEVICES];
+		uint8 chainIrLengths[CHAIN_MAX_DEVICES];
+
+		// USER-register channel (see jtagUserOpen())
+		bool isUserOpen;
+		uint32 userDevice;
+
 		// Async API context
 		struct CompletionReport completionReport;
 		uint8 *writeBuf;
 		uint8 *writePtr;
 		uint32 chunkSize;
+
+		// Set whilst a flProgramAsync() operation is running
+		struct Progress *progress;
 	};
 
+	// Report the start of a programming phase, or some progress through it. These do nothing
+	// unless a flProgramAsync() operation is running, and return FL_CANCELLED if it's been
+	// cancelled.
+	FLStatus progPhase(
+		struct FLContext *handle, FLProgPhase phase, uint64 total, const char **error
+	) WARN_UNUSED_RESULT;
+	FLStatus progAdvance(
+		struct FLContext *handle, uint64 amount, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Fingerprint a comma-separated list of programming files for flProgramIfDifferent()
+	FLStatus hashProgFiles(
+		const char *fileList, uint8 fingerprint[8], const char **error
+	) WARN_UNUSED_RESULT;
+
+	// True if a shift may use pipelinedShift(): no async CommFPGA transfers in flight or pending
+	bool canPipeline(struct FLContext *handle);
+
+	// Frame a batch of SPI transactions for spiXferBatch(), each getting a little-endian 16-bit
+	// count, and strip the counts from the reply; the stream is numSegs*2 bytes longer than the data
+	void spiBatchPack(
+		uint8 *stream, uint32 numSegs, const uint32 *segLengths, const uint8 *sendData,
+		uint8 bitOrder);
+	void spiBatchUnpack(
+		uint8 *recvData, uint32 numSegs, const uint32 *segLengths, const uint8 *stream,
+		uint8 bitOrder);
+
+	// Stream the data for a shift operation the micro has been asked to do, keeping several bulk
+	// transfers in flight, and translating each byte sent through lookupTable if it's not NULL.
+	FLStatus pipelinedShift(
+		struct FLContext *handle, const uint8 *inData, const uint8 *lookupTable, uint8 *outData,
+		bool isReceiving, uint32 numBytes, const char **error
+	) WARN_UNUSED_RESULT;
+
 	// Utility functions for manipulating big-endian words
 	uint16 flReadWord(const uint8 *p);
 	uint32 flReadLong(const uint8 *p);
@@ -102,6 +197,124 @@ extern "C" {
 		const char *svfFile, struct Buffer *csvfBuf, uint32 *maxBufSize, const char **error
 	) WARN_UNUSED_RESULT;
 
+	/**
+	 * @brief Load an SVF file and convert it to CSVF, using several threads
+	 *
+	 * Does the same job as \c flLoadSvfAndConvertToCsvf(), but splits the SVF file into chunks at
+	 * statement boundaries and converts them concurrently. The result plays identically, but each
+	 * chunk may begin by resending a TDO mask which is already in effect.
+	 *
+	 * @param svfFile The SVF filename.
+	 * @param csvfBuf A pointer to a \c Buffer to be populated with the CSVF data.
+	 * @param maxBufSize A pointer to a \c uint32 which will be set on exit to the number of bytes
+	 *            necessary for buffering in the playback logic.
+	 * @param numThreads The number of threads to use, or zero to use one for each CPU core.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c flFreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the command completed successfully.
+	 *     - \c FL_ALLOC_ERR if we ran out of memory, or a thread could not be started.
+	 *     - \c FL_FILE_ERR if the SVF file could not be loaded.
+	 *     - \c FL_SVF_PARSE_ERR if the SVF file could not be parsed.
+	 */
+	DLLEXPORT(FLStatus) flLoadSvfAndConvertToCsvfParallel(
+		const char *svfFile, struct Buffer *csvfBuf, uint32 *maxBufSize, uint32 numThreads,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Merge several CSVF streams into one, for programming a whole JTAG chain at once
+	 *
+	 * Each input stream must have been made for its device alone (i.e with no HIR/TIR/HDR/TDR
+	 * padding), and must begin with an IR scan. Stream zero is for the device nearest TDI, as
+	 * with \c jtagScanChain(). The merged stream does one IR or DR scan for all the devices at
+	 * once, keeping those with nothing to do in BYPASS.
+	 *
+	 * @param csvfData An array of \c numDevices pointers to CSVF streams.
+	 * @param numDevices The number of devices in the chain.
+	 * @param csvfBuf A pointer to a \c Buffer to be populated with the merged CSVF data.
+	 * @param maxBufSize A pointer to a \c uint32 which will be set on exit to the number of bytes
+	 *            necessary for buffering in the playback logic.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c flFreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the command completed successfully.
+	 *     - \c FL_ALLOC_ERR if we ran out of memory.
+	 *     - \c FL_FILE_ERR if a stream does not begin with an IR scan.
+	 *     - \c FL_PROG_SVF_UNKNOWN_CMD if a stream contains an unsupported command.
+	 *     - \c FL_UNSUPPORTED_SIZE_ERR if a combined scan is too long.
+	 */
+	DLLEXPORT(FLStatus) flMergeCsvf(
+		const uint8 *const *csvfData, uint32 numDevices, struct Buffer *csvfBuf, uint32 *maxBufSize,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Save a CSVF stream as a CSVC container
+	 *
+	 * A CSVC file holds the CSVF in blocks of whole commands, optionally compressed, with a header,
+	 * an index of the blocks and a CRC-32 for each. It can be given to \c flProgram() in place of
+	 * an SVF, XSVF or CSVF file, and is then played straight from a memory-mapping of the file,
+	 * one block at a time.
+	 *
+	 * @param csvcFile The CSVC filename.
+	 * @param csvfData The CSVF stream, ending in \c XCOMPLETE.
+	 * @param blockSize The uncompressed block size to aim for. Blocks only end between commands,
+	 *            so some will be bigger.
+	 * @param compress If true, blocks are PackBits-compressed, unless that would make them bigger.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c flFreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FL_SUCCESS if the command completed successfully.
+	 *     - \c FL_ALLOC_ERR if we ran out of memory.
+	 *     - \c FL_FILE_ERR if the CSVC file could not be written.
+	 */
+	DLLEXPORT(FLStatus) flSaveCsvc(
+		const char *csvcFile, const uint8 *csvfData, uint32 blockSize, bool compress,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	// USER-register channel frames move at most USER_FRAME_MAX bytes, just like a CommFPGA command.
+	// Each has a sync byte, a one-byte command and a big-endian 16-bit count. Read frames then have
+	// a turnaround byte, giving the FPGA a little time to fetch the first byte of the reply.
+	#define USER_FRAME_MAX 0x10000
+	#define USER_WRITE_HDR 4
+	#define USER_READ_HDR 5
+
+	// Fill in the header of a USER-register channel frame, work out how long a scan of such frames
+	// must be to reach the target, and do one such scan
+	void userMakeHeader(uint8 *frame, uint8 command, uint32 count);
+	uint32 userScanBits(uint32 numBefore, uint32 numAfter, uint32 tdiBytes, uint32 tdoBytes);
+	FLStatus userScan(
+		struct FLContext *handle, const uint8 *tdi, uint32 tdiBytes, uint8 *tdo, uint32 tdoBytes,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	// 7-series configuration frames are 101 32-bit words
+	#define FRAME_WORDS 101
+	#define FRAME_BYTES (4*FRAME_WORDS)
+	#define FRAME_BITS (32*FRAME_WORDS)
+
+	// Check frames read back by jtagScrub() against the golden frames (or their CRCs), ignoring the
+	// bits which are zero in the mask (if any), and append the indices of the bad ones to badFrames
+	struct ScrubContext {
+		const uint8 *golden;
+		const uint8 *mask;
+		const uint32 *goldenCrcs;
+		uint32 *badFrames;
+		uint32 numBad;
+	};
+	void scrubSink(void *cxt, uint32 firstFrame, const uint8 *frames, uint32 numFrames);
+
 	FLStatus copyFirmwareAndRewriteIDs(
 		const struct FirmwareInfo *fwInfo, uint16 vid, uint16 pid, uint16 did,
 		struct Buffer *dest, const char **error
@@ -22,8 +22,22 @@
 #include <makestuff/libfpgalink.h>
 #include "private.h"
 #include "csvfplay.h"
+#include "bitstream.h"
+#include "csvfstream.h"
+#include "csvfopt.h"
+#include "csvc.h"
+#include "cache.h"
+#include "hash.h"
+#include "thread.h"
+#include "xsvf.h"
 #include "vendorCommands.h"
 
+// How much CSVF flProgramStreaming() hands from the converter to the player at a time
+#define STREAM_BLOCK_SIZE 0x10000
+
+// How much configuration data is sent between progress reports in a flProgramAsync() operation
+#define PROGRESS_SLICE 0x4000
+
 // -------------------------------------------------------------------------------------------------
 // Implementation of private functions
 // -------------------------------------------------------------------------------------------------
@@ -109,6 +123,108 @@ cleanup:
 	return retVal;
 }
 
+// A shift may only be pipelined when there are no async CommFPGA transfers in flight, and none
+// being filled by flWriteChannelAsync() either: usbBulkWriteAsyncPrepare() would hand that same
+// buffer to pipelinedShift(), which would overwrite the buffered data and send it to the wrong
+// endpoint.
+//
+// Called by:
+//   jtagShiftInOut() -> canPipeline()
+//   jtagShiftInOnly() -> canPipeline()
+//   xProgram() -> dataWrite() -> canPipeline()
+//   aProgram() -> dataWrite() -> canPipeline()
+//   lProgram() -> dataWrite() -> canPipeline()
+//   spiSend() -> canPipeline()
+//   spiRecv() -> canPipeline()
+//   spiXfer() -> shiftInOut() -> canPipeline()
+//   spiXferBatch() -> shiftInOut() -> canPipeline()
+//
+bool canPipeline(struct FLContext *handle) {
+	return usbNumOutstandingRequests(handle->device) == 0 && !handle->writePtr;
+}
+
+// Stream the data for a shift operation to and from the micro, keeping several 64-byte bulk
+// transfers in flight rather than waiting for each to complete before starting the next. The
+// micro still works on one chunk at a time, but the USB round-trip latency between chunks is
+// hidden. If inData is NULL the operation is not sending, and if lookupTable is not NULL each byte
+// sent is translated through it. If isReceiving is true the received data goes to outData, or is
+// discarded if outData is NULL.
+//
+// Called by:
+//   jtagShiftInOut() -> pipelinedShift()
+//   jtagShiftInOnly() -> pipelinedShift()
+//   xProgram() -> dataWrite() -> pipelinedShift()
+//   aProgram() -> dataWrite() -> pipelinedShift()
+//   lProgram() -> dataWrite() -> pipelinedShift()
+//   spiSend() -> pipelinedShift()
+//   spiRecv() -> pipelinedShift()
+//   spiXfer() -> shiftInOut() -> pipelinedShift()
+//   spiXferBatch() -> shiftInOut() -> pipelinedShift()
+//
+FLStatus pipelinedShift(
+	struct FLContext *handle, const uint8 *inData, const uint8 *lookupTable, uint8 *outData,
+	bool isReceiving, uint32 numBytes, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	USBStatus uStatus;
+	struct CompletionReport report;
+	uint8 discard[64];
+	uint8 *sendPtr;
+	uint16 chunkSize, i;
+	while ( numBytes ) {
+		chunkSize = (uint16)((numBytes >= 64) ? 64 : numBytes);
+		if ( inData ) {
+			uStatus = usbBulkWriteAsyncPrepare(handle->device, &sendPtr, error);
+			CHECK_STATUS(uStatus, FL_PROG_SEND, cleanup, "pipelinedShift()");
+			if ( lookupTable ) {
+				for ( i = 0; i < chunkSize; i++ ) {
+					sendPtr[i] = lookupTable[inData[i]];
+				}
+			} else {
+				memcpy(sendPtr, inData, chunkSize);
+			}
+			uStatus = usbBulkWriteAsyncSubmit(
+				handle->device, handle->progOutEP, chunkSize, 5000, error);
+			CHECK_STATUS(uStatus, FL_PROG_SEND, cleanup, "pipelinedShift()");
+			inData += chunkSize;
+		}
+		if ( isReceiving ) {
+			uStatus = usbBulkReadAsync(
+				handle->device, handle->progInEP, outData ? outData : discard, chunkSize, 5000,
+				error);
+			CHECK_STATUS(uStatus, FL_PROG_RECV, cleanup, "pipelinedShift()");
+			if ( outData ) {
+				outData += chunkSize;
+			}
+		}
+		numBytes -= chunkSize;
+		while ( usbNumOutstandingRequests(handle->device) >= PIPELINE_DEPTH ) {
+			uStatus = usbBulkAwaitCompletion(handle->device, &report, error);
+			CHECK_STATUS(uStatus, FL_PROG_RECV, cleanup, "pipelinedShift()");
+			CHECK_STATUS(
+				report.flags.isRead && report.actualLength != report.requestLength,
+				FL_PROG_RECV, cleanup, "pipelinedShift(): Short read from the micro");
+		}
+	}
+	while ( usbNumOutstandingRequests(handle->device) ) {
+		uStatus = usbBulkAwaitCompletion(handle->device, &report, error);
+		CHECK_STATUS(uStatus, FL_PROG_RECV, cleanup, "pipelinedShift()");
+		CHECK_STATUS(
+			report.flags.isRead && report.actualLength != report.requestLength,
+			FL_PROG_RECV, cleanup, "pipelinedShift(): Short read from the micro");
+	}
+cleanup:
+	if ( retVal != FL_SUCCESS ) {
+		// Don't leave anything in flight; the next operation would get our completions
+		while ( usbNumOutstandingRequests(handle->device) ) {
+			if ( usbBulkAwaitCompletion(handle->device, &report, NULL) != USB_SUCCESS ) {
+				break;
+			}
+		}
+	}
+	return retVal;
+}
+
 static const char *spaces(ptrdiff_t n) {
 	const char *const s =
 		"                                                                "
@@ -171,7 +287,7 @@ static const char *spaces(ptrdiff_t n) {
 // location of that character stored in *endPtr.
 //
 // Called by:
-//   xProgram() -> populateMap()
+//   parseTail() -> populateMap()
 //
 static FLStatus populateMap(
 	const char *portConfig, const char *ptr, const char **endPtr,
@@ -208,7 +324,9 @@ cleanup:
 //
 // Called by:
 //   xProgram() -> portMap()
-//   progOpen() -> portMap()
+//   aProgram() -> portMap()
+//   lProgram() -> portMap()
+//   jtagOpen() -> portMap()
 //
 static FLStatus portMap(
 	struct FLContext *handle, LogicalPort patchOp, uint8 port, uint8 bit,
@@ -239,7 +357,9 @@ cleanup:
 // resulting translation map mirrors the bits.
 //
 // Called by:
-//   xProgram() -> makeLookup()
+//   xCompile() -> makeLookup()
+//   aCompile() -> makeLookup()
+//   lCompile() -> makeLookup()
 //
 static void makeLookup(const uint8 bitOrder[8], uint8 lookupTable[256]) {
 	uint8 thisByte;
@@ -259,18 +379,33 @@ static void makeLookup(const uint8 bitOrder[8], uint8 lookupTable[256]) {
 }	
 
 // For serial & parallel programming, when the FPGA is ready to accept data, this function sends it,
-// one 64-byte block at a time, with a bit-transformation applied to each block.
+// one 64-byte block at a time, with a bit-transformation applied to each block. Anything longer
+// than one block is pipelined, unless async CommFPGA operations are in flight.
 //
 // Called by:
-//   xProgram() -> fileWrite() -> dataWrite()
 //   xProgram() -> dataWrite()
+//   aProgram() -> dataWrite()
+//   lProgram() -> dataWrite()
 //
 static FLStatus dataWrite(struct FLContext *handle, ProgOp progOp, const uint8 *buf, uint32 len, const uint8 *lookupTable, const char **error) {
 	FLStatus retVal = FL_SUCCESS;
 	uint16 chunkSize;
 	FLStatus fStatus = beginShift(handle, len, progOp, 0x00, error);
 	CHECK_STATUS(fStatus, fStatus, cleanup, "dataWrite()");
-	if ( lookupTable ) {
+	if ( len > 64 && canPipeline(handle) ) {
+		// Pausing the pipeline now and then to report progress costs little
+		const uint32 sliceSize = handle->progress ? PROGRESS_SLICE : len;
+		uint32 thisSlice;
+		while ( len ) {
+			thisSlice = (len >= sliceSize) ? sliceSize : len;
+			fStatus = pipelinedShift(handle, buf, lookupTable, NULL, false, thisSlice, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "dataWrite()");
+			fStatus = progAdvance(handle, thisSlice, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "dataWrite()");
+			buf += thisSlice;
+			len -= thisSlice;
+		}
+	} else if ( lookupTable ) {
 		uint8 bitSwap[64];
 		uint16 i;
 		while ( len ) {
@@ -280,6 +415,8 @@ static FLStatus dataWrite(struct FLContext *handle, ProgOp progOp, const uint8 *
 			}
 			fStatus = doSend(handle, bitSwap, chunkSize, error);
 			CHECK_STATUS(fStatus, fStatus, cleanup, "dataWrite()");
+			fStatus = progAdvance(handle, chunkSize, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "dataWrite()");
 			buf += chunkSize;
 			len -= chunkSize;
 		}
@@ -288,6 +425,8 @@ static FLStatus dataWrite(struct FLContext *handle, ProgOp progOp, const uint8 *
 			chunkSize = (uint16)((len >= 64) ? 64 : len);
 			fStatus = doSend(handle, buf, chunkSize, error);
 			CHECK_STATUS(fStatus, fStatus, cleanup, "dataWrite()");
+			fStatus = progAdvance(handle, chunkSize, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "dataWrite()");
 			buf += chunkSize;
 			len -= chunkSize;
 		}
@@ -296,375 +435,960 @@ cleanup:
 	return retVal;
 }
 
-// This function performs either a serial or a parallel programming operation on Xilinx FPGAs.
+#define GET_CTRL(index, status, func) \
+	GET_PAIR(cfg->ctrl[index].port, cfg->ctrl[index].bit, func); \
+	cfg->ctrl[index].config = status; \
+	SET_BIT(cfg->ctrl[index].port, cfg->ctrl[index].bit, status, func)
+
+// Copy a string, or return NULL if it's NULL.
 //
 // Called by:
-//   flProgram() -> xProgram()
+//   compileProg() -> copyString()
+//   flProgramAsync() -> copyString()
 //
-static FLStatus xProgram(struct FLContext *handle, ProgOp progOp, const char *portConfig, const uint8 *data, uint32 len, const char **error) {
-	FLStatus retVal = FL_SUCCESS;
-	FLStatus fStatus;
-	uint8 progPort, progBit;
-	uint8 initPort, initBit;
-	uint8 donePort, doneBit;
-	uint8 cclkPort, cclkBit;
-	uint8 dataPort, dataBit[8];
-	uint8 port, bit;
-	uint8 initStatus, doneStatus;
-	const char *ptr = portConfig + 2;
-	PinConfig pinMap[26][32] = {{0,},};
-	PinConfig thisPin;
-	const uint8 zeroBlock[64] = {0,};
-	uint8 lookupTable[256];
-	int i;
-	char ch;
-	CHECK_STATUS(
-		progOp != PROG_PARALLEL && progOp != PROG_SPI_SEND, FL_CONF_FORMAT, cleanup,
-		"xProgram(): unsupported ProgOp");
-	EXPECT_CHAR(':', "xProgram");
-
-	GET_PAIR(progPort, progBit, "xProgram");
-	SET_BIT(progPort, progBit, PIN_LOW, "xProgram");
-
-	GET_PAIR(initPort, initBit, "xProgram");
-	SET_BIT(initPort, initBit, PIN_INPUT, "xProgram");
-
-	GET_PAIR(donePort, doneBit, "xProgram");
-	SET_BIT(donePort, doneBit, PIN_INPUT, "xProgram");
-
-	GET_PAIR(cclkPort, cclkBit, "xProgram");
-	SET_BIT(cclkPort, cclkBit, PIN_LOW, "xProgram");
-
-	GET_PORT(dataPort, "xProgram");
-	if ( progOp == PROG_PARALLEL ) {
-		for ( i = 0; i < 8; i++ ) {
-			GET_DIGIT(dataBit[i], "xProgram");
-			SET_BIT(dataPort, dataBit[i], PIN_LOW, "xProgram");
+static char *copyString(const char *str, bool *failed) {
+	char *copy = NULL;
+	if ( str ) {
+		copy = (char *)malloc(strlen(str) + 1);
+		if ( copy ) {
+			strcpy(copy, str);
+		} else {
+			*failed = true;
 		}
-		makeLookup(dataBit, lookupTable);
-	} else if ( progOp == PROG_SPI_SEND ) {
-		const uint8 bitOrder[8] = {7,6,5,4,3,2,1,0};
-		makeLookup(bitOrder, lookupTable);
-		GET_BIT(dataBit[0], "xProgram");
-		SET_BIT(dataPort, dataBit[0], PIN_LOW, "xProgram");
 	}
+	return copy;
+}
 
-	GET_CHAR("xProgram");
+// Parse the optional bracketed list of extra pins at the end of an algorithm's own pins, and check
+// that what follows is either the end of the string or the ':' before the programming file.
+//
+// Called by:
+//   xCompile() -> parseTail()
+//   aCompile() -> parseTail()
+//   lCompile() -> parseTail()
+//
+static FLStatus parseTail(
+	const char *portConfig, const char *ptr, const char **endPtr, PinConfig pinMap[26][32],
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	char ch = *ptr;
 	if ( ch == '[' ) {
 		ptr++;
 		fStatus = populateMap(portConfig, ptr, &ptr, pinMap, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-		EXPECT_CHAR(']', "xProgram");
+		CHECK_STATUS(fStatus, fStatus, cleanup, "parseTail()");
+		EXPECT_CHAR(']', "parseTail");
 	}
 	ch = *ptr;
 	CHECK_STATUS(
 		ch != '\0' && ch != ':', FL_CONF_FORMAT, cleanup,
-		"xProgram(): Expecting ':' or end-of-string:\n  %s\n  %s^", portConfig, spaces(ptr-portConfig));
-
-	// Map the CCLK bit & the SelectMAP data bus
-	fStatus = portMap(handle, LP_SCK, cclkPort, cclkBit, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-	if ( progOp == PROG_PARALLEL ) {
-		fStatus = portMap(handle, LP_D8, dataPort, 0x00, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-	} else if ( progOp == PROG_SPI_SEND ) {
-		fStatus = portMap(handle, LP_MOSI, dataPort, dataBit[0], error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-	}
-	fStatus = portMap(handle, LP_CHOOSE, 0x00, 0x00, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-
-	// Assert PROG & wait for INIT & DONE to go low
-	fStatus = flSingleBitPortAccess(handle, initPort, initBit, PIN_INPUT, NULL, error); // INIT is input
-	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-	fStatus = flSingleBitPortAccess(handle, donePort, doneBit, PIN_INPUT, NULL, error); // DONE is input
-	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-	fStatus = flSingleBitPortAccess(handle, progPort, progBit, PIN_LOW, NULL, error); // PROG is low
-	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-	do {
-		fStatus = flSingleBitPortAccess(handle, initPort, initBit, PIN_INPUT, &initStatus, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-		fStatus = flSingleBitPortAccess(handle, donePort, doneBit, PIN_INPUT, &doneStatus, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-	} while ( initStatus || doneStatus );
-
-	// Now it's safe to switch to conduit mode zero (=JTAG, etc)
-	fStatus = flSelectConduit(handle, 0x00, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+		"parseTail(): Expecting ':' or end-of-string:\n  %s\n  %s^", portConfig, spaces(ptr-portConfig));
+	*endPtr = ptr;
+cleanup:
+	return retVal;
+}
 
-	// Apply requested configuration to each specified pin
-	pinMap[progPort][progBit] = PIN_UNUSED;
-	pinMap[initPort][initBit] = PIN_UNUSED;
-	pinMap[donePort][doneBit] = PIN_UNUSED;
+// Turn what's left in pinMap into a list, in the same port & bit order the pins were always driven.
+//
+// Called by:
+//   xCompile() -> collectPins()
+//   aCompile() -> collectPins()
+//   lCompile() -> collectPins()
+//
+static FLStatus collectPins(PinConfig pinMap[26][32], struct FLPortConfig *cfg, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	struct PinOp *pin;
+	uint32 count = 0;
+	uint8 port, bit;
 	for ( port = 0; port < 26; port++ ) {
 		for ( bit = 0; bit < 32; bit++ ) {
-			thisPin = pinMap[port][bit];
-			if ( thisPin != PIN_UNUSED ) {
-				fStatus = flSingleBitPortAccess(handle, port, bit, thisPin, NULL, error);
-				CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+			if ( pinMap[port][bit] != PIN_UNUSED ) {
+				count++;
 			}
 		}
 	}
-
-	// Deassert PROG and wait for INIT to go high
-	fStatus = flSingleBitPortAccess(handle, progPort, progBit, PIN_HIGH, NULL, error); // PROG is high
-	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-	do {
-		fStatus = flSingleBitPortAccess(handle, initPort, initBit, PIN_INPUT, &initStatus, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-	} while ( !initStatus );
-
-	// Write the programming file into the FPGA
-	fStatus = dataWrite(handle, progOp, data, len, lookupTable, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-
-	i = 0;
-	for ( ; ; ) {
-		fStatus = flSingleBitPortAccess(handle, initPort, initBit, PIN_INPUT, &initStatus, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-		fStatus = flSingleBitPortAccess(handle, donePort, doneBit, PIN_INPUT, &doneStatus, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-		if ( doneStatus ) {
-			// If DONE goes high, we've finished.
-			break;
-		} else if ( initStatus ) {
-			// If DONE remains low and INIT remains high, we probably just need more clocks
-			i++;
-			CHECK_STATUS(i == 10, FL_PROG_ERR, cleanup, "xProgram(): DONE did not assert");
-			fStatus = dataWrite(handle, progOp, zeroBlock, 64, lookupTable, error);
-			CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
-		} else {
-			// If DONE remains low and INIT goes low, an error occurred
-			FAIL_RET(
-				FL_PROG_ERR, cleanup,
-				"xProgram(): INIT unexpectedly low (CRC error during config)");
-		}
-	}
-
-	// Make all specified pins inputs; leave INIT & DONE as inputs and leave PROG driven high
+	pin = cfg->pins = (struct PinOp *)malloc((count ? count : 1) * sizeof(struct PinOp));
+	CHECK_STATUS(!pin, FL_ALLOC_ERR, cleanup, "collectPins()");
 	for ( port = 0; port < 26; port++ ) {
 		for ( bit = 0; bit < 32; bit++ ) {
-			thisPin = pinMap[port][bit];
-			if ( thisPin != PIN_UNUSED ) {
-				fStatus = flSingleBitPortAccess(handle, port, bit, PIN_INPUT, NULL, error);
-				CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+			if ( pinMap[port][bit] != PIN_UNUSED ) {
+				pin->port = port;
+				pin->bit = bit;
+				pin->config = (uint8)pinMap[port][bit];
+				pin++;
 			}
 		}
 	}
+	cfg->numPins = count;
 cleanup:
 	return retVal;
 }
 
-// This function performs a "passive" serial programming operation on Altera FPGAs.
+// Parse a Xilinx config: "XP:<PROG><INIT><DONE><CCLK><D0..D7>[..]" or
+// "XS:<PROG><INIT><DONE><CCLK><DIN>[..]".
 //
 // Called by:
-//   flProgramBlob() -> xProgram()
+//   compileProg() -> xCompile()
 //
-static FLStatus aProgram(struct FLContext *handle, const char *portConfig, const uint8 *data, uint32 len, const char **error) {
+static FLStatus xCompile(
+	const char *portConfig, struct FLPortConfig *cfg, const char **endPtr, const char **error)
+{
 	FLStatus retVal = FL_SUCCESS;
 	FLStatus fStatus;
-	uint8 ncfgPort, ncfgBit;
-	uint8 donePort, doneBit;
-	uint8 dclkPort, dclkBit;
-	uint8 dataPort, dataBit;
-	uint8 port, bit;
-	uint8 doneStatus;
+	uint8 dataBit[8];
 	const char *ptr = portConfig + 2;
 	PinConfig pinMap[26][32] = {{0,},};
-	PinConfig thisPin;
-	uint8 lookupTable[256];
-	const uint8 bitOrder[8] = {0,1,2,3,4,5,6,7};
+	int i;
 	char ch;
-	EXPECT_CHAR(':', "aProgram");
-
-	GET_PAIR(ncfgPort, ncfgBit, "aProgram");
-	SET_BIT(ncfgPort, ncfgBit, PIN_LOW, "aProgram");
-
-	fStatus = flSingleBitPortAccess(handle, ncfgPort, ncfgBit, PIN_LOW, NULL, error); // nCONFIG is low
-	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-
-	GET_PAIR(donePort, doneBit, "aProgram");
-	SET_BIT(donePort, doneBit, PIN_INPUT, "aProgram");
-
-	GET_PAIR(dclkPort, dclkBit, "aProgram");
-	SET_BIT(dclkPort, dclkBit, PIN_LOW, "aProgram");
-
-	GET_PAIR(dataPort, dataBit, "aProgram");
-	SET_BIT(dataPort, dataBit, PIN_LOW, "aProgram");
-
-	GET_CHAR("aProgram");
-	if ( ch == '[' ) {
-		ptr++;
-		fStatus = populateMap(portConfig, ptr, &ptr, pinMap, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-		EXPECT_CHAR(']', "aProgram");
-	}
-	ch = *ptr;
-	CHECK_STATUS(
-		ch != '\0' && ch != ':', FL_CONF_FORMAT, cleanup,
-		"aProgram(): Expecting ':' or end-of-string:\n  %s\n  %s^", portConfig, spaces(ptr-portConfig));
-
-	// Make a lookup table to swap the bits
-	makeLookup(bitOrder, lookupTable);
-
-	// Map DCLK & DATA0
-	fStatus = portMap(handle, LP_SCK, dclkPort, dclkBit, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-	fStatus = portMap(handle, LP_MOSI, dataPort, dataBit, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-	fStatus = portMap(handle, LP_CHOOSE, 0x00, 0x00, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-
-	// Switch to conduit mode zero (=JTAG, etc)
-	fStatus = flSelectConduit(handle, 0x00, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-
-	// Apply requested configuration to each specified pin
-	pinMap[ncfgPort][ncfgBit] = PIN_UNUSED;
-	for ( port = 0; port < 26; port++ ) {
-		for ( bit = 0; bit < 32; bit++ ) {
-			thisPin = pinMap[port][bit];
-			if ( thisPin != PIN_UNUSED ) {
-				fStatus = flSingleBitPortAccess(handle, port, bit, thisPin, NULL, error);
-				CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-			}
-		}
-	}
-
-	// Deassert nCONFIG
-	fStatus = flSingleBitPortAccess(handle, ncfgPort, ncfgBit, PIN_INPUT, NULL, error); // nCONFIG pulled up
-	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-
-	// Write the programming file into the FPGA
-	fStatus = dataWrite(handle, PROG_SPI_SEND, data, len, lookupTable, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-
-	// Verify that CONF_DONE went high
-	fStatus = flSingleBitPortAccess(handle, donePort, doneBit, PIN_INPUT, &doneStatus, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-	CHECK_STATUS(
-		!doneStatus, FL_PROG_ERR, cleanup,
-		"aProgram(): CONF_DONE remained low (CRC error during config)");
-
-	// Make all specified pins inputs; leave CONF_DONE as input and leave nCONFIG driven high
-	for ( port = 0; port < 26; port++ ) {
-		for ( bit = 0; bit < 32; bit++ ) {
-			thisPin = pinMap[port][bit];
-			if ( thisPin != PIN_UNUSED ) {
-				fStatus = flSingleBitPortAccess(handle, port, bit, PIN_INPUT, NULL, error);
-				CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
-			}
+	EXPECT_CHAR(':', "xCompile");
+	GET_CTRL(X_PROG, PIN_LOW, "xCompile");
+	GET_CTRL(X_INIT, PIN_INPUT, "xCompile");
+	GET_CTRL(X_DONE, PIN_INPUT, "xCompile");
+	GET_CTRL(X_CCLK, PIN_LOW, "xCompile");
+	GET_PORT(cfg->dataPort, "xCompile");
+	if ( cfg->progOp == PROG_PARALLEL ) {
+		for ( i = 0; i < 8; i++ ) {
+			GET_DIGIT(dataBit[i], "xCompile");
+			SET_BIT(cfg->dataPort, dataBit[i], PIN_LOW, "xCompile");
 		}
+		makeLookup(dataBit, cfg->lookupTable);
+	} else {
+		const uint8 bitOrder[8] = {7,6,5,4,3,2,1,0};
+		makeLookup(bitOrder, cfg->lookupTable);
+		GET_BIT(cfg->dataBit, "xCompile");
+		SET_BIT(cfg->dataPort, cfg->dataBit, PIN_LOW, "xCompile");
 	}
+	fStatus = parseTail(portConfig, ptr, endPtr, pinMap, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xCompile()");
+
+	// PROG, INIT & DONE are driven separately
+	pinMap[cfg->ctrl[X_PROG].port][cfg->ctrl[X_PROG].bit] = PIN_UNUSED;
+	pinMap[cfg->ctrl[X_INIT].port][cfg->ctrl[X_INIT].bit] = PIN_UNUSED;
+	pinMap[cfg->ctrl[X_DONE].port][cfg->ctrl[X_DONE].bit] = PIN_UNUSED;
+	fStatus = collectPins(pinMap, cfg, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xCompile()");
 cleanup:
 	return retVal;
 }
 
-static FLStatus progOpenInternal(struct FLContext *handle, const char *portConfig, const char *ptr, const char **error) {
+// Parse an Altera config: "AP:<nCONFIG><CONF_DONE><DCLK><D0..D7>[..]" or
+// "AS:<nCONFIG><CONF_DONE><DCLK><DATA0>[..]".
+//
+// Called by:
+//   compileProg() -> aCompile()
+//
+static FLStatus aCompile(
+	const char *portConfig, struct FLPortConfig *cfg, const char **endPtr, const char **error)
+{
 	FLStatus retVal = FL_SUCCESS;
 	FLStatus fStatus;
-	uint8 misoPort, misoBit;
-	uint8 mosiPort, mosiBit;
-	uint8 ssPort, ssBit;
-	uint8 sckPort, sckBit;
+	uint8 dataBit[8];
+	const char *ptr = portConfig + 2;
 	PinConfig pinMap[26][32] = {{0,},};
+	int i;
 	char ch;
+	EXPECT_CHAR(':', "aCompile");
+	GET_CTRL(A_NCONFIG, PIN_LOW, "aCompile");
+	GET_CTRL(A_DONE, PIN_INPUT, "aCompile");
+	GET_CTRL(A_DCLK, PIN_LOW, "aCompile");
+	GET_PORT(cfg->dataPort, "aCompile");
+	if ( cfg->progOp == PROG_PARALLEL ) {
+		// DATA[7:0] on any eight bits of one port, given in order from DATA0 to DATA7
+		for ( i = 0; i < 8; i++ ) {
+			GET_DIGIT(dataBit[i], "aCompile");
+			SET_BIT(cfg->dataPort, dataBit[i], PIN_LOW, "aCompile");
+		}
+		makeLookup(dataBit, cfg->lookupTable);
+	} else {
+		// Passive-Serial sends each byte LSB-first, which is what the micro does anyway
+		const uint8 bitOrder[8] = {0,1,2,3,4,5,6,7};
+		makeLookup(bitOrder, cfg->lookupTable);
+		GET_BIT(cfg->dataBit, "aCompile");
+		SET_BIT(cfg->dataPort, cfg->dataBit, PIN_LOW, "aCompile");
+	}
+	fStatus = parseTail(portConfig, ptr, endPtr, pinMap, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aCompile()");
 
-	// Get all four JTAG bits and tell the micro which ones to use
-	GET_PAIR(misoPort, misoBit, "progOpen");        // MISO/TDO
-	SET_BIT(misoPort, misoBit, PIN_INPUT, "progOpen");
-	fStatus = portMap(handle, LP_MISO, misoPort, misoBit, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
-
-	GET_PAIR(mosiPort, mosiBit, "progOpen");        // MOSI/TDI
-	SET_BIT(mosiPort, mosiBit, PIN_LOW, "progOpen");
-	fStatus = portMap(handle, LP_MOSI, mosiPort, mosiBit, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
-
-	GET_PAIR(ssPort, ssBit, "progOpen");        // SS/TMS
-	SET_BIT(ssPort, ssBit, PIN_LOW, "progOpen");
-	fStatus = portMap(handle, LP_SS, ssPort, ssBit, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
-
-	GET_PAIR(sckPort, sckBit, "progOpen");        // SCK/TCK
-	SET_BIT(sckPort, sckBit, PIN_LOW, "progOpen");
-	fStatus = portMap(handle, LP_SCK, sckPort, sckBit, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
-
-	fStatus = portMap(handle, LP_CHOOSE, 0x00, 0x00, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
-
-	// Set MISO/TDO as an input and the other three as outputs
-	fStatus = flSingleBitPortAccess(handle, misoPort, misoBit, PIN_INPUT, NULL, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
-	fStatus = flSingleBitPortAccess(handle, mosiPort, mosiBit, PIN_LOW, NULL, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
-	fStatus = flSingleBitPortAccess(handle, ssPort, ssBit, PIN_LOW, NULL, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
-	fStatus = flSingleBitPortAccess(handle, sckPort, sckBit, PIN_LOW, NULL, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
-
-	// Remember the ports and bits for the benefit of progClose()
-	handle->misoPort = misoPort;
-	handle->misoBit = misoBit;
-	handle->mosiPort = mosiPort;
-	handle->mosiBit = mosiBit;
-	handle->ssPort = ssPort;
-	handle->ssBit = ssBit;
-	handle->sckPort = sckPort;
-	handle->sckBit = sckBit;
+	// nCONFIG is driven separately
+	pinMap[cfg->ctrl[A_NCONFIG].port][cfg->ctrl[A_NCONFIG].bit] = PIN_UNUSED;
+	fStatus = collectPins(pinMap, cfg, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aCompile()");
 cleanup:
 	return retVal;
 }
 
-// Program a device over JTAG.
+// Parse a Lattice iCE40 config: "LS:<CRESET_B><CDONE><SPI_SS_B><SPI_SCK><SPI_SI>[..]".
 //
 // Called by:
-//   flProgram() -> jProgram()
+//   compileProg() -> lCompile()
 //
-static FLStatus jProgram(struct FLContext *handle, const char *portConfig, const uint8 *csvfData, const char **error) {
+static FLStatus lCompile(
+	const char *portConfig, struct FLPortConfig *cfg, const char **endPtr, const char **error)
+{
 	FLStatus retVal = FL_SUCCESS;
 	FLStatus fStatus;
-	const char *ptr = portConfig + 1;
+	const char *ptr = portConfig + 2;
+	PinConfig pinMap[26][32] = {{0,},};
+	const uint8 bitOrder[8] = {7,6,5,4,3,2,1,0};
 	char ch;
-	EXPECT_CHAR(':', "jProgram");
-	fStatus = progOpenInternal(handle, portConfig, ptr, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgram()");
-	fStatus = csvfPlay(handle, csvfData, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgram()");
-	fStatus = progClose(handle, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgram()");
+	EXPECT_CHAR(':', "lCompile");
+	GET_CTRL(L_CRESET, PIN_LOW, "lCompile");
+	GET_CTRL(L_CDONE, PIN_INPUT, "lCompile");
+	GET_CTRL(L_SS, PIN_LOW, "lCompile");
+	GET_CTRL(L_SCK, PIN_LOW, "lCompile");
+	GET_CTRL(L_SDI, PIN_LOW, "lCompile");
+	fStatus = parseTail(portConfig, ptr, endPtr, pinMap, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lCompile()");
+
+	// The micro sends LSB-first, but the iCE40 wants MSB-first
+	makeLookup(bitOrder, cfg->lookupTable);
+
+	// CRESET_B is driven separately
+	pinMap[cfg->ctrl[L_CRESET].port][cfg->ctrl[L_CRESET].bit] = PIN_UNUSED;
+	fStatus = collectPins(pinMap, cfg, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lCompile()");
 cleanup:
 	return retVal;
 }
 
-// Reverse the array in-place by swapping the outer items and progressing inward until we meet in
-// the middle.
+// Parse the four JTAG pins: "<TDO><TDI><TMS><TCK>", e.g "D0D2D3D4".
 //
 // Called by:
-//   jtagScanChain()
+//   compileProg() -> jCompile()
+//   progOpenInternal() -> jCompile()
 //
-static void swap(uint32 *array, uint32 numWritten) {
-	uint32 *hiPtr = array + numWritten - 1;  // last one
-	uint32 *loPtr = array; // first one
-	uint32 temp;
-	while ( loPtr < hiPtr ) {
-		temp = *loPtr;
-		*loPtr++ = *hiPtr;
-		*hiPtr-- = temp;
+static FLStatus jCompile(
+	const char *portConfig, const char *ptr, struct FLPortConfig *cfg, const char **endPtr,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	PinConfig pinMap[26][32] = {{0,},};
+	char ch;
+	GET_CTRL(J_TDO, PIN_INPUT, "jCompile");  // MISO/TDO
+	GET_CTRL(J_TDI, PIN_LOW, "jCompile");    // MOSI/TDI
+	GET_CTRL(J_TMS, PIN_LOW, "jCompile");    // SS/TMS
+	GET_CTRL(J_TCK, PIN_LOW, "jCompile");    // SCK/TCK
+	ch = *ptr;
+	CHECK_STATUS(
+		ch != '\0' && ch != ':', FL_CONF_FORMAT, cleanup,
+		"jCompile(): Expecting ':' or end-of-string:\n  %s\n  %s^", portConfig, spaces(ptr-portConfig));
+	if ( endPtr ) {
+		*endPtr = ptr;
 	}
-}	
-
-// -------------------------------------------------------------------------------------------------
-// Implementation of public functions
-// -------------------------------------------------------------------------------------------------
+cleanup:
+	return retVal;
+}
 
-DLLEXPORT(FLStatus) progOpen(struct FLContext *handle, const char *portConfig, const char **error) {
-	return progOpenInternal(handle, portConfig, portConfig, error);
+// Free the allocations owned by a compiled config, but not the config itself.
+//
+// Called by:
+//   compileProg() -> releaseConfig()
+//   compilePins() -> releaseConfig()
+//   flProgram() -> releaseConfig()
+//   flProgramBlob() -> releaseConfig()
+//   flFreePortConfig() -> releaseConfig()
+//   flMultiBitPortAccess() -> releaseConfig()
+//   flProgramMulti() -> releaseConfig()
+//
+static void releaseConfig(struct FLPortConfig *cfg) {
+	free((void*)cfg->pins);
+	free((void*)cfg->progFile);
+	cfg->pins = NULL;
+	cfg->progFile = NULL;
+	cfg->numPins = 0;
 }
 
-DLLEXPORT(FLStatus) progClose(struct FLContext *handle, const char **error) {
-	FLStatus retVal = FL_SUCCESS;
+// Parse a programming config, e.g "XP:A7B3B4D0C01234567[D3+]:fpga.bit", into cfg.
+//
+// Called by:
+//   flProgram() -> compileProg()
+//   flProgramBlob() -> compileProg()
+//   flCompileProgConfig() -> compileProg()
+//   flProgramMulti() -> compileProg()
+//
+static FLStatus compileProg(const char *portConfig, struct FLPortConfig *cfg, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus = FL_SUCCESS;
+	const char algoVendor = portConfig[0];
+	const char algoType = algoVendor ? portConfig[1] : '\0';
+	const char *ptr = portConfig + 1;
+	bool failed = false;
+	char ch;
+	memset(cfg, 0, sizeof(struct FLPortConfig));
+	cfg->algoVendor = algoVendor;
+	if ( algoVendor == 'X' ) {
+		// This is a Xilinx algorithm
+		if ( algoType == 'P' ) {
+			// This is Xilinx Slave Parallel ("SelectMAP")
+			cfg->progOp = PROG_PARALLEL;
+		} else if ( algoType == 'S' ) {
+			// This is Xilinx Slave Serial
+			cfg->progOp = PROG_SPI_SEND;
+		} else if ( algoType == '\0' ) {
+			FAIL_RET(FL_CONF_FORMAT, cleanup, "flProgram(): Missing Xilinx algorithm code");
+		} else {
+			FAIL_RET(
+				FL_CONF_FORMAT, cleanup,
+				"flProgram(): '%c' is not a valid Xilinx algorithm code", algoType);
+		}
+		fStatus = xCompile(portConfig, cfg, &ptr, error);
+	} else if ( algoVendor == 'A' ) {
+		// This is an Altera algorithm
+		if ( algoType == 'S' ) {
+			// This is Altera Passive Serial
+			cfg->progOp = PROG_SPI_SEND;
+		} else if ( algoType == 'P' ) {
+			// This is Altera Fast Passive Parallel
+			cfg->progOp = PROG_PARALLEL;
+		} else if ( algoType == '\0' ) {
+			FAIL_RET(FL_CONF_FORMAT, cleanup, "flProgram(): Missing Altera algorithm code");
+		} else {
+			FAIL_RET(
+				FL_CONF_FORMAT, cleanup,
+				"flProgram(): '%c' is not a valid Altera algorithm code", algoType);
+		}
+		fStatus = aCompile(portConfig, cfg, &ptr, error);
+	} else if ( algoVendor == 'L' ) {
+		// This is a Lattice algorithm
+		if ( algoType == 'S' ) {
+			// This is Lattice iCE40 SPI-slave
+			cfg->progOp = PROG_SPI_SEND;
+		} else if ( algoType == '\0' ) {
+			FAIL_RET(FL_CONF_FORMAT, cleanup, "flProgram(): Missing Lattice algorithm code");
+		} else {
+			FAIL_RET(
+				FL_CONF_FORMAT, cleanup,
+				"flProgram(): '%c' is not a valid Lattice algorithm code", algoType);
+		}
+		fStatus = lCompile(portConfig, cfg, &ptr, error);
+	} else if ( algoVendor == 'J' ) {
+		// This is a JTAG algorithm
+		EXPECT_CHAR(':', "flProgram");
+		fStatus = jCompile(portConfig, ptr, cfg, &ptr, error);
+	} else if ( algoVendor == '\0' ) {
+		FAIL_RET(FL_CONF_FORMAT, cleanup, "flProgram(): Missing algorithm vendor code");
+	} else {
+		FAIL_RET(
+			FL_CONF_FORMAT, cleanup,
+			"flProgram(): '%c' is not a valid algorithm vendor code", algoVendor);
+	}
+	CHECK_STATUS(fStatus, fStatus, cleanup, "compileProg()");
+
+	// Remember the programming file, if one follows the pins
+	if ( *ptr == ':' ) {
+		cfg->progFile = copyString(ptr + 1, &failed);
+		CHECK_STATUS(failed, FL_ALLOC_ERR, cleanup, "compileProg()");
+	}
+cleanup:
+	if ( retVal != FL_SUCCESS ) {
+		releaseConfig(cfg);
+	}
+	return retVal;
+}
+
+// Parse a plain list of pins for flMultiBitPortAccess(), e.g "A12-,B2+,C7?", keeping them in the
+// order they're given.
+//
+// Called by:
+//   flMultiBitPortAccess() -> compilePins()
+//   flCompilePortConfig() -> compilePins()
+//
+static FLStatus compilePins(const char *portConfig, struct FLPortConfig *cfg, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	const char *ptr = portConfig;
+	struct PinOp *pin;
+	uint32 count = 1;
+	char ch;
+	memset(cfg, 0, sizeof(struct FLPortConfig));
+	while ( *ptr ) {
+		if ( *ptr++ == ',' ) {
+			count++;
+		}
+	}
+	ptr = portConfig;
+	pin = cfg->pins = (struct PinOp *)malloc(count * sizeof(struct PinOp));
+	CHECK_STATUS(!pin, FL_ALLOC_ERR, cleanup, "compilePins()");
+	do {
+		GET_PAIR(pin->port, pin->bit, "flMultiBitPortAccess");
+		GET_CHAR("flMultiBitPortAccess");
+		if ( ch == '+' ) {
+			pin->config = PIN_HIGH;
+		} else if ( ch == '-' ) {
+			pin->config = PIN_LOW;
+		} else if ( ch == '?' ) {
+			pin->config = PIN_INPUT;
+		} else {
+			FAIL_RET(
+				FL_CONF_FORMAT, cleanup,
+				"flMultiBitPortAccess(): Expecting '+', '-' or '?':\n  %s\n  %s^", portConfig, spaces(ptr-portConfig));
+		}
+		pin++;
+		ptr++;
+		ch = *ptr++;
+	} while ( ch == ',' );
+	CHECK_STATUS(
+		ch != '\0', FL_CONF_FORMAT, cleanup,
+		"flMultiBitPortAccess(): Expecting ',' or '\\0' here:\n  %s\n  %s^", portConfig, spaces(ptr-portConfig-1));
+	cfg->numPins = (uint32)(pin - cfg->pins);
+cleanup:
+	if ( retVal != FL_SUCCESS ) {
+		releaseConfig(cfg);
+	}
+	return retVal;
+}
+
+// Drive each of the config's other pins as it asks, or if release is set, make them all inputs.
+//
+// Called by:
+//   xProgram() -> applyPins()
+//   aProgram() -> applyPins()
+//   lProgram() -> applyPins()
+//
+static FLStatus applyPins(
+	struct FLContext *handle, const struct FLPortConfig *cfg, bool release, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	const struct PinOp *pin = cfg->pins;
+	const struct PinOp *const end = pin + cfg->numPins;
+	while ( pin < end ) {
+		fStatus = flSingleBitPortAccess(
+			handle, pin->port, pin->bit, release ? PIN_INPUT : pin->config, NULL, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "applyPins()");
+		pin++;
+	}
+cleanup:
+	return retVal;
+}
+
+// This function performs either a serial or a parallel programming operation on Xilinx FPGAs.
+//
+// Called by:
+//   flProgramBlobCompiled() -> xProgram()
+//
+static FLStatus xProgram(struct FLContext *handle, const struct FLPortConfig *cfg, const uint8 *data, uint32 len, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	FLStatus fStatus;
+	const ProgOp progOp = cfg->progOp;
+	const struct PinOp *const prog = cfg->ctrl + X_PROG;
+	const struct PinOp *const init = cfg->ctrl + X_INIT;
+	const struct PinOp *const done = cfg->ctrl + X_DONE;
+	const struct PinOp *const cclk = cfg->ctrl + X_CCLK;
+	uint8 initStatus, doneStatus;
+	const uint8 zeroBlock[64] = {0,};
+	struct Bitstream bs;
+	int i;
+
+	// Find the part of the file the FPGA actually needs
+	fStatus = bitParse(data, len, &bs, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+
+	// Map the CCLK bit & the SelectMAP data bus
+	fStatus = portMap(handle, LP_SCK, cclk->port, cclk->bit, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	if ( progOp == PROG_PARALLEL ) {
+		fStatus = portMap(handle, LP_D8, cfg->dataPort, 0x00, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	} else if ( progOp == PROG_SPI_SEND ) {
+		fStatus = portMap(handle, LP_MOSI, cfg->dataPort, cfg->dataBit, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	}
+	fStatus = portMap(handle, LP_CHOOSE, 0x00, 0x00, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+
+	// Assert PROG & wait for INIT & DONE to go low
+	fStatus = progPhase(handle, FL_PHASE_PROG, 0, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	fStatus = flSingleBitPortAccess(handle, init->port, init->bit, PIN_INPUT, NULL, error); // INIT is input
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	fStatus = flSingleBitPortAccess(handle, done->port, done->bit, PIN_INPUT, NULL, error); // DONE is input
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	fStatus = flSingleBitPortAccess(handle, prog->port, prog->bit, PIN_LOW, NULL, error); // PROG is low
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	do {
+		fStatus = flSingleBitPortAccess(handle, init->port, init->bit, PIN_INPUT, &initStatus, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+		fStatus = flSingleBitPortAccess(handle, done->port, done->bit, PIN_INPUT, &doneStatus, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	} while ( initStatus || doneStatus );
+
+	// Now it's safe to switch to conduit mode zero (=JTAG, etc)
+	fStatus = flSelectConduit(handle, 0x00, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+
+	// Apply requested configuration to each specified pin
+	fStatus = applyPins(handle, cfg, false, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+
+	// Deassert PROG and wait for INIT to go high
+	fStatus = progPhase(handle, FL_PHASE_INIT, 0, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	fStatus = flSingleBitPortAccess(handle, prog->port, prog->bit, PIN_HIGH, NULL, error); // PROG is high
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	do {
+		fStatus = flSingleBitPortAccess(handle, init->port, init->bit, PIN_INPUT, &initStatus, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	} while ( !initStatus );
+
+	// Write the configuration data into the FPGA, followed by the start-up clocks if we know where
+	// it ends (one CCLK per bit in serial mode, or per byte in parallel mode)
+	fStatus = progPhase(handle, FL_PHASE_DATA, bs.configLength, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	fStatus = dataWrite(handle, progOp, bs.config, bs.configLength, cfg->lookupTable, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	fStatus = progPhase(handle, FL_PHASE_DONE, 0, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	if ( bs.isComplete ) {
+		fStatus = dataWrite(
+			handle, progOp, zeroBlock,
+			(progOp == PROG_PARALLEL) ? BIT_STARTUP_CLOCKS : BIT_STARTUP_CLOCKS/8,
+			cfg->lookupTable, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+	}
+
+	i = 0;
+	for ( ; ; ) {
+		fStatus = flSingleBitPortAccess(handle, init->port, init->bit, PIN_INPUT, &initStatus, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+		fStatus = flSingleBitPortAccess(handle, done->port, done->bit, PIN_INPUT, &doneStatus, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+		if ( doneStatus ) {
+			// If DONE goes high, we've finished.
+			break;
+		} else if ( initStatus ) {
+			// If DONE remains low and INIT remains high, we probably just need more clocks
+			i++;
+			CHECK_STATUS(
+				i == 10, FL_PROG_ERR, cleanup,
+				"xProgram(): DONE did not assert (design %s for %s)",
+				bs.design ? bs.design : "unknown", bs.part ? bs.part : "unknown");
+			fStatus = dataWrite(handle, progOp, zeroBlock, 64, cfg->lookupTable, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+		} else {
+			// If DONE remains low and INIT goes low, an error occurred
+			FAIL_RET(
+				FL_PROG_ERR, cleanup,
+				"xProgram(): INIT unexpectedly low (CRC error during config of design %s for %s)",
+				bs.design ? bs.design : "unknown", bs.part ? bs.part : "unknown");
+		}
+	}
+
+	// Make all specified pins inputs; leave INIT & DONE as inputs and leave PROG driven high
+	fStatus = applyPins(handle, cfg, true, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xProgram()");
+cleanup:
+	return retVal;
+}
+
+// This function performs either a "passive" serial or a fast passive parallel programming operation
+// on Altera FPGAs.
+//
+// Called by:
+//   flProgramBlobCompiled() -> aProgram()
+//
+static FLStatus aProgram(struct FLContext *handle, const struct FLPortConfig *cfg, const uint8 *data, uint32 len, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	FLStatus fStatus;
+	const struct PinOp *const ncfg = cfg->ctrl + A_NCONFIG;
+	const struct PinOp *const done = cfg->ctrl + A_DONE;
+	const struct PinOp *const dclk = cfg->ctrl + A_DCLK;
+	uint8 doneStatus;
+
+	fStatus = progPhase(handle, FL_PHASE_PROG, 0, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+	fStatus = flSingleBitPortAccess(handle, ncfg->port, ncfg->bit, PIN_LOW, NULL, error); // nCONFIG is low
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+
+	// Map DCLK & either DATA0 or the DATA[7:0] bus
+	fStatus = portMap(handle, LP_SCK, dclk->port, dclk->bit, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+	if ( cfg->progOp == PROG_PARALLEL ) {
+		fStatus = portMap(handle, LP_D8, cfg->dataPort, 0x00, error);
+	} else {
+		fStatus = portMap(handle, LP_MOSI, cfg->dataPort, cfg->dataBit, error);
+	}
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+	fStatus = portMap(handle, LP_CHOOSE, 0x00, 0x00, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+
+	// Switch to conduit mode zero (=JTAG, etc)
+	fStatus = flSelectConduit(handle, 0x00, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+
+	// Apply requested configuration to each specified pin
+	fStatus = applyPins(handle, cfg, false, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+
+	// Deassert nCONFIG
+	fStatus = flSingleBitPortAccess(handle, ncfg->port, ncfg->bit, PIN_INPUT, NULL, error); // nCONFIG pulled up
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+
+	// Write the programming file into the FPGA
+	fStatus = progPhase(handle, FL_PHASE_DATA, len, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+	fStatus = dataWrite(handle, cfg->progOp, data, len, cfg->lookupTable, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+
+	// Verify that CONF_DONE went high
+	fStatus = progPhase(handle, FL_PHASE_DONE, 0, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+	fStatus = flSingleBitPortAccess(handle, done->port, done->bit, PIN_INPUT, &doneStatus, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+	CHECK_STATUS(
+		!doneStatus, FL_PROG_ERR, cleanup,
+		"aProgram(): CONF_DONE remained low (CRC error during config)");
+
+	// Make all specified pins inputs; leave CONF_DONE as input and leave nCONFIG driven high
+	fStatus = applyPins(handle, cfg, true, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "aProgram()");
+cleanup:
+	return retVal;
+}
+
+// This function performs an SPI-slave configuration of a Lattice iCE40 FPGA: hold CRESET_B low with
+// SPI_SS_B low so the FPGA comes up as an SPI slave rather than reading its own flash, then release
+// it, give it time to clear its configuration memory, and stream the bitstream MSB-first. CDONE
+// goes high once the bitstream is in, after which the FPGA needs a few more clocks to start up.
+//
+// Called by:
+//   flProgramBlobCompiled() -> lProgram()
+//
+static FLStatus lProgram(struct FLContext *handle, const struct FLPortConfig *cfg, const uint8 *data, uint32 len, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	FLStatus fStatus;
+	const struct PinOp *const creset = cfg->ctrl + L_CRESET;
+	const struct PinOp *const cdone = cfg->ctrl + L_CDONE;
+	const struct PinOp *const ss = cfg->ctrl + L_SS;
+	const struct PinOp *const sck = cfg->ctrl + L_SCK;
+	const struct PinOp *const sdi = cfg->ctrl + L_SDI;
+	uint8 cdoneStatus;
+	const uint8 zeroBlock[16] = {0,};  // at least 49 clocks are needed after CDONE goes high
+
+	// Map SCK & SDI
+	fStatus = portMap(handle, LP_SCK, sck->port, sck->bit, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	fStatus = portMap(handle, LP_MOSI, sdi->port, sdi->bit, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	fStatus = portMap(handle, LP_CHOOSE, 0x00, 0x00, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+
+	// Switch to conduit mode zero (=JTAG, etc)
+	fStatus = flSelectConduit(handle, 0x00, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+
+	// Assert CRESET_B first, then apply requested configuration to each specified pin, which
+	// drives SPI_SS_B low too
+	fStatus = progPhase(handle, FL_PHASE_PROG, 0, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	fStatus = flSingleBitPortAccess(handle, creset->port, creset->bit, PIN_LOW, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	fStatus = applyPins(handle, cfg, false, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+
+	// Deassert CRESET_B and wait at least 1200us for the configuration memory to clear
+	fStatus = progPhase(handle, FL_PHASE_INIT, 0, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	flSleep(1);
+	fStatus = flSingleBitPortAccess(handle, creset->port, creset->bit, PIN_HIGH, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	flSleep(2);
+
+	// Eight dummy clocks with SPI_SS_B high, then select it again for the bitstream
+	fStatus = flSingleBitPortAccess(handle, ss->port, ss->bit, PIN_HIGH, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	fStatus = dataWrite(handle, PROG_SPI_SEND, zeroBlock, 1, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	fStatus = flSingleBitPortAccess(handle, ss->port, ss->bit, PIN_LOW, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+
+	// Write the programming file into the FPGA, followed by the start-up clocks
+	fStatus = progPhase(handle, FL_PHASE_DATA, len, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	fStatus = dataWrite(handle, PROG_SPI_SEND, data, len, cfg->lookupTable, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	fStatus = progPhase(handle, FL_PHASE_DONE, 0, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	fStatus = dataWrite(handle, PROG_SPI_SEND, zeroBlock, sizeof(zeroBlock), NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+
+	// Verify that CDONE went high
+	fStatus = flSingleBitPortAccess(handle, cdone->port, cdone->bit, PIN_INPUT, &cdoneStatus, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+	CHECK_STATUS(
+		!cdoneStatus, FL_PROG_ERR, cleanup,
+		"lProgram(): CDONE remained low (bad bitstream, or not in SPI-slave mode)");
+
+	// Make all specified pins inputs, releasing the SPI bus; leave CRESET_B driven high
+	fStatus = applyPins(handle, cfg, true, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "lProgram()");
+cleanup:
+	return retVal;
+}
+
+// Tell the micro which four pins to use for JTAG, and get them ready.
+//
+// Called by:
+//   progOpenInternal() -> jtagOpen()
+//   jProgram() -> jtagOpen()
+//   jProgramCsvc() -> jtagOpen()
+//
+static FLStatus jtagOpen(struct FLContext *handle, const struct FLPortConfig *cfg, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	FLStatus fStatus;
+	const struct PinOp *const tdo = cfg->ctrl + J_TDO;
+	const struct PinOp *const tdi = cfg->ctrl + J_TDI;
+	const struct PinOp *const tms = cfg->ctrl + J_TMS;
+	const struct PinOp *const tck = cfg->ctrl + J_TCK;
+
+	// Tell the micro which bits to use
+	fStatus = portMap(handle, LP_MISO, tdo->port, tdo->bit, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+	fStatus = portMap(handle, LP_MOSI, tdi->port, tdi->bit, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+	fStatus = portMap(handle, LP_SS, tms->port, tms->bit, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+	fStatus = portMap(handle, LP_SCK, tck->port, tck->bit, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+	fStatus = portMap(handle, LP_CHOOSE, 0x00, 0x00, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+
+	// Set MISO/TDO as an input and the other three as outputs
+	fStatus = flSingleBitPortAccess(handle, tdo->port, tdo->bit, PIN_INPUT, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+	fStatus = flSingleBitPortAccess(handle, tdi->port, tdi->bit, PIN_LOW, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+	fStatus = flSingleBitPortAccess(handle, tms->port, tms->bit, PIN_LOW, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+	fStatus = flSingleBitPortAccess(handle, tck->port, tck->bit, PIN_LOW, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+
+	// Remember the ports and bits for the benefit of progClose()
+	handle->misoPort = tdo->port;
+	handle->misoBit = tdo->bit;
+	handle->mosiPort = tdi->port;
+	handle->mosiBit = tdi->bit;
+	handle->ssPort = tms->port;
+	handle->ssBit = tms->bit;
+	handle->sckPort = tck->port;
+	handle->sckBit = tck->bit;
+cleanup:
+	return retVal;
+}
+
+static FLStatus progOpenInternal(struct FLContext *handle, const char *portConfig, const char *ptr, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	FLStatus fStatus;
+	struct FLPortConfig cfg;
+	memset(&cfg, 0, sizeof(struct FLPortConfig));
+	fStatus = jCompile(portConfig, ptr, &cfg, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+	fStatus = jtagOpen(handle, &cfg, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "progOpen()");
+cleanup:
+	return retVal;
+}
+
+// Program a device over JTAG.
+//
+// Called by:
+//   flProgramBlobCompiled() -> jProgram()
+//
+static FLStatus jProgram(struct FLContext *handle, const struct FLPortConfig *cfg, const uint8 *csvfData, uint32 csvfLength, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	FLStatus fStatus;
+	fStatus = jtagOpen(handle, cfg, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgram()");
+	fStatus = progPhase(handle, FL_PHASE_DATA, csvfLength, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgram()");
+	fStatus = csvfPlay(handle, csvfData, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgram()");
+	fStatus = progClose(handle, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgram()");
+cleanup:
+	return retVal;
+}
+
+// Program a device over JTAG from a CSVC container, decompressing each block straight from the
+// mapped file just before it's played.
+//
+// Called by:
+//   flProgramCompiled() -> jProgramCsvc()
+//
+static FLStatus jProgramCsvc(struct FLContext *handle, const struct FLPortConfig *cfg, const char *csvcFile, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	FLStatus fStatus;
+	struct Csvc csvc = {0,};
+	fStatus = csvcOpen(&csvc, csvcFile, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgramCsvc()");
+	fStatus = jtagOpen(handle, cfg, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgramCsvc()");
+	fStatus = progPhase(handle, FL_PHASE_DATA, csvc.csvfLength, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgramCsvc()");
+	fStatus = csvcPlay(handle, &csvc, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgramCsvc()");
+	fStatus = progClose(handle, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jProgramCsvc()");
+cleanup:
+	csvcClose(&csvc);
+	return retVal;
+}
+
+// Convert an SVF file using all the cores, then optimise the result for playing, as the streaming
+// converters do. This is done here rather than in the public converters because it can change the
+// TAP sequence: an XSDRTDO with an all-zero mask becomes an XSDR, which leaves Shift-DR by a
+// shorter path. A caller of flLoadSvfAndConvertToCsvf() gets exactly what the file asked for.
+//
+// Called by:
+//   loadJtagFile() -> cacheConvert() -> convertSvf()
+//
+static FLStatus convertSvf(
+	const char *svfFile, struct Buffer *csvfBuf, uint32 *maxBufSize, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	fStatus = flLoadSvfAndConvertToCsvfParallel(svfFile, csvfBuf, maxBufSize, 0, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "convertSvf()");
+	fStatus = csvfOptimiseBuffer(csvfBuf, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "convertSvf()");
+cleanup:
+	return retVal;
+}
+
+// Convert an XSVF file, then optimise the result for playing, as convertSvf() does.
+//
+// Called by:
+//   loadJtagFile() -> cacheConvert() -> convertXsvf()
+//
+static FLStatus convertXsvf(
+	const char *xsvfFile, struct Buffer *csvfBuf, uint32 *maxBufSize, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	fStatus = flLoadXsvfAndConvertToCsvf(xsvfFile, csvfBuf, maxBufSize, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "convertXsvf()");
+	fStatus = csvfOptimiseBuffer(csvfBuf, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "convertXsvf()");
+cleanup:
+	return retVal;
+}
+
+// Load one JTAG programming file, converting it to CSVF if necessary.
+//
+// Called by:
+//   flProgramCompiled() -> loadProgFile() -> loadJtagFile()
+//   flProgramResumable() -> loadJtagFile()
+//   loadJtagFiles() -> loadJtagFile()
+//
+static FLStatus loadJtagFile(const char *progFile, struct Buffer *csvfBuf, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	struct Csvc csvc = {0,};
+	const char *const ext = progFile + strlen(progFile) - 5;
+	if ( csvcSniff(progFile) ) {
+		fStatus = csvcOpen(&csvc, progFile, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "loadJtagFile()");
+		fStatus = csvcLoad(&csvc, csvfBuf, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "loadJtagFile()");
+	} else if ( strcmp(".svf", ext+1) == 0 ) {
+		fStatus = cacheConvert(progFile, convertSvf, csvfBuf, NULL, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "loadJtagFile()");
+	} else if ( strcmp(".xsvf", ext) == 0 ) {
+		fStatus = cacheConvert(progFile, convertXsvf, csvfBuf, NULL, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "loadJtagFile()");
+	} else if ( strcmp(".csvf", ext) == 0 ) {
+		bStatus = bufAppendFromBinaryFile(csvfBuf, progFile, error);
+		CHECK_STATUS(bStatus, FL_FILE_ERR, cleanup, "loadJtagFile()");
+	} else {
+		FAIL_RET(
+			FL_FILE_ERR, cleanup,
+			"loadJtagFile(): JTAG files should have .svf, .xsvf or .csvf extension");
+	}
+cleanup:
+	csvcClose(&csvc);
+	return retVal;
+}
+
+// Load a comma-separated list of JTAG programming files, one for each device in the chain
+// (starting with the device nearest TDI), and merge them so the whole chain is programmed at once.
+//
+// Called by:
+//   flProgramCompiled() -> loadProgFile() -> loadJtagFiles()
+//   flProgramResumable() -> loadJtagFiles()
+//
+static FLStatus loadJtagFiles(const char *fileList, struct Buffer *csvfBuf, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	uint32 numFiles = 1, numLoaded = 0, i;
+	struct Buffer *bufs = NULL;
+	const uint8 **streams = NULL;
+	const char *p;
+	char *names = NULL, *name, *comma;
+	for ( p = fileList; *p; p++ ) {
+		if ( *p == ',' ) {
+			numFiles++;
+		}
+	}
+	names = (char *)malloc(strlen(fileList) + 1);
+	CHECK_STATUS(!names, FL_ALLOC_ERR, cleanup, "loadJtagFiles()");
+	strcpy(names, fileList);
+	bufs = (struct Buffer *)calloc(numFiles, sizeof(struct Buffer));
+	CHECK_STATUS(!bufs, FL_ALLOC_ERR, cleanup, "loadJtagFiles()");
+	streams = (const uint8 **)calloc(numFiles, sizeof(const uint8 *));
+	CHECK_STATUS(!streams, FL_ALLOC_ERR, cleanup, "loadJtagFiles()");
+	name = names;
+	for ( i = 0; i < numFiles; i++ ) {
+		comma = strchr(name, ',');
+		if ( comma ) {
+			*comma = '\0';
+		}
+		CHECK_STATUS(
+			*name == '\0', FL_FILE_ERR, cleanup,
+			"loadJtagFiles(): No file given for device %d", i);
+		bStatus = bufInitialise(bufs + i, 0x20000, 0, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "loadJtagFiles()");
+		numLoaded++;
+		fStatus = loadJtagFile(name, bufs + i, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "loadJtagFiles()");
+		streams[i] = bufs[i].data;
+		if ( comma ) {
+			name = comma + 1;
+		}
+	}
+	fStatus = flMergeCsvf(streams, numFiles, csvfBuf, NULL, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "loadJtagFiles()");
+cleanup:
+	for ( i = 0; i < numLoaded; i++ ) {
+		bufDestroy(bufs + i);
+	}
+	free((void*)streams);
+	free((void*)bufs);
+	free((void*)names);
+	return retVal;
+}
+
+// Reverse the array in-place by swapping the outer items and progressing inward until we meet in
+// the middle.
+//
+// Called by:
+//   jtagScanChain()
+//
+static void swap(uint32 *array, uint32 numWritten) {
+	uint32 *hiPtr = array + numWritten - 1;  // last one
+	uint32 *loPtr = array; // first one
+	uint32 temp;
+	while ( loPtr < hiPtr ) {
+		temp = *loPtr;
+		*loPtr++ = *hiPtr;
+		*hiPtr-- = temp;
+	}
+}	
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of public functions
+// -------------------------------------------------------------------------------------------------
+
+DLLEXPORT(FLStatus) progOpen(struct FLContext *handle, const char *portConfig, const char **error) {
+	return progOpenInternal(handle, portConfig, portConfig, error);
+}
+
+DLLEXPORT(FLStatus) progClose(struct FLContext *handle, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
 	FLStatus fStatus;
 
 	// Set MISO/TDO, MOSI/TDI, SS/TMS & SCK/TCK as inputs
@@ -680,12 +1404,69 @@ cleanup:
 	return retVal;
 }
 
-// Shift data into and out of JTAG chain.
-//   In pointer may be SHIFT_ZEROS (shift in zeros) or SHIFT_ONES (shift in ones).
-//   Out pointer may be NULL (not interested in data shifted out of the chain).
-//
-DLLEXPORT(FLStatus) jtagShiftInOut(
-	struct FLContext *handle, uint32 numBits, const uint8 *inData, uint8 *outData, uint8 isLast,
+// Shift data into and out of JTAG chain.
+//   In pointer may be SHIFT_ZEROS (shift in zeros) or SHIFT_ONES (shift in ones).
+//   Out pointer may be NULL (not interested in data shifted out of the chain).
+//   Shifts longer than one chunk are pipelined, unless async CommFPGA operations are in flight.
+//
+DLLEXPORT(FLStatus) jtagShiftInOut(
+	struct FLContext *handle, uint32 numBits, const uint8 *inData, uint8 *outData, uint8 isLast,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint32 numBytes = bitsToBytes(numBits);
+	uint16 chunkSize;
+	uint8 mode = 0x00;
+	bool isSending = false;
+
+	if ( inData == SHIFT_ONES ) {
+		mode |= bmSENDONES;
+	} else if ( inData != SHIFT_ZEROS ) {
+		isSending = true;
+	}
+	if ( isLast ) {
+		mode |= bmISLAST;
+	}
+	if ( isSending ) {
+		fStatus = beginShift(handle, numBits, PROG_JTAG_ISSENDING_ISRECEIVING, mode, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
+		if ( numBytes > 64 && canPipeline(handle) ) {
+			fStatus = pipelinedShift(handle, inData, NULL, outData, true, numBytes, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
+			numBytes = 0;
+		}
+		while ( numBytes ) {
+			chunkSize = (uint16)((numBytes >= 64) ? 64 : numBytes);
+			fStatus = doSend(handle, inData, chunkSize, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
+			inData += chunkSize;
+			fStatus = doReceive(handle, outData, chunkSize, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
+			outData += chunkSize;
+			numBytes -= chunkSize;
+		}
+	} else {
+		fStatus = beginShift(handle, numBits, PROG_JTAG_NOTSENDING_ISRECEIVING, mode, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
+		if ( numBytes > 64 && canPipeline(handle) ) {
+			fStatus = pipelinedShift(handle, NULL, NULL, outData, true, numBytes, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
+			numBytes = 0;
+		}
+		while ( numBytes ) {
+			chunkSize = (uint16)((numBytes >= 64) ? 64 : numBytes);
+			fStatus = doReceive(handle, outData, chunkSize, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
+			outData += chunkSize;
+			numBytes -= chunkSize;
+		}
+	}
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(FLStatus) jtagShiftInOnly(
+	struct FLContext *handle, uint32 numBits, const uint8 *inData, uint8 isLast,
 	const char **error)
 {
 	FLStatus retVal = FL_SUCCESS, fStatus;
@@ -693,7 +1474,6 @@ DLLEXPORT(FLStatus) jtagShiftInOut(
 	uint16 chunkSize;
 	uint8 mode = 0x00;
 	bool isSending = false;
-
 	if ( inData == SHIFT_ONES ) {
 		mode |= bmSENDONES;
 	} else if ( inData != SHIFT_ZEROS ) {
@@ -703,263 +1483,786 @@ DLLEXPORT(FLStatus) jtagShiftInOut(
 		mode |= bmISLAST;
 	}
 	if ( isSending ) {
-		fStatus = beginShift(handle, numBits, PROG_JTAG_ISSENDING_ISRECEIVING, mode, error);
+		fStatus = beginShift(handle, numBits, PROG_JTAG_ISSENDING_NOTRECEIVING, mode, error);
 		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
+		if ( numBytes > 64 && canPipeline(handle) ) {
+			fStatus = pipelinedShift(handle, inData, NULL, NULL, false, numBytes, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
+			numBytes = 0;
+		}
 		while ( numBytes ) {
 			chunkSize = (uint16)((numBytes >= 64) ? 64 : numBytes);
 			fStatus = doSend(handle, inData, chunkSize, error);
 			CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
 			inData += chunkSize;
-			fStatus = doReceive(handle, outData, chunkSize, error);
-			CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
-			outData += chunkSize;
 			numBytes -= chunkSize;
 		}
 	} else {
-		fStatus = beginShift(handle, numBits, PROG_JTAG_NOTSENDING_ISRECEIVING, mode, error);
+		fStatus = beginShift(handle, numBits, PROG_JTAG_NOTSENDING_NOTRECEIVING, mode, error);
 		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
-		while ( numBytes ) {
-			chunkSize = (uint16)((numBytes >= 64) ? 64 : numBytes);
-			fStatus = doReceive(handle, outData, chunkSize, error);
-			CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
-			outData += chunkSize;
-			numBytes -= chunkSize;
+	}
+cleanup:
+	return retVal;
+}
+
+// Apply the supplied bit pattern to SS/TMS, to move the TAP to a specific state.
+//
+DLLEXPORT(FLStatus) jtagClockFSM(
+	struct FLContext *handle, uint32 bitPattern, uint8 transitionCount, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	USBStatus uStatus;
+	union {
+		uint32 u32;
+		uint8 bytes[4];
+	} lePattern;
+	lePattern.u32 = littleEndian32(bitPattern);
+	uStatus = usbControlWrite(
+		handle->device,
+		CMD_JTAG_CLOCK_FSM,       // bRequest
+		(uint16)transitionCount,  // wValue
+		0x0000,                   // wIndex
+		lePattern.bytes,          // bit pattern
+		4,                        // wLength
+		5000,                     // timeout (ms)
+		error
+	);
+	CHECK_STATUS(uStatus, FL_PROG_JTAG_FSM, cleanup, "jtagClockFSM()");
+cleanup:
+	return retVal;
+}
+
+// Cycle the SCK/TCK line for the given number of times.
+//
+DLLEXPORT(FLStatus) jtagClocks(struct FLContext *handle, uint32 numClocks, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	USBStatus uStatus = usbControlWrite(
+		handle->device,
+		CMD_JTAG_CLOCK,                // bRequest
+		(uint16)(numClocks & 0xFFFF),  // wValue
+		(uint16)(numClocks >> 16),     // wIndex
+		NULL,                          // no data
+		0,                             // wLength
+		60000,                         // timeout (ms)
+		error
+	);
+	CHECK_STATUS(uStatus, FL_PROG_JTAG_CLOCKS, cleanup, "jtagClocks()");
+cleanup:
+	return retVal;
+}
+
+// Scan the JTAG chain and return an array of IDCODEs
+//
+DLLEXPORT(FLStatus) jtagScanChain(
+	struct FLContext *handle, const char *portConfig,
+	uint32 *numDevices, uint32 *deviceArray, uint32 arraySize,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	FLStatus fStatus;
+	uint32 i = 0;
+	union {
+		uint32 idCode;
+		uint8 bytes[4];
+	} u;
+	fStatus = progOpenInternal(handle, portConfig, portConfig, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagScanChain()");
+
+	i = 0;
+	fStatus = jtagClockFSM(handle, 0x0000005F, 9, error);  // Reset TAP, goto Shift-DR
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagScanChain()");
+	for ( ; ; ) {
+		fStatus = jtagShiftInOut(handle, 32, SHIFT_ZEROS, u.bytes, false, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagScanChain()");
+		if ( u.idCode == 0x00000000 || u.idCode == U32MAX ) {
+			break;
+		}
+		if ( deviceArray && i < arraySize ) {
+			deviceArray[i] = littleEndian32(u.idCode);
+		}
+		i++;
+	}
+	if ( deviceArray && i ) {
+		// The IDCODEs we have are in reverse order, so swap them to get the correct chain order.
+		swap(deviceArray, (i > arraySize) ? arraySize : i);
+	}
+	if ( numDevices ) {
+		*numDevices = i;
+	}
+
+	fStatus = progClose(handle, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagScanChain()");
+
+cleanup:
+	return retVal;
+}
+
+// Parse a programming config once, to be used by flProgramCompiled() & flProgramBlobCompiled().
+//
+DLLEXPORT(FLStatus) flCompileProgConfig(
+	const char *progConfig, struct FLPortConfig **compiled, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	struct FLPortConfig *const cfg = (struct FLPortConfig *)malloc(sizeof(struct FLPortConfig));
+	CHECK_STATUS(!cfg, FL_ALLOC_ERR, cleanup, "flCompileProgConfig()");
+	fStatus = compileProg(progConfig, cfg, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flCompileProgConfig()");
+	*compiled = cfg;
+cleanup:
+	if ( retVal != FL_SUCCESS ) {
+		free((void*)cfg);
+	}
+	return retVal;
+}
+
+// Parse a list of pins once, to be used by flMultiBitPortAccessCompiled().
+//
+DLLEXPORT(FLStatus) flCompilePortConfig(
+	const char *portConfig, struct FLPortConfig **compiled, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	struct FLPortConfig *const cfg = (struct FLPortConfig *)malloc(sizeof(struct FLPortConfig));
+	CHECK_STATUS(!cfg, FL_ALLOC_ERR, cleanup, "flCompilePortConfig()");
+	fStatus = compilePins(portConfig, cfg, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flCompilePortConfig()");
+	*compiled = cfg;
+cleanup:
+	if ( retVal != FL_SUCCESS ) {
+		free((void*)cfg);
+	}
+	return retVal;
+}
+
+DLLEXPORT(void) flFreePortConfig(struct FLPortConfig *compiled) {
+	if ( compiled ) {
+		releaseConfig(compiled);
+		free((void*)compiled);
+	}
+}
+
+// Programs a device using in-memory configuration information and a compiled config
+//
+DLLEXPORT(FLStatus) flProgramBlobCompiled(
+	struct FLContext *handle, const struct FLPortConfig *progConfig, uint32 blobLength,
+	const uint8 *blobData, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	switch ( progConfig->algoVendor ) {
+	case 'X':
+		fStatus = xProgram(handle, progConfig, blobData, blobLength, error);
+		break;
+	case 'A':
+		fStatus = aProgram(handle, progConfig, blobData, blobLength, error);
+		break;
+	case 'L':
+		fStatus = lProgram(handle, progConfig, blobData, blobLength, error);
+		break;
+	case 'J':
+		fStatus = jProgram(handle, progConfig, blobData, blobLength, error);
+		break;
+	default:
+		FAIL_RET(
+			FL_CONF_FORMAT, cleanup,
+			"flProgramBlobCompiled(): This is a list of pins, not a programming config");
+	}
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramBlobCompiled()");
+cleanup:
+	return retVal;
+}
+
+// Programs a device using in-memory configuration information
+//
+DLLEXPORT(FLStatus) flProgramBlob(
+	struct FLContext *handle, const char *portConfig, uint32 blobLength, const uint8 *blobData,
+	const char **error)
+{
+	FLStatus retVal;
+	struct FLPortConfig cfg;
+	retVal = compileProg(portConfig, &cfg, error);
+	if ( retVal == FL_SUCCESS ) {
+		retVal = flProgramBlobCompiled(handle, &cfg, blobLength, blobData, error);
+		releaseConfig(&cfg);
+	}
+	return retVal;
+}
+	
+// If progFile is NULL, find the filename at the end of portConfig instead.
+//
+// Called by:
+//   flProgramStreaming() -> getProgFile()
+//   flProgramResumable() -> getProgFile()
+//   flProgramIfDifferent() -> getProgFile()
+//
+static FLStatus getProgFile(const char *portConfig, const char **progFile, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	const char *p;
+	if ( *progFile == NULL ) {
+		// Expect to find prog file at the end of portConfig
+		p = portConfig;
+		while ( *p && *p != ':' ) {
+			p++;
+		}
+		CHECK_STATUS(
+			*p == '\0', FL_CONF_FORMAT, cleanup,
+			"getProgFile(): portConfig terminated before first ':'");
+		p++;
+		while ( *p && *p != ':' ) {
+			p++;
+		}
+		CHECK_STATUS(
+			*p == '\0', FL_CONF_FORMAT, cleanup,
+			"getProgFile(): progFile was NULL, and portConfig didn't specify a file");
+		*progFile = p + 1;
+	}
+cleanup:
+	return retVal;
+}
+
+// Load a programming file ready for flProgramBlob(), converting JTAG files to CSVF.
+//
+// Called by:
+//   flProgramCompiled() -> loadProgFile()
+//   flProgramMulti() -> loadProgFile()
+//
+static FLStatus loadProgFile(
+	char algoVendor, const char *progFile, struct Buffer *fileBuf, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	if ( algoVendor == 'J' ) {
+		// JTAG file, or a comma-separated list of them, one for each device in the chain
+		if ( strchr(progFile, ',') ) {
+			fStatus = loadJtagFiles(progFile, fileBuf, error);
+		} else {
+			fStatus = loadJtagFile(progFile, fileBuf, error);
+		}
+		CHECK_STATUS(fStatus, fStatus, cleanup, "loadProgFile()");
+	} else {
+		// Just load it
+		bStatus = bufAppendFromBinaryFile(fileBuf, progFile, error);
+		CHECK_STATUS(bStatus, FL_FILE_ERR, cleanup, "loadProgFile()");
+	}
+cleanup:
+	return retVal;
+}
+
+// Programs a device using configuration information loaded from a file and a compiled config. If
+// progFile is NULL, it expects the config to have named one.
+//
+DLLEXPORT(FLStatus) flProgramCompiled(
+	struct FLContext *handle, const struct FLPortConfig *progConfig, const char *progFile,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	const char algoVendor = progConfig->algoVendor;
+	struct Buffer fileBuf = {0,};
+	BufferStatus bStatus = bufInitialise(&fileBuf, 0x20000, 0, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flProgramCompiled()");
+	if ( progFile == NULL ) {
+		progFile = progConfig->progFile;
+		CHECK_STATUS(
+			progFile == NULL, FL_CONF_FORMAT, cleanup,
+			"flProgramCompiled(): progFile was NULL, and the config didn't specify a file");
+	}
+	if ( algoVendor == 'J' && !strchr(progFile, ',') && csvcSniff(progFile) ) {
+		// A CSVC container is played from the mapped file, rather than loaded
+		fStatus = jProgramCsvc(handle, progConfig, progFile, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramCompiled()");
+	} else {
+		fStatus = loadProgFile(algoVendor, progFile, &fileBuf, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramCompiled()");
+		fStatus = flProgramBlobCompiled(
+			handle, progConfig, (uint32)fileBuf.length, fileBuf.data, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramCompiled()");
+	}
+cleanup:
+	bufDestroy(&fileBuf);
+	return retVal;
+}
+
+// Programs a device using configuration information loaded from a file. If progFile is NULL,
+// it expects to find a filename at the end of portConfig.
+//
+DLLEXPORT(FLStatus) flProgram(
+	struct FLContext *handle, const char *portConfig, const char *progFile, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	struct FLPortConfig cfg;
+	fStatus = compileProg(portConfig, &cfg, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgram()");
+	fStatus = flProgramCompiled(handle, &cfg, progFile, error);
+	releaseConfig(&cfg);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgram()");
+cleanup:
+	return retVal;
+}
+
+// Fingerprint the programming files: a 64-bit FNV-1a hash of the contents of each file in turn,
+// stored big-endian.
+//
+// Called by:
+//   flProgramIfDifferent() -> hashProgFiles()
+//
+FLStatus hashProgFiles(const char *fileList, uint8 fingerprint[8], const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	uint64 hash = HASH_FNV64_INIT;
+	char *const names = (char *)malloc(strlen(fileList) + 1);
+	char *name, *comma;
+	uint8 *data;
+	size_t length;
+	CHECK_STATUS(!names, FL_ALLOC_ERR, cleanup, "hashProgFiles()");
+	strcpy(names, fileList);
+	name = names;
+	do {
+		comma = strchr(name, ',');
+		if ( comma ) {
+			*comma = '\0';
+		}
+		data = flLoadFile(name, &length);
+		CHECK_STATUS(
+			!data, FL_FILE_ERR, cleanup,
+			"hashProgFiles(): Unable to load %s", name);
+		hash = hashFnv64(hash, data, length);
+		flFreeFile(data);
+		if ( comma ) {
+			name = comma + 1;
+		}
+	} while ( comma );
+	flWriteLong((uint32)(hash >> 32), fingerprint);
+	flWriteLong((uint32)hash, fingerprint + 4);
+cleanup:
+	free((void*)names);
+	return retVal;
+}
+
+// Programs a device only if the running design didn't come from the same file. The fingerprint of
+// the file is kept in a CommFPGA register in the design itself, which a reconfiguration clears.
+//
+DLLEXPORT(FLStatus) flProgramIfDifferent(
+	struct FLContext *handle, const char *portConfig, const char *progFile, uint8 conduit,
+	uint8 idChan, uint8 *programmed, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint8 fingerprint[8], current[8];
+	uint8 isRunning = 0;
+	bool isSame = false;
+	*programmed = 0;
+	fStatus = getProgFile(portConfig, &progFile, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramIfDifferent()");
+	fStatus = hashProgFiles(progFile, fingerprint, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramIfDifferent()");
+	CHECK_STATUS(
+		!flIsCommCapable(handle, conduit), FL_PROTOCOL_ERR, cleanup,
+		"flProgramIfDifferent(): The device does not support CommFPGA on conduit %d", conduit);
+
+	// Is the same design already running?
+	fStatus = flSelectConduit(handle, conduit, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramIfDifferent()");
+	fStatus = flIsFPGARunning(handle, &isRunning, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramIfDifferent()");
+	if ( isRunning ) {
+		fStatus = flReadChannel(handle, idChan, sizeof(current), current, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramIfDifferent()");
+		isSame = !memcmp(current, fingerprint, sizeof(fingerprint));
+	}
+
+	// If not, program it and record the fingerprint in the new design
+	if ( !isSame ) {
+		fStatus = flSelectConduit(handle, 0x00, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramIfDifferent()");
+		fStatus = flProgram(handle, portConfig, progFile, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramIfDifferent()");
+		*programmed = 1;
+		fStatus = flSelectConduit(handle, conduit, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramIfDifferent()");
+		fStatus = flIsFPGARunning(handle, &isRunning, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramIfDifferent()");
+		CHECK_STATUS(
+			!isRunning, FL_PROG_ERR, cleanup,
+			"flProgramIfDifferent(): The FPGA was programmed, but it isn't running");
+		fStatus = flWriteChannel(handle, idChan, sizeof(fingerprint), fingerprint, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramIfDifferent()");
+	}
+cleanup:
+	return retVal;
+}
+
+// The state shared by the flProgramMulti() workers: each takes the next device off the list until
+// there are none left.
+//
+struct MultiJob {
+	const char *const *vpList;
+	uint32 numDevices;
+	const struct FLPortConfig *cfg;
+	const uint8 *data;
+	uint32 length;
+	FLStatus *statuses;
+	const char **errors;
+	struct Mutex mutex;
+	uint32 next;
+};
+
+// Called by:
+//   flProgramMulti() -> multiProgram() (on this thread and on the workers)
+//
+static void multiProgram(void *arg) {
+	struct MultiJob *const job = (struct MultiJob *)arg;
+	struct FLContext *handle;
+	FLStatus status;
+	const char *error;
+	const char **errPtr;
+	uint32 i;
+	for ( ;; ) {
+		mutexLock(&job->mutex);
+		i = job->next++;
+		mutexUnlock(&job->mutex);
+		if ( i >= job->numDevices ) {
+			break;
+		}
+		handle = NULL;
+		error = NULL;
+		errPtr = job->errors ? &error : NULL;
+		status = flOpen(job->vpList[i], &handle, errPtr);
+		if ( status == FL_SUCCESS ) {
+			status = flSelectConduit(handle, 0x00, errPtr);
+		}
+		if ( status == FL_SUCCESS ) {
+			status = flProgramBlobCompiled(handle, job->cfg, job->length, job->data, errPtr);
+		}
+		flClose(handle);
+		job->statuses[i] = status;
+		if ( job->errors ) {
+			job->errors[i] = error;
 		}
 	}
-cleanup:
-	return retVal;
 }
 
-DLLEXPORT(FLStatus) jtagShiftInOnly(
-	struct FLContext *handle, uint32 numBits, const uint8 *inData, uint8 isLast,
-	const char **error)
+// Programs several devices at once with the same file, which is loaded (and converted) just once,
+// and the same config, which is parsed just once.
+//
+DLLEXPORT(FLStatus) flProgramMulti(
+	const char *const *vpList, uint32 numDevices, const char *portConfig, const char *progFile,
+	uint32 maxThreads, FLStatus *statuses, const char **errors, const char **error)
 {
 	FLStatus retVal = FL_SUCCESS, fStatus;
-	uint32 numBytes = bitsToBytes(numBits);
-	uint16 chunkSize;
-	uint8 mode = 0x00;
-	bool isSending = false;
-	if ( inData == SHIFT_ONES ) {
-		mode |= bmSENDONES;
-	} else if ( inData != SHIFT_ZEROS ) {
-		isSending = true;
+	BufferStatus bStatus;
+	struct Buffer fileBuf = {0,};
+	struct FLPortConfig cfg;
+	struct MultiJob job;
+	struct Thread *threads = NULL;
+	uint32 numThreads, numStarted = 0, numFailed = 0, firstFailed = 0, i;
+	bool haveConfig = false, haveMutex = false;
+	for ( i = 0; i < numDevices; i++ ) {
+		statuses[i] = FL_PROG_ERR;
+		if ( errors ) {
+			errors[i] = NULL;
+		}
 	}
-	if ( isLast ) {
-		mode |= bmISLAST;
+	fStatus = compileProg(portConfig, &cfg, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramMulti()");
+	haveConfig = true;
+	if ( progFile == NULL ) {
+		progFile = cfg.progFile;
+		CHECK_STATUS(
+			progFile == NULL, FL_CONF_FORMAT, cleanup,
+			"flProgramMulti(): progFile was NULL, and portConfig didn't specify a file");
 	}
-	if ( isSending ) {
-		fStatus = beginShift(handle, numBits, PROG_JTAG_ISSENDING_NOTRECEIVING, mode, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
-		while ( numBytes ) {
-			chunkSize = (uint16)((numBytes >= 64) ? 64 : numBytes);
-			fStatus = doSend(handle, inData, chunkSize, error);
-			CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
-			inData += chunkSize;
-			numBytes -= chunkSize;
+	bStatus = bufInitialise(&fileBuf, 0x20000, 0, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flProgramMulti()");
+	fStatus = loadProgFile(cfg.algoVendor, progFile, &fileBuf, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramMulti()");
+
+	// One thread per device by default, since they mostly wait for USB
+	numThreads = (maxThreads && maxThreads < numDevices) ? maxThreads : numDevices;
+	if ( numThreads > 1 ) {
+		threads = (struct Thread *)calloc(numThreads, sizeof(struct Thread));
+		CHECK_STATUS(!threads, FL_ALLOC_ERR, cleanup, "flProgramMulti()");
+	}
+	job.vpList = vpList;
+	job.numDevices = numDevices;
+	job.cfg = &cfg;
+	job.data = fileBuf.data;
+	job.length = (uint32)fileBuf.length;
+	job.statuses = statuses;
+	job.errors = errors;
+	job.next = 0;
+	mutexInit(&job.mutex);
+	haveMutex = true;
+
+	// Program the devices; this thread is one of the workers. If a thread can't be started, the
+	// others just do more of the work.
+	for ( i = 1; i < numThreads; i++ ) {
+		if ( threadCreate(threads + i, multiProgram, &job, NULL) != FL_SUCCESS ) {
+			break;
+		}
+		numStarted = i;
+	}
+	multiProgram(&job);
+	for ( i = 1; i <= numStarted; i++ ) {
+		threadJoin(threads + i);
+	}
+
+	for ( i = numDevices; i--; ) {
+		if ( statuses[i] != FL_SUCCESS ) {
+			numFailed++;
+			firstFailed = i;
 		}
-	} else {
-		fStatus = beginShift(handle, numBits, PROG_JTAG_NOTSENDING_NOTRECEIVING, mode, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagShiftInOut()");
 	}
+	CHECK_STATUS(
+		numFailed, statuses[firstFailed], cleanup,
+		"flProgramMulti(): %u of %u devices failed, the first being %s",
+		numFailed, numDevices, vpList[firstFailed]);
 cleanup:
+	if ( haveMutex ) {
+		mutexDestroy(&job.mutex);
+	} else {
+		// Failed before any device was tried, so they all failed for the same reason
+		for ( i = 0; i < numDevices; i++ ) {
+			statuses[i] = retVal;
+		}
+	}
+	if ( haveConfig ) {
+		releaseConfig(&cfg);
+	}
+	free((void*)threads);
+	bufDestroy(&fileBuf);
 	return retVal;
 }
 
-// Apply the supplied bit pattern to SS/TMS, to move the TAP to a specific state.
+// Start a new phase of a flProgramAsync() operation.
 //
-DLLEXPORT(FLStatus) jtagClockFSM(
-	struct FLContext *handle, uint32 bitPattern, uint8 transitionCount, const char **error)
-{
+FLStatus progPhase(struct FLContext *handle, FLProgPhase phase, uint64 total, const char **error) {
 	FLStatus retVal = FL_SUCCESS;
-	USBStatus uStatus;
-	union {
-		uint32 u32;
-		uint8 bytes[4];
-	} lePattern;
-	lePattern.u32 = littleEndian32(bitPattern);
-	uStatus = usbControlWrite(
-		handle->device,
-		CMD_JTAG_CLOCK_FSM,       // bRequest
-		(uint16)transitionCount,  // wValue
-		0x0000,                   // wIndex
-		lePattern.bytes,          // bit pattern
-		4,                        // wLength
-		5000,                     // timeout (ms)
-		error
-	);
-	CHECK_STATUS(uStatus, FL_PROG_JTAG_FSM, cleanup, "jtagClockFSM()");
+	struct Progress *const progress = handle->progress;
+	if ( progress ) {
+		CHECK_STATUS(
+			threadAtomicGet(&progress->isCancelled), FL_CANCELLED, cleanup,
+			"progPhase(): Programming was cancelled");
+		progress->phase = phase;
+		progress->done = 0;
+		progress->total = total;
+		progress->nextReport = total / 100 + 1;
+		progress->startTime = threadNow();
+		if ( progress->func ) {
+			progress->func(progress->userData, phase, 0, total, 0.0);
+		}
+	}
 cleanup:
 	return retVal;
 }
 
-// Cycle the SCK/TCK line for the given number of times.
+// Record some progress through the current phase of a flProgramAsync() operation, reporting it
+// every one percent or so.
 //
-DLLEXPORT(FLStatus) jtagClocks(struct FLContext *handle, uint32 numClocks, const char **error) {
+FLStatus progAdvance(struct FLContext *handle, uint64 amount, const char **error) {
 	FLStatus retVal = FL_SUCCESS;
-	USBStatus uStatus = usbControlWrite(
-		handle->device,
-		CMD_JTAG_CLOCK,                // bRequest
-		(uint16)(numClocks & 0xFFFF),  // wValue
-		(uint16)(numClocks >> 16),     // wIndex
-		NULL,                          // no data
-		0,                             // wLength
-		60000,                         // timeout (ms)
-		error
-	);
-	CHECK_STATUS(uStatus, FL_PROG_JTAG_CLOCKS, cleanup, "jtagClocks()");
+	struct Progress *const progress = handle->progress;
+	double elapsed;
+	if ( progress ) {
+		CHECK_STATUS(
+			threadAtomicGet(&progress->isCancelled), FL_CANCELLED, cleanup,
+			"progAdvance(): Programming was cancelled");
+		progress->done += amount;
+		if ( progress->done >= progress->nextReport ) {
+			progress->nextReport = progress->done + progress->total / 100 + 1;
+			elapsed = threadNow() - progress->startTime;
+			if ( progress->func ) {
+				progress->func(
+					progress->userData, progress->phase, progress->done, progress->total,
+					(elapsed > 0.0) ? (double)progress->done / elapsed : 0.0);
+			}
+		}
+	}
 cleanup:
 	return retVal;
 }
 
-// Scan the JTAG chain and return an array of IDCODEs
+// An asynchronous programming operation
 //
-DLLEXPORT(FLStatus) jtagScanChain(
-	struct FLContext *handle, const char *portConfig,
-	uint32 *numDevices, uint32 *deviceArray, uint32 arraySize,
-	const char **error)
-{
-	FLStatus retVal = FL_SUCCESS;
-	FLStatus fStatus;
-	uint32 i = 0;
-	union {
-		uint32 idCode;
-		uint8 bytes[4];
-	} u;
-	fStatus = progOpenInternal(handle, portConfig, portConfig, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagScanChain()");
+struct FLProgJob {
+	struct FLContext *handle;
+	char *portConfig;
+	char *progFile;
+	struct Progress progress;
+	struct Thread thread;
+	FLStatus status;
+	const char *error;
+};
 
-	i = 0;
-	fStatus = jtagClockFSM(handle, 0x0000005F, 9, error);  // Reset TAP, goto Shift-DR
-	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagScanChain()");
-	for ( ; ; ) {
-		fStatus = jtagShiftInOut(handle, 32, SHIFT_ZEROS, u.bytes, false, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagScanChain()");
-		if ( u.idCode == 0x00000000 || u.idCode == U32MAX ) {
-			break;
-		}
-		if ( deviceArray && i < arraySize ) {
-			deviceArray[i] = littleEndian32(u.idCode);
-		}
-		i++;
-	}
-	if ( deviceArray && i ) {
-		// The IDCODEs we have are in reverse order, so swap them to get the correct chain order.
-		swap(deviceArray, (i > arraySize) ? arraySize : i);
-	}
-	if ( numDevices ) {
-		*numDevices = i;
+// Called by:
+//   flProgramAsync() -> asyncProgram() (on a worker thread)
+//
+static void asyncProgram(void *arg) {
+	struct FLProgJob *const job = (struct FLProgJob *)arg;
+	job->handle->progress = &job->progress;
+	job->status = flProgram(job->handle, job->portConfig, job->progFile, &job->error);
+	job->handle->progress = NULL;
+}
+
+// Start flProgram() on its own thread, reporting progress as it goes.
+//
+DLLEXPORT(FLStatus) flProgramAsync(
+	struct FLContext *handle, const char *portConfig, const char *progFile,
+	FLProgressFunc progress, void *userData, struct FLProgJob **job, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	bool failed = false;
+	struct FLProgJob *const newJob = (struct FLProgJob *)calloc(1, sizeof(struct FLProgJob));
+	CHECK_STATUS(!newJob, FL_ALLOC_ERR, cleanup, "flProgramAsync()");
+	newJob->handle = handle;
+	newJob->portConfig = copyString(portConfig, &failed);
+	newJob->progFile = copyString(progFile, &failed);
+	CHECK_STATUS(failed, FL_ALLOC_ERR, cleanup, "flProgramAsync()");
+	newJob->progress.func = progress;
+	newJob->progress.userData = userData;
+	fStatus = threadCreate(&newJob->thread, asyncProgram, newJob, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramAsync()");
+	*job = newJob;
+cleanup:
+	if ( retVal != FL_SUCCESS && newJob ) {
+		free((void*)newJob->portConfig);
+		free((void*)newJob->progFile);
+		free((void*)newJob);
 	}
+	return retVal;
+}
 
-	fStatus = progClose(handle, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagScanChain()");
+// Ask a flProgramAsync() operation to stop at the next chunk.
+//
+DLLEXPORT(void) flProgramCancel(struct FLProgJob *job) {
+	threadAtomicSet(&job->progress.isCancelled, 1);
+}
 
-cleanup:
+// Wait for a flProgramAsync() operation to finish, and free it.
+//
+DLLEXPORT(FLStatus) flProgramAwait(struct FLProgJob *job, const char **error) {
+	FLStatus retVal;
+	threadJoin(&job->thread);
+	retVal = job->status;
+	if ( error ) {
+		*error = job->error;
+	} else if ( job->error ) {
+		errFree(job->error);
+	}
+	free((void*)job->portConfig);
+	free((void*)job->progFile);
+	free((void*)job);
 	return retVal;
 }
 
-// Programs a device using in-memory configuration information
+// The converter side of flProgramStreaming(), which runs on its own thread
 //
-DLLEXPORT(FLStatus) flProgramBlob(
-	struct FLContext *handle, const char *portConfig, uint32 blobLength, const uint8 *blobData,
-	const char **error)
+struct StreamJob {
+	const char *progFile;
+	bool wantError;
+	struct CsvfQueue queue;
+};
+
+// Called by:
+//   flProgramStreaming() -> streamConvert() (on a worker thread)
+//
+static void streamConvert(void *arg) {
+	struct StreamJob *const job = (struct StreamJob *)arg;
+	const char *error = NULL;
+	const FLStatus status = csvfStreamFile(
+		job->progFile, &job->queue.sink, STREAM_BLOCK_SIZE, job->wantError ? &error : NULL);
+	csvfQueueClose(&job->queue, status, error);
+}
+
+// Programs a device over JTAG, playing the CSVF as it's converted rather than when it's all
+// ready.
+//
+DLLEXPORT(FLStatus) flProgramStreaming(
+	struct FLContext *handle, const char *portConfig, const char *progFile, const char **error)
 {
-	FLStatus retVal = FL_SUCCESS;
-	const char algoVendor = portConfig[0];
-	if ( algoVendor == 'X' ) {
-		// This is a Xilinx algorithm
-		const char algoType = portConfig[1];
-		if ( algoType == 'P' ) {
-			// This is Xilinx Slave Parallel ("SelectMAP")
-			return xProgram(handle, PROG_PARALLEL, portConfig, blobData, blobLength, error);
-		} else if ( algoType == 'S' ) {
-			// This is Xilinx Slave Serial
-			return xProgram(handle, PROG_SPI_SEND, portConfig, blobData, blobLength, error);
-		} else if ( algoType == '\0' ) {
-			FAIL_RET(FL_CONF_FORMAT, cleanup, "flProgram(): Missing Xilinx algorithm code");
-		} else {
-			FAIL_RET(
-				FL_CONF_FORMAT, cleanup,
-				"flProgram(): '%c' is not a valid Xilinx algorithm code", algoType);
-		}
-	} else if ( algoVendor == 'A' ) {
-		// This is an Altera algorithm
-		const char algoType = portConfig[1];
-		if ( algoType == 'S' ) {
-			// This is Altera Passive Serial
-			return aProgram(handle, portConfig, blobData, blobLength, error);
-		} else if ( algoType == '\0' ) {
-			FAIL_RET(FL_CONF_FORMAT, cleanup, "flProgram(): Missing Altera algorithm code");
-		} else {
-			FAIL_RET(
-				FL_CONF_FORMAT, cleanup,
-				"flProgram(): '%c' is not a valid Altera algorithm code", algoType);
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	struct StreamJob job;
+	struct Thread thread;
+	struct CsvfPlayer player;
+	struct Buffer block = {0,};
+	bool haveQueue = false, haveThread = false;
+	const char *ptr = portConfig + 1;
+	char ch;
+	CHECK_STATUS(
+		portConfig[0] != 'J', FL_CONF_FORMAT, cleanup,
+		"flProgramStreaming(): Only JTAG programming can be streamed");
+	EXPECT_CHAR(':', "flProgramStreaming");
+	fStatus = getProgFile(portConfig, &progFile, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramStreaming()");
+	bStatus = bufInitialise(&block, STREAM_BLOCK_SIZE + 1024, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flProgramStreaming()");
+
+	// Start converting...
+	fStatus = csvfQueueInit(&job.queue, error);
+	haveQueue = true;
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramStreaming()");
+	job.progFile = progFile;
+	job.wantError = (error != NULL);
+	fStatus = threadCreate(&thread, streamConvert, &job, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramStreaming()");
+	haveThread = true;
+
+	// ...and play each block as it arrives
+	fStatus = progOpenInternal(handle, portConfig, ptr, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramStreaming()");
+	fStatus = csvfPlayInit(handle, &player, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramStreaming()");
+	for ( ;; ) {
+		fStatus = csvfQueueTake(&job.queue, &block, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramStreaming()");
+		if ( block.length == 0 ) {
+			break;
 		}
-	} else if ( algoVendor == 'J' ) {
-		// This is a JTAG algorithm
-		return jProgram(handle, portConfig, blobData, error);
-	} else if ( algoVendor == '\0' ) {
-		FAIL_RET(FL_CONF_FORMAT, cleanup, "flProgram(): Missing algorithm vendor code");
-	} else {
-		FAIL_RET(
-			FL_CONF_FORMAT, cleanup,
-			"flProgram(): '%c' is not a valid algorithm vendor code", algoVendor);
+		bStatus = bufAppendByte(&block, XCOMPLETE, error);  // in case the block doesn't end the stream
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flProgramStreaming()");
+		fStatus = csvfPlayCommands(handle, &player, block.data, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramStreaming()");
 	}
+	fStatus = progClose(handle, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramStreaming()");
 cleanup:
+	if ( haveThread ) {
+		csvfQueueCancel(&job.queue);
+		threadJoin(&thread);
+	}
+	if ( haveQueue ) {
+		csvfQueueDestroy(&job.queue);
+	}
+	bufDestroy(&block);
 	return retVal;
 }
-	
-// Programs a device using configuration information loaded from a file. If progFile is NULL,
-// it expects to find a filename at the end of portConfig.
+
+// Programs a device over JTAG, saving checkpoints so an interrupted run can be resumed.
 //
-DLLEXPORT(FLStatus) flProgram(
-	struct FLContext *handle, const char *portConfig, const char *progFile, const char **error) {
+DLLEXPORT(FLStatus) flProgramResumable(
+	struct FLContext *handle, const char *portConfig, const char *progFile, const char *ckptFile,
+	const char **error)
+{
 	FLStatus retVal = FL_SUCCESS, fStatus;
-	const char algoVendor = portConfig[0];
+	BufferStatus bStatus;
 	struct Buffer fileBuf = {0,};
-	BufferStatus bStatus = bufInitialise(&fileBuf, 0x20000, 0, error);
-	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "playSVF()");
-	if ( progFile == NULL ) {
-		// Expect to find prog file at the end of portConfig
-		progFile = portConfig;
-		while ( *progFile && *progFile != ':' ) {
-			progFile++;
-		}
-		CHECK_STATUS(
-			*progFile == '\0', FL_CONF_FORMAT, cleanup,
-			"flProgram(): portConfig terminated before first ':'");
-		progFile++;
-		while ( *progFile && *progFile != ':' ) {
-			progFile++;
-		}
-		CHECK_STATUS(
-			*progFile == '\0', FL_CONF_FORMAT, cleanup,
-			"flProgram(): progFile was NULL, and portConfig didn't specify a file");
-		progFile++;
-	}
-	if ( algoVendor == 'J' ) {
-		// JTAG file
-		const char *const ext = progFile + strlen(progFile) - 5;
-		if ( strcmp(".svf", ext+1) == 0 ) {
-			fStatus = flLoadSvfAndConvertToCsvf(progFile, &fileBuf, NULL, error);
-			CHECK_STATUS(fStatus, fStatus, cleanup, "flProgram()");
-		} else if ( strcmp(".xsvf", ext) == 0 ) {
-			fStatus = flLoadXsvfAndConvertToCsvf(progFile, &fileBuf, NULL, error);
-			CHECK_STATUS(fStatus, fStatus, cleanup, "flProgram()");
-		} else if ( strcmp(".csvf", ext) == 0 ) {
-			bStatus = bufAppendFromBinaryFile(&fileBuf, progFile, error);
-			CHECK_STATUS(bStatus, FL_FILE_ERR, cleanup, "flProgram()");
-		} else {
-			FAIL_RET(
-				FL_FILE_ERR, cleanup,
-				"flProgram(): JTAG files should have .svf, .xsvf or .csvf extension");
-		}
+	const char *ptr = portConfig + 1;
+	char ch;
+	CHECK_STATUS(
+		portConfig[0] != 'J', FL_CONF_FORMAT, cleanup,
+		"flProgramResumable(): Only JTAG programming can be resumed");
+	EXPECT_CHAR(':', "flProgramResumable");
+	fStatus = getProgFile(portConfig, &progFile, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramResumable()");
+	bStatus = bufInitialise(&fileBuf, 0x20000, 0, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flProgramResumable()");
+	if ( strchr(progFile, ',') ) {
+		fStatus = loadJtagFiles(progFile, &fileBuf, error);
 	} else {
-		// Just load it
-		bStatus = bufAppendFromBinaryFile(&fileBuf, progFile, error);
-		CHECK_STATUS(bStatus, FL_FILE_ERR, cleanup, "flProgram()");
+		fStatus = loadJtagFile(progFile, &fileBuf, error);
 	}
-	fStatus = flProgramBlob(handle, portConfig, (uint32)fileBuf.length, fileBuf.data, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgram()");
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramResumable()");
+	fStatus = progOpenInternal(handle, portConfig, ptr, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramResumable()");
+	fStatus = csvfPlayResumable(handle, fileBuf.data, fileBuf.length, ckptFile, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramResumable()");
+	fStatus = progClose(handle, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flProgramResumable()");
 cleanup:
 	bufDestroy(&fileBuf);
 	return retVal;
@@ -995,45 +2298,43 @@ cleanup:
 	return retVal;
 }
 
-DLLEXPORT(FLStatus) flMultiBitPortAccess(
-	struct FLContext *handle, const char *portConfig, uint32 *readState, const char **error)
+DLLEXPORT(FLStatus) flMultiBitPortAccessCompiled(
+	struct FLContext *handle, const struct FLPortConfig *portConfig, uint32 *readState,
+	const char **error)
 {
 	FLStatus retVal = FL_SUCCESS, fStatus;
-	const char *ptr = portConfig;
+	const struct PinOp *pin = portConfig->pins;
+	const struct PinOp *const end = pin + portConfig->numPins;
 	uint32 result = 0;
-	uint8 thisPort, thisBit;
-	char ch;
-	PinConfig pinConfig;
 	uint8 bitState;
-	do {
-		GET_PAIR(thisPort, thisBit, "flMultiBitPortAccess");
-		GET_CHAR("flMultiBitPortAccess");
-		if ( ch == '+' ) {
-			pinConfig = PIN_HIGH;
-		} else if ( ch == '-' ) {
-			pinConfig = PIN_LOW;
-		} else if ( ch == '?' ) {
-			pinConfig = PIN_INPUT;
-		} else {
-			FAIL_RET(
-				FL_CONF_FORMAT, cleanup,
-				"flMultiBitPortAccess(): Expecting '+', '-' or '?':\n  %s\n  %s^", portConfig, spaces(ptr-portConfig));
-		}
-		fStatus = flSingleBitPortAccess(handle, thisPort, thisBit, pinConfig, &bitState, error);
-		CHECK_STATUS(fStatus, fStatus, cleanup);
+	CHECK_STATUS(
+		portConfig->algoVendor != '\0', FL_CONF_FORMAT, cleanup,
+		"flMultiBitPortAccessCompiled(): This is a programming config, not a list of pins");
+	while ( pin < end ) {
+		fStatus = flSingleBitPortAccess(handle, pin->port, pin->bit, pin->config, &bitState, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flMultiBitPortAccessCompiled()");
 		result <<= 1;
 		if ( bitState ) {
 			result |= 1;
 		}
-		ptr++;
-		ch = *ptr++;
-	} while ( ch == ',' );
-	CHECK_STATUS(
-		ch != '\0', FL_CONF_FORMAT, cleanup,
-		"flMultiBitPortAccess(): Expecting ',' or '\\0' here:\n  %s\n  %s^", portConfig, spaces(ptr-portConfig-1));
+		pin++;
+	}
 	if ( readState ) {
 		*readState = result;
 	}
 cleanup:
 	return retVal;
 }
+
+DLLEXPORT(FLStatus) flMultiBitPortAccess(
+	struct FLContext *handle, const char *portConfig, uint32 *readState, const char **error)
+{
+	FLStatus retVal;
+	struct FLPortConfig cfg;
+	retVal = compilePins(portConfig, &cfg, error);
+	if ( retVal == FL_SUCCESS ) {
+		retVal = flMultiBitPortAccessCompiled(handle, &cfg, readState, error);
+		releaseConfig(&cfg);
+	}
+	return retVal;
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libfpgalink.h>
+#include "private.h"
+#include "hash.h"
+
+// Frames are read back this many at a time, all within a single DR scan
+#define CHUNK_FRAMES 64
+
+// 7-series JTAG instructions (6-bit IR)
+#define CFG_OUT 0x04
+#define CFG_IN  0x05
+
+// Configuration packets
+#define NOOP 0x20000000
+#define SYNC 0xAA995566
+#define WRITE_CMD 0x30008001
+#define WRITE_FAR 0x30002001
+#define READ_FDRO 0x28006000
+#define TYPE2_READ 0x48000000
+#define CMD_RCFG 0x00000004
+#define CMD_RCRC 0x00000007
+#define CMD_DESYNC 0x0000000D
+#define FLUSH_NOOPS 32
+
+// Receives frames as they're read back
+typedef void (*FrameSink)(void *cxt, uint32 firstFrame, const uint8 *frames, uint32 numFrames);
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of private functions
+// -------------------------------------------------------------------------------------------------
+
+// Load an instruction into the target FPGA, and optionally shift some configuration words into it.
+// The configuration logic expects the MSB of each word first, so the words are bit-reversed.
+//
+// Called by:
+//   readFrames() -> sendWords()
+//
+static FLStatus sendWords(
+	struct FLContext *handle, uint32 device, uint8 insn, const uint32 *words, uint32 numWords,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint8 *buf = NULL;
+	uint32 i;
+	fStatus = jtagTargetShiftIR(handle, device, &insn, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "sendWords()");
+	if ( numWords ) {
+		buf = (uint8 *)malloc(4*numWords);
+		CHECK_STATUS(!buf, FL_ALLOC_ERR, cleanup, "sendWords()");
+		for ( i = 0; i < numWords; i++ ) {
+			flWriteLong(words[i], buf + 4*i);
+		}
+		spiBitSwap(4*numWords, buf);
+		fStatus = jtagTargetShiftDR(handle, device, 32*numWords, buf, NULL, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "sendWords()");
+	}
+cleanup:
+	free((void*)buf);
+	return retVal;
+}
+
+// Read back numFrames frames starting at the given frame address, passing them to the sink
+// CHUNK_FRAMES at a time as big-endian words. The read command asks for one extra frame, because
+// the configuration logic sends a pad frame first. Then the whole readback is one long DR scan,
+// split into several pipelined shifts so it can be checked while it's still arriving.
+//
+// Called by:
+//   jtagReadback() -> readFrames()
+//   jtagScrub() -> readFrames()
+//
+static FLStatus readFrames(
+	struct FLContext *handle, uint32 device, uint32 frameAddress, uint32 numFrames,
+	FrameSink sink, void *cxt, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint32 cmd[13 + FLUSH_NOOPS];
+	const uint32 desync[] = {WRITE_CMD, CMD_DESYNC, NOOP, NOOP};
+	uint32 numAfter, done, chunk, i = 0;
+	uint8 *buf = NULL;
+	CHECK_STATUS(
+		device >= handle->chainLength, FL_BAD_STATE, cleanup,
+		"readFrames(): Device %d is not in the chain (did you call jtagChainDetect()?)", device);
+	CHECK_STATUS(
+		handle->chainIrLengths[device] != 6, FL_BAD_STATE, cleanup,
+		"readFrames(): Device %d does not have the 6-bit IR of a 7-series FPGA", device);
+	CHECK_STATUS(
+		numFrames == 0 || numFrames >= 0x07FFFFFF / FRAME_WORDS, FL_UNSUPPORTED_SIZE_ERR, cleanup,
+		"readFrames(): Cannot read back %d frames", numFrames);
+	buf = (uint8 *)malloc(CHUNK_FRAMES * FRAME_BYTES);
+	CHECK_STATUS(!buf, FL_ALLOC_ERR, cleanup, "readFrames()");
+
+	// Synchronise, reset the CRC, then ask for the frames
+	cmd[i++] = 0xFFFFFFFF;
+	cmd[i++] = SYNC;
+	cmd[i++] = NOOP;
+	cmd[i++] = WRITE_CMD;
+	cmd[i++] = CMD_RCRC;
+	cmd[i++] = NOOP;
+	cmd[i++] = NOOP;
+	cmd[i++] = WRITE_CMD;
+	cmd[i++] = CMD_RCFG;
+	cmd[i++] = WRITE_FAR;
+	cmd[i++] = frameAddress;
+	cmd[i++] = READ_FDRO;
+	cmd[i++] = TYPE2_READ | ((numFrames + 1) * FRAME_WORDS);
+	while ( i < sizeof(cmd)/sizeof(*cmd) ) {
+		cmd[i++] = NOOP;
+	}
+	fStatus = sendWords(handle, device, CFG_IN, cmd, i, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "readFrames()");
+
+	// Skip the BYPASS bits of the devices between the target and TDO, and the pad frame
+	fStatus = sendWords(handle, device, CFG_OUT, NULL, 0, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "readFrames()");
+	fStatus = jtagClockFSM(handle, 0x00000001, 3, error);  // -> Shift-DR
+	CHECK_STATUS(fStatus, fStatus, cleanup, "readFrames()");
+	numAfter = handle->chainLength - device - 1;
+	if ( numAfter ) {
+		fStatus = jtagShiftInOut(handle, numAfter, SHIFT_ZEROS, NULL, false, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "readFrames()");
+	}
+	fStatus = jtagShiftInOut(handle, FRAME_BITS, SHIFT_ZEROS, buf, false, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "readFrames()");
+
+	// Now the real frames
+	for ( done = 0; done < numFrames; done += chunk ) {
+		chunk = (numFrames - done > CHUNK_FRAMES) ? CHUNK_FRAMES : numFrames - done;
+		fStatus = jtagShiftInOut(
+			handle, chunk * FRAME_BITS, SHIFT_ZEROS, buf, done + chunk == numFrames, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "readFrames()");
+		spiBitSwap(chunk * FRAME_BYTES, buf);
+		sink(cxt, done, buf, chunk);
+	}
+	fStatus = jtagClockFSM(handle, 0x00000001, 2, error);  // -> Run-Test/Idle
+	CHECK_STATUS(fStatus, fStatus, cleanup, "readFrames()");
+
+	// Let the configuration logic go
+	fStatus = sendWords(handle, device, CFG_IN, desync, sizeof(desync)/sizeof(*desync), error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "readFrames()");
+cleanup:
+	free((void*)buf);
+	return retVal;
+}
+
+// Sink for jtagReadback(): just copy the frames out.
+//
+// Called by:
+//   readFrames() -> copySink()
+//
+static void copySink(void *cxt, uint32 firstFrame, const uint8 *frames, uint32 numFrames) {
+	memcpy((uint8 *)cxt + firstFrame * FRAME_BYTES, frames, numFrames * FRAME_BYTES);
+}
+
+// Compare a frame with its golden copy, ignoring the bits which are zero in the mask (if any). The
+// differences are accumulated without branching, eight bytes at a time, so the compiler is free to
+// vectorise the loop.
+//
+// Called by:
+//   scrubSink() -> frameDiffers()
+//
+static bool frameDiffers(const uint8 *frame, const uint8 *golden, const uint8 *mask) {
+	uint64 acc = 0, f, g, m;
+	uint32 i;
+	for ( i = 0; i + 8 <= FRAME_BYTES; i += 8 ) {
+		memcpy(&f, frame + i, 8);
+		memcpy(&g, golden + i, 8);
+		if ( mask ) {
+			memcpy(&m, mask + i, 8);
+			acc |= (f ^ g) & m;
+		} else {
+			acc |= f ^ g;
+		}
+	}
+	for ( ; i < FRAME_BYTES; i++ ) {
+		acc |= (uint8)((frame[i] ^ golden[i]) & (mask ? mask[i] : 0xFF));
+	}
+	return acc != 0;
+}
+
+// Compute the CRC-32 of a frame, with the bits which are zero in the mask (if any) cleared.
+//
+// Called by:
+//   scrubSink() -> frameCrc()
+//
+static uint32 frameCrc(const uint8 *frame, const uint8 *mask) {
+	uint8 masked[FRAME_BYTES];
+	uint32 i;
+	if ( !mask ) {
+		return hashCrc32(0, frame, FRAME_BYTES);
+	}
+	for ( i = 0; i < FRAME_BYTES; i++ ) {
+		masked[i] = frame[i] & mask[i];
+	}
+	return hashCrc32(0, masked, FRAME_BYTES);
+}
+
+// Sink for jtagScrub(): check each frame and note the bad ones.
+//
+// Called by:
+//   readFrames() -> scrubSink()
+//
+void scrubSink(void *cxt, uint32 firstFrame, const uint8 *frames, uint32 numFrames) {
+	struct ScrubContext *scrub = (struct ScrubContext *)cxt;
+	const uint8 *mask;
+	uint32 i, frame;
+	bool isBad;
+	for ( i = 0; i < numFrames; i++, frames += FRAME_BYTES ) {
+		frame = firstFrame + i;
+		mask = scrub->mask ? scrub->mask + frame * FRAME_BYTES : NULL;
+		if ( scrub->golden ) {
+			isBad = frameDiffers(frames, scrub->golden + frame * FRAME_BYTES, mask);
+		} else {
+			isBad = frameCrc(frames, mask) != scrub->goldenCrcs[frame];
+		}
+		if ( isBad ) {
+			scrub->badFrames[scrub->numBad++] = frame;
+		}
+	}
+}
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of public functions
+// -------------------------------------------------------------------------------------------------
+
+DLLEXPORT(FLStatus) jtagReadback(
+	struct FLContext *handle, uint32 device, uint32 frameAddress, uint32 numFrames,
+	uint8 *buffer, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	fStatus = readFrames(handle, device, frameAddress, numFrames, copySink, buffer, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagReadback()");
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(FLStatus) jtagScrub(
+	struct FLContext *handle, uint32 device, uint32 frameAddress, uint32 numFrames,
+	const uint8 *golden, const uint8 *mask, const uint32 *goldenCrcs,
+	uint32 *badFrames, uint32 *numBad, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	struct ScrubContext scrub;
+	CHECK_STATUS(
+		!golden && !goldenCrcs, FL_BAD_STATE, cleanup,
+		"jtagScrub(): Either golden frames or golden CRCs must be supplied");
+	scrub.golden = golden;
+	scrub.mask = mask;
+	scrub.goldenCrcs = goldenCrcs;
+	scrub.badFrames = badFrames;
+	scrub.numBad = 0;
+	fStatus = readFrames(handle, device, frameAddress, numFrames, scrubSink, &scrub, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagScrub()");
+	*numBad = scrub.numBad;
+cleanup:
+	return retVal;
+}
@@ -15,6 +15,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <stdlib.h>
+#include <string.h>
 #include <makestuff/common.h>
 #include <makestuff/libusbwrap.h>
 #include <makestuff/liberror.h>
@@ -40,6 +41,49 @@ static const uint8 swapTable[] = {
 	0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
 };
 
+// Send a stream to the micro and read the same number of bytes back, pipelined unless async
+// CommFPGA operations are using the device already. The stream goes out a chunk at a time, so
+// the reply may safely overwrite it.
+//
+// Called by:
+//   spiXfer() -> shiftInOut()
+//   spiXferBatch() -> shiftInOut()
+//
+static FLStatus shiftInOut(
+	struct FLContext *handle, const uint8 *sendData, const uint8 *lookupTable, uint8 *recvData,
+	uint32 length, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	USBStatus uStatus;
+	uint8 swapBuffer[64];
+	uint32 chunkSize, i;
+	if ( canPipeline(handle) ) {
+		fStatus = pipelinedShift(handle, sendData, lookupTable, recvData, true, length, error);
+		CHECK_STATUS(fStatus, FL_USB_ERR, cleanup, "shiftInOut()");
+	} else {
+		while ( length ) {
+			chunkSize = (length >= 64) ? 64 : length;
+			for ( i = 0; i < chunkSize; i++ ) {
+				swapBuffer[i] = lookupTable ? lookupTable[sendData[i]] : sendData[i];
+			}
+			uStatus = usbBulkWrite(
+				handle->device, handle->progOutEP, swapBuffer, chunkSize, U32MAX, error);
+			CHECK_STATUS(uStatus, FL_USB_ERR, cleanup, "shiftInOut()");
+			uStatus = usbBulkRead(
+				handle->device, handle->progInEP, recvData ? recvData : swapBuffer, chunkSize,
+				U32MAX, error);
+			CHECK_STATUS(uStatus, FL_USB_ERR, cleanup, "shiftInOut()");
+			sendData += chunkSize;
+			if ( recvData ) {
+				recvData += chunkSize;
+			}
+			length -= chunkSize;
+		}
+	}
+cleanup:
+	return retVal;
+}
+
 DLLEXPORT(void) spiBitSwap(uint32 length, uint8 *buffer) {
 	while ( length-- ) {
 		*buffer = swapTable[*buffer];
@@ -47,30 +91,68 @@ DLLEXPORT(void) spiBitSwap(uint32 length, uint8 *buffer) {
 	}
 }
 
+// Build the stream for spiXferBatch(): each transaction is a little-endian 16-bit count followed by
+// its bytes (bit-swapped if necessary), or by zeros if there's no sendData.
+//
+// Called by:
+//   spiXferBatch() -> spiBatchPack()
+//
+void spiBatchPack(
+	uint8 *stream, uint32 numSegs, const uint32 *segLengths, const uint8 *sendData,
+	uint8 bitOrder)
+{
+	uint32 i, j;
+	for ( i = 0; i < numSegs; i++ ) {
+		*stream++ = (uint8)(segLengths[i] & 0xFF);
+		*stream++ = (uint8)(segLengths[i] >> 8);
+		if ( sendData ) {
+			for ( j = 0; j < segLengths[i]; j++ ) {
+				*stream++ = (bitOrder == SPI_MSBFIRST) ? swapTable[*sendData++] : *sendData++;
+			}
+		} else {
+			memset(stream, 0x00, segLengths[i]);
+			stream += segLengths[i];
+		}
+	}
+}
+
+// Strip the counts from the stream the micro sends back, leaving just the transactions' bytes
+// (bit-swapped if necessary).
+//
+// Called by:
+//   spiXferBatch() -> spiBatchUnpack()
+//
+void spiBatchUnpack(
+	uint8 *recvData, uint32 numSegs, const uint32 *segLengths, const uint8 *stream,
+	uint8 bitOrder)
+{
+	uint32 i, j;
+	for ( i = 0; i < numSegs; i++ ) {
+		stream += 2;
+		for ( j = 0; j < segLengths[i]; j++ ) {
+			*recvData++ = (bitOrder == SPI_MSBFIRST) ? swapTable[*stream++] : *stream++;
+		}
+	}
+}
+
+// Send data over SPI. The bytes are bit-swapped (if necessary) a chunk at a time, straight into the
+// transfer buffers, several of which are kept in flight unless async CommFPGA operations are using
+// the device already.
+//
 DLLEXPORT(FLStatus) spiSend(
 	struct FLContext *handle, uint32 length, const uint8 *buffer, uint8 bitOrder, const char **error)
 {
-	FLStatus retVal = FL_SUCCESS;
+	FLStatus retVal = FL_SUCCESS, fStatus;
 	USBStatus uStatus;
-	uint8 *swapBuffer = NULL;
-	const uint8 *data = buffer;
+	const uint8 *const lookupTable = (bitOrder == SPI_MSBFIRST) ? swapTable : NULL;
+	uint8 swapBuffer[64];
+	const uint8 *data;
+	uint32 chunkSize, i;
 	union {
 		uint32 u32;
 		uint8 bytes[4];
 	} countUnion;
 
-	// Maybe make a bit-swapped copy of the data before sending it
-	if ( bitOrder == SPI_MSBFIRST ) {
-		uint32 count = length;
-		const uint8 *srcPtr = buffer;
-		uint8 *dstPtr = swapBuffer = (uint8*)malloc(length);
-		CHECK_STATUS(!swapBuffer, FL_ALLOC_ERR, cleanup, "spiSend()");
-		while ( count-- ) {
-			*dstPtr++ = swapTable[*srcPtr++];
-		}
-		data = swapBuffer;
-	}
-
 	// Request the SPI send operation
 	countUnion.u32 = littleEndian32(length);
 	uStatus = usbControlWrite(
@@ -78,43 +160,47 @@ DLLEXPORT(FLStatus) spiSend(
 		countUnion.bytes, 4, 1000, NULL);
 	CHECK_STATUS(uStatus, FL_PROTOCOL_ERR, cleanup, "spiSend(): device doesn't support SPI send");
 
-	// You have to report it as 512 bytes, but make sure you never try to do a
-	// packet larger than 64.
-	// http://permalink.gmane.org/gmane.comp.lib.libusbx.devel/1312
-	//
-	while ( length >= 64 ) {
-		uStatus = usbBulkWrite(
-			handle->device,
-			handle->progOutEP,  // write to OUT endpoint
-			data,               // write from send buffer
-			64,                 // write this many bytes
-			U32MAX,             // timeout in milliseconds
-			error
-		);
-		data += 64;
-		length -= 64;
-	}
-	if ( length ) {
-		CHECK_STATUS(uStatus, FL_USB_ERR, cleanup, "spiSend()");
-		uStatus = usbBulkWrite(
-			handle->device,
-			handle->progOutEP,  // write to OUT endpoint
-			data,               // write from send buffer
-			length,             // write this many bytes
-			U32MAX,             // timeout in milliseconds
-			error
-		);
-		CHECK_STATUS(uStatus, FL_USB_ERR, cleanup, "spiSend()");
+	if ( canPipeline(handle) ) {
+		fStatus = pipelinedShift(handle, buffer, lookupTable, NULL, false, length, error);
+		CHECK_STATUS(fStatus, FL_USB_ERR, cleanup, "spiSend()");
+	} else {
+		// You have to report it as 512 bytes, but make sure you never try to do a
+		// packet larger than 64.
+		// http://permalink.gmane.org/gmane.comp.lib.libusbx.devel/1312
+		//
+		while ( length ) {
+			chunkSize = (length >= 64) ? 64 : length;
+			if ( lookupTable ) {
+				for ( i = 0; i < chunkSize; i++ ) {
+					swapBuffer[i] = lookupTable[buffer[i]];
+				}
+				data = swapBuffer;
+			} else {
+				data = buffer;
+			}
+			uStatus = usbBulkWrite(
+				handle->device,
+				handle->progOutEP,  // write to OUT endpoint
+				data,               // write from send buffer
+				chunkSize,          // write this many bytes
+				U32MAX,             // timeout in milliseconds
+				error
+			);
+			CHECK_STATUS(uStatus, FL_USB_ERR, cleanup, "spiSend()");
+			buffer += chunkSize;
+			length -= chunkSize;
+		}
 	}
 cleanup:
-	free(swapBuffer);
 	return retVal;
 }
 
+// Receive data over SPI, pipelined in the same way as spiSend().
+//
 DLLEXPORT(FLStatus) spiRecv(
 	struct FLContext *handle, uint32 length, uint8 *buf, uint8 bitOrder, const char **error)
 {
-	FLStatus retVal = FL_SUCCESS;
+	FLStatus retVal = FL_SUCCESS, fStatus;
 	USBStatus uStatus;
 	union {
 		uint32 u32;
@@ -130,33 +216,28 @@ DLLEXPORT(FLStatus) spiRecv(
 		countUnion.bytes, 4, 1000, NULL);
 	CHECK_STATUS(uStatus, FL_PROTOCOL_ERR, cleanup, "spiRecv(): device doesn't support SPI receive");
 
-	// You have to report it as 512 bytes, but make sure you never try to do a
-	// packet larger than 64.
-	// http://permalink.gmane.org/gmane.comp.lib.libusbx.devel/1312
-	//
-	while ( count >= 64 ) {
-		uStatus = usbBulkRead(
-			handle->device,
-			handle->progInEP,  // read from IN endpoint
-			ptr,               // read into receive buffer
-			64,                // read this many bytes
-			U32MAX,            // timeout in milliseconds
-			error
-		);
-		CHECK_STATUS(uStatus, FL_USB_ERR, cleanup, "spiRecv()");
-		ptr += 64;
-		count -= 64;
-	}
-	if ( count ) {
-		uStatus = usbBulkRead(
-			handle->device,
-			handle->progInEP,  // read from IN endpoint
-			ptr,               // read into receive buffer
-			count,             // read this many bytes
-			U32MAX,            // timeout in milliseconds
-			error
-		);
-		CHECK_STATUS(uStatus, FL_USB_ERR, cleanup, "spiRecv()");
+	if ( canPipeline(handle) ) {
+		fStatus = pipelinedShift(handle, NULL, NULL, buf, true, length, error);
+		CHECK_STATUS(fStatus, FL_USB_ERR, cleanup, "spiRecv()");
+	} else {
+		// You have to report it as 512 bytes, but make sure you never try to do a
+		// packet larger than 64.
+		// http://permalink.gmane.org/gmane.comp.lib.libusbx.devel/1312
+		//
+		while ( count ) {
+			const uint32 chunkSize = (count >= 64) ? 64 : count;
+			uStatus = usbBulkRead(
+				handle->device,
+				handle->progInEP,  // read from IN endpoint
+				ptr,               // read into receive buffer
+				chunkSize,         // read this many bytes
+				U32MAX,            // timeout in milliseconds
+				error
+			);
+			CHECK_STATUS(uStatus, FL_USB_ERR, cleanup, "spiRecv()");
+			ptr += chunkSize;
+			count -= chunkSize;
+		}
 	}
 
 	// Maybe bitswap the data
@@ -169,3 +250,91 @@ DLLEXPORT(FLStatus) spiRecv(
 cleanup:
 	return retVal;
 }
+
+// Send and receive data over SPI at the same time. This is just a JTAG shift with no TMS
+// transition at the end, so any firmware can do it.
+//
+DLLEXPORT(FLStatus) spiXfer(
+	struct FLContext *handle, uint32 length, const uint8 *sendData, uint8 *recvData,
+	uint8 bitOrder, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	USBStatus uStatus;
+	union {
+		uint32 u32;
+		uint8 bytes[4];
+	} countUnion;
+
+	// Request a full-duplex shift of all the bits
+	CHECK_STATUS(
+		length > 0x1FFFFFFF, FL_BAD_STATE, cleanup,
+		"spiXfer(): Cannot transfer %u bytes at once", length);
+	countUnion.u32 = littleEndian32(length << 3);
+	uStatus = usbControlWrite(
+		handle->device, CMD_PROG_CLOCK_DATA, 0x0000, PROG_JTAG_ISSENDING_ISRECEIVING,
+		countUnion.bytes, 4, 1000, NULL);
+	CHECK_STATUS(uStatus, FL_PROTOCOL_ERR, cleanup, "spiXfer(): device doesn't support SPI");
+
+	fStatus = shiftInOut(
+		handle, sendData, (bitOrder == SPI_MSBFIRST) ? swapTable : NULL, recvData, length, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "spiXfer()");
+
+	// Maybe bitswap the data
+	if ( recvData && bitOrder == SPI_MSBFIRST ) {
+		spiBitSwap(length, recvData);
+	}
+cleanup:
+	return retVal;
+}
+
+// Run a batch of SPI transactions in one go. Each transaction goes to the micro as a 16-bit count
+// followed by its bytes; the micro selects the device with SS for each one, and sends the whole
+// stream back with the transaction bytes replaced by those clocked out of the device.
+//
+DLLEXPORT(FLStatus) spiXferBatch(
+	struct FLContext *handle, uint32 numSegs, const uint32 *segLengths, const uint8 *sendData,
+	uint8 *recvData, uint8 bitOrder, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	USBStatus uStatus;
+	uint8 *stream = NULL;
+	uint32 total = 0, i;
+	union {
+		uint32 u32;
+		uint8 bytes[4];
+	} countUnion;
+
+	// Firmware which doesn't know the op would accept it and then never reply
+	CHECK_STATUS(
+		!handle->isSpiBatchCapable, FL_PROTOCOL_ERR, cleanup,
+		"spiXferBatch(): device firmware doesn't support SPI batches");
+
+	// Build the stream: each transaction is a little-endian count followed by its data
+	for ( i = 0; i < numSegs; i++ ) {
+		CHECK_STATUS(
+			segLengths[i] == 0 || segLengths[i] > 0xFFFF, FL_BAD_STATE, cleanup,
+			"spiXferBatch(): Transaction %u has illegal length %u", i, segLengths[i]);
+		total += 2 + segLengths[i];
+	}
+	stream = (uint8 *)malloc(total);
+	CHECK_STATUS(!stream, FL_ALLOC_ERR, cleanup, "spiXferBatch()");
+	spiBatchPack(stream, numSegs, segLengths, sendData, bitOrder);
+
+	// Request the SPI batch operation
+	countUnion.u32 = littleEndian32(total);
+	uStatus = usbControlWrite(
+		handle->device, CMD_PROG_CLOCK_DATA, 0x0000, PROG_SPI_BATCH,
+		countUnion.bytes, 4, 1000, NULL);
+	CHECK_STATUS(
+		uStatus, FL_PROTOCOL_ERR, cleanup, "spiXferBatch(): device doesn't support SPI batches");
+	fStatus = shiftInOut(handle, stream, NULL, stream, total, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "spiXferBatch()");
+
+	// Strip the counts from the reply, and maybe bitswap the data
+	if ( recvData ) {
+		spiBatchUnpack(recvData, numSegs, segLengths, stream, bitOrder);
+	}
+cleanup:
+	free((void*)stream);
+	return retVal;
+}
@@ -22,6 +22,14 @@
 #include "svf2csvf.h"
 #include "xsvf.h"
 #include "private.h"
+#include "csvfstream.h"
+#include "csvfopt.h"
+#include "bits.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define HEX_SSE2
+#endif
 
 static FLStatus shiftLeft(
 	struct Buffer *buffer, uint32 numBits, uint32 shiftCount, const char **error
@@ -80,24 +88,114 @@ uint32 readLongBE(const uint8 *p) {
 	return result;
 }
 
+// Decode eight hex digits into four bytes at once, treating the digits as the lanes of a 64-bit
+// word. Returns nonzero if any of the digits is not valid hex.
+//
+static int decodeHexWord(const char *src, uint8 *dst) {
+	const uint64 ones = 0x0101010101010101ULL;
+	const uint64 high = 0x8080808080808080ULL;
+	const uint8 *const p = (const uint8 *)src;
+	const uint64 x =
+		(uint64)p[0] | ((uint64)p[1] << 8) | ((uint64)p[2] << 16) | ((uint64)p[3] << 24) |
+		((uint64)p[4] << 32) | ((uint64)p[5] << 40) | ((uint64)p[6] << 48) | ((uint64)p[7] << 56);
+	const uint64 lower = x | (ones * 0x20);
+	uint64 isDigit, isAlpha, nibbles;
+	if ( x & high ) {
+		return 1;
+	}
+	// Each lane is below 0x80, so adding (0x80 - n) sets the lane's top bit iff the lane is >= n,
+	// without carrying into its neighbour.
+	isDigit = (x + ones*(0x80 - '0')) & ~(x + ones*(0x80 - '9' - 1)) & high;
+	isAlpha = (lower + ones*(0x80 - 'a')) & ~(lower + ones*(0x80 - 'f' - 1)) & high;
+	if ( (isDigit | isAlpha) != high ) {
+		return 1;
+	}
+	nibbles = (x & (ones * 0x0F)) + (isAlpha >> 7) * 9;
+	nibbles = ((nibbles & 0x00FF00FF00FF00FFULL) << 4) | ((nibbles >> 8) & 0x00FF00FF00FF00FFULL);
+	dst[0] = (uint8)nibbles;
+	dst[1] = (uint8)(nibbles >> 16);
+	dst[2] = (uint8)(nibbles >> 32);
+	dst[3] = (uint8)(nibbles >> 48);
+	return 0;
+}
+
+// Decode numBytes bytes from twice as many hex digits. Returns nonzero on a bad digit.
+//
+static int decodeHex(const char *src, uint8 *dst, uint32 numBytes) {
+#ifdef HEX_SSE2
+	const __m128i zero = _mm_set1_epi8('0' - 1);
+	const __m128i nine = _mm_set1_epi8('9' + 1);
+	const __m128i a = _mm_set1_epi8('a' - 1);
+	const __m128i f = _mm_set1_epi8('f' + 1);
+	const __m128i caseBit = _mm_set1_epi8(0x20);
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+	const __m128i alphaOffset = _mm_set1_epi8(9);
+	const __m128i lowByte = _mm_set1_epi16(0x00FF);
+	while ( numBytes >= 8 ) {
+		// Signed compares are fine: anything from 0x80 up looks negative, so it's rejected
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		const __m128i lower = _mm_or_si128(x, caseBit);
+		const __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(x, zero), _mm_cmplt_epi8(x, nine));
+		const __m128i isAlpha = _mm_and_si128(_mm_cmpgt_epi8(lower, a), _mm_cmplt_epi8(lower, f));
+		__m128i nibbles;
+		if ( _mm_movemask_epi8(_mm_or_si128(isDigit, isAlpha)) != 0xFFFF ) {
+			return 1;
+		}
+		nibbles = _mm_add_epi8(_mm_and_si128(x, nibbleMask), _mm_and_si128(isAlpha, alphaOffset));
+		nibbles = _mm_or_si128(
+			_mm_slli_epi16(_mm_and_si128(nibbles, lowByte), 4), _mm_srli_epi16(nibbles, 8));
+		_mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(nibbles, nibbles));
+		src += 16;
+		dst += 8;
+		numBytes -= 8;
+	}
+#endif
+	while ( numBytes >= 4 ) {
+		if ( decodeHexWord(src, dst) ) {
+			return 1;
+		}
+		src += 8;
+		dst += 4;
+		numBytes -= 4;
+	}
+	while ( numBytes-- ) {
+		if ( getHexByte(src, dst++) ) {
+			return 1;
+		}
+		src += 2;
+	}
+	return 0;
+}
+
 FLStatus readBytes(
 	struct Buffer *buffer, const char *hexDigits, const char **error)
 {
-	FLStatus retVal = FL_SUCCESS;
-	uint32 length = (uint32)strlen(hexDigits);
-	uint8 *p = buffer->data;
-	BufferStatus bStatus;
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	const uint32 length = (uint32)strlen(hexDigits);
 	CHECK_STATUS(
 		length & 1, FL_SVF_PARSE_ERR, cleanup,
 		"readBytes(): I need an even number of hex digits");
+	fStatus = readHexDigits(buffer, hexDigits, length, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "readBytes()");
+cleanup:
+	return retVal;
+}
+
+FLStatus readHexDigits(
+	struct Buffer *buffer, const char *hexDigits, uint32 numDigits, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	uint8 *p;
 	bufZeroLength(buffer);
-	length >>= 1;  // Number of bytes
-	bStatus = bufAppendConst(buffer, 0x00, length, error);
-	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "readBytes()");
-	while ( length-- ) {
-		CHECK_STATUS(getHexByte(hexDigits, p++), FL_SVF_PARSE_ERR, cleanup, "readBytes()");
-		hexDigits += 2;
+	bStatus = bufAppendConst(buffer, 0x00, (numDigits + 1) >> 1, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "readHexDigits()");
+	p = buffer->data;
+	if ( numDigits & 1 ) {
+		// An odd number of digits has an implicit leading zero
+		CHECK_STATUS(getHexNibble(*hexDigits++, p++), FL_SVF_PARSE_ERR, cleanup, "readHexDigits()");
 	}
+	CHECK_STATUS(decodeHex(hexDigits, p, numDigits >> 1), FL_SVF_PARSE_ERR, cleanup, "readHexDigits()");
 cleanup:
 	return retVal;
 }
@@ -108,40 +206,31 @@ static FLStatus shiftLeft(
 	FLStatus retVal = FL_SUCCESS;
 	uint32 shiftBytes = shiftCount>>3;
 	uint32 shiftBits = shiftCount&7;
-	uint16 accum;
-	const uint8 *p = buffer->data;
-	const uint8 *const end = buffer->data + buffer->length;
+	const uint8 *const p = buffer->data;
+	const uint32 length = (uint32)buffer->length;
+	uint8 *dst;
 	struct Buffer newBuffer = {0,};
 	BufferStatus bStatus;
 	if ( shiftBits ) {
-		bStatus = bufInitialise(&newBuffer, 1024, 0x00, error);
+		bStatus = bufInitialise(&newBuffer, length + 1, 0x00, error);
 		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "shiftLeft()");
-		numBits &= 7;  // Now the number of significant bits in first byte.
-		if ( numBits ) {
-			numBits = 8 - numBits; // Now the number of insignificant bits in first byte.
-		}
-		accum = p[0];
-		if ( p < end ) {
-			accum = (uint16)(accum >> (8-shiftBits));
+		bStatus = bufAppendConst(&newBuffer, 0x00, length + 1, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "shiftLeft()");
+		dst = newBuffer.data;
+		if ( length ) {
+			numBits &= 7;  // Now the number of significant bits in first byte.
+			if ( numBits ) {
+				numBits = 8 - numBits; // Now the number of insignificant bits in first byte.
+			}
 			if ( shiftBits > numBits ) {
 				// We're shifting by more than the number of insignificant bits
-				bStatus = bufAppendByte(&newBuffer, (uint8)(accum&0xFF), error);
-				CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "shiftLeft()");
-			}
-			accum = (uint16)((p[0]<<8) + p[1]);
-			p++;
-			while ( p < end ) {
-				accum = (uint16)(accum >> (8-shiftBits));
-				bStatus = bufAppendByte(&newBuffer, (uint8)(accum&0xFF), error);
-				CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "shiftLeft()");
-				accum = (uint16)((p[0]<<8) + p[1]);
-				p++;
+				*dst++ = (uint8)(p[0] >> (8-shiftBits));
+			} else {
+				newBuffer.length--;
 			}
+			bitFunnelMsb(dst, p, length - 1, shiftBits);
+			dst[length - 1] = (uint8)(p[length - 1] << shiftBits);
 		}
-		accum &= 0xFF00;
-		accum = (uint16)(accum >> (8-shiftBits));
-		bStatus = bufAppendByte(&newBuffer, (uint8)(accum&0xFF), error);
-		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "shiftLeft()");
 		bufSwap(&newBuffer, buffer);
 	}
 	if ( shiftBytes ) {
@@ -360,13 +449,16 @@ static FLStatus appendSwappedAndInterleaved(
 {
 	FLStatus retVal = FL_SUCCESS;
 	BufferStatus bStatus;
+	const size_t offset = buf->length;
 	const uint8 *tdiPtr = tdi + count - 1;
 	const uint8 *expPtr = exp + count - 1;
+	uint8 *dst;
+	bStatus = bufAppendConst(buf, 0x00, 2*(size_t)count, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "appendSwappedAndInterleaved()");
+	dst = buf->data + offset;
 	while ( count-- ) {
-		bStatus = bufAppendByte(buf, *tdiPtr--, error);
-		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "appendSwapped()");
-		bStatus = bufAppendByte(buf, *expPtr--, error);
-		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "appendSwapped()");
+		*dst++ = *tdiPtr--;
+		*dst++ = *expPtr--;
 	}
 cleanup:
 	return retVal;
@@ -377,10 +469,14 @@ static FLStatus appendSwapped(
 {
 	FLStatus retVal = FL_SUCCESS;
 	BufferStatus bStatus;
+	const size_t offset = buf->length;
+	uint8 *dst;
+	bStatus = bufAppendConst(buf, 0x00, count, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "appendSwapped()");
+	dst = buf->data + offset;
 	src += count - 1;
 	while ( count-- ) {
-		bStatus = bufAppendByte(buf, *src--, error);
-		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "appendSwapped()");
+		*dst++ = *src--;
 	}
 cleanup:
 	return retVal;
@@ -875,34 +971,13 @@ cleanup:
 	return retVal;
 }
 
-DLLEXPORT(FLStatus) flLoadSvfAndConvertToCsvf(
-	const char *svfFile, struct Buffer *csvfBuf, uint32 *maxBufSize, const char **error)
-{
-	FLStatus retVal = FL_SUCCESS;
-	struct Buffer lineBuf = {0,};
-	BufferStatus bStatus;
-	FLStatus fStatus;
-	const uint8 *buffer = NULL, *p, *end, *line;
-	size_t fileLength;
+uint8 *svfNextStatement(uint8 **cursor, const uint8 *end, size_t *length) {
+	uint8 *p = *cursor, *line, *stmt = NULL, *wr = NULL;
 	bool gotSemicolon;
-	struct ParseContext cxt = {0,};
 
-	// Initialise context and line buffer
-	fStatus = cxtInitialise(&cxt, error);
-	CHECK_STATUS(fStatus, fStatus, cleanup, "flLoadSvfAndConvertToCsvf()");
-	bStatus = bufInitialise(&lineBuf, 1024, 0x00, error);
-	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvf()");
-
-	// Load SVF file
-	buffer = flLoadFile(svfFile, &fileLength);
-	if ( !buffer ) {
-		//errRender(error, "flLoadSvfAndConvertToCsvf(): Unable to load SVF file %s", svfFile);
-		errRenderStd(error);
-		errPrefix(error, "flLoadSvfAndConvertToCsvf()");
-		FAIL_RET(FL_FILE_ERR, cleanup);
-	}
-	end = buffer + fileLength;
-	p = buffer;
+	// Statements are parsed in place. Those spanning several lines are joined by moving each new
+	// fragment down to the end of the statement so far; that only ever moves text backwards over
+	// line-endings and whitespace which have already been consumed.
 	while ( p < end ) {
 		if ( p[0] == '\n' || p[0] == '\r' ) {
 			p++;
@@ -930,22 +1005,66 @@ DLLEXPORT(FLStatus) flLoadSvfAndConvertToCsvf(
 					p--;
 				} while ( *p == ' ' || *p == '\t' );
 				p++; // go back to first space char
-				bStatus = bufAppendBlock(&lineBuf, line, (uint32)(p - line), error);
-				CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvf()");
+				if ( !stmt ) {
+					stmt = wr = line;
+				} else if ( wr != line ) {
+					memmove(wr, line, (size_t)(p - line));
+				}
+				wr += p - line;
 				while ( p < end && *p != '\n' && *p != '\r' ) {
 					p++;
 				}
 				p++; // Skip over CR
 				if ( gotSemicolon ) {
-					bStatus = bufAppendByte(&lineBuf, '\0', error);
-					CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvf()");
-					fStatus = parseLine(&cxt, &lineBuf, csvfBuf, maxBufSize, error);
-					CHECK_STATUS(fStatus, fStatus, cleanup, "flLoadSvfAndConvertToCsvf()");
-					bufZeroLength(&lineBuf);
+					*wr++ = '\0';
+					*cursor = p;
+					*length = (size_t)(wr - stmt);
+					return stmt;
 				}
 			}
 		}
 	}
+	*cursor = p;
+	return NULL;
+}
+
+DLLEXPORT(FLStatus) flLoadSvfAndConvertToCsvf(
+	const char *svfFile, struct Buffer *csvfBuf, uint32 *maxBufSize, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS;
+	struct Buffer stmtBuf = {0,};  // just a view of the statement being parsed
+	BufferStatus bStatus;
+	FLStatus fStatus;
+	uint8 *buffer = NULL, *p, *end;
+	size_t fileLength, initLength;
+	struct ParseContext cxt = {0,};
+
+	// Initialise context
+	fStatus = cxtInitialise(&cxt, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flLoadSvfAndConvertToCsvf()");
+
+	// Load SVF file
+	buffer = flLoadFile(svfFile, &fileLength);
+	if ( !buffer ) {
+		//errRender(error, "flLoadSvfAndConvertToCsvf(): Unable to load SVF file %s", svfFile);
+		errRenderStd(error);
+		errPrefix(error, "flLoadSvfAndConvertToCsvf()");
+		FAIL_RET(FL_FILE_ERR, cleanup);
+	}
+
+	// Every CSVF data byte comes from two hex digits, so half the file size is plenty; grow the
+	// output buffer to that once up front, rather than repeatedly as the commands are appended.
+	initLength = csvfBuf->length;
+	bStatus = bufAppendConst(csvfBuf, 0x00, fileLength/2, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvf()");
+	csvfBuf->length = initLength;
+
+	end = buffer + fileLength;
+	p = buffer;
+	while ( (stmtBuf.data = svfNextStatement(&p, end, &stmtBuf.length)) != NULL ) {
+		fStatus = parseLine(&cxt, &stmtBuf, csvfBuf, maxBufSize, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flLoadSvfAndConvertToCsvf()");
+	}
 	bStatus = bufAppendByte(csvfBuf, XCOMPLETE, error);
 	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvf()");
 	cxt.numCommands++;
@@ -954,7 +1073,157 @@ DLLEXPORT(FLStatus) flLoadSvfAndConvertToCsvf(
 	CHECK_STATUS(fStatus, fStatus, cleanup, "flLoadSvfAndConvertToCsvf()");
 cleanup:
 	cxtDestroy(&cxt);
-	bufDestroy(&lineBuf);
-	flFreeFile((void*)buffer);
+	flFreeFile(buffer);
+	return retVal;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Streaming conversion
+// -------------------------------------------------------------------------------------------------
+
+// Does the same reordering as processIndex(), but a command at a time: each group of commands up
+// to and including a shift is held back until the next command shows whether a RUNTEST follows
+// the shift, and so needs hoisting in front of it.
+//
+struct Reorder {
+	struct Buffer group;
+	bool haveShift;
+	uint32 oldrt;
+	struct Buffer *out;
+};
+
+// Called by:
+//   reorderCommand() -> reorderFlush()
+//   svfStream() -> reorderFlush()
+//
+static FLStatus reorderFlush(struct Reorder *r, const uint8 *runTest, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	const uint32 newrt = readLongBE(runTest + 1);
+	if ( newrt != r->oldrt ) {
+		bStatus = bufAppendBlock(r->out, runTest, 5, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "reorderFlush()");
+		r->oldrt = newrt;
+	}
+	bStatus = bufAppendBlock(r->out, r->group.data, r->group.length, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "reorderFlush()");
+	r->group.length = 0;
+	r->haveShift = false;
+cleanup:
+	return retVal;
+}
+
+// Called by:
+//   svfStream() -> reorderCommand()
+//
+static FLStatus reorderCommand(
+	struct Reorder *r, const uint8 *cmd, uint32 length, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	if ( r->haveShift && cmd[0] == XRUNTEST ) {
+		// Hoist it in front of the shift it follows
+		fStatus = reorderFlush(r, cmd, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "reorderCommand()");
+	} else {
+		if ( r->haveShift ) {
+			fStatus = reorderFlush(r, xrtZero, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "reorderCommand()");
+		}
+		bStatus = bufAppendBlock(&r->group, cmd, length, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "reorderCommand()");
+		r->haveShift = (cmd[0] == XSIR || cmd[0] == XSDR || cmd[0] == XSDRTDO);
+	}
+cleanup:
+	return retVal;
+}
+
+uint32 csvfCommandLength(const uint8 *cmd, uint32 *xsdrBytes) {
+	switch ( cmd[0] ) {
+	case XSDRSIZE:
+		*xsdrBytes = bitsToBytes(readLongBE(cmd + 1));
+		return 5;
+	case XRUNTEST:
+		return 5;
+	case XTDOMASK:
+	case XSDR:
+		return 1 + *xsdrBytes;
+	case XSDRTDO:
+		return 1 + 2 * *xsdrBytes;
+	case XSIR:
+		return 2 + bitsToBytes(cmd[1]);
+	default:
+		return 1;
+	}
+}
+
+FLStatus svfStream(
+	const char *svfFile, struct CsvfSink *sink, size_t blockSize, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	struct ParseContext cxt = {0,};
+	struct Reorder reorder = {{0,}, false, 0, NULL};
+	struct Buffer stmtBuf = {0,};  // just a view of the statement being parsed
+	struct Buffer cmdBuf = {0,};
+	struct Buffer block = {0,};
+	struct CsvfOptSink optSink = {{NULL}, NULL, {0,}, {0,}};
+	uint8 *buffer = NULL, *p, *end;
+	const uint8 *cmd, *cmdEnd;
+	size_t fileLength;
+	uint32 xsdrBytes = 0, length;
+
+	fStatus = cxtInitialise(&cxt, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "svfStream()");
+	fStatus = csvfOptSinkInit(&optSink, sink, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "svfStream()");
+	sink = &optSink.sink;
+	bStatus = bufInitialise(&cmdBuf, 1024, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "svfStream()");
+	bStatus = bufInitialise(&block, blockSize + 1024, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "svfStream()");
+	bStatus = bufInitialise(&reorder.group, 1024, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "svfStream()");
+	reorder.oldrt = illegal32;
+	reorder.out = &block;
+
+	buffer = flLoadFile(svfFile, &fileLength);
+	if ( !buffer ) {
+		errRenderStd(error);
+		errPrefix(error, "svfStream()");
+		FAIL_RET(FL_FILE_ERR, cleanup);
+	}
+	end = buffer + fileLength;
+	p = buffer;
+	while ( (stmtBuf.data = svfNextStatement(&p, end, &stmtBuf.length)) != NULL ) {
+		cmdBuf.length = 0;
+		fStatus = parseLine(&cxt, &stmtBuf, &cmdBuf, NULL, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "svfStream()");
+		cmd = cmdBuf.data;
+		cmdEnd = cmd + cmdBuf.length;
+		while ( cmd < cmdEnd ) {
+			length = csvfCommandLength(cmd, &xsdrBytes);
+			fStatus = reorderCommand(&reorder, cmd, length, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "svfStream()");
+			cmd += length;
+		}
+		if ( block.length >= blockSize ) {
+			fStatus = sink->put(sink, &block, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "svfStream()");
+		}
+	}
+	fStatus = reorderFlush(&reorder, xrtZero, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "svfStream()");
+	bStatus = bufAppendByte(&block, XCOMPLETE, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "svfStream()");
+	fStatus = sink->put(sink, &block, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "svfStream()");
+cleanup:
+	cxtDestroy(&cxt);
+	csvfOptSinkDestroy(&optSink);
+	bufDestroy(&reorder.group);
+	bufDestroy(&cmdBuf);
+	bufDestroy(&block);
+	flFreeFile(buffer);
 	return retVal;
-}	
+}
@@ -56,6 +56,16 @@ extern "C" {
 	FLStatus readBytes(
 		struct Buffer *buffer, const char *hexDigits, const char **error
 	) WARN_UNUSED_RESULT;
+
+	// Like readBytes(), but for numDigits digits which need not be NUL-terminated, nor even.
+	FLStatus readHexDigits(
+		struct Buffer *buffer, const char *hexDigits, uint32 numDigits, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Return the next statement in the SVF text from *cursor up to end, NUL-terminated in place
+	// with its length (including the NUL) in *length, or NULL if there are no more. Comments and
+	// the unsupported commands are skipped, and multi-line statements are joined.
+	uint8 *svfNextStatement(uint8 **cursor, const uint8 *end, size_t *length);
 	
 	FLStatus cxtInitialise(
 		struct ParseContext *cxt, const char **error
@@ -77,6 +87,18 @@ extern "C" {
 	const char *getCmdName(CmdPtr cmd);
 	uint32 readLongBE(const uint8 *p);
 
+	// The length of one CSVF command. The byte-count of the current XSDRSIZE is needed for shifts,
+	// and is updated if the command is itself an XSDRSIZE.
+	uint32 csvfCommandLength(const uint8 *cmd, uint32 *xsdrBytes);
+
+	// Convert an SVF file, sending the CSVF on to the sink in blocks of roughly blockSize bytes,
+	// as it's produced, optimised for playing. The result is the same as flLoadSvfAndConvertToCsvf()
+	// followed by csvfOptimiseBuffer() would give.
+	struct CsvfSink;
+	FLStatus svfStream(
+		const char *svfFile, struct CsvfSink *sink, size_t blockSize, const char **error
+	) WARN_UNUSED_RESULT;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/liberror.h>
+#include "svf2csvf.h"
+#include "csvfopt.h"
+#include "xsvf.h"
+#include "thread.h"
+#include "private.h"
+
+// SVF statements are independent apart from the state remembered in the ParseContext. The file is
+// therefore split into one chunk per thread at statement boundaries, and a quick sequential pass
+// works out the remembered state at the start of each chunk, without decoding any hex data. The
+// chunks are then converted concurrently and their CSVF concatenated.
+//
+// The only state not recovered is which TDO mask was last sent, so each chunk may begin by
+// resending an XTDOMASK which is already in effect. That changes nothing on the TAP, and once
+// csvfOptimiseBuffer() has dropped it the result is byte-for-byte what a single-threaded
+// conversion gives.
+
+// A hex string in the SVF text, which is left alone by parseLine() (it only overwrites the
+// surrounding parentheses), so workers may decode it whilst another thread parses its statement.
+struct HexSpan {
+	const char *digits;  // NULL if not given
+	uint32 numDigits;
+};
+
+// What a HIR/HDR/SIR/SDR/TIR/TDR statement leaves behind for the next of its kind
+struct StickyReg {
+	uint32 numBits;
+	struct HexSpan tdi;
+	struct HexSpan tdo;
+	struct HexSpan mask;
+};
+
+// In the same order as the BitStores in ParseContext
+typedef enum {
+	DATA_HEAD, INSN_HEAD, DATA_BODY, INSN_BODY, DATA_TAIL, INSN_TAIL, NUM_REGS
+} RegIndex;
+
+struct Sticky {
+	struct StickyReg reg[NUM_REGS];
+	uint32 curLength;
+};
+
+struct Statement {
+	uint8 *text;
+	size_t length;  // including the NUL
+};
+
+struct Chunk {
+	const struct Statement *stmts;
+	size_t numStmts;
+	struct Sticky sticky;
+	struct Buffer csvfBuf;
+	uint32 maxBufSize;
+	uint32 numCommands;
+	bool wantError;
+	const char *error;
+	FLStatus status;
+};
+
+// Find a "(<hex>)" value in a shift statement. Anything malformed is left for parseLine() to
+// report, so this just gives up.
+//
+// Called by:
+//   trackStatement() -> getSpan()
+//
+static const char *getSpan(const char *p, struct HexSpan *span) {
+	const char *close;
+	CHOMP();
+	if ( *p != '(' ) {
+		return NULL;
+	}
+	p++;
+	close = strchr(p, ')');
+	if ( !close ) {
+		return NULL;
+	}
+	span->digits = p;
+	span->numDigits = (uint32)(close - p);
+	return close + 1;
+}
+
+// Update the remembered state after a statement, following the same rules as processLine().
+//
+// Called by:
+//   flLoadSvfAndConvertToCsvfParallel() -> trackStatement()
+//
+static void trackStatement(struct Sticky *sticky, const char *line) {
+	const char *p = line + 3;
+	char *tmp;
+	struct HexSpan tdi = {NULL, 0}, tdo = {NULL, 0}, mask = {NULL, 0}, smask;
+	struct HexSpan *span;
+	struct StickyReg *reg;
+	uint32 length;
+	RegIndex index;
+	if (
+		!(line[0] == 'H' || line[0] == 'S' || line[0] == 'T') ||
+		!(line[1] == 'I' || line[1] == 'D') ||
+		line[2] != 'R' || !(line[3] == ' ' || line[3] == '\t')
+	) {
+		return;
+	}
+	index = (line[0] == 'H') ? DATA_HEAD : (line[0] == 'S') ? DATA_BODY : DATA_TAIL;
+	if ( line[1] == 'I' ) {
+		index++;
+	}
+	CHOMP();
+	length = (uint32)strtoul(p, &tmp, 10);
+	p = tmp;
+	CHOMP();
+	while ( p && *p ) {
+		if ( !strncmp(p, "TDI", 3) ) {
+			p += 3;
+			span = &tdi;
+		} else if ( !strncmp(p, "SMASK", 5) ) {
+			p += 5;
+			span = &smask;
+		} else if ( !strncmp(p, "TDO", 3) ) {
+			p += 3;
+			span = &tdo;
+		} else if ( !strncmp(p, "MASK", 4) ) {
+			p += 4;
+			span = &mask;
+		} else {
+			break;
+		}
+		p = getSpan(p, span);
+		if ( p ) {
+			CHOMP();
+		}
+	}
+	reg = sticky->reg + index;
+	if ( reg->numBits != length ) {
+		reg->tdi.digits = NULL;
+		reg->mask.digits = NULL;
+	}
+	reg->numBits = length;
+	reg->tdo = tdo;
+	if ( tdi.digits ) {
+		reg->tdi = tdi;
+	}
+	if ( mask.digits ) {
+		reg->mask = mask;
+	}
+	if ( index == DATA_BODY ) {
+		sticky->curLength =
+			sticky->reg[DATA_HEAD].numBits + sticky->reg[DATA_BODY].numBits +
+			sticky->reg[DATA_TAIL].numBits;
+	}
+}
+
+// Decode a span into a buffer already sized for its register.
+//
+// Called by:
+//   seedStore() -> seedBuffer()
+//
+static FLStatus seedBuffer(
+	struct Buffer *buf, uint32 numBits, uint8 fill, const struct HexSpan *span,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	bufZeroLength(buf);
+	if ( numBits ) {
+		bStatus = bufAppendConst(buf, fill, bitsToBytes(numBits), error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "seedBuffer()");
+	}
+	if ( span->digits ) {
+		fStatus = readHexDigits(buf, span->digits, span->numDigits, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "seedBuffer()");
+	}
+cleanup:
+	return retVal;
+}
+
+// Called by:
+//   convertChunk() -> seedStore()
+//
+static FLStatus seedStore(struct BitStore *store, const struct StickyReg *reg, const char **error) {
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	store->numBits = reg->numBits;
+	fStatus = seedBuffer(&store->tdi, reg->numBits, 0x00, &reg->tdi, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "seedStore()");
+	fStatus = seedBuffer(&store->tdo, reg->numBits, 0x00, &reg->tdo, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "seedStore()");
+	fStatus = seedBuffer(&store->mask, reg->numBits, 0xFF, &reg->mask, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "seedStore()");
+cleanup:
+	return retVal;
+}
+
+// Convert one chunk of statements, starting from the state the pre-pass found for it. Runs on a
+// worker thread, so the result and any error are left in the chunk.
+//
+// Called by:
+//   flLoadSvfAndConvertToCsvfParallel() -> convertChunk()
+//
+static void convertChunk(void *arg) {
+	struct Chunk *const chunk = (struct Chunk *)arg;
+	const char **const error = chunk->wantError ? &chunk->error : NULL;
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	struct ParseContext cxt = {0,};
+	struct BitStore *const stores[NUM_REGS] = {
+		&cxt.dataHead, &cxt.insnHead, &cxt.dataBody, &cxt.insnBody, &cxt.dataTail, &cxt.insnTail
+	};
+	struct Buffer stmtBuf = {0,};  // just a view of the statement being parsed
+	size_t i;
+	fStatus = cxtInitialise(&cxt, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "convertChunk()");
+	for ( i = 0; i < NUM_REGS; i++ ) {
+		fStatus = seedStore(stores[i], chunk->sticky.reg + i, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "convertChunk()");
+	}
+	cxt.curLength = chunk->sticky.curLength;
+	for ( i = 0; i < chunk->numStmts; i++ ) {
+		stmtBuf.data = chunk->stmts[i].text;
+		stmtBuf.length = chunk->stmts[i].length;
+		fStatus = parseLine(&cxt, &stmtBuf, &chunk->csvfBuf, &chunk->maxBufSize, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "convertChunk()");
+	}
+	chunk->numCommands = cxt.numCommands;
+cleanup:
+	cxtDestroy(&cxt);
+	chunk->status = retVal;
+}
+
+DLLEXPORT(FLStatus) flLoadSvfAndConvertToCsvfParallel(
+	const char *svfFile, struct Buffer *csvfBuf, uint32 *maxBufSize, uint32 numThreads,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	BufferStatus bStatus;
+	uint8 *buffer = NULL, *p, *end;
+	size_t fileLength, initLength, totalLength;
+	struct Buffer stmtList = {0,};
+	struct Statement stmt;
+	struct Sticky sticky;
+	struct Chunk *chunks = NULL;
+	struct Thread *threads = NULL;
+	struct ParseContext cxt = {0,};
+	uint32 numChunks = 0, numStarted = 0, i, c;
+	size_t numStmts = 0;
+
+	// Like flLoadXsvfAndConvertToCsvf(), give the size for this file alone
+	if ( maxBufSize ) {
+		*maxBufSize = 0;
+	}
+	if ( numThreads == 0 ) {
+		numThreads = threadNumCores();
+	}
+	if ( numThreads == 1 ) {
+		fStatus = flLoadSvfAndConvertToCsvf(svfFile, csvfBuf, maxBufSize, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flLoadSvfAndConvertToCsvfParallel()");
+		goto cleanup;
+	}
+
+	// Load SVF file
+	buffer = flLoadFile(svfFile, &fileLength);
+	if ( !buffer ) {
+		errRenderStd(error);
+		errPrefix(error, "flLoadSvfAndConvertToCsvfParallel()");
+		FAIL_RET(FL_FILE_ERR, cleanup);
+	}
+	chunks = (struct Chunk *)calloc(numThreads, sizeof(struct Chunk));
+	CHECK_STATUS(!chunks, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvfParallel()");
+	threads = (struct Thread *)calloc(numThreads, sizeof(struct Thread));
+	CHECK_STATUS(!threads, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvfParallel()");
+	bStatus = bufInitialise(&stmtList, 1024*sizeof(struct Statement), 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvfParallel()");
+
+	// Sequential pre-pass: split into statements, dividing them into chunks of roughly equal
+	// size, and note the remembered state at the start of each chunk.
+	memset(&sticky, 0, sizeof(sticky));
+	end = buffer + fileLength;
+	p = buffer;
+	while ( (stmt.text = svfNextStatement(&p, end, &stmt.length)) != NULL ) {
+		c = (uint32)((uint64)(stmt.text - buffer) * numThreads / fileLength);
+		if ( numChunks == 0 || c >= numChunks ) {
+			chunks[numChunks].sticky = sticky;
+			chunks[numChunks].numStmts = numStmts;  // index of first statement, for now
+			numChunks++;
+		}
+		bStatus = bufAppendBlock(&stmtList, (const uint8 *)&stmt, sizeof(stmt), error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvfParallel()");
+		numStmts++;
+		trackStatement(&sticky, (const char *)stmt.text);
+	}
+	for ( i = 0; i < numChunks; i++ ) {
+		const size_t first = chunks[i].numStmts;
+		const size_t next = (i + 1 < numChunks) ? chunks[i + 1].numStmts : numStmts;
+		chunks[i].stmts = (const struct Statement *)stmtList.data + first;
+		chunks[i].numStmts = next - first;
+		chunks[i].wantError = (error != NULL);
+		bStatus = bufInitialise(
+			&chunks[i].csvfBuf, (size_t)((uint64)fileLength / 2 / numChunks) + 1024, 0x00, error);
+		CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvfParallel()");
+	}
+
+	// Convert the chunks; the first on this thread
+	for ( i = 1; i < numChunks; i++ ) {
+		fStatus = threadCreate(threads + i, convertChunk, chunks + i, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "flLoadSvfAndConvertToCsvfParallel()");
+		numStarted = i;
+	}
+	if ( numChunks ) {
+		convertChunk(chunks);
+	}
+	for ( i = 1; i <= numStarted; i++ ) {
+		threadJoin(threads + i);
+	}
+	numStarted = 0;
+
+	// Concatenate the results
+	totalLength = 0;
+	for ( i = 0; i < numChunks; i++ ) {
+		if ( chunks[i].status ) {
+			if ( error ) {
+				*error = chunks[i].error;
+				chunks[i].error = NULL;
+			}
+			CHECK_STATUS(
+				chunks[i].status, chunks[i].status, cleanup,
+				"flLoadSvfAndConvertToCsvfParallel()");
+		}
+		totalLength += chunks[i].csvfBuf.length;
+	}
+	initLength = csvfBuf->length;
+	bStatus = bufAppendConst(csvfBuf, 0x00, totalLength + 1, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flLoadSvfAndConvertToCsvfParallel()");
+	p = csvfBuf->data + initLength;
+	for ( i = 0; i < numChunks; i++ ) {
+		memcpy(p, chunks[i].csvfBuf.data, chunks[i].csvfBuf.length);
+		p += chunks[i].csvfBuf.length;
+		cxt.numCommands += chunks[i].numCommands;
+		if ( maxBufSize && chunks[i].maxBufSize > *maxBufSize ) {
+			*maxBufSize = chunks[i].maxBufSize;
+		}
+	}
+	*p = XCOMPLETE;
+	cxt.numCommands++;
+
+	// Only the command count is needed for reordering
+	fStatus = buildIndex(&cxt, csvfBuf, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flLoadSvfAndConvertToCsvfParallel()");
+cleanup:
+	for ( i = 1; i <= numStarted; i++ ) {
+		threadJoin(threads + i);
+	}
+	if ( chunks ) {
+		for ( i = 0; i < numChunks; i++ ) {
+			bufDestroy(&chunks[i].csvfBuf);
+			if ( chunks[i].error ) {
+				errFree(chunks[i].error);
+			}
+		}
+		free((void*)chunks);
+	}
+	free((void*)threads);
+	bufDestroy(&stmtList);
+	flFreeFile(buffer);
+	return retVal;
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include "thread.h"
+
+#ifdef WIN32
+	static DWORD WINAPI trampoline(LPVOID arg) {
+		struct Thread *const thread = (struct Thread *)arg;
+		thread->func(thread->arg);
+		return 0;
+	}
+#else
+	#include <time.h>
+	#include <unistd.h>
+	static void *trampoline(void *arg) {
+		struct Thread *const thread = (struct Thread *)arg;
+		thread->func(thread->arg);
+		return NULL;
+	}
+#endif
+
+FLStatus threadCreate(struct Thread *thread, ThreadFunc func, void *arg, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	thread->func = func;
+	thread->arg = arg;
+	#ifdef WIN32
+		thread->handle = CreateThread(NULL, 0, trampoline, thread, 0, NULL);
+		CHECK_STATUS(
+			thread->handle == NULL, FL_ALLOC_ERR, cleanup,
+			"threadCreate(): Unable to start a thread");
+	#else
+		CHECK_STATUS(
+			pthread_create(&thread->handle, NULL, trampoline, thread), FL_ALLOC_ERR, cleanup,
+			"threadCreate(): Unable to start a thread");
+	#endif
+cleanup:
+	return retVal;
+}
+
+void threadJoin(struct Thread *thread) {
+	#ifdef WIN32
+		WaitForSingleObject(thread->handle, INFINITE);
+		CloseHandle(thread->handle);
+	#else
+		pthread_join(thread->handle, NULL);
+	#endif
+}
+
+uint32 threadNumCores(void) {
+	#ifdef WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwNumberOfProcessors ? (uint32)info.dwNumberOfProcessors : 1;
+	#else
+		const long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+		return numCores > 0 ? (uint32)numCores : 1;
+	#endif
+}
+
+double threadNow(void) {
+	#ifdef WIN32
+		LARGE_INTEGER freq, count;
+		QueryPerformanceFrequency(&freq);
+		QueryPerformanceCounter(&count);
+		return (double)count.QuadPart / (double)freq.QuadPart;
+	#else
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+	#endif
+}
+
+uint32 threadUniqueId(void) {
+	#ifdef WIN32
+		static volatile LONG counter = 0;
+		return (uint32)InterlockedIncrement(&counter);
+	#else
+		static volatile uint32 counter = 0;
+		return __sync_add_and_fetch(&counter, 1);
+	#endif
+}
+
+uint32 threadAtomicGet(volatile uint32 *flag) {
+	#ifdef WIN32
+		return (uint32)InterlockedCompareExchange((volatile LONG *)flag, 0, 0);
+	#else
+		return __sync_add_and_fetch(flag, 0);
+	#endif
+}
+
+void threadAtomicSet(volatile uint32 *flag, uint32 value) {
+	#ifdef WIN32
+		InterlockedExchange((volatile LONG *)flag, (LONG)value);
+	#else
+		__sync_lock_test_and_set(flag, value);
+		__sync_synchronize();
+	#endif
+}
+
+void mutexInit(struct Mutex *mutex) {
+	#ifdef WIN32
+		InitializeCriticalSection(&mutex->cs);
+	#else
+		pthread_mutex_init(&mutex->mutex, NULL);
+	#endif
+}
+
+void mutexDestroy(struct Mutex *mutex) {
+	#ifdef WIN32
+		DeleteCriticalSection(&mutex->cs);
+	#else
+		pthread_mutex_destroy(&mutex->mutex);
+	#endif
+}
+
+void mutexLock(struct Mutex *mutex) {
+	#ifdef WIN32
+		EnterCriticalSection(&mutex->cs);
+	#else
+		pthread_mutex_lock(&mutex->mutex);
+	#endif
+}
+
+void mutexUnlock(struct Mutex *mutex) {
+	#ifdef WIN32
+		LeaveCriticalSection(&mutex->cs);
+	#else
+		pthread_mutex_unlock(&mutex->mutex);
+	#endif
+}
+
+void condInit(struct Cond *cond) {
+	#ifdef WIN32
+		InitializeConditionVariable(&cond->cv);
+	#else
+		pthread_cond_init(&cond->cond, NULL);
+	#endif
+}
+
+void condDestroy(struct Cond *cond) {
+	#ifdef WIN32
+		(void)cond;  // nothing to free
+	#else
+		pthread_cond_destroy(&cond->cond);
+	#endif
+}
+
+void condWait(struct Cond *cond, struct Mutex *mutex) {
+	#ifdef WIN32
+		SleepConditionVariableCS(&cond->cv, &mutex->cs, INFINITE);
+	#else
+		pthread_cond_wait(&cond->cond, &mutex->mutex);
+	#endif
+}
+
+void condBroadcast(struct Cond *cond) {
+	#ifdef WIN32
+		WakeAllConditionVariable(&cond->cv);
+	#else
+		pthread_cond_broadcast(&cond->cond);
+	#endif
+}
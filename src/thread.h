@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef THREAD_H
+#define THREAD_H
+
+#ifdef WIN32
+	#include <Windows.h>
+#else
+	#include <pthread.h>
+#endif
+#include <makestuff/common.h>
+#include <makestuff/libfpgalink.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// Platform-agnostic worker threads, just enough to spread work over a few cores
+	typedef void (*ThreadFunc)(void *arg);
+	struct Thread {
+	#ifdef WIN32
+		HANDLE handle;
+	#else
+		pthread_t handle;
+	#endif
+		ThreadFunc func;
+		void *arg;
+	};
+
+	// Start func(arg) on a new thread. The Thread must stay put until threadJoin() returns.
+	FLStatus threadCreate(
+		struct Thread *thread, ThreadFunc func, void *arg, const char **error
+	) WARN_UNUSED_RESULT;
+
+	// Wait for a thread started by threadCreate() to finish
+	void threadJoin(struct Thread *thread);
+
+	// The number of CPU cores available, or one if it can't be determined
+	uint32 threadNumCores(void);
+
+	// Seconds since some arbitrary point, from a clock which never goes backwards
+	double threadNow(void);
+
+	// A number which no other call in this process returns, whichever thread it's called on
+	uint32 threadUniqueId(void);
+
+	// Read or write a flag which one thread sets and another polls, with a full memory barrier
+	uint32 threadAtomicGet(volatile uint32 *flag);
+	void threadAtomicSet(volatile uint32 *flag, uint32 value);
+
+	// A mutex, and a condition variable to wait on whilst holding it
+	struct Mutex {
+	#ifdef WIN32
+		CRITICAL_SECTION cs;
+	#else
+		pthread_mutex_t mutex;
+	#endif
+	};
+	struct Cond {
+	#ifdef WIN32
+		CONDITION_VARIABLE cv;
+	#else
+		pthread_cond_t cond;
+	#endif
+	};
+	void mutexInit(struct Mutex *mutex);
+	void mutexDestroy(struct Mutex *mutex);
+	void mutexLock(struct Mutex *mutex);
+	void mutexUnlock(struct Mutex *mutex);
+	void condInit(struct Cond *cond);
+	void condDestroy(struct Cond *cond);
+	void condWait(struct Cond *cond, struct Mutex *mutex);
+	void condBroadcast(struct Cond *cond);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
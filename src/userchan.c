@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libfpgalink.h>
+#include "private.h"
+#include "bits.h"
+
+// Frames begin with a sync byte, whose first bit marks the start of the frame
+#define FRAME_SYNC 0x01
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of private functions
+// -------------------------------------------------------------------------------------------------
+
+// Fill in a frame header: the sync byte, the channel (with bit 7 set for reads) and the count
+// (0x0000 = 64KiB).
+//
+// Called by:
+//   jtagUserWrite() -> userMakeHeader()
+//   jtagUserRead() -> userMakeHeader()
+//   jtagFlashXfer() -> userMakeHeader()
+//
+void userMakeHeader(uint8 *frame, uint8 command, uint32 count) {
+	frame[0] = FRAME_SYNC;
+	frame[1] = command;
+	flWriteWord((uint16)((count == USER_FRAME_MAX) ? 0x0000 : count), frame+2);
+}
+
+// Work out the length in bits of a USER-register scan. The tdiBytes bytes reach the target after
+// passing through the numBefore BYPASS bits nearer TDI. If tdoBytes is not zero, the scan must
+// also be long enough for that many bytes of reply to pass through the numAfter BYPASS bits
+// nearer TDO, so the reply starts at bit numBefore+numAfter of what's captured.
+//
+// Called by:
+//   userScan() -> userScanBits()
+//
+uint32 userScanBits(uint32 numBefore, uint32 numAfter, uint32 tdiBytes, uint32 tdoBytes) {
+	const uint32 inBits = numBefore + 8*tdiBytes;
+	const uint32 outBits = tdoBytes ? numBefore + numAfter + 8*tdoBytes : 0;
+	return (inBits > outBits) ? inBits : outBits;
+}
+
+// Do one DR scan through the USER register of the device opened by jtagUserOpen(). The tdiBytes
+// bytes of tdi are clocked into the chain first, so they reach the target after passing through
+// the BYPASS registers of the devices nearer TDI; the FPGA finds the start of each frame by
+// waiting for the first 1-bit. If tdo is not NULL, tdoBytes bytes are captured, aligned with the
+// target's view of the scan: bit n of tdo is what the target drove on TDO as it received bit n of
+// tdi. So a read frame starting at byte f of tdi has its reply at byte f+USER_READ_HDR of tdo.
+//
+// Called by:
+//   jtagUserWrite() -> userScan()
+//   jtagUserRead() -> userScan()
+//   jtagFlashXfer() -> userScan()
+//
+FLStatus userScan(
+	struct FLContext *handle, const uint8 *tdi, uint32 tdiBytes, uint8 *tdo, uint32 tdoBytes,
+	const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	const uint32 numBefore = handle->userDevice;
+	const uint32 numAfter = handle->chainLength - handle->userDevice - 1;
+	const uint32 numBits = userScanBits(numBefore, numAfter, tdiBytes, tdo ? tdoBytes : 0);
+	const uint32 numBytes = bitsToBytes(numBits);
+	uint8 *inBuf = NULL, *outBuf;
+	CHECK_STATUS(
+		!handle->isUserOpen, FL_BAD_STATE, cleanup,
+		"userScan(): The USER channel is not open (did you call jtagUserOpen()?)");
+	inBuf = (uint8 *)malloc(2*numBytes);
+	CHECK_STATUS(!inBuf, FL_ALLOC_ERR, cleanup, "userScan()");
+	outBuf = inBuf + numBytes;
+	memcpy(inBuf, tdi, tdiBytes);
+	memset(inBuf + tdiBytes, 0x00, numBytes - tdiBytes);
+	fStatus = jtagClockFSM(handle, 0x00000001, 3, error);  // -> Shift-DR
+	CHECK_STATUS(fStatus, fStatus, cleanup, "userScan()");
+	if ( tdo ) {
+		fStatus = jtagShiftInOut(handle, numBits, inBuf, outBuf, true, error);
+	} else {
+		fStatus = jtagShiftInOnly(handle, numBits, inBuf, true, error);
+	}
+	CHECK_STATUS(fStatus, fStatus, cleanup, "userScan()");
+	fStatus = jtagClockFSM(handle, 0x00000001, 2, error);  // -> Run-Test/Idle
+	CHECK_STATUS(fStatus, fStatus, cleanup, "userScan()");
+	if ( tdo ) {
+		bitCopy(tdo, 0, outBuf, numBefore + numAfter, 8*tdoBytes);
+	}
+cleanup:
+	free((void*)inBuf);
+	return retVal;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Implementation of public functions
+// -------------------------------------------------------------------------------------------------
+
+DLLEXPORT(FLStatus) jtagUserOpen(
+	struct FLContext *handle, uint32 device, uint32 userInsn, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint8 insn[4];
+	handle->isUserOpen = false;
+	CHECK_STATUS(
+		jtagChainGetIRLength(handle, device) > 32, FL_UNSUPPORTED_SIZE_ERR, cleanup,
+		"jtagUserOpen(): Device %d has an IR longer than 32 bits", device);
+	insn[0] = (uint8)userInsn;
+	insn[1] = (uint8)(userInsn >> 8);
+	insn[2] = (uint8)(userInsn >> 16);
+	insn[3] = (uint8)(userInsn >> 24);
+	fStatus = jtagClockFSM(handle, 0x0000001F, 6, error);  // Reset TAP, goto Run-Test/Idle
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagUserOpen()");
+	fStatus = jtagTargetShiftIR(handle, device, insn, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "jtagUserOpen()");
+	handle->userDevice = device;
+	handle->isUserOpen = true;
+cleanup:
+	return retVal;
+}
+
+// Write some bytes to the specified channel, one DR scan per 64KiB frame.
+//
+DLLEXPORT(FLStatus) jtagUserWrite(
+	struct FLContext *handle, uint8 chan, size_t count, const uint8 *data, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint8 *frame = NULL;
+	uint32 frameSize;
+	CHECK_STATUS(
+		count == 0, FL_PROTOCOL_ERR, cleanup,
+		"jtagUserWrite(): Zero-length writes are illegal!");
+	frameSize = (count >= USER_FRAME_MAX) ? USER_FRAME_MAX : (uint32)count;
+	frame = (uint8 *)malloc(USER_WRITE_HDR + frameSize);
+	CHECK_STATUS(!frame, FL_ALLOC_ERR, cleanup, "jtagUserWrite()");
+	while ( count ) {
+		frameSize = (count >= USER_FRAME_MAX) ? USER_FRAME_MAX : (uint32)count;
+		userMakeHeader(frame, chan & 0x7F, frameSize);
+		memcpy(frame + USER_WRITE_HDR, data, frameSize);
+		fStatus = userScan(handle, frame, USER_WRITE_HDR + frameSize, NULL, 0, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagUserWrite()");
+		data += frameSize;
+		count -= frameSize;
+	}
+cleanup:
+	free((void*)frame);
+	return retVal;
+}
+
+// Read some bytes from the specified channel, one DR scan per 64KiB frame.
+//
+DLLEXPORT(FLStatus) jtagUserRead(
+	struct FLContext *handle, uint8 chan, size_t count, uint8 *buffer, const char **error)
+{
+	FLStatus retVal = FL_SUCCESS, fStatus;
+	uint8 *frame = NULL;
+	uint32 frameSize;
+	CHECK_STATUS(
+		count == 0, FL_PROTOCOL_ERR, cleanup,
+		"jtagUserRead(): Zero-length reads are illegal!");
+	frameSize = (count >= USER_FRAME_MAX) ? USER_FRAME_MAX : (uint32)count;
+	frame = (uint8 *)malloc(USER_READ_HDR + frameSize);
+	CHECK_STATUS(!frame, FL_ALLOC_ERR, cleanup, "jtagUserRead()");
+	while ( count ) {
+		frameSize = (count >= USER_FRAME_MAX) ? USER_FRAME_MAX : (uint32)count;
+		userMakeHeader(frame, chan | 0x80, frameSize);
+		fStatus = userScan(handle, frame, USER_WRITE_HDR, frame, USER_READ_HDR + frameSize, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "jtagUserRead()");
+		memcpy(buffer, frame + USER_READ_HDR, frameSize);
+		buffer += frameSize;
+		count -= frameSize;
+	}
+cleanup:
+	free((void*)frame);
+	return retVal;
+}
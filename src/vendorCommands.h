@@ -36,10 +36,14 @@ typedef enum {
 	PROG_JTAG_NOTSENDING_NOTRECEIVING,
 	PROG_PARALLEL,
 	PROG_SPI_SEND,
-	PROG_SPI_RECV
+	PROG_SPI_RECV,
+	PROG_SPI_BATCH
 } ProgOp;
 
 #define bmISLAST       (1<<0)
 #define bmSENDONES     (1<<1)
 
+// Capability flags, in byte 14 of the CMD_MODE_STATUS reply (older firmware sends zero there)
+#define bmCAP_SPI_BATCH (1<<0)
+
 #endif
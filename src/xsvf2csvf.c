@@ -14,26 +14,44 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <stdio.h>
+#include <stdlib.h>
 #include <makestuff/common.h>
 #include <makestuff/libfpgalink.h>
 #include <makestuff/libbuffer.h>
 #include <makestuff/liberror.h>
 #include "xsvf.h"
 #include "private.h"
+#include "csvfstream.h"
+#include "csvfopt.h"
 
 #define ENABLE_SWAP
 
-// Global buffer and offset used to implement the iterator
+// The input is read through a fixed-size window, so the whole XSVF file never needs to be in
+// memory at once.
 //
+#define XSVF_WINDOW 0x10000
+
 typedef struct {
-	struct Buffer xsvfBuf;
+	FILE *file;
 	uint32 offset;
+	uint32 fill;
+	bool eof;  // tried to read past the end of the file
+	uint8 window[XSVF_WINDOW];
 } XC;
 
-// The buffer iterator. TODO: refactor to return error code on end of buffer.
+// The buffer iterator. Past the end of the file it returns zeros (i.e XCOMPLETE) and sets eof.
 //
 static uint8 getNextByte(XC *xc) {
-	return xc->xsvfBuf.data[xc->offset++];
+	if ( xc->offset == xc->fill ) {
+		xc->offset = 0;
+		xc->fill = (uint32)fread(xc->window, 1, XSVF_WINDOW, xc->file);
+		if ( xc->fill == 0 ) {
+			xc->eof = true;
+			return 0x00;
+		}
+	}
+	return xc->window[xc->offset++];
 }
 
 // Read "numBytes" bytes from the stream and write them out in reverse order to the supplied buffer
@@ -99,11 +117,17 @@ cleanup:
 	return retVal;
 }
 
-// Parse the XSVF, reversing the byte-ordering of all the bytestreams.
+// Parse the XSVF, reversing the byte-ordering of all the bytestreams. If sink is not NULL, the
+// CSVF is sent on to it whenever there's more than blockSize of it, except in the middle of an
+// XSDRB...XSDRE sequence, since that is rolled into one XSDR whose XSDRSIZE is patched as it goes.
 //
-static FLStatus xsvfSwapBytes(XC *xc, struct Buffer *outBuf, uint32 *maxBufSize, const char **error) {
+static FLStatus xsvfSwapBytes(
+	XC *xc, struct Buffer *outBuf, uint32 *maxBufSize, struct CsvfSink *sink, size_t blockSize,
+	const char **error)
+{
 	FLStatus fStatus, retVal = FL_SUCCESS;
 	uint32 newXSize = 0, curXSize = 0, totOffset = 0;
+	bool inSequence = false;
 	uint32 numBytes;
 	BufferStatus bStatus;
 	uint8 thisByte;
@@ -239,6 +263,7 @@ static FLStatus xsvfSwapBytes(XC *xc, struct Buffer *outBuf, uint32 *maxBufSize,
 			curXSize = newXSize;
 			sendXSize(outBuf, curXSize, error);
 			totOffset = (uint32)outBuf->length - 4; // each subsequent XSDRC & XSDRE updates this XSDRSIZE
+			inSequence = true;
 			bStatus = bufAppendByte(outBuf, XSDR, error);
 			CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "xsvfSwapBytes()");
 			fStatus = swapBytes(xc, bitsToBytes(newXSize), outBuf, error);
@@ -261,6 +286,7 @@ static FLStatus xsvfSwapBytes(XC *xc, struct Buffer *outBuf, uint32 *maxBufSize,
 			CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "xsvfSwapBytes()");
 			fStatus = swapBytes(xc, bitsToBytes(newXSize), outBuf, error);
 			CHECK_STATUS(fStatus, fStatus, cleanup, "xsvfSwapBytes()");
+			inSequence = false;
 			break;
 
 		case XSTATE:
@@ -294,31 +320,92 @@ static FLStatus xsvfSwapBytes(XC *xc, struct Buffer *outBuf, uint32 *maxBufSize,
 				FL_UNSUPPORTED_CMD_ERR, cleanup,
 				"xsvfSwapBytes(): Unsupported command 0x%02X!", thisByte);
 		}
+		CHECK_STATUS(
+			xc->eof, FL_FILE_ERR, cleanup,
+			"xsvfSwapBytes(): The XSVF file ends in the middle of a command");
+		if ( sink && !inSequence && outBuf->length >= blockSize ) {
+			fStatus = sink->put(sink, outBuf, error);
+			CHECK_STATUS(fStatus, fStatus, cleanup, "xsvfSwapBytes()");
+		}
 		thisByte = getNextByte(xc);
 	}
 
 	// Add the XCOMPLETE command
 	bStatus = bufAppendByte(outBuf, XCOMPLETE, error);
 	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "xsvfSwapBytes()");
+	if ( sink ) {
+		fStatus = sink->put(sink, outBuf, error);
+		CHECK_STATUS(fStatus, fStatus, cleanup, "xsvfSwapBytes()");
+	}
 
 cleanup:
 	return retVal;
 }
 
+// Called by:
+//   flLoadXsvfAndConvertToCsvf() -> openXsvf()
+//   xsvfStream() -> openXsvf()
+//
+static FLStatus openXsvf(const char *xsvfFile, XC **xc, const char **error) {
+	FLStatus retVal = FL_SUCCESS;
+	*xc = (XC *)calloc(1, sizeof(XC));
+	CHECK_STATUS(!*xc, FL_ALLOC_ERR, cleanup, "openXsvf()");
+	(*xc)->file = fopen(xsvfFile, "rb");
+	if ( !(*xc)->file ) {
+		errRenderStd(error);
+		errPrefix(error, "openXsvf(): Unable to open %s", xsvfFile);
+		FAIL_RET(FL_FILE_ERR, cleanup);
+	}
+cleanup:
+	return retVal;
+}
+
+// Called by:
+//   flLoadXsvfAndConvertToCsvf() -> closeXsvf()
+//   xsvfStream() -> closeXsvf()
+//
+static void closeXsvf(XC *xc) {
+	if ( xc ) {
+		if ( xc->file ) {
+			fclose(xc->file);
+		}
+		free((void*)xc);
+	}
+}
+
 DLLEXPORT(FLStatus) flLoadXsvfAndConvertToCsvf(
 	const char *xsvfFile, struct Buffer *csvfBuf, uint32 *maxBufSize, const char **error)
 {
 	FLStatus fStatus, retVal = FL_SUCCESS;
-	BufferStatus bStatus;
-	XC xc;
-	xc.offset = 0;
-	bStatus = bufInitialise(&xc.xsvfBuf, 0x20000, 0, error);
-	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "flLoadXsvfAndConvertToCsvf()");
-	bStatus = bufAppendFromBinaryFile(&xc.xsvfBuf, xsvfFile, error);
-	CHECK_STATUS(bStatus, FL_FILE_ERR, cleanup, "flLoadXsvfAndConvertToCsvf()");
-	fStatus = xsvfSwapBytes(&xc, csvfBuf, maxBufSize, error);
+	XC *xc = NULL;
+	fStatus = openXsvf(xsvfFile, &xc, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "flLoadXsvfAndConvertToCsvf()");
+	fStatus = xsvfSwapBytes(xc, csvfBuf, maxBufSize, NULL, 0, error);
 	CHECK_STATUS(fStatus, fStatus, cleanup, "flLoadXsvfAndConvertToCsvf()");
 cleanup:
-	bufDestroy(&xc.xsvfBuf);
+	closeXsvf(xc);
+	return retVal;
+}
+
+FLStatus xsvfStream(
+	const char *xsvfFile, struct CsvfSink *sink, size_t blockSize, const char **error)
+{
+	FLStatus fStatus, retVal = FL_SUCCESS;
+	BufferStatus bStatus;
+	struct Buffer block = {0,};
+	struct CsvfOptSink optSink = {{NULL}, NULL, {0,}, {0,}};
+	XC *xc = NULL;
+	bStatus = bufInitialise(&block, blockSize + 1024, 0x00, error);
+	CHECK_STATUS(bStatus, FL_ALLOC_ERR, cleanup, "xsvfStream()");
+	fStatus = csvfOptSinkInit(&optSink, sink, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xsvfStream()");
+	fStatus = openXsvf(xsvfFile, &xc, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xsvfStream()");
+	fStatus = xsvfSwapBytes(xc, &block, NULL, &optSink.sink, blockSize, error);
+	CHECK_STATUS(fStatus, fStatus, cleanup, "xsvfStream()");
+cleanup:
+	closeXsvf(xc);
+	csvfOptSinkDestroy(&optSink);
+	bufDestroy(&block);
 	return retVal;
 }
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include "bitstream.h"
+
+namespace {
+	void append(std::vector<uint8> &v, const uint8 *bytes, size_t length) {
+		v.insert(v.end(), bytes, bytes + length);
+	}
+}
+
+TEST(FPGALink, testBitParse) {
+	const uint8 header[] = {
+		0x00, 0x09, 0x0F, 0xF0, 0x0F, 0xF0, 0x0F, 0xF0, 0x0F, 0xF0, 0x00, 0x00, 0x01,
+		'a', 0x00, 0x04, 't', 'o', 'p', 0x00,
+		'b', 0x00, 0x06, '3', 's', '2', '0', '0', 0x00,
+		'c', 0x00, 0x02, '1', 0x00,
+		'd', 0x00, 0x02, '2', 0x00,
+		'e', 0x00, 0x00, 0x00, 0x30
+	};
+	const uint8 config[] = {
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,  // padding
+		0xAA, 0x99, 0x55, 0x66,  // sync
+		0x30, 0x01, 0x20, 0x01, 0x00, 0x00, 0x00, 0x00,  // some frame data
+		0x30, 0x00, 0x80, 0x01, 0x00, 0x00, 0x00, 0x0D,  // DESYNC
+		0x20, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00,  // NOOPs
+		0x20, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00
+	};
+	std::vector<uint8> file;
+	struct Bitstream bs;
+	FLStatus fStatus;
+	append(file, header, sizeof(header));
+	append(file, config, sizeof(config));
+
+	// A .bit file: one dummy word, the sync word, and up to the end of the DESYNC
+	fStatus = bitParse(&file[0], (uint32)file.size(), &bs, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_STREQ("top", bs.design);
+	ASSERT_STREQ("3s200", bs.part);
+	ASSERT_EQ(&file[sizeof(header) + 8], bs.config);
+	ASSERT_EQ(24U, bs.configLength);
+	ASSERT_TRUE(bs.isComplete);
+
+	// The same as a .bin file
+	fStatus = bitParse(config, sizeof(config), &bs, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(NULL, bs.design);
+	ASSERT_EQ(config + 8, bs.config);
+	ASSERT_EQ(24U, bs.configLength);
+
+	// Something other than NOOPs after the DESYNC means we can't tell where it ends
+	fStatus = bitParse(config, sizeof(config) - 1, &bs, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(sizeof(config) - 9, bs.configLength);
+	ASSERT_FALSE(bs.isComplete);
+
+	// A truncated .bit file is refused
+	fStatus = bitParse(&file[0], (uint32)file.size() - 1, &bs, NULL);
+	ASSERT_EQ(FL_FILE_ERR, fStatus);
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfpgalink.h>
+#include "cache.h"
+#include "thread.h"
+#include "private.h"
+
+namespace {
+	const char *const cacheDir = "testCache.d";
+	const char *const srcName = "testCache.svf";
+	uint32 numConversions;
+
+	FLStatus fakeConvert(const char *, struct Buffer *csvfBuf, uint32 *maxBufSize, const char **) {
+		const uint8 csvf[] = {0x02, 0x06, 0x09, 0x00};
+		numConversions++;
+		*maxBufSize = 7;
+		return bufAppendBlock(csvfBuf, csvf, sizeof(csvf), NULL) ? FL_ALLOC_ERR : FL_SUCCESS;
+	}
+
+	void writeSource(const char *text) {
+		FILE *const file = std::fopen(srcName, "wb");
+		std::fputs(text, file);
+		std::fclose(file);
+	}
+
+	// Converts the same file as all the others, at the same time
+	const uint32 numThreads = 8;
+	const uint32 numIds = 1000;
+	struct Worker {
+		struct Thread thread;
+		struct Buffer csvfBuf;
+		FLStatus status;
+		uint32 ids[numIds];
+	};
+	FLStatus quietConvert(const char *, struct Buffer *csvfBuf, uint32 *maxBufSize, const char **) {
+		const uint8 csvf[] = {0x02, 0x06, 0x09, 0x00};
+		*maxBufSize = 7;
+		return bufAppendBlock(csvfBuf, csvf, sizeof(csvf), NULL) ? FL_ALLOC_ERR : FL_SUCCESS;
+	}
+	void convertWorker(void *arg) {
+		struct Worker *const worker = (struct Worker *)arg;
+		for ( uint32 i = 0; i < numIds; i++ ) {
+			worker->ids[i] = threadUniqueId();
+		}
+		worker->status = cacheConvert(srcName, quietConvert, &worker->csvfBuf, NULL, NULL);
+	}
+
+	// Count the entries, including any temporary files left behind
+	uint32 countEntries(void) {
+		DIR *const dir = opendir(cacheDir);
+		struct dirent *ent;
+		uint32 count = 0;
+		while ( (ent = readdir(dir)) != NULL ) {
+			if ( ent->d_name[0] != '.' ) {
+				count++;
+			}
+		}
+		closedir(dir);
+		return count;
+	}
+
+	// Overwrite the last byte of every entry, or with remove set, delete them all
+	void forEachEntry(bool remove) {
+		DIR *const dir = opendir(cacheDir);
+		struct dirent *ent;
+		while ( (ent = readdir(dir)) != NULL ) {
+			if ( ent->d_name[0] != '.' ) {
+				const std::string path = std::string(cacheDir) + "/" + ent->d_name;
+				if ( remove ) {
+					std::remove(path.c_str());
+				} else {
+					FILE *const file = std::fopen(path.c_str(), "r+b");
+					std::fseek(file, -1, SEEK_END);
+					std::fputc(0x55, file);
+					std::fclose(file);
+				}
+			}
+		}
+		closedir(dir);
+	}
+}
+
+TEST(FPGALink, testConversionCache) {
+	struct Buffer csvfBuf;
+	uint32 maxBufSize;
+	FLStatus fStatus;
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&csvfBuf, 1024, 0x00, NULL));
+	mkdir(cacheDir, 0755);
+	writeSource("SIR 6 TDI (09);\n");
+	numConversions = 0;
+
+	// Without a cache, every load converts
+	for ( int i = 0; i < 2; i++ ) {
+		bufZeroLength(&csvfBuf);
+		fStatus = cacheConvert(srcName, fakeConvert, &csvfBuf, NULL, NULL);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+	}
+	ASSERT_EQ(2U, numConversions);
+
+	// With one, only the first does
+	fStatus = flSetConversionCache(cacheDir, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	for ( int i = 0; i < 3; i++ ) {
+		bufZeroLength(&csvfBuf);
+		maxBufSize = 0;
+		fStatus = cacheConvert(srcName, fakeConvert, &csvfBuf, &maxBufSize, NULL);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+		ASSERT_EQ(4U, csvfBuf.length);
+		ASSERT_EQ(0x09, csvfBuf.data[2]);
+		ASSERT_EQ(7U, maxBufSize);
+	}
+	ASSERT_EQ(3U, numConversions);
+
+	// Different contents miss...
+	writeSource("SIR 6 TDI (0A);\n");
+	fStatus = cacheConvert(srcName, fakeConvert, &csvfBuf, NULL, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(4U, numConversions);
+
+	// ...as does a damaged entry
+	forEachEntry(false);
+	fStatus = cacheConvert(srcName, fakeConvert, &csvfBuf, NULL, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(5U, numConversions);
+
+	fStatus = flSetConversionCache(NULL, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	forEachEntry(true);
+	std::remove(cacheDir);
+	std::remove(srcName);
+	bufDestroy(&csvfBuf);
+}
+
+TEST(FPGALink, testConversionCacheThreads) {
+	static struct Worker workers[numThreads];
+	std::set<uint32> ids;
+	FLStatus fStatus;
+	mkdir(cacheDir, 0755);
+	writeSource("SIR 6 TDI (0B);\n");
+	fStatus = flSetConversionCache(cacheDir, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+
+	// Several threads missing the same entry all store it, each through its own temporary file
+	for ( uint32 i = 0; i < numThreads; i++ ) {
+		ASSERT_EQ(BUF_SUCCESS, bufInitialise(&workers[i].csvfBuf, 1024, 0x00, NULL));
+		fStatus = threadCreate(&workers[i].thread, convertWorker, workers + i, NULL);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+	}
+	for ( uint32 i = 0; i < numThreads; i++ ) {
+		threadJoin(&workers[i].thread);
+		ASSERT_EQ(FL_SUCCESS, workers[i].status);
+		ASSERT_EQ(4U, workers[i].csvfBuf.length);
+		ASSERT_EQ(0x09, workers[i].csvfBuf.data[2]);
+		ids.insert(workers[i].ids, workers[i].ids + numIds);
+		bufDestroy(&workers[i].csvfBuf);
+	}
+	ASSERT_EQ(numThreads * numIds, ids.size());
+	ASSERT_EQ(1U, countEntries());
+
+	fStatus = flSetConversionCache(NULL, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	forEachEntry(true);
+	std::remove(cacheDir);
+	std::remove(srcName);
+}
+
+TEST(FPGALink, testConversionCacheMaxBufSize) {
+	struct Buffer expected, csvfBuf;
+	uint32 wantSize = 0, maxBufSize;
+	FLStatus fStatus;
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&expected, 1024, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&csvfBuf, 1024, 0x00, NULL));
+	mkdir(cacheDir, 0755);
+	writeSource("SIR 6 TDI (0C);\nSDR 40 TDI (0123456789) TDO (0000000000) MASK (FFFFFFFFFF);\n");
+	fStatus = flLoadSvfAndConvertToCsvf(srcName, &expected, &wantSize, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(5U, wantSize);
+	fStatus = flSetConversionCache(cacheDir, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+
+	// A miss without maxBufSize (as loadJtagFile() does it) must still store the right one...
+	fStatus = cacheConvert(srcName, flLoadSvfAndConvertToCsvf, &csvfBuf, NULL, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(1U, countEntries());
+
+	// ...so a hit returns it, whatever the caller's variable held before
+	bufZeroLength(&csvfBuf);
+	maxBufSize = 0xDEADBEEF;
+	fStatus = cacheConvert(srcName, flLoadSvfAndConvertToCsvf, &csvfBuf, &maxBufSize, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(wantSize, maxBufSize);
+	ASSERT_EQ(expected.length, csvfBuf.length);
+	ASSERT_EQ(0, std::memcmp(expected.data, csvfBuf.data, expected.length));
+
+	// A miss returns the same, whatever the caller's variable held before
+	forEachEntry(true);
+	bufZeroLength(&csvfBuf);
+	maxBufSize = 0xDEADBEEF;
+	fStatus = cacheConvert(srcName, flLoadSvfAndConvertToCsvf, &csvfBuf, &maxBufSize, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(wantSize, maxBufSize);
+	ASSERT_EQ(expected.length, csvfBuf.length);
+	ASSERT_EQ(0, std::memcmp(expected.data, csvfBuf.data, expected.length));
+
+	fStatus = flSetConversionCache(NULL, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	forEachEntry(true);
+	std::remove(cacheDir);
+	std::remove(srcName);
+	bufDestroy(&csvfBuf);
+	bufDestroy(&expected);
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include "chain.h"
+#include "bits.h"
+
+TEST(FPGALink, testLookupIRLength) {
+	ASSERT_EQ(6, chainLookupIRLength(0x24001093));  // XC6SLX9 rev 2
+	ASSERT_EQ(6, chainLookupIRLength(0x01C22093));  // XC3S500E
+	ASSERT_EQ(8, chainLookupIRLength(0xF5046093));  // XCF04S
+	ASSERT_EQ(16, chainLookupIRLength(0x05059093)); // XCF32P
+	ASSERT_EQ(8, chainLookupIRLength(0x06E5E093));  // XC2C64A
+	ASSERT_EQ(10, chainLookupIRLength(0x020B10DD)); // EP2C5
+	ASSERT_EQ(4, chainLookupIRLength(0x4BA00477));  // Cortex-A9 DAP
+	ASSERT_EQ(0, chainLookupIRLength(0x12345679));  // Unknown
+}
+
+TEST(FPGALink, testPlanDR) {
+	struct ChainPlan plan;
+
+	// Single device: no padding at all
+	chainPlanDR(1, 0, 32, true, &plan);
+	ASSERT_EQ(32U, plan.numBits);
+	ASSERT_EQ(0U, plan.tdiOffset);
+	ASSERT_EQ(0U, plan.tdoOffset);
+
+	// Target nearest TDI of four: writes need no padding, reads need three bits
+	chainPlanDR(4, 0, 32, false, &plan);
+	ASSERT_EQ(32U, plan.numBits);
+	chainPlanDR(4, 0, 32, true, &plan);
+	ASSERT_EQ(35U, plan.numBits);
+	ASSERT_EQ(3U, plan.tdiOffset);
+	ASSERT_EQ(3U, plan.tdoOffset);
+
+	// Target nearest TDO of four: writes need three bits, reads need none extra
+	chainPlanDR(4, 3, 32, true, &plan);
+	ASSERT_EQ(35U, plan.numBits);
+	ASSERT_EQ(0U, plan.tdiOffset);
+	ASSERT_EQ(0U, plan.tdoOffset);
+
+	// Middle of five
+	chainPlanDR(5, 1, 8, true, &plan);
+	ASSERT_EQ(11U, plan.numBits);
+	ASSERT_EQ(2U, plan.tdiOffset);
+	ASSERT_EQ(3U, plan.tdoOffset);
+}
+
+TEST(FPGALink, testBitCopy) {
+	const uint8 src[] = {0xA5, 0x3C, 0xF0, 0x0F};
+	uint8 dst[6];
+
+	// Unaligned copy, checking that neighbouring bits survive
+	std::memset(dst, 0xFF, sizeof(dst));
+	bitCopy(dst, 3, src, 0, 16);
+	ASSERT_EQ(0x2F, dst[0]);  // 0xA5 << 3 | 0x07
+	ASSERT_EQ(0xE5, dst[1]);
+	ASSERT_EQ(0xF9, dst[2]);
+
+	// Round-trip back out again
+	uint8 back[2] = {0, 0};
+	bitCopy(back, 0, dst, 3, 16);
+	ASSERT_EQ(0xA5, back[0]);
+	ASSERT_EQ(0x3C, back[1]);
+
+	// Fill
+	std::memset(dst, 0x00, sizeof(dst));
+	bitFill(dst, 5, 14, true);
+	ASSERT_EQ(0xE0, dst[0]);
+	ASSERT_EQ(0xFF, dst[1]);
+	ASSERT_EQ(0x07, dst[2]);
+	ASSERT_EQ(0x00, dst[3]);
+}
+
+namespace {
+	bool getBit(const uint8 *p, uint32 n) {
+		return (p[n >> 3] >> (n & 7)) & 1;
+	}
+}
+
+TEST(FPGALink, testBitCopyAlignments) {
+	uint8 src[64], dst[64], expected[64];
+	for ( uint32 i = 0; i < sizeof(src); i++ ) {
+		src[i] = (uint8)(i * 37 + 11);
+	}
+
+	// Every alignment, with runs long enough to go through the word-wide kernels
+	for ( uint32 srcOffset = 0; srcOffset < 16; srcOffset++ ) {
+		for ( uint32 dstOffset = 0; dstOffset < 16; dstOffset++ ) {
+			for ( uint32 numBits = 0; numBits < 400; numBits += 13 ) {
+				std::memset(dst, 0xA5, sizeof(dst));
+				std::memset(expected, 0xA5, sizeof(expected));
+				for ( uint32 i = 0; i < numBits; i++ ) {
+					const uint32 d = dstOffset + i;
+					expected[d >> 3] = (uint8)(
+						(expected[d >> 3] & ~(1 << (d & 7))) | (getBit(src, srcOffset + i) << (d & 7)));
+				}
+				bitCopy(dst, dstOffset, src, srcOffset, numBits);
+				ASSERT_EQ(0, std::memcmp(expected, dst, sizeof(dst)))
+					<< "srcOffset=" << srcOffset << " dstOffset=" << dstOffset << " numBits=" << numBits;
+			}
+		}
+	}
+}
+
+TEST(FPGALink, testBitFunnel) {
+	uint8 src[64], dst[64];
+	for ( uint32 i = 0; i < sizeof(src); i++ ) {
+		src[i] = (uint8)(i * 91 + 3);
+	}
+	for ( uint32 shift = 1; shift < 8; shift++ ) {
+		for ( uint32 numBytes = 0; numBytes < sizeof(src); numBytes++ ) {
+			std::memset(dst, 0x00, sizeof(dst));
+			bitFunnelMsb(dst, src, numBytes, shift);
+			for ( uint32 i = 0; i < numBytes; i++ ) {
+				ASSERT_EQ((uint8)((src[i] << shift) | (src[i+1] >> (8 - shift))), dst[i]);
+			}
+			ASSERT_EQ(0x00, dst[numBytes]);
+			bitFunnelLsb(dst, src, numBytes, shift);
+			for ( uint32 i = 0; i < numBytes; i++ ) {
+				ASSERT_EQ((uint8)((src[i] >> shift) | (src[i+1] << (8 - shift))), dst[i]);
+			}
+		}
+	}
+}
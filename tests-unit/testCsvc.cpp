@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include "csvc.h"
+#include "private.h"
+#include "xsvf.h"
+
+namespace {
+	// A few hundred commands, with the long runs of 0x00 and 0xFF typical of bitstream data
+	void makeCsvf(struct Buffer *buf) {
+		const uint8 size[] = {XSDRSIZE, 0x00, 0x00, 0x04, 0x00};  // 128 bytes
+		const uint8 insn[] = {XSIR, 6, 0x05};
+		ASSERT_EQ(BUF_SUCCESS, bufAppendBlock(buf, size, sizeof(size), NULL));
+		for ( uint32 i = 0; i < 300; i++ ) {
+			ASSERT_EQ(BUF_SUCCESS, bufAppendBlock(buf, insn, sizeof(insn), NULL));
+			ASSERT_EQ(BUF_SUCCESS, bufAppendByte(buf, XSDR, NULL));
+			ASSERT_EQ(BUF_SUCCESS, bufAppendConst(buf, (i & 1) ? 0xFF : 0x00, 100, NULL));
+			for ( uint32 j = 0; j < 28; j++ ) {
+				ASSERT_EQ(BUF_SUCCESS, bufAppendByte(buf, (uint8)(i*j + 1), NULL));
+			}
+		}
+		ASSERT_EQ(BUF_SUCCESS, bufAppendByte(buf, XCOMPLETE, NULL));
+	}
+}
+
+TEST(FPGALink, testCsvc) {
+	const char *const fileName = "testCsvc.csvc";
+	struct Buffer csvf, loaded;
+	struct Csvc csvc;
+	FLStatus fStatus;
+	FILE *file;
+	long fileSize;
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&csvf, 1024, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&loaded, 1024, 0x00, NULL));
+	makeCsvf(&csvf);
+
+	for ( int compress = 0; compress < 2; compress++ ) {
+		fStatus = flSaveCsvc(fileName, csvf.data, 4096, compress != 0, NULL);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+		ASSERT_TRUE(csvcSniff(fileName));
+		fStatus = csvcOpen(&csvc, fileName, NULL);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+		ASSERT_EQ(csvf.length, csvc.csvfLength);
+		ASSERT_LT(1U, csvc.numBlocks);
+		if ( compress ) {
+			ASSERT_LT(csvc.size, csvf.length/2);
+		}
+		bufZeroLength(&loaded);
+		fStatus = csvcLoad(&csvc, &loaded, NULL);
+		csvcClose(&csvc);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+		ASSERT_EQ(csvf.length, loaded.length);
+		ASSERT_EQ(0, std::memcmp(csvf.data, loaded.data, csvf.length));
+	}
+
+	// Damage the last byte of the last block
+	file = std::fopen(fileName, "r+b");
+	ASSERT_TRUE(file != NULL);
+	std::fseek(file, 0, SEEK_END);
+	fileSize = std::ftell(file);
+	std::fseek(file, fileSize - 1, SEEK_SET);
+	std::fputc(0x55, file);
+	std::fclose(file);
+	fStatus = csvcOpen(&csvc, fileName, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	bufZeroLength(&loaded);
+	fStatus = csvcLoad(&csvc, &loaded, NULL);
+	csvcClose(&csvc);
+	ASSERT_EQ(FL_FILE_ERR, fStatus);
+
+	// A raw CSVF stream is not a CSVC file
+	ASSERT_EQ(BUF_SUCCESS, bufWriteBinaryFile(&csvf, fileName, 0, csvf.length, NULL));
+	ASSERT_FALSE(csvcSniff(fileName));
+	fStatus = csvcOpen(&csvc, fileName, NULL);
+	ASSERT_EQ(FL_FILE_ERR, fStatus);
+
+	bufDestroy(&loaded);
+	bufDestroy(&csvf);
+	std::remove(fileName);
+}
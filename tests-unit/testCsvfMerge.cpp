@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include "private.h"
+#include "xsvf.h"
+
+TEST(FPGALink, testCsvfMerge) {
+	// Device zero (nearest TDI): 4-bit IR, one write-only DR scan
+	const uint8 dev0[] = {
+		XSIR, 4, 0x05,
+		XSDRSIZE, 0x00, 0x00, 0x00, 0x08,
+		XSDR, 0xA5,
+		XCOMPLETE
+	};
+	// Device one: 6-bit IR, a checked DR scan with a runtest, then a write-only DR scan
+	const uint8 dev1[] = {
+		XSIR, 6, 0x09,
+		XSDRSIZE, 0x00, 0x00, 0x00, 0x04,
+		XTDOMASK, 0x0F,
+		XRUNTEST, 0x00, 0x00, 0x00, 0x64,
+		XSDRTDO, 0x03, 0x06,
+		XSDR, 0x07,
+		XCOMPLETE
+	};
+	const uint8 *const streams[] = {dev0, dev1};
+	const char *const expected =
+		"020A4901"          // both IRs: device one's first, then device zero's
+		"020A7F01"          // device one into BYPASS for device zero's write-only scan
+		"0800000009"        // 8 DR bits + 1 BYPASS bit
+		"034A01"
+		"020AC903"          // reload device one, and put device zero in BYPASS
+		"0800000005"        // 4 DR bits + 1 BYPASS bit
+		"010F"              // only device one's bits are checked
+		"0400000064"        // device one's runtest
+		"090306"            // the checked scan goes on its own
+		"0307"
+		"00";
+	char result[256];
+	struct Buffer csvfBuf;
+	BufferStatus bStatus;
+	FLStatus fStatus;
+	uint32 maxBufSize;
+	bStatus = bufInitialise(&csvfBuf, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	fStatus = flMergeCsvf(streams, 2, &csvfBuf, &maxBufSize, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(2U, maxBufSize);
+	ASSERT_LT(csvfBuf.length, sizeof(result)/2);
+	for ( uint32 i = 0; i < csvfBuf.length; i++ ) {
+		std::sprintf(result + 2*i, "%02X", csvfBuf.data[i]);
+	}
+	result[2*csvfBuf.length] = '\0';
+	ASSERT_STREQ(expected, result);
+
+	// Checked scans do merge with each other, and a device with no XTDOMASK has all its bits checked
+	const uint8 devA[] = {
+		XSIR, 4, 0x05,
+		XSDRSIZE, 0x00, 0x00, 0x00, 0x08,
+		XSDRTDO, 0x11, 0x22,
+		XCOMPLETE
+	};
+	const uint8 devB[] = {
+		XSIR, 4, 0x03,
+		XSDRSIZE, 0x00, 0x00, 0x00, 0x04,
+		XTDOMASK, 0x03,
+		XSDRTDO, 0x01, 0x02,
+		XCOMPLETE
+	};
+	const uint8 *const checkedStreams[] = {devA, devB};
+	bufZeroLength(&csvfBuf);
+	fStatus = flMergeCsvf(checkedStreams, 2, &csvfBuf, NULL, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_LT(csvfBuf.length, sizeof(result)/2);
+	for ( uint32 i = 0; i < csvfBuf.length; i++ ) {
+		std::sprintf(result + 2*i, "%02X", csvfBuf.data[i]);
+	}
+	result[2*csvfBuf.length] = '\0';
+	ASSERT_STREQ("020853" "080000000C" "01F30F" "0911220102" "00", result);
+
+	// A stream must load an instruction before doing a DR scan
+	const uint8 bad[] = {XSDRSIZE, 0x00, 0x00, 0x00, 0x08, XSDR, 0xA5, XCOMPLETE};
+	const uint8 *const badStreams[] = {dev0, bad};
+	bufZeroLength(&csvfBuf);
+	fStatus = flMergeCsvf(badStreams, 2, &csvfBuf, NULL, NULL);
+	ASSERT_EQ(FL_FILE_ERR, fStatus);
+	bufDestroy(&csvfBuf);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include "csvfopt.h"
+#include "xsvf.h"
+
+namespace {
+	void toHex(const struct Buffer *buf, char *result) {
+		for ( uint32 i = 0; i < buf->length; i++ ) {
+			std::sprintf(result + 2*i, "%02X", buf->data[i]);
+		}
+		result[2*buf->length] = '\0';
+	}
+}
+
+TEST(FPGALink, testCsvfOptimise) {
+	const uint8 csvf[] = {
+		XRUNTEST, 0x00, 0x00, 0x00, 0x00,  // the player starts with zero anyway
+		XSIR, 6, 0x09,
+		XSDRSIZE, 0x00, 0x00, 0x00, 0x08,
+		XTDOMASK, 0xFF,
+		XRUNTEST, 0x00, 0x00, 0x00, 0x64,
+		XSDRTDO, 0x12, 0x34,
+		XSDRSIZE, 0x00, 0x00, 0x00, 0x08,  // nothing changes...
+		XTDOMASK, 0xFF,
+		XRUNTEST, 0x00, 0x00, 0x00, 0x64,
+		XSDRTDO, 0x56, 0x78,               // ...so only the shift remains
+		XTDOMASK, 0x00,
+		XRUNTEST, 0x00, 0x00, 0x00, 0x00,  // overridden by the next one
+		XRUNTEST, 0x00, 0x00, 0x00, 0x10,
+		XSDRTDO, 0xAB, 0xCD,               // nothing to compare
+		XSDRSIZE, 0x00, 0x00, 0x00, 0x04,
+		XTDOMASK, 0x0F,
+		XSDRTDO, 0x01, 0x02,
+		XSDRSIZE, 0x00, 0x00, 0x00, 0x08,
+		XTDOMASK, 0x0F,                    // same mask, different size
+		XSDRTDO, 0x03, 0x04,
+		XSDRSIZE, 0x00, 0x00, 0x00, 0x10,  // never used
+		XCOMPLETE
+	};
+	const char *const expected =
+		"020609"
+		"0400000064" "0800000008" "01FF" "091234"
+		"095678"
+		"0400000010" "03AB"
+		"0800000004" "010F" "090102"
+		"0800000008" "090304"
+		"00";
+	const size_t split = 23;  // just after the first XSDRTDO
+	char result[256];
+	struct Buffer csvfBuf, streamed;
+	struct CsvfOpt opt;
+	BufferStatus bStatus;
+	FLStatus fStatus;
+	bStatus = bufInitialise(&csvfBuf, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	bStatus = bufInitialise(&streamed, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	bStatus = bufAppendBlock(&csvfBuf, csvf, sizeof(csvf), NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	fStatus = csvfOptimiseBuffer(&csvfBuf, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_LT(csvfBuf.length, sizeof(result)/2);
+	toHex(&csvfBuf, result);
+	ASSERT_STREQ(expected, result);
+
+	// Optimising in pieces gives the same result
+	ASSERT_EQ(XSDRSIZE, csvf[split]);
+	csvfOptInit(&opt);
+	fStatus = csvfOptimise(&opt, csvf, split, &streamed, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	fStatus = csvfOptimise(&opt, csvf + split, sizeof(csvf) - split, &streamed, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	toHex(&streamed, result);
+	ASSERT_STREQ(expected, result);
+
+	bufDestroy(&streamed);
+	bufDestroy(&csvfBuf);
+}
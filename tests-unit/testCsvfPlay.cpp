@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include "csvfplay.h"
+#include "private.h"
+
+namespace {
+	// Every TAP operation the player asks for, flattened into bytes; and how many more to allow
+	// before failing, as if the cable had been pulled out
+	std::vector<uint8> tapLog;
+	int tapBudget;
+
+	bool logOp(uint8 op, uint32 value, const uint8 *data, uint32 numBits) {
+		tapLog.push_back(op);
+		for ( int i = 24; i >= 0; i -= 8 ) {
+			tapLog.push_back((uint8)(value >> i));
+		}
+		if ( data ) {
+			tapLog.insert(tapLog.end(), data, data + (numBits + 7) / 8);
+		}
+		return tapBudget < 0 || tapBudget-- > 0;
+	}
+	FLStatus fakeClockFSM(struct FLContext *, uint32 bitPattern, uint8 transitionCount, const char **) {
+		return logOp('F', bitPattern << 8 | transitionCount, NULL, 0) ? FL_SUCCESS : FL_PROG_JTAG_FSM;
+	}
+	FLStatus fakeShiftInOut(
+		struct FLContext *, uint32 numBits, const uint8 *tdiData, uint8 *tdoData, uint8, const char **)
+	{
+		std::memset(tdoData, 0x00, (numBits + 7) / 8);
+		return logOp('X', numBits, tdiData, numBits) ? FL_SUCCESS : FL_PROG_SHIFT;
+	}
+	FLStatus fakeShiftInOnly(
+		struct FLContext *, uint32 numBits, const uint8 *tdiData, uint8, const char **)
+	{
+		return logOp('S', numBits, tdiData, numBits) ? FL_SUCCESS : FL_PROG_SHIFT;
+	}
+	FLStatus fakeClocks(struct FLContext *, uint32 numClocks, const char **) {
+		return logOp('C', numClocks, NULL, 0) ? FL_SUCCESS : FL_PROG_JTAG_FSM;
+	}
+	const struct CsvfTap fakeTap = {fakeClockFSM, fakeShiftInOut, fakeShiftInOnly, fakeClocks};
+
+	void appendLong(std::vector<uint8> &csvf, uint8 cmd, uint32 value) {
+		csvf.push_back(cmd);
+		for ( int i = 24; i >= 0; i -= 8 ) {
+			csvf.push_back((uint8)(value >> i));
+		}
+	}
+}
+
+TEST(FPGALink, testCsvfCheckpoint) {
+	const char *const ckptName = "testCsvfPlay.ckpt";
+	struct CsvfCheckpoint saved, loaded;
+	FLStatus fStatus;
+	FILE *file;
+	std::remove(ckptName);
+	ASSERT_FALSE(csvfCheckpointLoad(ckptName, &loaded));
+
+	saved.csvfLength = 123456;
+	saved.csvfCrc = 0xCAFEF00D;
+	saved.offset = 65600;
+	saved.xsdrSize = 2048;
+	saved.xruntest = 100000;
+	for ( uint32 i = 0; i < BUF_SIZE; i++ ) {
+		saved.tdoMask[i] = (uint8)(i * 13);
+	}
+	fStatus = csvfCheckpointSave(ckptName, &saved, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_TRUE(csvfCheckpointLoad(ckptName, &loaded));
+	ASSERT_EQ(saved.csvfLength, loaded.csvfLength);
+	ASSERT_EQ(saved.csvfCrc, loaded.csvfCrc);
+	ASSERT_EQ(saved.offset, loaded.offset);
+	ASSERT_EQ(saved.xsdrSize, loaded.xsdrSize);
+	ASSERT_EQ(saved.xruntest, loaded.xruntest);
+	ASSERT_EQ(0, std::memcmp(saved.tdoMask, loaded.tdoMask, BUF_SIZE));
+
+	// Saving again replaces the old checkpoint
+	saved.offset = 131200;
+	fStatus = csvfCheckpointSave(ckptName, &saved, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_TRUE(csvfCheckpointLoad(ckptName, &loaded));
+	ASSERT_EQ(saved.offset, loaded.offset);
+
+	// A damaged checkpoint is ignored
+	file = std::fopen(ckptName, "r+b");
+	std::fseek(file, 100, SEEK_SET);
+	std::fputc(0x55, file);
+	std::fclose(file);
+	ASSERT_FALSE(csvfCheckpointLoad(ckptName, &loaded));
+	std::remove(ckptName);
+}
+
+TEST(FPGALink, testCsvfPlayResume) {
+	const char *const ckptName = "testCsvfPlayResume.ckpt";
+	const uint8 mask[] = {0xFF, 0x00, 0xFF, 0x00};
+	std::vector<uint8> csvf, whole, resumed;
+	struct FLContext handle;
+	struct CsvfCheckpoint ckpt;
+	FLStatus fStatus;
+	size_t tail;
+	std::memset(&handle, 0, sizeof(handle));
+	std::remove(ckptName);
+
+	// Several checkpoints' worth of scans. The XTDOMASK is only given at the start, and the TDO
+	// expected in its zero bits never matches, so a resumed run must restore it. XRUNTEST varies,
+	// and is sometimes zero, so not every XSIR is a safe point.
+	appendLong(csvf, XSDRSIZE, 32);
+	csvf.push_back(XTDOMASK);
+	csvf.insert(csvf.end(), mask, mask + 4);
+	for ( uint32 i = 0; i < 10000; i++ ) {
+		appendLong(csvf, XRUNTEST, (i % 5) * 100);
+		csvf.push_back(XSIR);
+		csvf.push_back(6);
+		csvf.push_back((uint8)(i & 0x3F));
+		csvf.push_back(XSDR);
+		for ( uint32 j = 0; j < 4; j++ ) {
+			csvf.push_back((uint8)(i >> (8 * j)));
+		}
+		csvf.push_back(XSDRTDO);
+		for ( uint32 j = 0; j < 4; j++ ) {
+			csvf.push_back((uint8)(i * 7 + j));       // TDI
+			csvf.push_back(mask[j] ? 0x00 : 0x5A);  // expected TDO
+		}
+	}
+	csvf.push_back(XCOMPLETE);
+
+	// An uninterrupted run, which leaves no checkpoint behind
+	tapLog.clear();
+	tapBudget = -1;
+	fStatus = csvfPlayResumableOn(&handle, &fakeTap, csvf.data(), csvf.size(), ckptName, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_FALSE(csvfCheckpointLoad(ckptName, &ckpt));
+	whole = tapLog;
+
+	// A run which fails two thirds of the way through leaves a checkpoint...
+	tapLog.clear();
+	tapBudget = 100000;
+	fStatus = csvfPlayResumableOn(&handle, &fakeTap, csvf.data(), csvf.size(), ckptName, NULL);
+	ASSERT_NE(FL_SUCCESS, fStatus);
+	ASSERT_TRUE(csvfCheckpointLoad(ckptName, &ckpt));
+	ASSERT_LT(0U, ckpt.offset);
+	ASSERT_EQ(XSIR, csvf[ckpt.offset]);
+
+	// ...and the next run resets the TAP, then carries on from there exactly as the uninterrupted
+	// run did
+	tapLog.clear();
+	tapBudget = -1;
+	fStatus = csvfPlayResumableOn(&handle, &fakeTap, csvf.data(), csvf.size(), ckptName, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_FALSE(csvfCheckpointLoad(ckptName, &ckpt));
+	resumed = tapLog;
+	ASSERT_LT(resumed.size(), whole.size());
+	ASSERT_EQ(0, std::memcmp(whole.data(), resumed.data(), 5));  // the reset
+	tail = resumed.size() - 5;
+	ASSERT_EQ(0, std::memcmp(whole.data() + whole.size() - tail, resumed.data() + 5, tail));
+	ASSERT_EQ('F', whole[whole.size() - tail]);  // resumed at an XSIR's move to Shift-IR
+}
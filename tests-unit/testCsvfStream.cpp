@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include "svf2csvf.h"
+#include "csvfstream.h"
+#include "csvfopt.h"
+#include "xsvf.h"
+#include "private.h"
+
+namespace {
+	const char *const fileName = "testCsvfStream.svf";
+
+	void writeSvf() {
+		std::FILE *file = std::fopen(fileName, "wb");
+		ASSERT_TRUE(file != NULL);
+		std::fprintf(file, "RUNTEST 5 TCK;\n");
+		for ( uint32 i = 0; i < 500; i++ ) {
+			std::fprintf(file, "SIR 6 TDI (%02X);\n", i & 0x3F);
+			if ( i % 3 == 0 ) {
+				std::fprintf(file, "RUNTEST %u TCK;\n", i % 7);
+			}
+			std::fprintf(file, "SDR 32 TDI (%08X) TDO (%08X) MASK (%s);\n", i, ~i, (i & 4) ? "FFFF0000" : "00000000");
+			if ( i % 5 == 0 ) {
+				std::fprintf(file, "RUNTEST 100 TCK;\n");
+			}
+		}
+		std::fclose(file);
+	}
+
+	uint32 countCommands(const struct Buffer *csvfBuf, uint8 which) {
+		const uint8 *cmd = csvfBuf->data;
+		const uint8 *const end = csvfBuf->data + csvfBuf->length;
+		uint32 xsdrBytes = 0, count = 0;
+		while ( cmd < end ) {
+			if ( *cmd == which ) {
+				count++;
+			}
+			cmd += csvfCommandLength(cmd, &xsdrBytes);
+		}
+		return count;
+	}
+
+	void consume(struct CsvfQueue *queue, struct Buffer *result, uint32 maxBlocks, FLStatus *status) {
+		struct Buffer block;
+		BufferStatus bStatus = bufInitialise(&block, 1024, 0x00, NULL);
+		ASSERT_EQ(BUF_SUCCESS, bStatus);
+		for ( ;; ) {
+			*status = csvfQueueTake(queue, &block, NULL);
+			if ( *status || block.length == 0 || maxBlocks-- == 0 ) {
+				break;
+			}
+			bStatus = bufAppendBlock(result, block.data, block.length, NULL);
+			ASSERT_EQ(BUF_SUCCESS, bStatus);
+		}
+		csvfQueueCancel(queue);
+		bufDestroy(&block);
+	}
+
+	void putLong(std::FILE *file, uint32 value) {
+		std::fputc((int)(value >> 24), file);
+		std::fputc((int)(value >> 16) & 0xFF, file);
+		std::fputc((int)(value >> 8) & 0xFF, file);
+		std::fputc((int)value & 0xFF, file);
+	}
+
+	void writeXsvf(const char *name, bool truncate) {
+		std::FILE *file = std::fopen(name, "wb");
+		ASSERT_TRUE(file != NULL);
+		for ( uint32 i = 0; i < 300; i++ ) {
+			std::fputc(XSIR, file); std::fputc(6, file); std::fputc((int)i & 0x3F, file);
+			std::fputc(XRUNTEST, file); putLong(file, i % 4);
+			std::fputc(XSDRSIZE, file); putLong(file, 32);
+			std::fputc(XTDOMASK, file); putLong(file, (i & 1) ? 0xFFFFFFFFU : 0U);
+			std::fputc(XSDRTDO, file); putLong(file, i); putLong(file, ~i);
+			std::fputc(XSDRSIZE, file); putLong(file, 16);
+			std::fputc(XSDRB, file); std::fputc(0x12, file); std::fputc((int)i & 0xFF, file);
+			std::fputc(XSDRC, file); std::fputc(0x34, file); std::fputc(0x56, file);
+			std::fputc(XSDRE, file); std::fputc(0x78, file); std::fputc(0x9A, file);
+		}
+		if ( truncate ) {
+			std::fputc(XSDRTDO, file); std::fputc(0, file);  // needs four bytes
+		} else {
+			std::fputc(XCOMPLETE, file);
+		}
+		std::fclose(file);
+	}
+}
+
+TEST(FPGALink, testSvfStream) {
+	struct Buffer whole, streamed;
+	struct CsvfQueue queue;
+	BufferStatus bStatus;
+	FLStatus fStatus, takeStatus;
+	writeSvf();
+	bStatus = bufInitialise(&whole, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	bStatus = bufInitialise(&streamed, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	fStatus = flLoadSvfAndConvertToCsvf(fileName, &whole, NULL, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	fStatus = csvfOptimiseBuffer(&whole, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+
+	// Small blocks, so the queue fills up and the converter has to wait for the player
+	fStatus = csvfQueueInit(&queue, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	std::thread player(consume, &queue, &streamed, 0xFFFFFFFFU, &takeStatus);
+	fStatus = svfStream(fileName, &queue.sink, 64, NULL);
+	csvfQueueClose(&queue, fStatus, NULL);
+	player.join();
+	csvfQueueDestroy(&queue);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(FL_SUCCESS, takeStatus);
+	ASSERT_EQ(whole.length, streamed.length);
+	ASSERT_EQ(0, std::memcmp(whole.data, streamed.data, whole.length));
+
+	// A player which gives up stops the converter
+	fStatus = csvfQueueInit(&queue, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	bufZeroLength(&streamed);
+	std::thread quitter(consume, &queue, &streamed, 2U, &takeStatus);
+	fStatus = svfStream(fileName, &queue.sink, 64, NULL);
+	csvfQueueClose(&queue, fStatus, NULL);
+	quitter.join();
+	csvfQueueDestroy(&queue);
+	ASSERT_EQ(FL_BAD_STATE, fStatus);
+
+	bufDestroy(&streamed);
+	bufDestroy(&whole);
+	std::remove(fileName);
+}
+
+TEST(FPGALink, testXsvfStream) {
+	const char *const xsvfName = "testCsvfStream.xsvf";
+	struct Buffer whole, streamed;
+	struct CsvfBufferSink sink;
+	BufferStatus bStatus;
+	FLStatus fStatus;
+	writeXsvf(xsvfName, false);
+	bStatus = bufInitialise(&whole, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	bStatus = bufInitialise(&streamed, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	csvfBufferSinkInit(&sink, &streamed);
+	fStatus = flLoadXsvfAndConvertToCsvf(xsvfName, &whole, NULL, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+
+	// The public converter passes every nonzero XTDOMASK through; only the stream (which is for
+	// programming) is optimised, leaving just the first, because they're all the same
+	ASSERT_EQ(150U, countCommands(&whole, XTDOMASK));
+	fStatus = csvfOptimiseBuffer(&whole, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(1U, countCommands(&whole, XTDOMASK));
+	fStatus = xsvfStream(xsvfName, &sink.sink, 50, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(whole.length, streamed.length);
+	ASSERT_EQ(0, std::memcmp(whole.data, streamed.data, whole.length));
+	ASSERT_EQ(XCOMPLETE, streamed.data[streamed.length - 1]);
+
+	// A file which stops in the middle of a command is rejected
+	writeXsvf(xsvfName, true);
+	bufZeroLength(&streamed);
+	fStatus = xsvfStream(xsvfName, &sink.sink, 50, NULL);
+	ASSERT_EQ(FL_FILE_ERR, fStatus);
+
+	bufDestroy(&streamed);
+	bufDestroy(&whole);
+	std::remove(xsvfName);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include "flash.h"
+
+// A simple model of a 128KiB SPI flash, which stays busy for a few status reads after each
+// program or erase.
+namespace {
+	const uint32 memSize = 2*FLASH_SECTOR_SIZE;
+	uint8 mem[memSize];
+	bool writeEnabled;
+	uint32 busyCount;
+	uint32 numBatches;
+
+	uint32 addressOf(const uint8 *mosi) {
+		return (uint32)((mosi[1] << 16) | (mosi[2] << 8) | mosi[3]) % memSize;
+	}
+
+	FLStatus fakeXfer(
+		struct FLContext *, const struct FlashSeg *segs, uint32 numSegs, const char **)
+	{
+		numBatches++;
+		for ( uint32 i = 0; i < numSegs; i++ ) {
+			const struct FlashSeg *seg = segs + i;
+			uint8 mosi[4 + FLASH_PAGE_SIZE];
+			uint8 miso[0x10000];
+			std::memset(mosi, 0x00, sizeof(mosi));
+			std::memcpy(mosi, seg->mosi, seg->mosiLength);
+			std::memset(miso, 0xFF, seg->length);
+			switch ( mosi[0] ) {
+			case 0x9F:
+				miso[1] = 0x20; miso[2] = 0xBA; miso[3] = 0x18;
+				break;
+			case 0x06:
+				writeEnabled = true;
+				break;
+			case 0x05:
+				for ( uint32 j = 1; j < seg->length; j++ ) {
+					miso[j] = busyCount ? 0x03 : 0x00;
+					if ( busyCount ) {
+						busyCount--;
+					}
+				}
+				break;
+			case 0x03:
+				for ( uint32 j = 4; j < seg->length; j++ ) {
+					miso[j] = mem[(addressOf(mosi) + j - 4) % memSize];
+				}
+				break;
+			case 0x02:
+				if ( writeEnabled && !busyCount ) {
+					for ( uint32 j = 4; j < seg->length; j++ ) {
+						mem[addressOf(mosi) + j - 4] &= mosi[j];
+					}
+					writeEnabled = false;
+					busyCount = 10;
+				}
+				break;
+			case 0xD8:
+				if ( writeEnabled && !busyCount ) {
+					std::memset(mem + (addressOf(mosi) & ~(FLASH_SECTOR_SIZE - 1)), 0xFF, FLASH_SECTOR_SIZE);
+					writeEnabled = false;
+					busyCount = 100;  // longer than one batch of polls
+				}
+				break;
+			}
+			if ( seg->miso ) {
+				std::memcpy(seg->miso, miso, seg->length);
+			}
+		}
+		return FL_SUCCESS;
+	}
+}
+
+TEST(FPGALink, testFlashUpdate) {
+	uint8 data[FLASH_SECTOR_SIZE + 1000];
+	uint8 readBack[sizeof(data)];
+	uint32 jedecId;
+	FLStatus fStatus;
+	for ( uint32 i = 0; i < sizeof(data); i++ ) {
+		data[i] = (uint8)(i * 7 + (i >> 8));
+	}
+	std::memset(data + 512, 0xFF, FLASH_PAGE_SIZE);  // one page needs no programming
+	std::memset(mem, 0x00, sizeof(mem));
+	std::memset(mem + sizeof(data), 0x5A, memSize - sizeof(data));  // beyond the image
+	busyCount = 0;
+
+	fStatus = flashReadId(NULL, fakeXfer, &jedecId, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(0x20BA18U, jedecId);
+
+	// Two whole sectors of reads to compare, two erases, each needing extra polls, then one batch
+	// per page except the blank one, including those restoring the rest of the second sector, then
+	// two whole sectors of reads to verify
+	numBatches = 0;
+	fStatus = flashUpdate(NULL, fakeXfer, 0, sizeof(data), data, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(0, std::memcmp(mem, data, sizeof(data)));
+	for ( uint32 i = sizeof(data); i < memSize; i++ ) {
+		ASSERT_EQ(0x5A, mem[i]);
+	}
+	ASSERT_EQ(4U + 2U + 2*3 + 511 + 4, numBatches);
+
+	// Nothing has changed, so it's just the reads to compare
+	numBatches = 0;
+	fStatus = flashUpdate(NULL, fakeXfer, 0, sizeof(data), data, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(4U, numBatches);
+
+	// Clearing bits in one page of the second sector needs no erase, and only that sector verified
+	data[FLASH_SECTOR_SIZE + 300] &= 0x0F;
+	data[FLASH_SECTOR_SIZE + 301] = 0x00;
+	numBatches = 0;
+	fStatus = flashUpdate(NULL, fakeXfer, 0, sizeof(data), data, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(0, std::memcmp(mem, data, sizeof(data)));
+	ASSERT_EQ(4U + 1 + 2, numBatches);
+
+	// Setting a bit in the first sector means erasing it and programming it all again
+	data[100] = 0xFF;
+	numBatches = 0;
+	fStatus = flashUpdate(NULL, fakeXfer, 0, sizeof(data), data, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(0, std::memcmp(mem, data, sizeof(data)));
+	ASSERT_EQ(4U + 4 + 255 + 2, numBatches);
+
+	// A short update of the last sector keeps the rest of it, even when it needs an erase
+	data[FLASH_SECTOR_SIZE] = 0xFF;
+	numBatches = 0;
+	fStatus = flashUpdate(NULL, fakeXfer, FLASH_SECTOR_SIZE, 1000, data + FLASH_SECTOR_SIZE, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(0, std::memcmp(mem, data, sizeof(data)));
+	for ( uint32 i = sizeof(data); i < memSize; i++ ) {
+		ASSERT_EQ(0x5A, mem[i]);
+	}
+
+	fStatus = flashRead(NULL, fakeXfer, 100, 5000, readBack, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(0, std::memcmp(readBack, data + 100, 5000));
+
+	// Unaligned updates are refused
+	fStatus = flashUpdate(NULL, fakeXfer, 0x100, 16, data, NULL);
+	ASSERT_EQ(FL_BAD_STATE, fStatus);
+}
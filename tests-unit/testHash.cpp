@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include "hash.h"
+#include "private.h"
+
+TEST(FPGALink, testCrc32) {
+	const uint8 check[] = "123456789";
+	ASSERT_EQ(0x00000000U, hashCrc32(0, check, 0));
+	ASSERT_EQ(0xCBF43926U, hashCrc32(0, check, 9));
+
+	// Running CRCs give the same result as one-shot CRCs
+	ASSERT_EQ(0xCBF43926U, hashCrc32(hashCrc32(0, check, 4), check + 4, 5));
+}
+
+TEST(FPGALink, testFnv64) {
+	const uint8 check[] = "foobar";
+	ASSERT_EQ(0xCBF29CE484222325ULL, hashFnv64(HASH_FNV64_INIT, check, 0));
+	ASSERT_EQ(0xAF63DC4C8601EC8CULL, hashFnv64(HASH_FNV64_INIT, check + 4, 1));
+	ASSERT_EQ(0x85944171F73967E8ULL, hashFnv64(hashFnv64(HASH_FNV64_INIT, check, 2), check + 2, 4));
+}
+
+TEST(FPGALink, testHashProgFiles) {
+	const uint8 expected[] = {0x85, 0x94, 0x41, 0x71, 0xF7, 0x39, 0x67, 0xE8};
+	uint8 fingerprint[8];
+	FLStatus fStatus;
+	FILE *file = std::fopen("testHashA.bin", "wb");
+	std::fputs("foo", file);
+	std::fclose(file);
+	file = std::fopen("testHashB.bin", "wb");
+	std::fputs("bar", file);
+	std::fclose(file);
+
+	// The files are hashed in turn, as if they were one, and the hash is stored MSB-first
+	fStatus = hashProgFiles("testHashA.bin,testHashB.bin", fingerprint, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(0, std::memcmp(expected, fingerprint, 8));
+
+	// So the order matters
+	fStatus = hashProgFiles("testHashB.bin,testHashA.bin", fingerprint, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_NE(0, std::memcmp(expected, fingerprint, 8));
+
+	// A single file has no comma at all; missing files and empty names are refused
+	fStatus = hashProgFiles("testHashA.bin", fingerprint, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	fStatus = hashProgFiles("testHashA.bin,testHashC.bin", fingerprint, NULL);
+	ASSERT_EQ(FL_FILE_ERR, fStatus);
+	fStatus = hashProgFiles("testHashA.bin,", fingerprint, NULL);
+	ASSERT_EQ(FL_FILE_ERR, fStatus);
+	std::remove("testHashA.bin");
+	std::remove("testHashB.bin");
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libfpgalink.h>
+#include "private.h"
+
+TEST(FPGALink, testPortConfigCompile) {
+	struct FLPortConfig *prog = NULL, *pins = NULL, *bad = NULL;
+	uint32 readState;
+	FLStatus fStatus;
+
+	// Each kind of programming config compiles, with or without a file & extra pins
+	fStatus = flCompileProgConfig("XP:A7B3B4D0C01234567[D3+,D5?]:fpga.bit", &prog, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	flFreePortConfig(prog);
+	fStatus = flCompileProgConfig("AS:D5D6D1A0", &prog, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	flFreePortConfig(prog);
+	fStatus = flCompileProgConfig("LS:D5D6D3D4D2[D7-]", &prog, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	flFreePortConfig(prog);
+	fStatus = flCompileProgConfig("J:D0D2D3D4:a.svf,b.svf", &prog, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+
+	// Malformed configs are refused, including pins used twice
+	fStatus = flCompileProgConfig("XP:A7B3B4D0C01234567[A7+]", &bad, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	fStatus = flCompileProgConfig("XS:A7B3B4D0C0x", &bad, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	fStatus = flCompileProgConfig("Q:D0D2D3D4", &bad, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	fStatus = flCompilePortConfig("A12-,B2+,C7", &bad, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	ASSERT_EQ(NULL, bad);
+
+	// Neither kind may be used in place of the other; the device is never touched
+	fStatus = flCompilePortConfig("A12-,B2+,C7?", &pins, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	fStatus = flProgramBlobCompiled(NULL, pins, 0, NULL, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	fStatus = flMultiBitPortAccessCompiled(NULL, prog, &readState, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	flFreePortConfig(pins);
+	flFreePortConfig(prog);
+	flFreePortConfig(NULL);
+}
+
+TEST(FPGALink, testPortConfigAlgorithms) {
+	struct FLPortConfig *cfg = NULL, *bad = NULL;
+	FLStatus fStatus;
+
+	// Altera parallel: DATA0..DATA7 may be any bits of the data port, and the table maps each byte
+	fStatus = flCompileProgConfig("AP:D5D6D1B73560214", &cfg, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ('A', cfg->algoVendor);
+	ASSERT_EQ(PROG_PARALLEL, cfg->progOp);
+	ASSERT_EQ(1, cfg->dataPort);
+	ASSERT_EQ(3, cfg->ctrl[A_DCLK].port);
+	ASSERT_EQ(1, cfg->ctrl[A_DCLK].bit);
+	ASSERT_EQ(0x80, cfg->lookupTable[0x01]);  // DATA0 on B7
+	ASSERT_EQ(0x08, cfg->lookupTable[0x02]);  // DATA1 on B3
+	ASSERT_EQ(0x01, cfg->lookupTable[0x10]);  // DATA4 on B0
+	ASSERT_EQ(0x10, cfg->lookupTable[0x80]);  // DATA7 on B4
+	ASSERT_EQ(0x00, cfg->lookupTable[0x00]);
+	ASSERT_EQ(0xFF, cfg->lookupTable[0xFF]);
+	flFreePortConfig(cfg);
+
+	// Altera serial goes LSB-first, just like the micro
+	fStatus = flCompileProgConfig("AS:D5D6D1A0", &cfg, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ(PROG_SPI_SEND, cfg->progOp);
+	for ( uint32 i = 0; i < 256; i++ ) {
+		ASSERT_EQ(i, cfg->lookupTable[i]);
+	}
+	flFreePortConfig(cfg);
+
+	// Lattice wants MSB-first, so each byte is mirrored; CRESET_B is not in the list of pins
+	fStatus = flCompileProgConfig("LS:D5D6D3D4D2", &cfg, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	ASSERT_EQ('L', cfg->algoVendor);
+	ASSERT_EQ(PROG_SPI_SEND, cfg->progOp);
+	ASSERT_EQ(2, cfg->ctrl[L_SDI].bit);
+	ASSERT_EQ(0x80, cfg->lookupTable[0x01]);
+	ASSERT_EQ(0x01, cfg->lookupTable[0x80]);
+	ASSERT_EQ(0xF0, cfg->lookupTable[0x0F]);
+	ASSERT_EQ(0x2C, cfg->lookupTable[0x34]);
+	ASSERT_EQ(4U, cfg->numPins);
+	flFreePortConfig(cfg);
+
+	// A bit may not be used twice, whether as data or as one of the algorithm's own pins
+	fStatus = flCompileProgConfig("AP:D5D6D1B01234566", &bad, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	fStatus = flCompileProgConfig("AP:B5D6D1B01234567", &bad, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	fStatus = flCompileProgConfig("AS:D5D6D1D5", &bad, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	fStatus = flCompileProgConfig("LS:D5D6D3D4D3", &bad, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	fStatus = flCompileProgConfig("LS:D5D6D3D4D2[D6+]", &bad, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	ASSERT_EQ(NULL, bad);
+}
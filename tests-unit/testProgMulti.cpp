@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libfpgalink.h>
+
+// None of these get as far as opening a device, so the VID:PIDs are never looked up
+//
+TEST(FPGALink, testProgramMulti) {
+	const char *const vpList[] = {"1d50:602b:0002", "1d50:602b:0003", "1d50:602b:0004"};
+	FLStatus statuses[3];
+	const char *errors[3];
+	const char *error = NULL;
+	FLStatus fStatus;
+	uint32 i;
+
+	// A malformed config fails every device the same way
+	fStatus = flProgramMulti(vpList, 3, "Q:D0D2D3D4", "fpga.svf", 0, statuses, errors, &error);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	ASSERT_TRUE(error != NULL);
+	flFreeError(error);
+	error = NULL;
+	for ( i = 0; i < 3; i++ ) {
+		ASSERT_EQ(FL_CONF_FORMAT, statuses[i]);
+		ASSERT_EQ(NULL, errors[i]);
+	}
+
+	// So does a config which names no file when none is given
+	fStatus = flProgramMulti(vpList, 3, "J:D0D2D3D4", NULL, 0, statuses, errors, &error);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	ASSERT_TRUE(error != NULL);
+	flFreeError(error);
+	error = NULL;
+	for ( i = 0; i < 3; i++ ) {
+		ASSERT_EQ(FL_CONF_FORMAT, statuses[i]);
+		ASSERT_EQ(NULL, errors[i]);
+	}
+
+	// A missing file is a file error, whether it's given separately or in the config, and
+	// whether or not it needs converting
+	fStatus = flProgramMulti(vpList, 3, "J:D0D2D3D4", "nonexistent.svf", 2, statuses, errors, &error);
+	ASSERT_EQ(FL_FILE_ERR, fStatus);
+	ASSERT_TRUE(error != NULL);
+	flFreeError(error);
+	error = NULL;
+	for ( i = 0; i < 3; i++ ) {
+		ASSERT_EQ(FL_FILE_ERR, statuses[i]);
+		ASSERT_EQ(NULL, errors[i]);
+	}
+	fStatus = flProgramMulti(
+		vpList, 2, "XP:A7B3B4D0C01234567:nonexistent.bit", NULL, 0, statuses, NULL, &error);
+	ASSERT_EQ(FL_FILE_ERR, fStatus);
+	ASSERT_TRUE(error != NULL);
+	flFreeError(error);
+	ASSERT_EQ(FL_FILE_ERR, statuses[0]);
+	ASSERT_EQ(FL_FILE_ERR, statuses[1]);
+
+	// The return code is still valid without an error message
+	fStatus = flProgramMulti(vpList, 1, "Q:D0D2D3D4", "fpga.svf", 0, statuses, NULL, NULL);
+	ASSERT_EQ(FL_CONF_FORMAT, fStatus);
+	ASSERT_EQ(FL_CONF_FORMAT, statuses[0]);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <thread>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include "thread.h"
+#include "private.h"
+
+namespace {
+	uint32 numReports;
+	uint64 lastDone;
+
+	void onProgress(void *, FLProgPhase phase, uint64 done, uint64 total, double) {
+		ASSERT_EQ(FL_PHASE_DATA, phase);
+		ASSERT_EQ(1000U, total);
+		numReports++;
+		lastDone = done;
+	}
+}
+
+TEST(FPGALink, testProgress) {
+	struct FLContext handle;
+	struct Progress progress;
+	FLStatus fStatus;
+	std::memset(&handle, 0, sizeof(handle));
+	std::memset(&progress, 0, sizeof(progress));
+
+	// Without a progress context, nothing happens
+	fStatus = progAdvance(&handle, 10, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+
+	// Reports at the start, then roughly every one percent
+	handle.progress = &progress;
+	progress.func = onProgress;
+	numReports = 0;
+	fStatus = progPhase(&handle, FL_PHASE_DATA, 1000, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	for ( int i = 0; i < 1000; i++ ) {
+		fStatus = progAdvance(&handle, 1, NULL);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+	}
+	ASSERT_EQ(1U + 90U, numReports);
+	ASSERT_GE(lastDone, 990U);
+
+	// Cancellation shows up at the next chunk
+	threadAtomicSet(&progress.isCancelled, 1);
+	fStatus = progAdvance(&handle, 1, NULL);
+	ASSERT_EQ(FL_CANCELLED, fStatus);
+
+	// ...even when it comes from another thread, as flProgramCancel() does
+	threadAtomicSet(&progress.isCancelled, 0);
+	progress.func = NULL;
+	std::thread canceller(threadAtomicSet, &progress.isCancelled, 1U);
+	do {
+		fStatus = progAdvance(&handle, 1, NULL);
+	} while ( fStatus == FL_SUCCESS );
+	canceller.join();
+	ASSERT_EQ(FL_CANCELLED, fStatus);
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include "private.h"
+#include "hash.h"
+
+namespace {
+	const uint32 numFrames = 4;
+	uint8 golden[numFrames * FRAME_BYTES];
+	uint8 mask[numFrames * FRAME_BYTES];
+	uint8 frames[numFrames * FRAME_BYTES];
+	uint32 goldenCrcs[numFrames];
+	uint32 badFrames[numFrames];
+
+	// Golden frames of arbitrary data, with the top nibble of byte 10 and the whole of the last
+	// byte of each frame masked off, as if they held LUT RAM
+	void makeGolden(void) {
+		for ( uint32 i = 0; i < numFrames * FRAME_BYTES; i++ ) {
+			golden[i] = (uint8)(i * 7 + (i >> 8));
+		}
+		std::memset(mask, 0xFF, sizeof(mask));
+		for ( uint32 i = 0; i < numFrames; i++ ) {
+			mask[i * FRAME_BYTES + 10] = 0x0F;
+			mask[i * FRAME_BYTES + FRAME_BYTES - 1] = 0x00;
+		}
+		std::memcpy(frames, golden, sizeof(frames));
+	}
+
+	// The CRC of each golden frame, with the masked bits cleared if there's a mask
+	void makeCrcs(const uint8 *maskData) {
+		uint8 frame[FRAME_BYTES];
+		for ( uint32 i = 0; i < numFrames; i++ ) {
+			for ( uint32 j = 0; j < FRAME_BYTES; j++ ) {
+				frame[j] = golden[i * FRAME_BYTES + j];
+				if ( maskData ) {
+					frame[j] &= maskData[i * FRAME_BYTES + j];
+				}
+			}
+			goldenCrcs[i] = hashCrc32(0, frame, FRAME_BYTES);
+		}
+	}
+
+	// Scrub all the frames in one go, returning the number of bad ones
+	uint32 scrubAll(const uint8 *goldenData, const uint8 *maskData, const uint32 *crcs) {
+		struct ScrubContext scrub = {goldenData, maskData, crcs, badFrames, 0};
+		scrubSink(&scrub, 0, frames, numFrames);
+		return scrub.numBad;
+	}
+}
+
+TEST(FPGALink, testScrubCompare) {
+	struct ScrubContext scrub;
+	makeGolden();
+
+	// Unchanged frames are all good
+	ASSERT_EQ(0U, scrubAll(golden, NULL, NULL));
+	ASSERT_EQ(0U, scrubAll(golden, mask, NULL));
+
+	// A flip in a checked bit is found, whether it's in the eight-byte loop or the tail
+	frames[1 * FRAME_BYTES + 20] ^= 0x40;
+	frames[3 * FRAME_BYTES + FRAME_BYTES - 2] ^= 0x01;
+	ASSERT_EQ(2U, scrubAll(golden, NULL, NULL));
+	ASSERT_EQ(1U, badFrames[0]);
+	ASSERT_EQ(3U, badFrames[1]);
+	ASSERT_EQ(2U, scrubAll(golden, mask, NULL));
+	ASSERT_EQ(1U, badFrames[0]);
+	ASSERT_EQ(3U, badFrames[1]);
+
+	// Flips in masked bits only count without the mask
+	std::memcpy(frames, golden, sizeof(frames));
+	frames[0 * FRAME_BYTES + 10] ^= 0xF0;
+	frames[2 * FRAME_BYTES + FRAME_BYTES - 1] ^= 0xFF;
+	ASSERT_EQ(2U, scrubAll(golden, NULL, NULL));
+	ASSERT_EQ(0U, badFrames[0]);
+	ASSERT_EQ(2U, badFrames[1]);
+	ASSERT_EQ(0U, scrubAll(golden, mask, NULL));
+
+	// ...but the unmasked nibble of the same byte is still checked
+	frames[0 * FRAME_BYTES + 10] ^= 0x01;
+	ASSERT_EQ(1U, scrubAll(golden, mask, NULL));
+	ASSERT_EQ(0U, badFrames[0]);
+
+	// Frames arriving a chunk at a time are numbered from the start of the readback, and the bad
+	// ones accumulate
+	std::memcpy(frames, golden, sizeof(frames));
+	frames[0 * FRAME_BYTES + 100] ^= 0x02;
+	frames[3 * FRAME_BYTES + 200] ^= 0x80;
+	scrub.golden = golden;
+	scrub.mask = mask;
+	scrub.goldenCrcs = NULL;
+	scrub.badFrames = badFrames;
+	scrub.numBad = 0;
+	scrubSink(&scrub, 0, frames, 2);
+	scrubSink(&scrub, 2, frames + 2 * FRAME_BYTES, 2);
+	ASSERT_EQ(2U, scrub.numBad);
+	ASSERT_EQ(0U, badFrames[0]);
+	ASSERT_EQ(3U, badFrames[1]);
+}
+
+TEST(FPGALink, testScrubCrcs) {
+	makeGolden();
+
+	// Without a mask, the CRCs are of the raw frames, so any flip is found
+	makeCrcs(NULL);
+	ASSERT_EQ(0U, scrubAll(NULL, NULL, goldenCrcs));
+	frames[2 * FRAME_BYTES + FRAME_BYTES - 1] ^= 0x10;
+	ASSERT_EQ(1U, scrubAll(NULL, NULL, goldenCrcs));
+	ASSERT_EQ(2U, badFrames[0]);
+
+	// With one, the masked bits are cleared before the CRC is taken, so they may change freely
+	makeCrcs(mask);
+	std::memcpy(frames, golden, sizeof(frames));
+	ASSERT_EQ(0U, scrubAll(NULL, mask, goldenCrcs));
+	frames[1 * FRAME_BYTES + 10] ^= 0xA0;
+	frames[2 * FRAME_BYTES + FRAME_BYTES - 1] ^= 0x10;
+	ASSERT_EQ(0U, scrubAll(NULL, mask, goldenCrcs));
+	frames[1 * FRAME_BYTES + 10] ^= 0x04;
+	frames[3 * FRAME_BYTES] ^= 0x01;
+	ASSERT_EQ(2U, scrubAll(NULL, mask, goldenCrcs));
+	ASSERT_EQ(1U, badFrames[0]);
+	ASSERT_EQ(3U, badFrames[1]);
+
+	// Golden frames take precedence over CRCs when both are given
+	goldenCrcs[0] ^= 1;
+	std::memcpy(frames, golden, sizeof(frames));
+	ASSERT_EQ(0U, scrubAll(golden, mask, goldenCrcs));
+	ASSERT_EQ(1U, scrubAll(NULL, mask, goldenCrcs));
+	ASSERT_EQ(0U, badFrames[0]);
+}
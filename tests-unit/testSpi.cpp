@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libfpgalink.h>
+#include "private.h"
+
+TEST(FPGALink, testSpiBatchFraming) {
+	const uint32 segLengths[] = {1, 3, 2};
+	const uint8 sendData[] = {0x80, 0x01, 0x02, 0x03, 0xF0, 0x0E};
+	const uint8 msbFirst[] = {
+		0x01, 0x00, 0x01,
+		0x03, 0x00, 0x80, 0x40, 0xC0,
+		0x02, 0x00, 0x0F, 0x70
+	};
+	const uint8 lsbFirst[] = {
+		0x01, 0x00, 0x80,
+		0x03, 0x00, 0x01, 0x02, 0x03,
+		0x02, 0x00, 0xF0, 0x0E
+	};
+	uint8 stream[sizeof(msbFirst)];
+	uint8 recvData[sizeof(sendData)];
+
+	// Each transaction gets a little-endian count, and its bytes are bit-swapped for MSB-first
+	std::memset(stream, 0xAA, sizeof(stream));
+	spiBatchPack(stream, 3, segLengths, sendData, SPI_MSBFIRST);
+	ASSERT_EQ(0, std::memcmp(msbFirst, stream, sizeof(stream)));
+	spiBatchPack(stream, 3, segLengths, sendData, SPI_LSBFIRST);
+	ASSERT_EQ(0, std::memcmp(lsbFirst, stream, sizeof(stream)));
+
+	// Without data, zeros are sent
+	std::memset(stream, 0xAA, sizeof(stream));
+	spiBatchPack(stream, 3, segLengths, NULL, SPI_MSBFIRST);
+	ASSERT_EQ(0x03, stream[3]);
+	ASSERT_EQ(0x00, stream[4]);
+	ASSERT_EQ(0x00, stream[5]);
+	ASSERT_EQ(0x00, stream[7]);
+	ASSERT_EQ(0x00, stream[11]);
+
+	// The counts are stripped from the reply, and the data swapped back
+	std::memset(recvData, 0xAA, sizeof(recvData));
+	spiBatchUnpack(recvData, 3, segLengths, msbFirst, SPI_MSBFIRST);
+	ASSERT_EQ(0, std::memcmp(sendData, recvData, sizeof(recvData)));
+	std::memset(recvData, 0xAA, sizeof(recvData));
+	spiBatchUnpack(recvData, 3, segLengths, lsbFirst, SPI_LSBFIRST);
+	ASSERT_EQ(0, std::memcmp(sendData, recvData, sizeof(recvData)));
+
+	// Long transactions have a two-byte count, low byte first
+	{
+		const uint32 longLength[] = {0x1234};
+		uint8 longStream[2 + 0x1234];
+		spiBatchPack(longStream, 1, longLength, NULL, SPI_LSBFIRST);
+		ASSERT_EQ(0x34, longStream[0]);
+		ASSERT_EQ(0x12, longStream[1]);
+		ASSERT_EQ(0x00, longStream[1 + 0x1234]);
+	}
+}
+
+TEST(FPGALink, testSpiBatchCapability) {
+	struct FLContext handle;
+	const uint32 segLengths[] = {4};
+	uint8 data[4] = {0x9F, 0x00, 0x00, 0x00};
+	const char *error = NULL;
+	FLStatus fStatus;
+
+	// Firmware which didn't say it can run batches is refused before anything is sent
+	std::memset(&handle, 0, sizeof(handle));
+	fStatus = spiXferBatch(&handle, 1, segLengths, data, data, SPI_MSBFIRST, &error);
+	ASSERT_EQ(FL_PROTOCOL_ERR, fStatus);
+	ASSERT_TRUE(error != NULL);
+	flFreeError(error);
+}
@@ -20,7 +20,9 @@
 #include <makestuff/common.h>
 #include <makestuff/libbuffer.h>
 #include "svf2csvf.h"
+#include "csvfopt.h"
 #include "xsvf.h"
+#include "private.h"
 
 void testReadBytes(struct Buffer *buf, const char *expected) {
 	FLStatus fStatus;
@@ -49,10 +51,51 @@ TEST(FPGALink, testReadBytes) {
 	testReadBytes(&lineBuf, "DEADF00D");
 	testReadBytes(&lineBuf, "CAFEF00D1E");
 	testReadBytes(&lineBuf, "DEADCAFEBABE");
+	testReadBytes(&lineBuf, "0123456789ABCDEF0123456789ABCDEF");
+	testReadBytes(&lineBuf, "FEDCBA9876543210FEDCBA98765432100123456789ABCDEF01");
+	testReadBytes(&lineBuf, "00000000000000000000000000000000000000000000000000000000000000FF");
 
 	bufDestroy(&lineBuf);
 }
 
+TEST(FPGALink, testReadBytesLong) {
+	const char *const hexDigits = "0123456789abcdefABCDEF";
+	char hex[2*300 + 1];
+	uint8 expected[300];
+	struct Buffer buf;
+	BufferStatus bStatus;
+	FLStatus fStatus;
+	bStatus = bufInitialise(&buf, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	for ( uint32 i = 0; i < sizeof(expected); i++ ) {
+		const uint32 hi = (i * 7) % 22, lo = (i * 13 + 5) % 22;
+		hex[2*i] = hexDigits[hi];
+		hex[2*i + 1] = hexDigits[lo];
+		expected[i] = (uint8)(((hi < 16 ? hi : hi - 6) << 4) | (lo < 16 ? lo : lo - 6));
+	}
+
+	// Every length, so each of the wide, word & byte-at-a-time paths gets exercised
+	for ( uint32 length = 0; length <= sizeof(expected); length++ ) {
+		hex[2*length] = '\0';
+		fStatus = readBytes(&buf, hex, NULL);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+		ASSERT_EQ(length, buf.length);
+		ASSERT_EQ(0, std::memcmp(expected, buf.data, length));
+		hex[2*length] = hexDigits[((length * 7) % 22)];
+	}
+
+	// A bad digit anywhere is rejected
+	hex[2*40] = '\0';
+	for ( uint32 i = 0; i < 2*40; i++ ) {
+		const char save = hex[i];
+		hex[i] = (i & 1) ? 'g' : (char)0xC6;
+		fStatus = readBytes(&buf, hex, NULL);
+		ASSERT_EQ(FL_SVF_PARSE_ERR, fStatus);
+		hex[i] = save;
+	}
+	bufDestroy(&buf);
+}
+
 void testShift(const char *line, uint32 lineBits, const char *head, uint32 headBits, const char *tail, uint32 tailBits, const char *expectedHex) {
 	struct Buffer lineBuf;
 	struct Buffer headBuf;
@@ -852,3 +895,123 @@ TEST(FPGALink, testBuildIndex) {
 	ASSERT_EQ(csvfBuf.length, 40);
 	bufDestroy(&csvfBuf);
 }
+
+TEST(FPGALink, testParallelConvert) {
+	const char *const fileName = "testParallelConvert.svf";
+	std::FILE *file = std::fopen(fileName, "wb");
+	struct Buffer serial, parallel;
+	BufferStatus bStatus;
+	FLStatus fStatus;
+	ASSERT_TRUE(file != NULL);
+
+	// Plenty of statements relying on the TDI, header & length remembered from earlier ones
+	std::fprintf(file, "! Remembered state across chunk boundaries\nTRST OFF;\n");
+	for ( uint32 i = 0; i < 2000; i++ ) {
+		switch ( i % 7 ) {
+		case 0:
+			std::fprintf(file, "SIR 6 TDI (%02X);\n", i & 0x3F);
+			break;
+		case 1:
+			std::fprintf(file, "HDR %u TDI (%X);\n", i & 3, i & 3);
+			break;
+		case 2:
+			std::fprintf(file, "SDR 32 TDI (%08X);\n", i * 0x9E3779B9U);
+			break;
+		case 3:
+			std::fprintf(file, "SDR 32;\nRUNTEST %u TCK;\n", i);
+			break;
+		case 4:
+			std::fprintf(file, "SDR %u TDI (%04X\n  %04X);\n", 20 + (i & 15), i & 0xFFFF, i * 3 & 0xFFFF);
+			break;
+		case 5:
+			std::fprintf(file, (i >> 3) & 1 ? "TIR 4 TDI (F);\n" : "TIR 0;\n");
+			break;
+		default:
+			std::fprintf(file, "SDR 32 MASK (0000FFFF);\n");
+			break;
+		}
+	}
+	std::fclose(file);
+
+	bStatus = bufInitialise(&serial, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	bStatus = bufInitialise(&parallel, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	fStatus = flLoadSvfAndConvertToCsvf(fileName, &serial, NULL, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	for ( uint32 numThreads = 1; numThreads <= 8; numThreads++ ) {
+		bufZeroLength(&parallel);
+		fStatus = flLoadSvfAndConvertToCsvfParallel(fileName, &parallel, NULL, numThreads, NULL);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+		ASSERT_EQ(serial.length, parallel.length);
+		ASSERT_EQ(0, std::memcmp(serial.data, parallel.data, serial.length));
+	}
+	bufDestroy(&parallel);
+	bufDestroy(&serial);
+	std::remove(fileName);
+}
+
+// A chunk may start right after an SDR which set a TDO mask, relying on it being remembered; and
+// the mask may have changed without being sent, because that SDR didn't check TDO
+//
+TEST(FPGALink, testParallelConvertMask) {
+	const char *const fileName = "testParallelConvertMask.svf";
+	std::FILE *file = std::fopen(fileName, "wb");
+	struct Buffer serial, parallel;
+	uint32 serialSize = 0, parallelSize;
+	BufferStatus bStatus;
+	FLStatus fStatus;
+	ASSERT_TRUE(file != NULL);
+	std::fprintf(file, "! Remembered TDO masks across chunk boundaries\nTRST OFF;\n");
+	for ( uint32 i = 0; i < 2000; i++ ) {
+		switch ( i % 6 ) {
+		case 0:
+			std::fprintf(
+				file, "SDR 32 TDI (%08X) TDO (%08X) MASK (%s);\n", i, i * 0x9E3779B9U,
+				(i >> 3) & 1 ? "0000FFFF" : "FFFF0000");
+			break;
+		case 1:
+			std::fprintf(file, "SDR 32 TDI (%08X) TDO (%08X);\n", i, i * 3);
+			break;
+		case 2:
+			std::fprintf(file, "SDR 32 TDO (%08X);\nRUNTEST %u TCK;\n", i, i & 0xFF);
+			break;
+		case 3:
+			std::fprintf(file, "SDR 32 TDI (%08X) MASK (00FF00FF);\n", i);
+			break;
+		case 4:
+			std::fprintf(file, "SDR 32 TDI (%08X) TDO (%08X);\n", i * 5, i);
+			break;
+		default:
+			std::fprintf(file, (i >> 4) & 1 ? "HDR 4 TDI (0) TDO (0) MASK (%X);\n" : "HDR 0;\n", i & 15);
+			break;
+		}
+	}
+	std::fclose(file);
+
+	bStatus = bufInitialise(&serial, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	bStatus = bufInitialise(&parallel, 1024, 0x00, NULL);
+	ASSERT_EQ(BUF_SUCCESS, bStatus);
+	fStatus = flLoadSvfAndConvertToCsvf(fileName, &serial, &serialSize, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	fStatus = csvfOptimiseBuffer(&serial, NULL);
+	ASSERT_EQ(FL_SUCCESS, fStatus);
+	for ( uint32 numThreads = 1; numThreads <= 16; numThreads++ ) {
+		// The buffer size is reported afresh, not raised from whatever was there before
+		bufZeroLength(&parallel);
+		parallelSize = 0xDEADBEEF;
+		fStatus = flLoadSvfAndConvertToCsvfParallel(fileName, &parallel, &parallelSize, numThreads, NULL);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+		ASSERT_EQ(serialSize, parallelSize) << numThreads << " threads";
+
+		// A chunk may resend the mask in effect, which the optimiser drops again
+		fStatus = csvfOptimiseBuffer(&parallel, NULL);
+		ASSERT_EQ(FL_SUCCESS, fStatus);
+		ASSERT_EQ(serial.length, parallel.length) << numThreads << " threads";
+		ASSERT_EQ(0, std::memcmp(serial.data, parallel.data, serial.length)) << numThreads << " threads";
+	}
+	bufDestroy(&parallel);
+	bufDestroy(&serial);
+	std::remove(fileName);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include "private.h"
+
+TEST(FPGALink, testUserFrame) {
+	uint8 frame[USER_WRITE_HDR];
+
+	// Writes: sync byte, channel, big-endian count
+	userMakeHeader(frame, 0x03, 0x1234);
+	ASSERT_EQ(0x01, frame[0]);
+	ASSERT_EQ(0x03, frame[1]);
+	ASSERT_EQ(0x12, frame[2]);
+	ASSERT_EQ(0x34, frame[3]);
+
+	// Reads have bit 7 of the channel set, and a full frame has a count of zero
+	userMakeHeader(frame, 0x7F | 0x80, USER_FRAME_MAX);
+	ASSERT_EQ(0x01, frame[0]);
+	ASSERT_EQ(0xFF, frame[1]);
+	ASSERT_EQ(0x00, frame[2]);
+	ASSERT_EQ(0x00, frame[3]);
+}
+
+TEST(FPGALink, testUserScanBits) {
+	// A lone device: the frame is the whole scan
+	ASSERT_EQ(8U*(USER_WRITE_HDR + 16), userScanBits(0, 0, USER_WRITE_HDR + 16, 0));
+
+	// Writes to the device nearest TDO of four go through three BYPASS bits first
+	ASSERT_EQ(3 + 8U*(USER_WRITE_HDR + 16), userScanBits(3, 0, USER_WRITE_HDR + 16, 0));
+
+	// Writes to the device nearest TDI don't care what comes after it
+	ASSERT_EQ(8U*(USER_WRITE_HDR + 16), userScanBits(0, 3, USER_WRITE_HDR + 16, 0));
+
+	// Reads must go on long enough for the whole reply to come out of the far end of the chain
+	ASSERT_EQ(1 + 2 + 8U*(USER_READ_HDR + 16), userScanBits(1, 2, USER_WRITE_HDR, USER_READ_HDR + 16));
+
+	// ...but never shorter than the frame going in
+	ASSERT_EQ(8U*(USER_WRITE_HDR + 16), userScanBits(0, 0, USER_WRITE_HDR + 16, 1));
+}
+
+TEST(FPGALink, testUserChecks) {
+	struct FLContext handle;
+	uint8 data[4] = {0,};
+	FLStatus fStatus;
+	std::memset(&handle, 0, sizeof(handle));
+
+	// Zero-length transfers are refused
+	fStatus = jtagUserWrite(&handle, 0, 0, data, NULL);
+	ASSERT_EQ(FL_PROTOCOL_ERR, fStatus);
+	fStatus = jtagUserRead(&handle, 0, 0, data, NULL);
+	ASSERT_EQ(FL_PROTOCOL_ERR, fStatus);
+
+	// Nothing is shifted until jtagUserOpen() has succeeded
+	fStatus = jtagUserWrite(&handle, 0, sizeof(data), data, NULL);
+	ASSERT_EQ(FL_BAD_STATE, fStatus);
+	fStatus = jtagUserRead(&handle, 0, sizeof(data), data, NULL);
+	ASSERT_EQ(FL_BAD_STATE, fStatus);
+}